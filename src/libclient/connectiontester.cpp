@@ -2,6 +2,7 @@
 #include "measurement/ping/ping.h"
 #include "types.h"
 #include "networkhelper.h"
+#include "network/networkstate.h"
 
 #include <QNetworkConfigurationManager>
 #include <QNetworkConfiguration>
@@ -24,6 +25,9 @@
 #include <QTimer>
 #include <QNetworkRequest>
 #include <QNetworkReply>
+#include <QEventLoop>
+#include <QHash>
+#include <QSet>
 
 #ifdef Q_OS_LINUX
 #include <netinet/in.h>
@@ -41,6 +45,14 @@
 #include <sys/system_properties.h>
 #endif
 
+namespace
+{
+    // All checks of one run share this deadline
+    const int checkTimeout = 10000;
+
+    const char *publicIpUrl = "http://icanhazip.com";
+}
+
 class ConnectionTester::Private : public QObject
 {
     Q_OBJECT
@@ -49,26 +61,60 @@ public:
     Private(ConnectionTester *q)
     : q(q)
     , result(ConnectionTester::Offline)
+    , running(false)
+    , generation(0)
+    , configurationManager(NULL)
+    , publicIpReply(NULL)
     {
-        connect(&watcher, SIGNAL(started()), q, SIGNAL(runningChanged()));
-        connect(&watcher, SIGNAL(finished()), q, SIGNAL(runningChanged()));
+        deadline.setSingleShot(true);
+        deadline.setInterval(checkTimeout);
 
-        connect(&watcher, SIGNAL(started()), q, SIGNAL(started()));
-        connect(&watcher, SIGNAL(finished()), q, SIGNAL(finished()));
+        connect(&deadline, SIGNAL(timeout()), this, SLOT(timeout()));
+    }
+
+    ~Private()
+    {
+        // Workers call into this object, let them finish first
+        foreach (QFutureWatcher<QVariant> *watcher, watchers)
+        {
+            watcher->waitForFinished();
+        }
     }
 
     ConnectionTester *q;
 
     ConnectionTester::ResultType result;
-    QFutureWatcher<void> watcher;
 
-    void checkInterfaces();
+    bool running;
+    int generation;
+    QSet<int> pending;
+    QList<QFutureWatcher<QVariant> *> watchers;
+    QTimer deadline;
+
+    // Results which only change with the interfaces
+    QHash<int, QVariant> cache;
+    QNetworkConfigurationManager *configurationManager;
+
+    QNetworkAccessManager networkAccessManager;
+    QNetworkReply *publicIpReply;
+
+    void startChecks();
+    void startCheck(ConnectionTester::TestType testType, const QString &host = QString());
+    void finishCheck(ConnectionTester::TestType testType, const QVariant &value);
+    void finish();
+
+    QNetworkConfigurationManager *manager();
+    QVariant value(ConnectionTester::TestType testType);
+    QVariant runCheck(ConnectionTester::TestType testType, const QString &host) const;
+    static bool isCacheable(ConnectionTester::TestType testType);
+    static bool isSuccess(ConnectionTester::TestType testType, const QVariant &value);
+
     void checkSlow();
 
     QString findDefaultGateway() const;
     QString findDefaultDNS() const;
     QString localIpAddress() const;
-    QString publicIpAddress() const;
+    QString publicIpAddress();
     bool canPing(const QString &host, int *averagePing = 0) const;
 
 #ifdef Q_OS_MAC
@@ -78,18 +124,278 @@ public:
 #ifdef Q_OS_ANDROID
     QString propHelper(const QByteArray &property) const;
 #endif // Q_OS_ANDROID
+
+public slots:
+    void checkFinished();
+    void publicIpFinished();
+    void timeout();
+    void invalidate();
 };
 
-void ConnectionTester::Private::checkInterfaces()
+void ConnectionTester::Private::startChecks()
+{
+    ++generation;
+    running = true;
+
+    emit q->started();
+    emit q->runningChanged();
+
+    // Announce every check up front so they are listed in a stable order
+    QList<ConnectionTester::TestType> checks;
+    checks << ConnectionTester::ActiveInterface << ConnectionTester::DefaultGateway
+           << ConnectionTester::DefaultDns << ConnectionTester::PingDefaultGateway
+           << ConnectionTester::LocalIpAddress << ConnectionTester::PublicIpAddress
+           << ConnectionTester::PingGoogleDnsServer << ConnectionTester::PingGoogleDomain;
+
+    foreach (ConnectionTester::TestType testType, checks)
+    {
+        pending.insert(testType);
+        emit q->checkStarted(testType);
+    }
+
+    deadline.start();
+
+    finishCheck(ConnectionTester::ActiveInterface, manager()->isOnline());
+
+    startCheck(ConnectionTester::DefaultGateway);
+    startCheck(ConnectionTester::DefaultDns);
+    startCheck(ConnectionTester::LocalIpAddress);
+    startCheck(ConnectionTester::PublicIpAddress);
+    startCheck(ConnectionTester::PingGoogleDnsServer, "8.8.8.8");
+    startCheck(ConnectionTester::PingGoogleDomain, "google.com");
+}
+
+void ConnectionTester::Private::startCheck(ConnectionTester::TestType testType, const QString &host)
+{
+    if (cache.contains(testType))
+    {
+        finishCheck(testType, cache.value(testType));
+        return;
+    }
+
+    if (testType == ConnectionTester::PublicIpAddress)
+    {
+        publicIpReply = networkAccessManager.get(QNetworkRequest(QUrl(QString(publicIpUrl))));
+        publicIpReply->setProperty("generation", generation);
+        connect(publicIpReply, SIGNAL(finished()), this, SLOT(publicIpFinished()));
+        return;
+    }
+
+    QFutureWatcher<QVariant> *watcher = new QFutureWatcher<QVariant>(this);
+    watcher->setProperty("testType", testType);
+    watcher->setProperty("generation", generation);
+    connect(watcher, SIGNAL(finished()), this, SLOT(checkFinished()));
+    watchers.append(watcher);
+
+    watcher->setFuture(QtConcurrent::run(this, &ConnectionTester::Private::runCheck, testType, host));
+}
+
+void ConnectionTester::Private::finishCheck(ConnectionTester::TestType testType, const QVariant &value)
+{
+    if (!pending.remove(testType))
+    {
+        return;
+    }
+
+    if (isCacheable(testType) && isSuccess(testType, value))
+    {
+        cache.insert(testType, value);
+        manager();
+    }
+
+    emit q->checkFinished(testType, isSuccess(testType, value), value);
+
+    // Pinging the gateway has to wait for the lookup
+    if (testType == ConnectionTester::DefaultGateway)
+    {
+        if (isSuccess(testType, value))
+        {
+            startCheck(ConnectionTester::PingDefaultGateway, value.toString());
+        }
+        else
+        {
+            finishCheck(ConnectionTester::PingDefaultGateway, QVariant(0));
+        }
+    }
+
+    if (pending.isEmpty() && running)
+    {
+        finish();
+    }
+}
+
+void ConnectionTester::Private::finish()
+{
+    deadline.stop();
+    running = false;
+
+    emit q->finished();
+    emit q->runningChanged();
+}
+
+QNetworkConfigurationManager *ConnectionTester::Private::manager()
+{
+    if (!configurationManager)
+    {
+        configurationManager = new QNetworkConfigurationManager(this);
+
+        connect(configurationManager, SIGNAL(configurationAdded(QNetworkConfiguration)), this, SLOT(invalidate()));
+        connect(configurationManager, SIGNAL(configurationRemoved(QNetworkConfiguration)), this, SLOT(invalidate()));
+        connect(configurationManager, SIGNAL(configurationChanged(QNetworkConfiguration)), this, SLOT(invalidate()));
+        connect(configurationManager, SIGNAL(onlineStateChanged(bool)), this, SLOT(invalidate()));
+    }
+
+    return configurationManager;
+}
+
+QVariant ConnectionTester::Private::value(ConnectionTester::TestType testType)
+{
+    if (cache.contains(testType))
+    {
+        return cache.value(testType);
+    }
+
+    QVariant value;
+
+    if (testType == ConnectionTester::PublicIpAddress)
+    {
+        value = publicIpAddress();
+    }
+    else
+    {
+        value = runCheck(testType, QString());
+    }
+
+    // Failures are retried on the next call
+    if (isSuccess(testType, value))
+    {
+        cache.insert(testType, value);
+        manager();
+    }
+
+    return value;
+}
+
+QVariant ConnectionTester::Private::runCheck(ConnectionTester::TestType testType, const QString &host) const
+{
+    switch (testType)
+    {
+    case ConnectionTester::DefaultGateway:
+        return findDefaultGateway();
+
+    case ConnectionTester::DefaultDns:
+        return findDefaultDNS();
+
+    case ConnectionTester::LocalIpAddress:
+        return localIpAddress();
+
+    case ConnectionTester::PingDefaultGateway:
+    case ConnectionTester::PingGoogleDnsServer:
+    case ConnectionTester::PingGoogleDomain:
+    {
+        int avgPing = 0;
+        canPing(host, &avgPing);
+        return avgPing;
+    }
+
+    default:
+        return QVariant();
+    }
+}
+
+bool ConnectionTester::Private::isCacheable(ConnectionTester::TestType testType)
+{
+    switch (testType)
+    {
+    case ConnectionTester::DefaultGateway:
+    case ConnectionTester::DefaultDns:
+    case ConnectionTester::LocalIpAddress:
+    case ConnectionTester::PublicIpAddress:
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+bool ConnectionTester::Private::isSuccess(ConnectionTester::TestType testType, const QVariant &value)
+{
+    switch (testType)
+    {
+    case ConnectionTester::ActiveInterface:
+        return value.toBool();
+
+    case ConnectionTester::DefaultGateway:
+        return !value.toString().isEmpty() && value.toString() != "0.0.0.0";
+
+    case ConnectionTester::PingDefaultGateway:
+    case ConnectionTester::PingGoogleDnsServer:
+    case ConnectionTester::PingGoogleDomain:
+        return value.toInt() > 0;
+
+    default:
+        return !value.toString().isEmpty();
+    }
+}
+
+void ConnectionTester::Private::checkFinished()
+{
+    QFutureWatcher<QVariant> *watcher = static_cast<QFutureWatcher<QVariant> *>(sender());
+    watchers.removeAll(watcher);
+    watcher->deleteLater();
+
+    // Late results of a run which hit the deadline are dropped
+    if (watcher->property("generation").toInt() == generation)
+    {
+        finishCheck((ConnectionTester::TestType)watcher->property("testType").toInt(), watcher->result());
+    }
+}
+
+void ConnectionTester::Private::publicIpFinished()
+{
+    QNetworkReply *reply = qobject_cast<QNetworkReply *>(sender());
+    reply->deleteLater();
+
+    if (reply == publicIpReply)
+    {
+        publicIpReply = NULL;
+    }
+
+    if (reply->property("generation").toInt() != generation)
+    {
+        return;
+    }
+
+    QString ip;
+
+    if (reply->error() == QNetworkReply::NoError)
+    {
+        ip = QString(reply->readAll()).trimmed();
+    }
+
+    finishCheck(ConnectionTester::PublicIpAddress, ip);
+}
+
+void ConnectionTester::Private::timeout()
 {
-    q->checkOnline();
-    q->findDefaultGateway();
-    q->findDefaultDNS();
-    q->canPingGateway();
-    q->localIpAddress();
-    q->publicIpAddress();
-    q->canPingGoogleDnsServer();
-    q->canPingGoogleDomain();
+    foreach (int testType, pending)
+    {
+        emit q->checkFinished((ConnectionTester::TestType)testType, false, QVariant());
+    }
+
+    pending.clear();
+
+    if (publicIpReply)
+    {
+        publicIpReply->abort();
+    }
+
+    finish();
+}
+
+void ConnectionTester::Private::invalidate()
+{
+    cache.clear();
 }
 
 void ConnectionTester::Private::checkSlow()
@@ -115,6 +421,14 @@ QString ConnectionTester::Private::findDefaultGateway() const
     QString gw;
 
 #ifdef Q_OS_LINUX
+    // The network state follows the routing table already
+    NetworkState::SnapshotPtr state = NetworkState::snapshot();
+
+    if (state)
+    {
+        return state->defaultGateway;
+    }
+
     QFile file("/proc/net/route");
 
     if (!file.open(QIODevice::ReadOnly))
@@ -309,22 +623,20 @@ QString ConnectionTester::Private::localIpAddress() const
     return hostIp.toString();
 }
 
-QString ConnectionTester::Private::publicIpAddress() const
+QString ConnectionTester::Private::publicIpAddress()
 {
     QString ret;
     QEventLoop eventLoop;
-    QNetworkAccessManager mgr;
     QTimer timer;
 
     timer.setSingleShot(true);
 
-    QObject::connect(&mgr, SIGNAL(finished(QNetworkReply*)), &eventLoop, SLOT(quit()));
-    QObject::connect(&timer, SIGNAL(timeout()), &eventLoop, SLOT(quit()));
+    QNetworkReply *reply = networkAccessManager.get(QNetworkRequest(QUrl(QString(publicIpUrl))));
 
-    QNetworkRequest req(QUrl(QString("http://icanhazip.com")));
-    QNetworkReply *reply = mgr.get(req);
+    QObject::connect(reply, SIGNAL(finished()), &eventLoop, SLOT(quit()));
+    QObject::connect(&timer, SIGNAL(timeout()), &eventLoop, SLOT(quit()));
 
-    timer.start(10000);
+    timer.start(checkTimeout);
 
     eventLoop.exec();
 
@@ -424,19 +736,22 @@ ConnectionTester::ConnectionTester(QObject *parent)
 
 ConnectionTester::~ConnectionTester()
 {
-    d->watcher.waitForFinished();
     delete d;
 }
 
 bool ConnectionTester::isRunning() const
 {
-    return d->watcher.isRunning();
+    return d->running;
 }
 
 void ConnectionTester::start()
 {
-    QFuture<void> future = QtConcurrent::run(d, &ConnectionTester::Private::checkInterfaces);
-    d->watcher.setFuture(future);
+    if (d->running)
+    {
+        return;
+    }
+
+    d->startChecks();
 }
 
 ConnectionTester::ResultType ConnectionTester::result() const
@@ -447,8 +762,7 @@ ConnectionTester::ResultType ConnectionTester::result() const
 bool ConnectionTester::checkOnline()
 {
     emit checkStarted(ActiveInterface);
-    QNetworkConfigurationManager mgr;
-    bool online = mgr.isOnline();
+    bool online = d->manager()->isOnline();
     emit checkFinished(ActiveInterface, online, QVariant::fromValue(online));
     return online;
 }
@@ -456,38 +770,38 @@ bool ConnectionTester::checkOnline()
 QString ConnectionTester::findDefaultGateway()
 {
     emit checkStarted(DefaultGateway);
-    QString gw = d->findDefaultGateway();
-    emit checkFinished(DefaultGateway, !gw.isNull() && gw != "0.0.0.0", gw);
+    QString gw = d->value(DefaultGateway).toString();
+    emit checkFinished(DefaultGateway, Private::isSuccess(DefaultGateway, gw), gw);
     return gw;
 }
 
 QString ConnectionTester::findDefaultDNS()
 {
     emit checkStarted(DefaultDns);
-    QString dns = d->findDefaultDNS();
-    emit checkFinished(DefaultDns, !dns.isNull(), dns);
+    QString dns = d->value(DefaultDns).toString();
+    emit checkFinished(DefaultDns, !dns.isEmpty(), dns);
     return dns;
 }
 
 QString ConnectionTester::localIpAddress()
 {
     emit checkStarted(LocalIpAddress);
-    QString ip = d->localIpAddress();
-    emit checkFinished(LocalIpAddress, !ip.isNull(), ip);
+    QString ip = d->value(LocalIpAddress).toString();
+    emit checkFinished(LocalIpAddress, !ip.isEmpty(), ip);
     return ip;
 }
 
 QString ConnectionTester::publicIpAddress()
 {
     emit checkStarted(PublicIpAddress);
-    QString ip = d->publicIpAddress();
-    emit checkFinished(PublicIpAddress, !ip.isNull(), ip);
+    QString ip = d->value(PublicIpAddress).toString();
+    emit checkFinished(PublicIpAddress, !ip.isEmpty(), ip);
     return ip;
 }
 
 bool ConnectionTester::canPingGateway()
 {
-    return canPing(PingDefaultGateway, d->findDefaultGateway());
+    return canPing(PingDefaultGateway, d->value(DefaultGateway).toString());
 }
 
 bool ConnectionTester::canPingGoogleDnsServer()
@@ -678,15 +992,24 @@ void ConnectionTesterModel::onCheckStarted(ConnectionTester::TestType testType)
 
 void ConnectionTesterModel::onCheckFinished(ConnectionTester::TestType testType, bool success, const QVariant &result)
 {
-    Q_UNUSED(testType);
+    // Checks run concurrently and finish in any order
+    for (int i = 0; i < m_rows.size(); ++i)
+    {
+        RowData &data = m_rows[i];
 
-    RowData &data = m_rows.last();
-    data.success = success;
-    data.result = result;
-    data.finished = true;
+        if (data.testType != testType || data.finished)
+        {
+            continue;
+        }
+
+        data.success = success;
+        data.result = result;
+        data.finished = true;
 
-    QModelIndex idx = index(m_rows.size() - 1);
-    emit dataChanged(idx, idx);
+        QModelIndex idx = index(i);
+        emit dataChanged(idx, idx);
+        break;
+    }
 }
 
 void ConnectionTesterModel::onFinished()
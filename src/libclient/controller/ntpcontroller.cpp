@@ -1,33 +1,58 @@
 #include <QTimer>
 #include <QHostInfo>
+#include <QUdpSocket>
+#include <QReadWriteLock>
+#include <QHash>
+#include <qmath.h>
+#include <string.h>
 
 #include "ntpcontroller.h"
+#include "../timing/clock.h"
 #include "../log/logger.h"
 
 LOGGER(NtpController);
 
 static const int interval = 3600000;
 
+// Number of requests per synchronization and the gap between them
+static const int sampleCount = 8;
+static const int sampleInterval = 250;
+
+// Time to wait for late responses after the last request
+static const int responseTimeout = 2000;
+
+// Number of synchronizations used for the drift estimation
+static const int historySize = 8;
+
+// Drift estimations are only trusted if the history spans this many µs
+static const qint64 minDriftSpan = Q_INT64_C(600000000);
+
+// Maximum drift we accept in ppm (RFC 5905 uses 500 ppm)
+static const double maxDrift = 500.0;
+
+// Frequency tolerance added to the error between synchronizations (RFC 5905 PHI, 15 ppm)
+static const double driftTolerance = 15.0;
+
+static const qint64 ntpEpochOffset = Q_INT64_C(2208988800); // seconds from 1900 to 1970
+
 struct NtpTimestamp
 {
     quint32 seconds;
     quint32 fraction;
 
-    static QDateTime toDateTime(const NtpTimestamp &timestamp)
+    static qint64 toUSecs(const NtpTimestamp &timestamp)
     {
-        quint32 seconds = qFromBigEndian(timestamp.seconds);
-        quint32 fraction = qFromBigEndian(timestamp.fraction);
-        qint64 ms = seconds * 1000ll + fraction * 1000ll / 0x100000000ll;
+        qint64 seconds = qFromBigEndian(timestamp.seconds);
+        quint64 fraction = qFromBigEndian(timestamp.fraction);
 
-        return QDateTime::fromMSecsSinceEpoch(ms - 2208988800000ll);
+        return (seconds - ntpEpochOffset) * 1000000 + (qint64)((fraction * 1000000) >> 32);
     }
 
-    static NtpTimestamp fromDateTime(const QDateTime &timestamp)
+    static NtpTimestamp fromUSecs(qint64 usecs)
     {
         NtpTimestamp result;
-        qint64 ms = timestamp.toMSecsSinceEpoch() + 2208988800000ll;
-        quint32 seconds = ms / 1000;
-        quint32 fraction = 0x100000000ll * (ms % 1000) / 1000;
+        quint32 seconds = usecs / 1000000 + ntpEpochOffset;
+        quint32 fraction = ((quint64)(usecs % 1000000) << 32) / 1000000;
 
         result.seconds = qToBigEndian(seconds);
         result.fraction = qToBigEndian(fraction);
@@ -59,6 +84,21 @@ struct NtpPacket
     NtpTimestamp transmitTimestamp;
 };
 
+// NTP short format (16.16 seconds) to µs
+static qint64 shortToUSecs(quint32 value)
+{
+    return ((quint64)qFromBigEndian(value) * 1000000) >> 16;
+}
+
+struct NtpSample
+{
+    qint64 monotonic; // local monotonic time of the response in µs
+    qint64 offset; // µs
+    qint64 delay; // µs
+    qint64 rootDistance; // µs
+    qint64 localTime; // µs since epoch, uncorrected
+};
+
 class NtpController::Private : public QObject
 {
     Q_OBJECT
@@ -66,15 +106,111 @@ class NtpController::Private : public QObject
 public:
     Private(NtpController *q)
     : q(q)
+    , server("ptbtime1.ptb.de")
+    , socket(NULL)
+    , lookupId(-1)
+    , requestsSent(0)
+    , synchronized(false)
+    , offset(0)
+    , delay(0)
+    , drift(0.0)
+    , baseError(0)
+    , syncMonotonic(0)
     {
         connect(&timer, SIGNAL(timeout()), q, SLOT(update()));
         timer.start(interval);
+
+        requestTimer.setInterval(sampleInterval);
+        connect(&requestTimer, SIGNAL(timeout()), q, SLOT(sendRequest()));
+
+        evaluateTimer.setSingleShot(true);
+        connect(&evaluateTimer, SIGNAL(timeout()), q, SLOT(evaluate()));
+
+        // The monotonic clock is anchored to the wall clock once, all
+        // local timestamps are taken from this timeline
+        wallBase = QDateTime::currentMSecsSinceEpoch() * 1000 - monotonic();
     }
 
     NtpController *q;
     QTimer timer;
+    QTimer requestTimer;
+    QTimer evaluateTimer;
+
+    QString server;
+    QHostAddress serverAddress;
+    QUdpSocket *socket;
+    int lookupId;
+    QString errorString;
+
+    // Requests in flight, keyed by the transmit timestamp we sent
+    QHash<quint64, qint64> pendingRequests;
+    QList<NtpSample> samples;
+    int requestsSent;
+    QList<NtpSample> history;
+
+    qint64 wallBase;
+
+    // Clock state, guarded by lock since it's read from other threads
+    mutable QReadWriteLock lock;
+    bool synchronized;
+    qint64 offset; // µs
+    qint64 delay; // µs
+    double drift; // ppm
+    qint64 baseError; // µs
+    qint64 syncMonotonic; // µs
+    qint64 syncLocalTime; // µs since epoch, uncorrected
+    qint64 syncNetworkTime; // µs since epoch
+
+    // Functions
+    qint64 monotonic() const;
+    qint64 localUSecs() const;
+    void estimateDrift();
 };
 
+qint64 NtpController::Private::monotonic() const
+{
+    return Clock::monotonic() / 1000;
+}
+
+qint64 NtpController::Private::localUSecs() const
+{
+    return wallBase + monotonic();
+}
+
+void NtpController::Private::estimateDrift()
+{
+    // Least squares fit of the offset over the local time
+    if (history.size() < 2 || history.last().monotonic - history.first().monotonic < minDriftSpan)
+    {
+        return;
+    }
+
+    double meanX = 0, meanY = 0;
+
+    foreach (const NtpSample &sample, history)
+    {
+        meanX += sample.monotonic;
+        meanY += sample.offset;
+    }
+
+    meanX /= history.size();
+    meanY /= history.size();
+
+    double sxy = 0, sxx = 0;
+
+    foreach (const NtpSample &sample, history)
+    {
+        sxy += (sample.monotonic - meanX) * (sample.offset - meanY);
+        sxx += (sample.monotonic - meanX) * (sample.monotonic - meanX);
+    }
+
+    if (sxx > 0)
+    {
+        double ppm = sxy / sxx * 1000000.0;
+        drift = qBound(-maxDrift, ppm, maxDrift);
+    }
+}
+
 NtpController::NtpController(QObject *parent)
 : Controller(parent)
 , d(new Private(this))
@@ -83,32 +219,73 @@ NtpController::NtpController(QObject *parent)
 
 NtpController::~NtpController()
 {
+    if (d->lookupId != -1)
+    {
+        QHostInfo::abortHostLookup(d->lookupId);
+    }
+
     delete d;
 }
 
 void NtpController::update()
 {
-    QHostInfo hostInfo = QHostInfo::fromName("ptbtime1.ptb.de");
+    // Already in progress
+    if (d->lookupId != -1 || d->requestTimer.isActive() || d->evaluateTimer.isActive())
+    {
+        return;
+    }
+
+    d->lookupId = QHostInfo::lookupHost(d->server, this, SLOT(lookupFinished(QHostInfo)));
+}
+
+void NtpController::lookupFinished(const QHostInfo &hostInfo)
+{
+    d->lookupId = -1;
+
+    QHostAddress ntpServer;
 
-    if (!hostInfo.addresses().isEmpty())
+    // prefer IPv4, NTP servers often don't answer on IPv6
+    foreach (const QHostAddress &address, hostInfo.addresses())
+    {
+        if (ntpServer.isNull() || address.protocol() == QAbstractSocket::IPv4Protocol)
+        {
+            ntpServer = address;
+        }
+
+        if (address.protocol() == QAbstractSocket::IPv4Protocol)
+        {
+            break;
+        }
+    }
+
+    if (!ntpServer.isNull())
     {
-        QHostAddress ntpServer = hostInfo.addresses().first();
         sync(ntpServer);
     }
     else
     {
-        LOG_WARNING("could not resolve ntp server");
+        LOG_WARNING(QString("could not resolve ntp server %1: %2").arg(d->server).arg(hostInfo.errorString()));
     }
 }
 
 Controller::Status NtpController::status() const
 {
-    return Controller::Unknown;
+    if (d->requestTimer.isActive() || d->evaluateTimer.isActive() || d->lookupId != -1)
+    {
+        return Controller::Running;
+    }
+
+    if (!d->errorString.isEmpty())
+    {
+        return Controller::Error;
+    }
+
+    return d->synchronized ? Controller::Finished : Controller::Unknown;
 }
 
 QString NtpController::errorString() const
 {
-    return "";
+    return d->errorString;
 }
 
 bool NtpController::init()
@@ -118,26 +295,71 @@ bool NtpController::init()
     return true;
 }
 
-bool NtpController::sync(QHostAddress &host)
+void NtpController::setServer(const QString &hostname)
+{
+    d->server = hostname;
+}
+
+QString NtpController::server() const
 {
+    return d->server;
+}
+
+bool NtpController::sync(const QHostAddress &host)
+{
+    if (!d->socket)
+    {
+        d->socket = new QUdpSocket(this);
+        connect(d->socket, SIGNAL(readyRead()), this, SLOT(readResponse()));
+    }
+
+    d->serverAddress = host;
+    d->pendingRequests.clear();
+    d->samples.clear();
+    d->requestsSent = 0;
+
+    sendRequest();
+
+    if (d->requestsSent == 0)
+    {
+        return false;
+    }
+
+    d->requestTimer.start();
+
+    return true;
+}
+
+void NtpController::sendRequest()
+{
+    if (d->requestsSent >= sampleCount)
+    {
+        d->requestTimer.stop();
+        d->evaluateTimer.start(responseTimeout);
+        return;
+    }
+
     NtpPacket packet;
 
     memset(&packet, 0, sizeof(packet));
     packet.flags.mode = 3;
     packet.flags.versionNumber = 4;
-    packet.transmitTimestamp = NtpTimestamp::fromDateTime(
-                                   QDateTime::currentDateTimeUtc());
 
-    m_socket = new QUdpSocket(this);
-    connect(m_socket, SIGNAL(readyRead()), this, SLOT(readResponse()));
+    qint64 t1 = d->localUSecs();
+    packet.transmitTimestamp = NtpTimestamp::fromUSecs(t1);
 
-    if (m_socket->writeDatagram((char *)&packet, sizeof(packet), host, 123) < 0)
+    if (d->socket->writeDatagram((char *)&packet, sizeof(packet), d->serverAddress, 123) < 0)
     {
+        d->errorString = d->socket->errorString();
+        d->requestTimer.stop();
         emit error("writeDatagram");
-        return false;
+        return;
     }
 
-    return true;
+    // The server echoes our transmit timestamp as origin timestamp
+    quint64 key = ((quint64)packet.transmitTimestamp.seconds << 32) | packet.transmitTimestamp.fraction;
+    d->pendingRequests.insert(key, t1);
+    d->requestsSent++;
 }
 
 void NtpController::readResponse()
@@ -147,48 +369,169 @@ void NtpController::readResponse()
     quint16 port;
     qint64 bytes;
 
-    memset(&packet, 0, sizeof(packet));
+    while (d->socket->hasPendingDatagrams())
+    {
+        memset(&packet, 0, sizeof(packet));
+
+        bytes = d->socket->readDatagram((char *)&packet, sizeof(packet), &address,
+                                        &port);
 
-    while (m_socket->hasPendingDatagrams())
+        qint64 monotonicTime = d->monotonic();
+        qint64 t4 = d->wallBase + monotonicTime;
+
+        // Only accept server replies which are not kiss-o'-death packets
+        if (bytes != 48 || packet.flags.mode != 4 || packet.peerClockStratum == 0 ||
+            packet.receiveTimestamp.seconds == 0)
+        {
+            continue;
+        }
+
+        quint64 key = ((quint64)packet.originTimestamp.seconds << 32) | packet.originTimestamp.fraction;
+
+        if (!d->pendingRequests.contains(key))
+        {
+            LOG_DEBUG("Dropping unexpected ntp response");
+            continue;
+        }
+
+        qint64 t1 = d->pendingRequests.take(key);
+        qint64 t2 = NtpTimestamp::toUSecs(packet.receiveTimestamp);
+        qint64 t3 = NtpTimestamp::toUSecs(packet.transmitTimestamp);
+
+        NtpSample sample;
+        sample.monotonic = monotonicTime;
+        sample.localTime = t4;
+        sample.offset = ((t2 - t1) + (t3 - t4)) / 2;
+        sample.delay = qMax(Q_INT64_C(0), (t4 - t1) - (t3 - t2));
+        sample.rootDistance = shortToUSecs(packet.rootDelay) / 2 + shortToUSecs(packet.rootDispersion);
+
+        d->samples.append(sample);
+    }
+
+    // All answers received, don't wait for the timeout
+    if (d->requestsSent >= sampleCount && d->pendingRequests.isEmpty() && d->evaluateTimer.isActive())
     {
-        bytes = m_socket->readDatagram((char *)&packet, sizeof(packet), &address,
-                               &port);
+        d->evaluateTimer.stop();
+        evaluate();
+    }
+}
 
-        m_localTime = QDateTime::currentDateTime();
+void NtpController::evaluate()
+{
+    d->requestTimer.stop();
+    d->pendingRequests.clear();
+
+    if (d->samples.isEmpty())
+    {
+        d->errorString = QString("No answer from ntp server %1").arg(d->serverAddress.toString());
+        LOG_WARNING(d->errorString);
+        emit error(d->errorString);
+        return;
+    }
+
+    // The sample with the smallest delay has the smallest error
+    NtpSample best = d->samples.first();
 
-        if (bytes == 48 && packet.receiveTimestamp.seconds > 0)
+    foreach (const NtpSample &sample, d->samples)
+    {
+        if (sample.delay < best.delay)
         {
-            m_networkTime = NtpTimestamp::toDateTime(packet.receiveTimestamp);
+            best = sample;
         }
     }
 
-    m_socket->close();
-    delete m_socket;
+    d->history.append(best);
+
+    while (d->history.size() > historySize)
+    {
+        d->history.removeFirst();
+    }
+
+    {
+        QWriteLocker locker(&d->lock);
+
+        d->offset = best.offset;
+        d->delay = best.delay;
+        d->baseError = best.delay / 2 + best.rootDistance;
+        d->syncMonotonic = best.monotonic;
+        d->syncLocalTime = best.localTime;
+        d->syncNetworkTime = best.localTime + best.offset;
+        d->estimateDrift();
+        d->synchronized = true;
+    }
+
+    // readers of the corrected time don't take the lock
+    Clock::setCorrection((d->wallBase + d->offset) * 1000, d->syncMonotonic * 1000, d->drift);
+
+    d->errorString.clear();
+
+    LOG_DEBUG(QString("Clock offset %1 us, delay %2 us, drift %3 ppm (%4 samples)")
+              .arg(best.offset).arg(best.delay).arg(d->drift, 0, 'f', 2).arg(d->samples.size()));
+
+    d->samples.clear();
+
+    emit synchronized();
+}
+
+bool NtpController::isSynchronized() const
+{
+    QReadLocker locker(&d->lock);
+    return d->synchronized;
 }
 
 QDateTime NtpController::localTime() const
 {
-    return m_localTime;
+    QReadLocker locker(&d->lock);
+    return d->synchronized ? QDateTime::fromMSecsSinceEpoch(d->syncLocalTime / 1000) : QDateTime();
 }
 
 QDateTime NtpController::networkTime() const
 {
-    return m_networkTime;
+    QReadLocker locker(&d->lock);
+    return d->synchronized ? QDateTime::fromMSecsSinceEpoch(d->syncNetworkTime / 1000) : QDateTime();
 }
 
 QDateTime NtpController::currentDateTime() const
 {
-    return QDateTime::currentDateTime().addSecs(this->offset());
+    return Clock::currentDateTime();
+}
+
+qint64 NtpController::currentUSecsSinceEpoch() const
+{
+    return Clock::now() / 1000;
+}
+
+qint64 NtpController::offset() const
+{
+    // The offset to the system clock, which is what callers compare against
+    return (currentUSecsSinceEpoch() - QDateTime::currentMSecsSinceEpoch() * 1000) / 1000;
 }
 
-quint64 NtpController::offset() const
+qint64 NtpController::delay() const
 {
-    if (!m_localTime.isValid() || !m_networkTime.isValid())
+    QReadLocker locker(&d->lock);
+    return d->delay;
+}
+
+double NtpController::drift() const
+{
+    QReadLocker locker(&d->lock);
+    return d->drift;
+}
+
+qint64 NtpController::clockError() const
+{
+    qint64 monotonicTime = d->monotonic();
+
+    QReadLocker locker(&d->lock);
+
+    if (!d->synchronized)
     {
-        return 0;
+        return -1;
     }
 
-    return m_localTime.secsTo(m_networkTime);
+    // The error grows with the frequency tolerance since the last synchronization
+    return d->baseError + (qint64)((monotonicTime - d->syncMonotonic) * driftTolerance / 1000000.0);
 }
 
 #include "ntpcontroller.moc"
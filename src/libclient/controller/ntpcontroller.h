@@ -6,11 +6,15 @@
 #include <QtEndian>
 #include <QDateTime>
 #include <QObject>
-#include <QUdpSocket>
+#include <QHostAddress>
+
+class QHostInfo;
 
 class CLIENT_API NtpController : public Controller
 {
     Q_OBJECT
+    Q_PROPERTY(qint64 offset READ offset NOTIFY synchronized)
+    Q_PROPERTY(qint64 clockError READ clockError NOTIFY synchronized)
 
 public:
     explicit NtpController(QObject *parent = 0);
@@ -21,25 +25,44 @@ public:
     QString errorString() const;
 
     bool init();
-    bool sync(QHostAddress &host);
+
+    void setServer(const QString &hostname);
+    QString server() const;
+
+    bool sync(const QHostAddress &host);
+    bool isSynchronized() const;
+
     QDateTime localTime() const;
     QDateTime networkTime() const;
+
+    // Corrected time, see Clock for the lock-free variants
     QDateTime currentDateTime() const;
-    quint64 offset() const;
+    qint64 currentUSecsSinceEpoch() const;
+
+    // Offset to the local clock in ms
+    qint64 offset() const;
+
+    // Round trip delay of the selected sample in µs
+    qint64 delay() const;
+
+    // Estimated drift of the local clock in ppm
+    double drift() const;
+
+    // Estimated maximum clock error in µs
+    qint64 clockError() const;
 
 signals:
     void error(QString message);
+    void synchronized();
 
-private:
-    QUdpSocket *m_socket;
-    QDateTime m_localTime;
-    QDateTime m_networkTime;
+public slots:
+    void update();
 
 private slots:
+    void lookupFinished(const QHostInfo &hostInfo);
+    void sendRequest();
     void readResponse();
-
-public slots:
-    void update();
+    void evaluate();
 
 protected:
     class Private;
@@ -11,6 +11,7 @@
 #include "../client.h"
 #include "../timing/timer.h"
 #include "../storage/storagepaths.h"
+#include "../storage/jsonwriter.h"
 
 #include <QPointer>
 #include <QStringList>
@@ -62,6 +63,30 @@ public:
         return map;
     }
 
+    // Writes the reports straight away, a full backlog as QVariantMap
+    // costs more than the upload itself
+    QByteArray toJson() const
+    {
+        QByteArray json;
+        JsonWriter writer(&json);
+
+        writer.beginObject();
+        writer.name("device_id");
+        writer.write(deviceId());
+        writer.name("reports");
+        writer.beginArray();
+
+        foreach (const Report &report, m_reports)
+        {
+            report.writeJson(&writer);
+        }
+
+        writer.endArray();
+        writer.endObject();
+
+        return json;
+    }
+
 protected:
     ReportList m_reports;
 };
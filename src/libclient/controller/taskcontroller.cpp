@@ -62,8 +62,15 @@ public:
     GetResourceRequest scheduleRequest;
     GetScheduleResponse scheduleResponse;
 
+    // Changes of the current instruction which are applied once all schedules arrived
+    QString pendingVersion;
+    QList<ScheduleId> pendingRemovals;
+
     Timer timer;
 
+    // Functions
+    void applyChanges(const ScheduleDefinitionList &schedules);
+
 public slots:
     void updateTimer();
     void instructionFinished();
@@ -102,13 +109,43 @@ void TaskController::Private::updateTimer()
     timer.start();
 }
 
+void TaskController::Private::applyChanges(const ScheduleDefinitionList &schedules)
+{
+    QList<ScheduleId> removals = pendingRemovals;
+
+    // changed schedules replace the ones we already have
+    foreach (const ScheduleDefinition &schedule, schedules)
+    {
+        if (scheduler->knownTestId(schedule.id()))
+        {
+            removals.append(schedule.id());
+        }
+    }
+
+    scheduler->update(schedules, removals);
+
+    LOG_DEBUG(QString("Applied schedule version %1: %2 schedules, %3 removed")
+              .arg(pendingVersion).arg(schedules.size()).arg(pendingRemovals.size()));
+
+    // only now it is safe to ask for changes since this version
+    settings->setScheduleVersion(pendingVersion);
+    pendingRemovals.clear();
+}
+
 void TaskController::Private::instructionFinished()
 {
+    if (instructionRequester.notModified())
+    {
+        LOG_DEBUG("Schedules not modified");
+        return;
+    }
+
     // check if we received a kill signal
     if (instructionResponse.killSwitch() == "data")
     {
         Storage storage;
         storage.deleteData();
+        settings->setScheduleVersion(QString());
 
         LOG_INFO(QString("Removed all local data as instructed by the server."));
     }
@@ -129,11 +166,20 @@ void TaskController::Private::instructionFinished()
     }
 
     scheduleRequest.clearResourceIds();
+    pendingRemovals.clear();
+
+    // the server version wins, otherwise fall back to the ETag
+    pendingVersion = instructionResponse.version();
+
+    if (pendingVersion.isEmpty())
+    {
+        pendingVersion = QString::fromUtf8(instructionRequester.eTag()).remove('"');
+    }
 
-    // check which schedules we need
+    // check which schedules we need, a delta only lists new or changed ones
     foreach (const ScheduleId &id, instructionResponse.scheduleIds())
     {
-        if (!scheduler->knownTestId(id))
+        if (instructionResponse.isDelta() || !scheduler->knownTestId(id))
         {
             scheduleRequest.addResourceId(id.toInt());
         }
@@ -144,23 +190,24 @@ void TaskController::Private::instructionFinished()
     {
         if (scheduler->knownTestId(id))
         {
-            scheduler->dequeue(id);
+            pendingRemovals.append(id);
         }
     }
 
     // get new schedules
-    if(!scheduleRequest.resourceIds().isEmpty())
+    if (!scheduleRequest.resourceIds().isEmpty())
     {
         scheduleRequester.start();
     }
+    else
+    {
+        applyChanges(ScheduleDefinitionList());
+    }
 }
 
 void TaskController::Private::scheduleFinished()
 {
-    foreach (const ScheduleDefinition &testDefinition, scheduleResponse.tasks())
-    {
-        scheduler->enqueue(testDefinition);
-    }
+    applyChanges(scheduleResponse.tasks());
 }
 
 void TaskController::Private::instructionError()
@@ -170,7 +217,9 @@ void TaskController::Private::instructionError()
 
 void TaskController::Private::scheduleError()
 {
+    // keep the old version, the next poll asks for the same changes again
     LOG_ERROR(QString("Error fetching schedules: %1").arg(scheduleRequester.errorString()));
+    pendingRemovals.clear();
 }
 
 void TaskController::Private::timingChanged()
@@ -215,6 +264,14 @@ QString TaskController::errorString() const
 
 void TaskController::fetchTasks()
 {
+    // ask only for changes since the version we applied last
+    QString version = d->settings->scheduleVersion();
+
+    QVariantMap data;
+    data.insert("since", version);
+    d->instructionRequest.addData(data);
+    d->instructionRequester.setETag(version.isEmpty() ? QByteArray() : QString("\"%1\"").arg(version).toUtf8());
+
     d->instructionRequester.start();
 }
 
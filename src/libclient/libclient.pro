@@ -109,23 +109,33 @@ SOURCES +=  \
     report/reportstorage.cpp \
     report/reportscheduler.cpp \
     report/report.cpp \
+    report/devicestatecolumns.cpp \
     task/taskvalidator.cpp \
     task/taskexecutor.cpp \
     task/task.cpp \
     task/result.cpp \
+    task/crosstrafficsampler.cpp \
     network/networkmanager.cpp \
     measurement/measurementfactory.cpp \
     measurement/measurement.cpp \
     measurement/measurementdefinition.cpp \
+    measurement/streamingstats.cpp \
     measurement/btc/btc_mp.cpp \
     measurement/btc/btc_ma.cpp \
     measurement/btc/btc_definition.cpp \
     network/udpsocket.cpp \
     network/tcpsocket.cpp \
+    network/peerconnection.cpp \
+    network/peerrequest.cpp \
+    network/keepaliveservice.cpp \
+    network/networkstate.cpp \
+    network/dnsclient.cpp \
+    network/reverseresolver.cpp \
     controller/logincontroller.cpp \
     measurement/btc/btc_plugin.cpp \
     measurement/upnp/upnp.cpp \
     measurement/upnp/upnp_plugin.cpp \
+    measurement/upnp/internetgateway.cpp \
     report/reportmodel.cpp \
     controller/reportcontroller.cpp \
     types.cpp \
@@ -139,6 +149,8 @@ SOURCES +=  \
     measurement/packettrains/packettrains_ma.cpp \
     measurement/packettrains/packettrains_mp.cpp \
     measurement/packettrains/packettrainsplugin.cpp \
+    measurement/packettrains/packettrainspacer.cpp \
+    measurement/packettrains/packettrainsender.cpp \
     controller/crashcontroller.cpp \
     measurement/http/httpdownload.cpp \
     measurement/http/httpdownload_definition.cpp \
@@ -147,6 +159,9 @@ SOURCES +=  \
     log/filelogger.cpp \
     measurement/ping/ping_definition.cpp \
     measurement/ping/ping_plugin.cpp \
+    measurement/pingmesh/pingmesh.cpp \
+    measurement/pingmesh/pingmesh_definition.cpp \
+    measurement/pingmesh/pingmesh_plugin.cpp \
     measurement/traceroute/traceroute.cpp \
     measurement/traceroute/traceroute_definition.cpp \
     measurement/traceroute/traceroute_plugin.cpp \
@@ -172,7 +187,10 @@ SOURCES +=  \
     measurement/wifilookup/wifilookup_definition.cpp \
     measurement/wifilookup/wifilookup_plugin.cpp \
     storage/storage.cpp \
+    storage/jsonwriter.cpp \
+    storage/jsonreader.cpp \
     timing/timer.cpp \
+    timing/clock.cpp \
     controller/ntpcontroller.cpp
 
 HEADERS += \
@@ -202,26 +220,36 @@ HEADERS += \
     report/reportstorage.h \
     report/reportscheduler.h \
     report/report.h \
+    report/devicestatecolumns.h \
     task/taskvalidator.h \
     task/taskexecutor.h \
     task/task.h \
     task/result.h \
+    task/crosstrafficsampler.h \
     serializable.h \
     network/networkmanager.h \
     measurement/measurementfactory.h \
     measurement/measurement.h \
     measurement/measurementdefinition.h \
+    measurement/streamingstats.h \
     measurement/btc/btc_mp.h \
     measurement/btc/btc_ma.h \
     measurement/btc/btc_definition.h \
     network/udpsocket.h \
     network/tcpsocket.h \
+    network/peerconnection.h \
+    network/peerrequest.h \
+    network/keepaliveservice.h \
+    network/networkstate.h \
+    network/dnsclient.h \
+    network/reverseresolver.h \
     controller/logincontroller.h \
     log/logger.h \
     measurement/measurementplugin.h \
     measurement/btc/btc_plugin.h \
     measurement/upnp/upnp.h \
     measurement/upnp/upnp_plugin.h \
+    measurement/upnp/internetgateway.h \
     report/reportmodel.h \
     storage/storagepaths.h \
     controller/reportcontroller.h \
@@ -234,6 +262,8 @@ HEADERS += \
     measurement/packettrains/packettrains_mp.h \
     measurement/packettrains/packettrains_ma.h \
     measurement/packettrains/packettrainsplugin.h \
+    measurement/packettrains/packettrainspacer.h \
+    measurement/packettrains/packettrainsender.h \
     controller/crashcontroller.h \
     measurement/http/httpdownload.h \
     measurement/http/httpdownload_definition.h \
@@ -243,6 +273,9 @@ HEADERS += \
     measurement/ping/ping.h \
     measurement/ping/ping_definition.h \
     measurement/ping/ping_plugin.h \
+    measurement/pingmesh/pingmesh.h \
+    measurement/pingmesh/pingmesh_definition.h \
+    measurement/pingmesh/pingmesh_plugin.h \
     measurement/traceroute/traceroute.h \
     measurement/traceroute/traceroute_definition.h \
     measurement/traceroute/traceroute_plugin.h \
@@ -270,7 +303,10 @@ HEADERS += \
     measurement/wifilookup/wifilookup_plugin.h \
     ident.h \
     storage/storage.h \
+    storage/jsonwriter.h \
+    storage/jsonreader.h \
     timing/timer.h \
+    timing/clock.h \
     controller/ntpcontroller.h
 
 OTHER_FILES += \
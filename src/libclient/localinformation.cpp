@@ -1,6 +1,7 @@
 #include "localinformation.h"
 #include "client.h"
 #include "settings.h"
+#include "network/networkmanager.h"
 
 LocalInformation::LocalInformation()
 {
@@ -16,7 +17,7 @@ QVariantMap LocalInformation::getVariables() const
     map.insert("signal_strength", deviceInfo.signalStrength());
     map.insert("battery_level", deviceInfo.batteryLevel());
     map.insert("available_disk_space", deviceInfo.availableDiskSpace());
-    map.insert("connection_mode", networkMangager.connectionMode());
+    map.insert("connection_mode", Client::instance()->networkManager()->connectionMode());
     map.insert("tbm_active", settings->trafficBudgetManagerActive());
     map.insert("available_traffic", settings->availableTraffic());
     map.insert("available_mobile_traffic", settings->availableMobileTraffic());
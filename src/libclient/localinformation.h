@@ -2,7 +2,6 @@
 #define LOCALINFORMATION_H
 
 #include "deviceinfo.h"
-#include "network/networkmanager.h"
 
 #include <QVariant>
 
@@ -17,7 +16,6 @@ public:
 
 private:
     DeviceInfo deviceInfo;
-    NetworkManager networkMangager;
 };
 
 #endif // LOCALINFORMATION_H
@@ -5,7 +5,7 @@
 
 class BulkTransportCapacityDefinition;
 
-typedef QSharedPointer<BulkTransportCapacityDefinition> BulkTransportCapacityDefinitionPtr;
+typedef QSharedPointer<const BulkTransportCapacityDefinition> BulkTransportCapacityDefinitionPtr;
 typedef QList<BulkTransportCapacityDefinitionPtr> BulkTransportCapacityDefinitionList;
 
 class BulkTransportCapacityDefinition : public MeasurementDefinition
@@ -1,6 +1,7 @@
 #include "btc_ma.h"
 #include "../../log/logger.h"
 #include "../../network/networkmanager.h"
+#include "../../network/peerconnection.h"
 #include "../../client.h"
 #include "../../trafficbudgetmanager.h"
 
@@ -23,6 +24,12 @@ BulkTransportCapacityMA::BulkTransportCapacityMA(QObject *parent)
 
 bool BulkTransportCapacityMA::start()
 {
+    if (!m_tcpSocket)
+    {
+        setErrorString("Not connected to the peer");
+        return false;
+    }
+
     m_status = BulkTransportCapacityMA::Running;
 
     LOG_INFO("Sending initial data size to server");
@@ -90,6 +97,7 @@ void BulkTransportCapacityMA::calculateResult()
             {
                 qreal speed = (bytes / 1024.0) / (((time / 1000.0) / 1000) / 1000);
                 m_downloadSpeeds << speed;
+                m_speedStats.add(speed);
 
                 // reset counters
                 bytes = 0;
@@ -97,10 +105,7 @@ void BulkTransportCapacityMA::calculateResult()
             }
         }
 
-        // calculate mean speed
-        qreal sum = std::accumulate(m_downloadSpeeds.begin(), m_downloadSpeeds.end(), 0.0);
-        qreal mean = sum / m_downloadSpeeds.size();
-        LOG_INFO(QString("Speed (mean): %1 KByte/s").arg(mean, 0, 'f', 0));
+        LOG_INFO(QString("Speed (mean): %1 KByte/s").arg(m_speedStats.mean(), 0, 'f', 0));
 
         /* At the moment deactivated
         // calculate standard deviation
@@ -189,7 +194,10 @@ Measurement::Status BulkTransportCapacityMA::status() const
 bool BulkTransportCapacityMA::prepare(NetworkManager *networkManager,
                                       const MeasurementDefinitionPtr &measurementDefinition)
 {
-    definition = measurementDefinition.dynamicCast<BulkTransportCapacityDefinition>();
+    Q_UNUSED(networkManager);
+
+    // the peer connection is established by prepareAsync()
+    definition = measurementDefinition.dynamicCast<const BulkTransportCapacityDefinition>();
 
     if (definition.isNull())
     {
@@ -197,27 +205,59 @@ bool BulkTransportCapacityMA::prepare(NetworkManager *networkManager,
         return false;
     }
 
+    m_bytesExpected = 0;
+    m_preTest = true;
+
+    if (!Client::instance()->trafficBudgetManager()->addUsedTraffic(definition->initialDataSize))
+    {
+        setErrorString("not enough traffic available");
+        return false;
+    }
+
+    return true;
+}
+
+bool BulkTransportCapacityMA::prepareAsync(NetworkManager *networkManager,
+                                           const MeasurementDefinitionPtr &measurementDefinition)
+{
+    if (!prepare(networkManager, measurementDefinition))
+    {
+        return false;
+    }
+
     QString hostname = QString("%1:%2").arg(definition->host).arg(definition->port);
 
-    m_tcpSocket = qobject_cast<QTcpSocket *>(networkManager->establishConnection(hostname, taskId(), "btc_mp", definition,
-                                                                                 NetworkManager::TcpSocket));
+    setMeasurementUuid(QUuid::createUuid());
 
-    if (!m_tcpSocket)
+    m_connection = networkManager->establishConnection(hostname, taskId(), "btc_mp", definition,
+                                                       getMeasurementUuid(), NetworkManager::TcpSocket);
+
+    if (!m_connection)
     {
         setErrorString("Preparation failed");
         return false;
     }
 
-    m_tcpSocket->setParent(this);
-    m_bytesExpected = 0;
-    m_preTest = true;
+    m_connection->setParent(this);
+    connect(m_connection.data(), SIGNAL(connected()), this, SLOT(peerConnected()));
+    connect(m_connection.data(), SIGNAL(error(const QString &)), this, SLOT(peerError(const QString &)));
 
-    if (!Client::instance()->trafficBudgetManager()->addUsedTraffic(definition->initialDataSize))
+    return true;
+}
+
+void BulkTransportCapacityMA::peerConnected()
+{
+    m_tcpSocket = qobject_cast<QTcpSocket *>(m_connection->takeSocket());
+    m_connection->deleteLater();
+
+    if (!m_tcpSocket)
     {
-        setErrorString("not enough traffic available");
-        return false;
+        emit error("Preparation failed");
+        return;
     }
 
+    m_tcpSocket->setParent(this);
+
     // Signal for new data
     connect(m_tcpSocket, SIGNAL(readyRead()), this, SLOT(receiveResponse()));
 
@@ -228,7 +268,14 @@ bool BulkTransportCapacityMA::prepare(NetworkManager *networkManager,
     // Signal for end of data transmission
     connect(m_tcpSocket, SIGNAL(disconnected()), this, SLOT(serverDisconnected()));
 
-    return true;
+    emit prepared();
+}
+
+void BulkTransportCapacityMA::peerError(const QString &message)
+{
+    m_connection->deleteLater();
+
+    emit error(QString("Preparation failed: %1").arg(message));
 }
 
 bool BulkTransportCapacityMA::stop()
@@ -251,32 +298,20 @@ Result BulkTransportCapacityMA::result() const
 {
     QVariantMap res;
     QVariantList downSpeeds;
-    float avg = 0.0;
 
-    // get max and min
-    QList<qreal>::const_iterator it = std::max_element(m_downloadSpeeds.begin(), m_downloadSpeeds.end());
-    float max = *it;
-    it = std::min_element(m_downloadSpeeds.begin(), m_downloadSpeeds.end());
-    float min = *it;
-
-    // calculate average and fill downspeeds
     foreach (qreal val, m_downloadSpeeds)
     {
         downSpeeds << val;
-        avg += val;
     }
 
-    avg /= m_downloadSpeeds.size();
-
-    // calculate standard deviation
-    qreal sq_sum = std::inner_product(m_downloadSpeeds.begin(), m_downloadSpeeds.end(), m_downloadSpeeds.begin(), 0.0);
-    qreal stdev = qSqrt(sq_sum / m_downloadSpeeds.size() - avg * avg);
-
-    res.insert("kBs_avg", avg);
-    res.insert("kBs_min", min);
-    res.insert("kBs_max", max);
-    res.insert("kBs_stddev", stdev);
+    res.insert("kBs_avg", m_speedStats.mean());
+    res.insert("kBs_min", m_speedStats.min());
+    res.insert("kBs_max", m_speedStats.max());
+    res.insert("kBs_stddev", m_speedStats.stdev());
+    res.insert("kBs_p50", m_speedStats.quantile(0.5));
+    res.insert("kBs_p90", m_speedStats.quantile(0.9));
+    res.insert("kBs_p99", m_speedStats.quantile(0.99));
     res.insert("kBs", downSpeeds);
 
-    return Result(res, definition->measurementUuid);
+    return Result(res, getMeasurementUuid());
 }
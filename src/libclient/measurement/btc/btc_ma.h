@@ -3,10 +3,14 @@
 
 #include "../measurement.h"
 #include "btc_definition.h"
+#include "../streamingstats.h"
 
 #include <QObject>
 #include <QTcpSocket>
 #include <QElapsedTimer>
+#include <QPointer>
+
+class PeerConnection;
 
 class BulkTransportCapacityMA : public Measurement
 {
@@ -18,6 +22,7 @@ public:
     // Measurement interface
     Status status() const;
     bool prepare(NetworkManager *networkManager, const MeasurementDefinitionPtr &measurementDefinition);
+    bool prepareAsync(NetworkManager *networkManager, const MeasurementDefinitionPtr &measurementDefinition);
     bool start();
     bool stop();
     Result result() const;
@@ -29,17 +34,21 @@ private:
     BulkTransportCapacityDefinitionPtr definition;
     bool m_preTest;
     QTcpSocket *m_tcpSocket;
+    QPointer<PeerConnection> m_connection;
     QElapsedTimer m_time;
     qint64 m_bytesReceived; // without first packets
     qint64 m_totalBytesReceived; // with first packets
     qint64 m_bytesExpected;
     qint64 m_lasttime;
     QList<qreal> m_downloadSpeeds;
+    StreamingStats m_speedStats;
     Status m_status;
     QVector<qint64> m_bytesReceivedList;
     QVector<qint64> m_times;
 
 private slots:
+    void peerConnected();
+    void peerError(const QString &message);
     void receiveResponse();
     void serverDisconnected();
     void handleError(QAbstractSocket::SocketError socketError);
@@ -3,16 +3,66 @@
 #include "../../network/networkmanager.h"
 
 #include <QDataStream>
+#include <QDateTime>
 
 LOGGER(BulkTransportCapacityMP);
 
+namespace
+{
+    // Size of the pre-generated payload every response is streamed from
+    const int payloadSize = 64 * 1024;
+
+    // Maximum amount of data queued in a socket before we wait for bytesWritten()
+    const qint64 writeWindow = 256 * 1024;
+
+    // Interval in which rate limited peers get refilled
+    const int pacingInterval = 5;
+
+    // Default limits for a single peer
+    const int defaultMaxClients = 8;
+    const quint64 defaultMaxBytesPerClient = Q_UINT64_C(1024) * 1024 * 1024; // 1 GiB
+    const quint64 defaultMaxRatePerClient = Q_UINT64_C(125000000); // 1 GBit/s
+
+    // Random data to prevent compression on the path, shared by all servers
+    const QByteArray &payload()
+    {
+        static QByteArray data;
+
+        if (data.isEmpty())
+        {
+            QByteArray buffer(payloadSize, Qt::Uninitialized);
+            qsrand(QDateTime::currentMSecsSinceEpoch());
+
+            for (int i = 0; i < buffer.size(); ++i)
+            {
+                buffer[i] = static_cast<char>(qrand() & 0xff);
+            }
+
+            data = buffer;
+        }
+
+        return data;
+    }
+}
+
 BulkTransportCapacityMP::BulkTransportCapacityMP(QObject *parent)
 : Measurement(parent)
 , m_tcpServer(NULL)
+, m_status(Unknown)
+, m_maxClients(defaultMaxClients)
+, m_maxBytesPerClient(defaultMaxBytesPerClient)
+, m_maxRatePerClient(defaultMaxRatePerClient)
 {
     connect(this, SIGNAL(error(const QString &)), this,
             SLOT(setErrorString(const QString &)));
-    resetServer();
+
+    m_pacingTimer.setSingleShot(true);
+    m_pacingTimer.setTimerType(Qt::PreciseTimer);
+    m_pacingTimer.setInterval(pacingInterval);
+    connect(&m_pacingTimer, SIGNAL(timeout()), this, SLOT(fillSockets()));
+
+    // Generate the payload before the first client shows up
+    payload();
 }
 
 bool BulkTransportCapacityMP::start()
@@ -20,62 +70,236 @@ bool BulkTransportCapacityMP::start()
     // Start listening
     bool ret = m_tcpServer->listen(QHostAddress::Any, definition->port);
     LOG_DEBUG(QString("Listening on port %1: %2").arg(definition->port).arg(ret));
+
+    if (ret)
+    {
+        m_status = Running;
+    }
+
     return ret;
 }
 
-qint64 BulkTransportCapacityMP::sendResponse(quint64 bytes)
+void BulkTransportCapacityMP::setMaxClients(int maxClients)
 {
-    // send data back
-    QByteArray data;
-    data.resize(bytes);
-    data.fill('X'); // TODO: do we need to randomize this to prevent compression on the path?
-    return m_tcpSocket->write(data);
+    m_maxClients = maxClients;
 }
 
-void BulkTransportCapacityMP::resetServer()
+int BulkTransportCapacityMP::maxClients() const
 {
-    m_tcpSocket = 0;
+    return m_maxClients;
 }
 
-void BulkTransportCapacityMP::newClientConnection()
+void BulkTransportCapacityMP::setMaxBytesPerClient(quint64 bytes)
+{
+    m_maxBytesPerClient = bytes;
+}
+
+quint64 BulkTransportCapacityMP::maxBytesPerClient() const
+{
+    return m_maxBytesPerClient;
+}
+
+void BulkTransportCapacityMP::setMaxRatePerClient(quint64 bytesPerSecond)
+{
+    m_maxRatePerClient = bytesPerSecond;
+}
+
+quint64 BulkTransportCapacityMP::maxRatePerClient() const
+{
+    return m_maxRatePerClient;
+}
+
+void BulkTransportCapacityMP::sendResponse(QTcpSocket *socket, quint64 bytes)
+{
+    Peer &peer = m_peers[socket];
+
+    // bytesTotal never exceeds the limit, compare against the remainder to not overflow
+    if (m_maxBytesPerClient && bytes > m_maxBytesPerClient - peer.bytesTotal)
+    {
+        LOG_WARNING(QString("Client requested %1 more bytes after %2, exceeding the limit of %3 bytes").arg(bytes)
+                    .arg(peer.bytesTotal).arg(m_maxBytesPerClient));
+
+        bytes = m_maxBytesPerClient - peer.bytesTotal;
+        peer.capped = true;
+    }
+
+    // Restart the rate window if the peer was idle
+    if (peer.bytesPending == 0)
+    {
+        peer.rateTimer.start();
+        peer.bytesSent = 0;
+    }
+
+    peer.bytesPending += bytes;
+    peer.bytesTotal += bytes;
+
+    if (!fillSocket(socket, peer))
+    {
+        m_pacingTimer.start();
+    }
+}
+
+bool BulkTransportCapacityMP::fillSocket(QTcpSocket *socket, Peer &peer)
+{
+    const QByteArray &data = payload();
+
+    // Only keep a small window queued, the rest is written as the socket drains
+    while (peer.bytesPending > 0 && socket->bytesToWrite() < writeWindow)
+    {
+        qint64 chunk = qMin<quint64>(peer.bytesPending, data.size());
+
+        if (m_maxRatePerClient)
+        {
+            // Allowed bytes since the start of the rate window
+            qint64 allowed = static_cast<qint64>(peer.rateTimer.nsecsElapsed() * (m_maxRatePerClient / 1.0e9))
+                             - static_cast<qint64>(peer.bytesSent);
+
+            if (allowed <= 0)
+            {
+                return false;
+            }
+
+            chunk = qMin(chunk, allowed);
+        }
+
+        qint64 written = socket->write(data.constData(), chunk);
+
+        if (written <= 0)
+        {
+            // The error signal of the socket takes care of this
+            return true;
+        }
+
+        peer.bytesPending -= written;
+        peer.bytesSent += written;
+    }
+
+    if (peer.bytesPending == 0 && peer.capped)
+    {
+        LOG_INFO("Client reached its size limit, closing connection");
+
+        // Note: This might emit disconnected() synchronously, don't touch peer afterwards
+        socket->disconnectFromHost();
+    }
+
+    return true;
+}
+
+void BulkTransportCapacityMP::fillSockets()
 {
-    LOG_INFO("New client connection");
+    bool pacing = false;
 
-    if (!m_tcpSocket)
+    foreach (QTcpSocket *socket, m_peers.keys())
     {
-        m_tcpSocket = m_tcpServer->nextPendingConnection();
+        QHash<QTcpSocket *, Peer>::iterator it = m_peers.find(socket);
 
-        connect(m_tcpSocket, SIGNAL(disconnected()), this, SIGNAL(finished()));
-        connect(m_tcpSocket, SIGNAL(disconnected()), m_tcpSocket, SLOT(deleteLater()));
-        connect(m_tcpSocket, SIGNAL(readyRead()), this, SLOT(receiveRequest()));
-        connect(m_tcpSocket, SIGNAL(destroyed()), this, SLOT(resetServer()));
+        if (it == m_peers.end())
+        {
+            continue;
+        }
+
+        if (!fillSocket(socket, it.value()))
+        {
+            pacing = true;
+        }
     }
-    else
+
+    if (pacing)
     {
-        LOG_WARNING("There is already a client connected, abort");
-        QTcpSocket *next = m_tcpServer->nextPendingConnection();
-        next->abort();
-        delete next;
+        m_pacingTimer.start();
+    }
+}
+
+void BulkTransportCapacityMP::newClientConnection()
+{
+    while (m_tcpServer->hasPendingConnections())
+    {
+        QTcpSocket *socket = m_tcpServer->nextPendingConnection();
+
+        if (m_maxClients && m_peers.size() >= m_maxClients)
+        {
+            LOG_WARNING(QString("Already %1 clients connected, abort").arg(m_peers.size()));
+            socket->abort();
+            delete socket;
+            continue;
+        }
+
+        LOG_INFO(QString("New client connection from %1").arg(socket->peerAddress().toString()));
+
+        m_peers.insert(socket, Peer());
+
+        connect(socket, SIGNAL(disconnected()), this, SLOT(clientDisconnected()));
+        connect(socket, SIGNAL(readyRead()), this, SLOT(receiveRequest()));
+        connect(socket, SIGNAL(bytesWritten(qint64)), this, SLOT(socketWritten()));
+        connect(socket, SIGNAL(error(QAbstractSocket::SocketError)), this,
+                SLOT(handleError(QAbstractSocket::SocketError)));
     }
 }
 
 void BulkTransportCapacityMP::receiveRequest()
 {
-    LOG_INFO("New client request");
+    QTcpSocket *socket = qobject_cast<QTcpSocket *>(sender());
+
+    if (!socket || !m_peers.contains(socket))
+    {
+        return;
+    }
+
+    // wait until a complete request was received
+    while (socket->bytesAvailable() >= (int)sizeof(quint64))
+    {
+        LOG_INFO("New client request");
+
+        // get bytes from message
+        QDataStream in(socket);
+
+        quint64 bytes;
+        in >> bytes;
+        sendResponse(socket, bytes);
+
+        // sendResponse() might have closed the socket
+        if (!m_peers.contains(socket))
+        {
+            return;
+        }
+    }
+}
+
+void BulkTransportCapacityMP::socketWritten()
+{
+    QTcpSocket *socket = qobject_cast<QTcpSocket *>(sender());
+    QHash<QTcpSocket *, Peer>::iterator it = m_peers.find(socket);
 
-    // abort if received data is not what we expected
-    if (m_tcpSocket->bytesAvailable() < (int)sizeof(quint64))
+    if (it == m_peers.end())
     {
-        LOG_DEBUG("Data length is not what we expected");
         return;
     }
 
-    // get bytes from message
-    QDataStream in(m_tcpSocket);
+    if (!fillSocket(socket, it.value()))
+    {
+        m_pacingTimer.start();
+    }
+}
+
+void BulkTransportCapacityMP::clientDisconnected()
+{
+    QTcpSocket *socket = qobject_cast<QTcpSocket *>(sender());
 
-    quint64 bytes;
-    in >> bytes;
-    sendResponse(bytes);
+    if (!m_peers.remove(socket))
+    {
+        return;
+    }
+
+    LOG_INFO("Client disconnected");
+    socket->deleteLater();
+
+    // We are done once the last client left
+    if (m_peers.isEmpty())
+    {
+        m_pacingTimer.stop();
+        m_status = Finished;
+        emit finished();
+    }
 }
 
 void BulkTransportCapacityMP::handleError(QAbstractSocket::SocketError socketError)
@@ -86,30 +310,42 @@ void BulkTransportCapacityMP::handleError(QAbstractSocket::SocketError socketErr
     }
 
     QAbstractSocket *socket = qobject_cast<QAbstractSocket *>(sender());
-    emit error(QString("Socket Error: %1").arg(socket->errorString()));
 
-    emit error(socket->errorString());
+    if (socket)
+    {
+        // A broken client connection doesn't affect the other clients
+        LOG_WARNING(QString("Socket Error: %1").arg(socket->errorString()));
+        return;
+    }
+
+    emit error(QString("Server Error: %1").arg(m_tcpServer->errorString()));
 }
 
 Measurement::Status BulkTransportCapacityMP::status() const
 {
-    return Unknown;
+    return m_status;
 }
 
 bool BulkTransportCapacityMP::prepare(NetworkManager *networkManager,
                                       const MeasurementDefinitionPtr &measurementDefinition)
 {
-    definition = measurementDefinition.dynamicCast<BulkTransportCapacityDefinition>();
+    definition = measurementDefinition.dynamicCast<const BulkTransportCapacityDefinition>();
 
     if (definition.isNull())
     {
         setErrorString("Definition is empty");
+        return false;
     }
 
-    m_tcpSocket = 0;
+    m_peers.clear();
     m_tcpServer = networkManager->createServerSocket();
     m_tcpServer->setParent(this);
 
+    if (m_maxClients)
+    {
+        m_tcpServer->setMaxPendingConnections(m_maxClients);
+    }
+
     // Signal for errors
     connect(m_tcpServer, SIGNAL(acceptError(QAbstractSocket::SocketError)), this,
             SLOT(handleError(QAbstractSocket::SocketError)));
@@ -122,7 +358,22 @@ bool BulkTransportCapacityMP::prepare(NetworkManager *networkManager,
 
 bool BulkTransportCapacityMP::stop()
 {
-    delete m_tcpSocket;
+    m_pacingTimer.stop();
+
+    if (m_tcpServer)
+    {
+        m_tcpServer->close();
+    }
+
+    foreach (QTcpSocket *socket, m_peers.keys())
+    {
+        socket->disconnect(this);
+        socket->abort();
+        socket->deleteLater();
+    }
+
+    m_peers.clear();
+
     return true;
 }
 
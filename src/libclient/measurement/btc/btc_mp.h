@@ -5,10 +5,13 @@
 #include "btc_definition.h"
 
 #include <QObject>
+#include <QHash>
+#include <QTimer>
+#include <QElapsedTimer>
 #include <QTcpServer>
 #include <QTcpSocket>
 
-class BulkTransportCapacityMP : public Measurement
+class CLIENT_API BulkTransportCapacityMP : public Measurement
 {
     Q_OBJECT
 
@@ -22,17 +25,53 @@ public:
     bool stop();
     Result result() const;
 
+    // Limits for a single peer (0 = unlimited)
+    void setMaxClients(int maxClients);
+    int maxClients() const;
+
+    void setMaxBytesPerClient(quint64 bytes);
+    quint64 maxBytesPerClient() const;
+
+    void setMaxRatePerClient(quint64 bytesPerSecond);
+    quint64 maxRatePerClient() const;
+
 private:
-    qint64 sendResponse(quint64 bytes);
+    struct Peer
+    {
+        Peer()
+        : bytesPending(0)
+        , bytesTotal(0)
+        , bytesSent(0)
+        , capped(false)
+        {
+        }
+
+        quint64 bytesPending; // bytes requested but not yet handed to the socket
+        quint64 bytesTotal; // all bytes ever requested by this peer
+        quint64 bytesSent; // bytes handed to the socket while rate limited
+        bool capped; // the size cap was hit, close after flushing
+        QElapsedTimer rateTimer;
+    };
+
+    void sendResponse(QTcpSocket *socket, quint64 bytes);
+    bool fillSocket(QTcpSocket *socket, Peer &peer);
 
     BulkTransportCapacityDefinitionPtr definition;
     QTcpServer *m_tcpServer;
-    QTcpSocket *m_tcpSocket;
+    QHash<QTcpSocket *, Peer> m_peers;
+    QTimer m_pacingTimer;
+    Status m_status;
+
+    int m_maxClients;
+    quint64 m_maxBytesPerClient;
+    quint64 m_maxRatePerClient;
 
 private slots:
-    void resetServer();
     void newClientConnection();
     void receiveRequest();
+    void socketWritten();
+    void clientDisconnected();
+    void fillSockets();
     void handleError(QAbstractSocket::SocketError socketError);
 };
 
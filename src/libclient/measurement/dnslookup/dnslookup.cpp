@@ -2,9 +2,10 @@
 #include "../../log/logger.h"
 #include "../../client.h"
 #include "../../trafficbudgetmanager.h"
+#include "../../timing/clock.h"
 
-#include <QDnsLookup>
 #include <QHostAddress>
+#include <QHash>
 #include "../../types.h"
 
 LOGGER(Dnslookup);
@@ -13,6 +14,7 @@ Dnslookup::Dnslookup(QObject *parent)
 : Measurement(parent)
 , m_currentStatus(Dnslookup::Unknown)
 {
+    connect(&m_client, SIGNAL(finished()), this, SLOT(handleServers()));
 }
 
 Dnslookup::~Dnslookup()
@@ -22,7 +24,7 @@ Dnslookup::~Dnslookup()
 bool Dnslookup::prepare(NetworkManager *networkManager, const MeasurementDefinitionPtr &measurementDefinition)
 {
     Q_UNUSED(networkManager);
-    m_definition = measurementDefinition.dynamicCast<DnslookupDefinition>();
+    m_definition = measurementDefinition.dynamicCast<const DnslookupDefinition>();
 
     if (m_definition.isNull())
     {
@@ -30,29 +32,75 @@ bool Dnslookup::prepare(NetworkManager *networkManager, const MeasurementDefinit
         return false;
     }
 
-    connect(&m_dns, SIGNAL(finished()), this, SLOT(handleServers()));
+    if (m_definition->hosts.isEmpty())
+    {
+        setErrorString("No host to look up");
+        return false;
+    }
 
     m_currentStatus = Dnslookup::Unknown;
+    m_servers.clear();
+
+    foreach (const QString &dnsServer, m_definition->dnsServers)
+    {
+        QHostAddress address(dnsServer);
+
+        if (address.isNull())
+        {
+            setErrorString(QString("Invalid dns server: %1").arg(dnsServer));
+            return false;
+        }
 
-    m_dns.setType(QDnsLookup::ANY);
-    m_dns.setName(m_definition->host);
+        m_servers.append(address);
+    }
+
+    if (m_servers.isEmpty())
+    {
+        m_servers = DnsClient::systemNameservers();
+    }
+
+    if (m_servers.isEmpty())
+    {
+        setErrorString("No dns server found");
+        return false;
+    }
 
-#if QT_VERSION >= QT_VERSION_CHECK(5, 3, 0)
+    QList<quint16> types;
 
-    if (!m_definition->dnsServer.isEmpty())
+    foreach (const QString &type, m_definition->types)
     {
-        QHostAddress hostAddress(m_definition->dnsServer);
-        m_dns.setNameserver(hostAddress);
+        quint16 value = DnsClient::typeFromString(type);
+
+        if (value == 0)
+        {
+            setErrorString(QString("Unknown record type: %1").arg(type));
+            return false;
+        }
+
+        types.append(value);
     }
 
-#endif
+    m_client.clear();
+    m_client.setTimeout(m_definition->timeout);
+    m_client.setRetries(m_definition->retries);
+
+    foreach (const QString &host, m_definition->hosts)
+    {
+        foreach (quint16 type, types)
+        {
+            foreach (const QHostAddress &server, m_servers)
+            {
+                m_client.addQuery(host, type, server);
+            }
+        }
+    }
 
     /*
      * worst case: 512 bytes
      * best case: 74 bytes
      * average: 293 bytes
      */
-    if (!Client::instance()->trafficBudgetManager()->addUsedTraffic(586))
+    if (!Client::instance()->trafficBudgetManager()->addUsedTraffic(586 * m_client.queries().size()))
     {
         setErrorString("not enough traffic available");
         return false;
@@ -63,20 +111,40 @@ bool Dnslookup::prepare(NetworkManager *networkManager, const MeasurementDefinit
 
 bool Dnslookup::start()
 {
-    m_dns.lookup();
+    setStatus(Dnslookup::Running);
+
+    if (!m_client.start())
+    {
+        setErrorString(m_client.errorString());
+        return false;
+    }
+
     return true;
 }
 
 void Dnslookup::handleServers()
 {
-    // Check the lookup succeeded.
-    if (m_dns.error() != QDnsLookup::NoError)
+    QString error;
+    bool answered = false;
+
+    foreach (const DnsClient::Query &query, m_client.queries())
     {
-        emit error(QString("DNS lookup failed: %1").arg(m_dns.errorString()));
-        m_dnsError = enumToString(QDnsLookup, Error, m_dns.error());
+        if (query.rcode == 0)
+        {
+            answered = true;
+        }
+        else if (error.isEmpty())
+        {
+            error = query.rcode == -1 ? query.errorString : DnsClient::rcodeToString(query.rcode);
+        }
     }
 
-    m_dnslookupOutput = m_dns.hostAddressRecords();
+    // Check the lookup succeeded.
+    if (!answered)
+    {
+        emit error(QString("DNS lookup failed: %1").arg(error));
+        m_dnsError = error;
+    }
 
     setStatus(Dnslookup::Finished);
     emit finished();
@@ -99,7 +167,20 @@ void Dnslookup::setStatus(Status status)
 
 bool Dnslookup::stop()
 {
-    m_dns.abort();
+    m_client.abort();
+    return true;
+}
+
+bool Dnslookup::reset()
+{
+    Measurement::reset();
+
+    m_client.clear();
+    m_definition.clear();
+    m_servers.clear();
+    m_dnsError.clear();
+    m_currentStatus = Dnslookup::Unknown;
+
     return true;
 }
 
@@ -108,35 +189,75 @@ Result Dnslookup::result() const
     QVariantMap res;
 
     QVariantList records;
+    QVariantList queries;
+    QStringList columns;
+    QHash<QString, QVariantList> latencies;
 
-    foreach (const QDnsHostAddressRecord &val, m_dnslookupOutput)
+    foreach (const DnsClient::Query &query, m_client.queries())
     {
-        QString type;
+        QString server = query.server.toString();
+        QString column = QString("%1 %2").arg(query.name).arg(DnsClient::typeToString(query.type));
+        qint64 latency = query.latency();
 
-        switch (val.value().protocol())
+        foreach (const DnsClient::Answer &answer, query.answers)
         {
-        case QAbstractSocket::IPv4Protocol:
-            type = "A";
-            break;
+            QVariantMap map;
+            map.insert("name", answer.name);
+            map.insert("ttl", answer.ttl);
+            map.insert("value", answer.value);
+            map.insert("type", DnsClient::typeToString(answer.type));
+            map.insert("dns_server", server);
+
+            records << map;
+        }
+
+        QVariantMap map;
+        map.insert("name", query.name);
+        map.insert("type", DnsClient::typeToString(query.type));
+        map.insert("dns_server", server);
+        map.insert("send_time", Clock::toDateTime(query.sendTime));
+        map.insert("receive_time", Clock::toDateTime(query.receiveTime));
+        map.insert("latency", latency == -1 ? QVariant() : QVariant(latency / 1000000.0));
+        map.insert("attempts", query.attempts);
+        map.insert("rcode", DnsClient::rcodeToString(query.rcode));
+        map.insert("ttl", query.minimumTtl());
+        map.insert("answers", query.answers.size());
+        map.insert("truncated", query.truncated);
+        map.insert("tcp", query.tcp);
+
+        if (!query.errorString.isEmpty())
+        {
+            map.insert("error", query.errorString);
+        }
 
-        case QAbstractSocket::IPv6Protocol:
-            type = "AAAA";
-            break;
+        queries << map;
 
-        default:
-            break;
+        if (!columns.contains(column))
+        {
+            columns << column;
         }
 
-        QVariantMap map;
-        map.insert("name", val.name());
-        map.insert("ttl", val.timeToLive());
-        map.insert("value", val.value().toString());
-        map.insert("type", type);
+        latencies[server] << map.value("latency");
+    }
+
+    // One row of latencies per server, the columns are the queried names and types
+    QVariantList servers;
+    QVariantList rows;
 
-        records << map;
+    foreach (const QHostAddress &address, m_servers)
+    {
+        servers << address.toString();
+        rows << QVariant(latencies.value(address.toString()));
     }
 
+    QVariantMap matrix;
+    matrix.insert("dns_servers", servers);
+    matrix.insert("queries", columns);
+    matrix.insert("latency", rows);
+
     res.insert("records", records);
+    res.insert("queries", queries);
+    res.insert("matrix", matrix);
 
     Result result(res);
     result.setErrorString(m_dnsError);
@@ -145,8 +266,6 @@ Result Dnslookup::result() const
 
 void Dnslookup::started()
 {
-    m_dnslookupOutput.clear();
-
     setStatus(Dnslookup::Running);
 }
 
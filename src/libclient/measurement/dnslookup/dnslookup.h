@@ -3,8 +3,7 @@
 
 #include "../measurement.h"
 #include "dnslookup_definition.h"
-
-#include <QDnsLookup>
+#include "../../network/dnsclient.h"
 
 class Dnslookup : public Measurement
 {
@@ -20,13 +19,14 @@ public:
     bool start();
     bool stop();
     Result result() const;
+    bool reset();
 
 private:
     void setStatus(Status status);
 
     DnslookupDefinitionPtr m_definition;
-    QDnsLookup m_dns;
-    QList<QDnsHostAddressRecord> m_dnslookupOutput;
+    DnsClient m_client;
+    QList<QHostAddress> m_servers;
     QString m_dnsError;
     Status m_currentStatus;
 
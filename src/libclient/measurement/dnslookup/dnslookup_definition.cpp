@@ -3,7 +3,19 @@
 DnslookupDefinition::DnslookupDefinition(const QString &host, const QString &dnsServer)
 : host(host)
 , dnsServer(dnsServer)
+, types(QStringList() << "A" << "AAAA")
+, timeout(2000)
+, retries(2)
 {
+    if (!host.isEmpty())
+    {
+        hosts.append(host);
+    }
+
+    if (!dnsServer.isEmpty())
+    {
+        dnsServers.append(dnsServer);
+    }
 }
 
 DnslookupDefinition::~DnslookupDefinition()
@@ -15,11 +27,44 @@ QVariant DnslookupDefinition::toVariant() const
     QVariantMap map;
     map.insert("host", host);
     map.insert("dns_server", dnsServer);
+    map.insert("hosts", hosts);
+    map.insert("dns_servers", dnsServers);
+    map.insert("types", types);
+    map.insert("timeout", timeout);
+    map.insert("retries", retries);
     return map;
 }
 
 DnslookupDefinitionPtr DnslookupDefinition::fromVariant(const QVariant &variant)
 {
     QVariantMap map = variant.toMap();
-    return DnslookupDefinitionPtr(new DnslookupDefinition(map.value("host").toString(), map.value("dns_server").toString()));
+
+    DnslookupDefinition *definition = new DnslookupDefinition(map.value("host").toString(),
+                                                              map.value("dns_server").toString());
+
+    foreach (const QString &host, map.value("hosts").toStringList())
+    {
+        if (!definition->hosts.contains(host))
+        {
+            definition->hosts.append(host);
+        }
+    }
+
+    foreach (const QString &dnsServer, map.value("dns_servers").toStringList())
+    {
+        if (!definition->dnsServers.contains(dnsServer))
+        {
+            definition->dnsServers.append(dnsServer);
+        }
+    }
+
+    if (map.contains("types"))
+    {
+        definition->types = map.value("types").toStringList();
+    }
+
+    definition->timeout = map.value("timeout", 2000).toInt();
+    definition->retries = map.value("retries", 2).toInt();
+
+    return DnslookupDefinitionPtr(definition);
 }
@@ -3,9 +3,11 @@
 
 #include "../measurementdefinition.h"
 
+#include <QStringList>
+
 class DnslookupDefinition;
 
-typedef QSharedPointer<DnslookupDefinition> DnslookupDefinitionPtr;
+typedef QSharedPointer<const DnslookupDefinition> DnslookupDefinitionPtr;
 typedef QList<DnslookupDefinitionPtr> DnslookupDefinitionList;
 
 class DnslookupDefinition : public MeasurementDefinition
@@ -21,6 +23,15 @@ public:
     QString host;
     QString dnsServer;
 
+    // Every host is queried for every type at every server, the system
+    // name servers are used if none is given
+    QStringList hosts;
+    QStringList dnsServers;
+    QStringList types;
+
+    int timeout; // ms
+    int retries;
+
     // Serializable interface
     QVariant toVariant() const;
 };
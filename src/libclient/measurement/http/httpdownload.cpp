@@ -1,4 +1,5 @@
 #include "httpdownload.h"
+#include "../streamingstats.h"
 #include "../../log/logger.h"
 #include "types.h"
 
@@ -189,13 +190,18 @@ void DownloadThread::startDownload()
 
 void DownloadThread::read()
 {
-    bytesReceived << socket->bytesAvailable();
-    timeIntervals << measurementTimer.nsecsElapsed();
+    addSample(socket->bytesAvailable(), measurementTimer.nsecsElapsed());
 
     socket->readAll();   //we don't need the actual data but need to free space in the
                          //socket buffer
 }
 
+void DownloadThread::addSample(qint64 bytes, qint64 nsecs)
+{
+    bytesReceived << bytes;
+    timeIntervals << nsecs;
+}
+
 qreal DownloadThread::averageThroughput(qint64 sTime, qint64 eTime) const
 {
     int i = 0;
@@ -321,7 +327,7 @@ bool HTTPDownload::prepare(NetworkManager *networkManager,
 {
     Q_UNUSED(networkManager)
 
-    definition = measurementDefinition.dynamicCast<HTTPDownloadDefinition>();
+    definition = measurementDefinition.dynamicCast<const HTTPDownloadDefinition>();
 
     if (definition.isNull())
     {
@@ -628,24 +634,24 @@ bool HTTPDownload::calculateResults()
 
         QList<qreal> measurementSlots = workers[i]->measurementSlots(definition->slotLength);
 
-        // get max and min
-        QList<qreal>::const_iterator it = std::max_element(measurementSlots.begin(), measurementSlots.end());
-        qreal max = *it;
-        thread.insert("max", max);
-        it = std::min_element(measurementSlots.begin(), measurementSlots.end());
-        qreal min = *it;
-        thread.insert("min", min);
+        StreamingStats slotStats;
+
+        foreach (qreal slot, measurementSlots)
+        {
+            slotStats.add(slot);
+        }
 
-        qreal sq_sum = std::inner_product(measurementSlots.begin(), measurementSlots.end(), measurementSlots.begin(), 0.0);
-        qreal stdev = 0.0;
+        thread.insert("max", slotStats.max());
+        thread.insert("min", slotStats.min());
 
-        if (measurementSlots.size() > 0)
+        if (slotStats.count() > 0)
         {
-            // calculate standard deviation
-            stdev = qSqrt(sq_sum / measurementSlots.size() - avg * avg);
-            thread.insert("stdev", stdev);
+            thread.insert("stdev", slotStats.stdev());
         }
 
+        thread.insert("p50", slotStats.quantile(0.5));
+        thread.insert("p90", slotStats.quantile(0.9));
+        thread.insert("p99", slotStats.quantile(0.99));
         thread.insert("slots", listToVariant(measurementSlots));
 
         threadResults.append(thread);
@@ -14,7 +14,7 @@
 #include <QPointer>
 
 
-class DownloadThread : public QObject
+class CLIENT_API DownloadThread : public QObject
 {
     Q_OBJECT
 
@@ -43,6 +43,9 @@ public:
     qreal averageThroughput(qint64 sTime, qint64 eTime) const; //average througput in bps
     QList<qreal> measurementSlots(int slotLength) const; //slotLength in ms
 
+    //records bytes received at nsecs after the start of the download
+    void addSample(qint64 bytes, qint64 nsecs);
+
 private:
 
     //url holds the URL to download from (incl. the port number, default 80)
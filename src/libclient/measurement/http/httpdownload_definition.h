@@ -5,7 +5,7 @@
 
 class HTTPDownloadDefinition;
 
-typedef QSharedPointer<HTTPDownloadDefinition> HTTPDownloadDefinitionPtr;
+typedef QSharedPointer<const HTTPDownloadDefinition> HTTPDownloadDefinitionPtr;
 typedef QList<HTTPDownloadDefinitionPtr> HTTPDownloadDefinitionList;
 
 class HTTPDownloadDefinition : public MeasurementDefinition
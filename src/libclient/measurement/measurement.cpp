@@ -35,6 +35,29 @@ QAbstractSocket *Measurement::peerSocket() const
     return d->peerSocket;
 }
 
+bool Measurement::prepareAsync(NetworkManager *networkManager, const MeasurementDefinitionPtr &measurementDefinition)
+{
+    if (!prepare(networkManager, measurementDefinition))
+    {
+        return false;
+    }
+
+    emit prepared();
+    return true;
+}
+
+bool Measurement::reset()
+{
+    d->peerSocket.clear();
+    d->taskId = TaskId();
+    d->measurementUuid = QUuid();
+    d->startDateTime = QDateTime();
+    d->errorString.clear();
+    d->preInfo.clear();
+
+    return false;
+}
+
 TaskId Measurement::taskId() const
 {
     return d->taskId;
@@ -36,11 +36,21 @@ public:
     virtual bool prepare(NetworkManager *networkManager,
                          const MeasurementDefinitionPtr &measurementDefinition) = 0;
 
+    // Prepares without blocking the calling thread and emits prepared() or
+    // error() once done. Returns false if preparing failed right away. The
+    // default implementation runs prepare() and reports immediately.
+    virtual bool prepareAsync(NetworkManager *networkManager,
+                              const MeasurementDefinitionPtr &measurementDefinition);
+
     virtual bool start() = 0;
     virtual bool stop() = 0;
 
     virtual Result result() const = 0;
 
+    // Bring a finished measurement back to its initial state so the factory
+    // can hand it out again. Returns false if it can not be reused.
+    virtual bool reset();
+
     TaskId taskId() const;
     void setTaskId(const TaskId &taskId);
 
@@ -56,6 +66,7 @@ public:
     QString errorString() const;
 
 signals:
+    void prepared();
     void started();
     void finished();
     void error(const QString &message);
@@ -7,16 +7,15 @@
 #include <QUuid>
 
 class MeasurementDefinition;
-typedef QSharedPointer<MeasurementDefinition> MeasurementDefinitionPtr;
+typedef QSharedPointer<const MeasurementDefinition> MeasurementDefinitionPtr;
 typedef QList<MeasurementDefinitionPtr> MeasurementDefinitionPtrList;
 
+// Definitions are immutable once created, they are shared between runs of a schedule
 class CLIENT_API MeasurementDefinition : public Serializable
 {
 public:
     MeasurementDefinition();
     ~MeasurementDefinition();
-
-    QUuid measurementUuid;
 };
 
 #endif // MEASUREMENTDEFINITION_H
@@ -7,6 +7,7 @@
 #include "reverse_dnslookup/reverseDnslookup_plugin.h"
 #include "packettrains/packettrainsplugin.h"
 #include "ping/ping_plugin.h"
+#include "pingmesh/pingmesh_plugin.h"
 #include "traceroute/traceroute_plugin.h"
 #include "wifilookup/wifilookup_plugin.h"
 #include "../log/logger.h"
@@ -15,10 +16,19 @@
 
 LOGGER(MeasurementFactory);
 
+namespace
+{
+    // Idle measurements kept per name, one is usually enough
+    const int poolLimit = 2;
+}
+
 class MeasurementFactory::Private
 {
 public:
     Private()
+    : poolingEnabled(false)
+    , allocations(0)
+    , reuses(0)
     {
         // TODO: Don't link with plugins
         addPlugin(new BulkTransportCapacityPlugin);
@@ -29,6 +39,7 @@ public:
         addPlugin(new ReverseDnslookupPlugin);
         addPlugin(new PacketTrainsPlugin);
         addPlugin(new PingPlugin);
+        addPlugin(new PingMeshPlugin);
         addPlugin(new TraceroutePlugin);
         addPlugin(new WifiLookupPlugin);
     }
@@ -42,6 +53,11 @@ public:
     QList<MeasurementPlugin *> plugins;
     QHash<QString, MeasurementPlugin *> pluginNameHash;
 
+    bool poolingEnabled;
+    QHash<QString, QList<MeasurementPtr> > pool;
+    quint64 allocations;
+    quint64 reuses;
+
     // Functions
     void addPlugin(MeasurementPlugin *plugin);
 };
@@ -78,10 +94,30 @@ QStringList MeasurementFactory::availableMeasurements() const
 
 MeasurementPtr MeasurementFactory::createMeasurement(const QString &name, const TaskId &id)
 {
+    if (d->poolingEnabled)
+    {
+        QList<MeasurementPtr> &idle = d->pool[name];
+
+        if (!idle.isEmpty())
+        {
+            MeasurementPtr ptr = idle.takeLast();
+            ptr->setTaskId(id);
+            ++d->reuses;
+            return ptr;
+        }
+    }
+
     if (MeasurementPlugin *plugin = d->pluginNameHash.value(name))
     {
         MeasurementPtr ptr = plugin->createMeasurement(name);
+
+        if (ptr.isNull())
+        {
+            return ptr;
+        }
+
         ptr->setTaskId(id);
+        ++d->allocations;
         return ptr;
     }
 
@@ -101,3 +137,48 @@ MeasurementDefinitionPtr MeasurementFactory::createMeasurementDefinition(const Q
 
     return MeasurementDefinitionPtr();
 }
+
+void MeasurementFactory::setPoolingEnabled(bool enabled)
+{
+    d->poolingEnabled = enabled;
+
+    if (!enabled)
+    {
+        d->pool.clear();
+    }
+}
+
+bool MeasurementFactory::isPoolingEnabled() const
+{
+    return d->poolingEnabled;
+}
+
+void MeasurementFactory::recycle(const QString &name, const MeasurementPtr &measurement)
+{
+    if (!d->poolingEnabled || measurement.isNull())
+    {
+        return;
+    }
+
+    QList<MeasurementPtr> &idle = d->pool[name];
+
+    if (idle.size() >= poolLimit || idle.contains(measurement))
+    {
+        return;
+    }
+
+    if (measurement->reset())
+    {
+        idle.append(measurement);
+    }
+}
+
+quint64 MeasurementFactory::allocations() const
+{
+    return d->allocations;
+}
+
+quint64 MeasurementFactory::reuses() const
+{
+    return d->reuses;
+}
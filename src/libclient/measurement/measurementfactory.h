@@ -15,6 +15,17 @@ public:
     MeasurementPtr createMeasurement(const QString &name, const TaskId &id);
     MeasurementDefinitionPtr createMeasurementDefinition(const QString &name, const QVariant &data);
 
+    // Optional recycling of finished measurements, disabled by default
+    void setPoolingEnabled(bool enabled);
+    bool isPoolingEnabled() const;
+
+    // Hand a finished measurement back, the caller must hold the only reference
+    void recycle(const QString &name, const MeasurementPtr &measurement);
+
+    // Number of measurements constructed by plugins and handed out from the pool
+    quint64 allocations() const;
+    quint64 reuses() const;
+
 protected:
     class Private;
     Private *d;
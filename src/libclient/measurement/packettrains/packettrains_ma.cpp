@@ -1,41 +1,28 @@
 #include "packettrains_ma.h"
+#include "packettrainspacer.h"
+#include "packettrainsender.h"
 #include "../../log/logger.h"
 #include "../../network/networkmanager.h"
+#include "../../network/peerconnection.h"
 #include "../../client.h"
 #include "../../trafficbudgetmanager.h"
+#include "../../types.h"
 #include <QUdpSocket>
-#include <QElapsedTimer>
-
-#ifdef Q_OS_WIN
-#include <WinSock2.h>
-#include <chrono>
-#include <thread>
-#else
-#include <arpa/inet.h>
-#endif
+#include <QHostInfo>
 
 LOGGER(PacketTrainsMA);
 
-namespace help
+namespace
 {
-#ifdef Q_OS_WIN
-    inline void nanosleep(qint64 ns)
-    {
-        std::this_thread::sleep_for(std::chrono::nanoseconds(ns));
-    }
-#else
-    inline void nanosleep(qint64 ns)
-    {
-        struct timespec delay;
-        delay.tv_sec = 0;
-        delay.tv_nsec = ns;
-        ::nanosleep(&delay, NULL);
-    }
-#endif
+    // Lead time before the first packet is due
+    const qint64 startDelay = 1000000; // 1 ms
 }
 
 PacketTrainsMA::PacketTrainsMA()
-: m_udpSocket(NULL)
+: m_networkManager(NULL)
+, m_udpSocket(NULL)
+, m_lookupId(-1)
+, m_sendErrors(0)
 {
     connect(this, SIGNAL(error(const QString &)), this,
             SLOT(setErrorString(const QString &)));
@@ -43,45 +30,52 @@ PacketTrainsMA::PacketTrainsMA()
 
 bool PacketTrainsMA::start()
 {
-    QByteArray buffer;
-    buffer.resize(definition->packetSize);
+    const int packetSize = definition->packetSize;
+    const int trainLength = definition->trainLength;
 
-    struct msg *message = reinterpret_cast<msg *>(buffer.data());
+    if (!m_udpSocket)
+    {
+        setErrorString("Not connected to the peer");
+        return false;
+    }
+
+    if (packetSize < (int)sizeof(msg) || trainLength < 2)
+    {
+        setErrorString("Invalid packet size or train length");
+        return false;
+    }
 
-    // calculate disperson
-    quint64 *disp = new quint64[definition->iterations];
     quint64 R_MIN = definition->rateMin;
     quint64 R_MAX = definition->rateMax;
-    quint64 delay = definition->delay;
+    qint64 delay = definition->delay;
 
-    for (int i = 0; i < definition->iterations; i++)
-    {
-        disp[i] = (quint64)(definition->packetSize * 1000000000.0 / ((R_MAX - R_MIN) / definition->iterations * i +
-                                                                     R_MIN));  // Linear Rate
-    }
+    PacketTrainSender trainSender(m_udpSocket, m_address, definition->port, packetSize);
+
+    m_targetDispersion.clear();
+    m_achievedDispersion.clear();
+    m_sendErrors = 0;
 
-    QElapsedTimer timer;
-    timer.start();
+    qint64 trainStart = PacketTrainsPacer::now() + startDelay;
 
     // send trains
-    for (int i = 0; i < definition->trainLength * definition->iterations; i++)
+    for (int iter = 0; iter < definition->iterations; iter++)
     {
-        message->iter = htons(i / definition->trainLength);
-        message->id = i % definition->trainLength;
+        // calculate dispersion (linear rate)
+        quint64 rate = (R_MAX - R_MIN) / definition->iterations * iter + R_MIN;
+        qint64 gap = rate ? (qint64)(packetSize * 1000000000.0 / rate) : 0;
 
-        message->otime = timer.nsecsElapsed();
+        m_sendErrors += trainLength - trainSender.send(iter, trainLength, trainStart, gap);
 
-        m_udpSocket->writeDatagram(buffer, QHostAddress(definition->host), definition->port);
+        m_targetDispersion.append(gap);
+        m_achievedDispersion.append(trainSender.achievedDispersion());
 
-        help::nanosleep(i / definition->trainLength);
-
-        if (i % definition->trainLength == definition->trainLength - 1)
-        {
-            help::nanosleep(delay);
-        }
+        trainStart = trainSender.lastSent() + delay;
     }
 
-    delete[] disp;
+    if (m_sendErrors)
+    {
+        LOG_WARNING(QString("%1 packets could not be sent").arg(m_sendErrors));
+    }
 
     emit finished();
     return true;
@@ -106,7 +100,9 @@ Measurement::Status PacketTrainsMA::status() const
 
 bool PacketTrainsMA::prepare(NetworkManager *networkManager, const MeasurementDefinitionPtr &measurementDefinition)
 {
-    definition = measurementDefinition.dynamicCast<PacketTrainsDefinition>();
+    Q_UNUSED(networkManager);
+
+    definition = measurementDefinition.dynamicCast<const PacketTrainsDefinition>();
 
     if (definition.isNull())
     {
@@ -114,39 +110,123 @@ bool PacketTrainsMA::prepare(NetworkManager *networkManager, const MeasurementDe
         return false;
     }
 
+    // resolve the destination once instead of for every datagram, host
+    // names are looked up by prepareAsync()
+    m_address = QHostAddress(definition->host);
+
+    if (!Client::instance()->trafficBudgetManager()->addUsedTraffic(definition->iterations *
+                                                                    definition->packetSize * definition->trainLength))
+    {
+        setErrorString("not enough traffic available");
+        return false;
+    }
+
+    // the peer connection is established by prepareAsync()
+    return true;
+}
+
+bool PacketTrainsMA::prepareAsync(NetworkManager *networkManager, const MeasurementDefinitionPtr &measurementDefinition)
+{
+    if (!prepare(networkManager, measurementDefinition))
+    {
+        return false;
+    }
+
+    m_networkManager = networkManager;
+
+    if (m_address.isNull())
+    {
+        m_lookupId = QHostInfo::lookupHost(definition->host, this, SLOT(hostLookedUp(QHostInfo)));
+        return true;
+    }
+
+    return connectPeer();
+}
+
+bool PacketTrainsMA::connectPeer()
+{
     QString hostname = QString("%1:%2").arg(definition->host).arg(definition->port);
 
-    m_udpSocket = qobject_cast<QUdpSocket *>(networkManager->establishConnection(hostname, taskId(), "packettrains_mp",
-                                                                                 definition, NetworkManager::UdpSocket));
+    setMeasurementUuid(QUuid::createUuid());
 
-    if (!m_udpSocket)
+    m_connection = m_networkManager->establishConnection(hostname, taskId(), "packettrains_mp", definition,
+                                                         getMeasurementUuid(), NetworkManager::UdpSocket);
+
+    if (!m_connection)
     {
         setErrorString("Preparation failed");
         return false;
     }
 
+    m_connection->setParent(this);
+    connect(m_connection.data(), SIGNAL(connected()), this, SLOT(peerConnected()));
+    connect(m_connection.data(), SIGNAL(error(const QString &)), this, SLOT(peerError(const QString &)));
+
+    return true;
+}
+
+void PacketTrainsMA::hostLookedUp(const QHostInfo &hostInfo)
+{
+    m_lookupId = -1;
+
+    if (hostInfo.addresses().isEmpty())
+    {
+        emit error(QString("Unable to resolve %1").arg(definition->host));
+        return;
+    }
+
+    m_address = hostInfo.addresses().first();
+
+    if (!connectPeer())
+    {
+        emit error(errorString());
+    }
+}
+
+void PacketTrainsMA::peerConnected()
+{
+    m_udpSocket = qobject_cast<QUdpSocket *>(m_connection->takeSocket());
+    m_connection->deleteLater();
+
+    if (!m_udpSocket)
+    {
+        emit error("Preparation failed");
+        return;
+    }
+
     m_udpSocket->setParent(this);
 
     // Signal for errors
     connect(m_udpSocket, SIGNAL(error(QAbstractSocket::SocketError)), this,
             SLOT(handleError(QAbstractSocket::SocketError)));
 
-    if (!Client::instance()->trafficBudgetManager()->addUsedTraffic(definition->iterations *
-                                                                    definition->packetSize * definition->trainLength))
-    {
-        setErrorString("not enough traffic available");
-        return false;
-    }
+    emit prepared();
+}
 
-    return true;
+void PacketTrainsMA::peerError(const QString &message)
+{
+    m_connection->deleteLater();
+
+    emit error(QString("Preparation failed: %1").arg(message));
 }
 
 bool PacketTrainsMA::stop()
 {
+    if (m_lookupId != -1)
+    {
+        QHostInfo::abortHostLookup(m_lookupId);
+        m_lookupId = -1;
+    }
+
     return true;
 }
 
 Result PacketTrainsMA::result() const
 {
-    return Result(QVariantMap(), definition->measurementUuid);
+    QVariantMap map;
+    map.insert("target_dispersion", listToVariant(m_targetDispersion));
+    map.insert("achieved_dispersion", listToVariant(m_achievedDispersion));
+    map.insert("send_errors", m_sendErrors);
+
+    return Result(map, getMeasurementUuid());
 }
@@ -2,10 +2,14 @@
 #define PACKETTRAINS_MA_H
 
 #include <QUdpSocket>
+#include <QPointer>
 
 #include "../measurement.h"
 #include "packettrainsdefinition.h"
 
+class PeerConnection;
+class QHostInfo;
+
 class PacketTrainsMA : public Measurement
 {
     Q_OBJECT
@@ -13,16 +17,33 @@ public:
     explicit PacketTrainsMA();
     Status status() const;
     bool prepare(NetworkManager *networkManager, const MeasurementDefinitionPtr &measurementDefinition);
+    bool prepareAsync(NetworkManager *networkManager, const MeasurementDefinitionPtr &measurementDefinition);
     bool start();
     bool stop();
     Result result() const;
 
 private:
+    bool connectPeer();
+
     PacketTrainsDefinitionPtr definition;
+    NetworkManager *m_networkManager;
     QUdpSocket *m_udpSocket;
+    QPointer<PeerConnection> m_connection;
+    QHostAddress m_address;
+    int m_lookupId;
+
+    // per train in ns
+    QList<qint64> m_targetDispersion;
+    QList<qint64> m_achievedDispersion;
+    int m_sendErrors;
 
 public slots:
     void handleError(QAbstractSocket::SocketError socketError);
+
+private slots:
+    void hostLookedUp(const QHostInfo &hostInfo);
+    void peerConnected();
+    void peerError(const QString &message);
 };
 
 #endif // PACKETTRAINS_MA_H
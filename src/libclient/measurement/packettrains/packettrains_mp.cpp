@@ -1,8 +1,7 @@
 #include "packettrains_mp.h"
 #include <QUdpSocket>
-#include <iostream>
-using namespace std;
-#include <iomanip>
+#include <QVarLengthArray>
+#include <string.h>
 #include "../../log/logger.h"
 #include "../../network/networkmanager.h"
 #include "../../types.h"
@@ -13,15 +12,51 @@ using namespace std;
 #include <arpa/inet.h>
 #endif
 
-LOGGER(PacketTrainsMA);
+#if defined(Q_OS_LINUX) && !defined(Q_OS_ANDROID)
+#define PACKETTRAINS_RECVMMSG
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <linux/net_tstamp.h>
+#endif
+
+LOGGER(PacketTrainsMP);
+
+namespace
+{
+    // Datagrams fetched with one system call
+    const int maxBatch = 32;
+
+#ifdef PACKETTRAINS_RECVMMSG
+    // Room for SCM_TIMESTAMPNS or SCM_TIMESTAMPING (three timespecs)
+    const int controlSize = CMSG_SPACE(3 * sizeof(struct timespec));
+
+    inline qint64 toNsecs(const struct timespec &ts)
+    {
+        return ts.tv_sec * Q_INT64_C(1000000000) + ts.tv_nsec;
+    }
+#endif
+}
 
 PacketTrainsMP::PacketTrainsMP()
 : m_udpSocket(NULL)
+, m_descriptor(-1)
+, m_notifier(NULL)
+, m_duplicates(0)
+, m_invalid(0)
+, m_timestampSource(UserTimestamp)
 {
     connect(this, SIGNAL(error(const QString &)), this,
             SLOT(setErrorString(const QString &)));
 }
 
+PacketTrainsMP::~PacketTrainsMP()
+{
+    closeDescriptor();
+}
+
 bool PacketTrainsMP::start()
 {
    // Timeout for "nothing happens after start"
@@ -36,95 +71,316 @@ bool PacketTrainsMP::start()
     connect(&m_timer, SIGNAL(timeout()), this, SLOT(eval()));
 
     m_receiveTimer.invalidate();
+    m_timestampSource = UserTimestamp;
 
-    // Signal for new packets
-    connect(m_udpSocket, SIGNAL(readyRead()), this, SLOT(readPendingDatagrams()));
+    if (openDescriptor())
+    {
+        enableTimestamps();
+
+        m_notifier = new QSocketNotifier(m_descriptor, QSocketNotifier::Read, this);
+        connect(m_notifier, SIGNAL(activated(int)), this, SLOT(readPendingDatagrams()));
+    }
+    else
+    {
+        // Signal for new packets
+        connect(m_udpSocket, SIGNAL(readyRead()), this, SLOT(readPendingDatagrams()));
+    }
 
     return true;
 }
 
-void PacketTrainsMP::readPendingDatagrams()
+bool PacketTrainsMP::openDescriptor()
 {
-    m_timeout.start();
+#ifdef PACKETTRAINS_RECVMMSG
+    // Since Qt 5.7 readyRead() is not emitted again until the QUdpSocket
+    // itself read a datagram, so recvmmsg() works on a duplicate with its
+    // own notifier and the QUdpSocket is closed.
+    m_descriptor = fcntl(m_udpSocket->socketDescriptor(), F_DUPFD_CLOEXEC, 0);
+
+    if (m_descriptor == -1)
+    {
+        LOG_WARNING(QString("Unable to duplicate the socket: %1").arg(strerror(errno)));
+        return false;
+    }
+
+    m_udpSocket->close();
+    return true;
+#else
+    return false;
+#endif
+}
+
+void PacketTrainsMP::closeDescriptor()
+{
+    if (m_notifier)
+    {
+        m_notifier->setEnabled(false);
+        m_notifier->deleteLater();
+        m_notifier = NULL;
+    }
+
+#ifdef PACKETTRAINS_RECVMMSG
+    if (m_descriptor != -1)
+    {
+        ::close(m_descriptor);
+        m_descriptor = -1;
+    }
+#endif
+}
+
+void PacketTrainsMP::enableTimestamps()
+{
+#ifdef PACKETTRAINS_RECVMMSG
+    int fd = m_descriptor;
 
-    qint64 timestamp;
-    struct msg *message;
-    quint16 iter;
+    // Hardware timestamps are only delivered if the interface was configured for
+    // it (SIOCSHWTSTAMP), the software timestamp is always part of SO_TIMESTAMPING.
+    int flags = SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE |
+                SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
 
-    if (!m_receiveTimer.isValid())
+    if (setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) == 0)
     {
-        m_receiveTimer.start();
+        m_timestampSource = KernelTimestamp;
+    }
+    else
+    {
+        int enable = 1;
+
+        if (setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, &enable, sizeof(enable)) == 0)
+        {
+            m_timestampSource = KernelTimestamp;
+        }
+        else
+        {
+            LOG_WARNING(QString("Kernel timestamps not available: %1").arg(strerror(errno)));
+        }
     }
+#endif
+}
+
+bool PacketTrainsMP::readBatch()
+{
+#ifdef PACKETTRAINS_RECVMMSG
+    const int packetSize = m_buffer.size() / maxBatch;
 
-    while (m_udpSocket->hasPendingDatagrams())
+    struct mmsghdr messages[maxBatch];
+    struct iovec iovecs[maxBatch];
+    union
     {
-        // get time first
-        timestamp = m_receiveTimer.nsecsElapsed();
+        char buffer[controlSize];
+        struct cmsghdr align;
+    } control[maxBatch];
 
-        QByteArray buffer;
-        buffer.resize(m_udpSocket->pendingDatagramSize());
+    memset(messages, 0, sizeof(messages));
 
-        QHostAddress sender;
-        quint16 senderPort;
+    for (int i = 0; i < maxBatch; ++i)
+    {
+        iovecs[i].iov_base = m_buffer.data() + i * packetSize;
+        iovecs[i].iov_len = packetSize;
 
-        m_udpSocket->readDatagram(buffer.data(), buffer.size(), &sender, &senderPort);
-        message = reinterpret_cast<msg *>(buffer.data());
+        messages[i].msg_hdr.msg_iov = &iovecs[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+        messages[i].msg_hdr.msg_control = control[i].buffer;
+        messages[i].msg_hdr.msg_controllen = controlSize;
+    }
 
-        message->rtime = timestamp;
-        message->r_id = m_packetsReceived++;
+    int count = recvmmsg(m_descriptor, messages, maxBatch, MSG_DONTWAIT, NULL);
 
-        iter = ntohs(message->iter);
+    if (count <= 0)
+    {
+        return false;
+    }
 
-        if (iter < m_rec.size())
+    for (int i = 0; i < count; ++i)
+    {
+        qint64 timestamp = -1;
+        struct msghdr *header = &messages[i].msg_hdr;
+
+        for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(header); cmsg; cmsg = CMSG_NXTHDR(header, cmsg))
         {
-            m_rec[iter].append(*message);
+            if (cmsg->cmsg_level != SOL_SOCKET)
+            {
+                continue;
+            }
+
+            if (cmsg->cmsg_type == SCM_TIMESTAMPNS)
+            {
+                timestamp = toNsecs(*(struct timespec *)CMSG_DATA(cmsg));
+            }
+            else if (cmsg->cmsg_type == SCM_TIMESTAMPING)
+            {
+                // [0] software, [1] deprecated, [2] raw hardware
+                struct timespec *ts = (struct timespec *)CMSG_DATA(cmsg);
+
+                if (ts[2].tv_sec || ts[2].tv_nsec)
+                {
+                    timestamp = toNsecs(ts[2]);
+                    m_timestampSource = HardwareTimestamp;
+                }
+                else
+                {
+                    timestamp = toNsecs(ts[0]);
+                }
+            }
         }
-        else
+
+        if (timestamp < 0)
+        {
+            // same clock as the kernel software timestamps
+            struct timespec now;
+            clock_gettime(CLOCK_REALTIME, &now);
+            timestamp = toNsecs(now);
+        }
+
+        recordPacket(m_buffer.constData() + i * packetSize, messages[i].msg_len, timestamp);
+    }
+
+    // there might be more datagrams waiting
+    return count == maxBatch;
+#else
+    return false;
+#endif
+}
+
+void PacketTrainsMP::recordPacket(const char *data, qint64 size, qint64 timestamp)
+{
+    if (size < (qint64)sizeof(msg))
+    {
+        m_invalid++;
+        return;
+    }
+
+    struct msg message;
+    memcpy(&message, data, sizeof(message));
+
+    quint16 iter = ntohs(message.iter);
+
+    if (iter >= definition->iterations || message.id >= definition->trainLength)
+    {
+        m_invalid++;
+        return;
+    }
+
+    int slot = iter * definition->trainLength + message.id;
+
+    if (m_received.testBit(slot))
+    {
+        m_duplicates++;
+        return;
+    }
+
+    message.rtime = timestamp;
+    message.r_id = m_trainReceived[iter]++;
+
+    m_ring[slot] = message;
+    m_received.setBit(slot);
+}
+
+void PacketTrainsMP::readPendingDatagrams()
+{
+    m_timeout.start();
+
+    if (m_descriptor != -1)
+    {
+        while (readBatch())
+        {
+        }
+    }
+    else
+    {
+        if (!m_receiveTimer.isValid())
         {
-            LOG_WARNING("Something went wrong"); // TODO
+            m_receiveTimer.start();
         }
 
-        m_timer.start();
+        while (m_udpSocket->hasPendingDatagrams())
+        {
+            // get time first
+            qint64 timestamp = m_receiveTimer.nsecsElapsed();
+            qint64 size = m_udpSocket->readDatagram(m_buffer.data(), m_buffer.size());
+            recordPacket(m_buffer.constData(), size, timestamp);
+        }
     }
+
+    m_timer.start();
 }
 
 void PacketTrainsMP::eval()
 {
-    foreach (const QList<msg> &l, m_rec)
+    const int trainLength = definition->trainLength;
+
+    for (int iter = 0; iter < definition->iterations; iter++)
     {
-        quint64 ts_otime[2] = {0}, ts_rtime[2] = {2};
-        double srate = 0, rrate = 0;
+        int received = m_trainReceived.at(iter);
+
+        m_loss.append(trainLength - received);
+
+        if (received < 2)
+        {
+            m_reordered.append(0);
+            LOG_WARNING(QString("Ignoring train %1, only %2 packets received").arg(iter).arg(received));
+            continue;
+        }
+
+        qint64 ts_otime[2] = {0}, ts_rtime[2] = {0};
+        bool first = true;
+        QVarLengthArray<int, 256> order(received);
 
-        for (int i = 0; i < l.size(); i++)
+        for (int id = 0; id < trainLength; id++)
         {
-            if (l[i].id != l[i].r_id)
+            int slot = iter * trainLength + id;
+
+            if (!m_received.testBit(slot))
+            {
+                continue;
+            }
+
+            const msg &message = m_ring.at(slot);
+            order[message.r_id] = id;
+
+            if (first)
             {
-                LOG_DEBUG("Packages out of order");
+                ts_otime[0] = ts_otime[1] = message.otime;
+                ts_rtime[0] = ts_rtime[1] = message.rtime;
+                first = false;
+            }
+            else
+            {
+                ts_otime[0] = qMin(ts_otime[0], message.otime);
+                ts_otime[1] = qMax(ts_otime[1], message.otime);
+                ts_rtime[0] = qMin(ts_rtime[0], message.rtime);
+                ts_rtime[1] = qMax(ts_rtime[1], message.rtime);
             }
         }
 
-        /*
-        ts_otime[0] = l.first().otime.tv_sec * 1000000000 + l.first().otime.tv_nsec;
-        ts_otime[1] = l.last().otime.tv_sec * 1000000000 + l.last().otime.tv_nsec;
-        ts_rtime[0] = l.first().rtime.tv_sec * 1000000000 + l.first().rtime.tv_nsec;
-        ts_rtime[1] = l.last().rtime.tv_sec * 1000000000 + l.last().rtime.tv_nsec;
-        */
+        // count packets which arrived after a packet with a higher id
+        int reordered = 0;
+        int maxId = -1;
 
-        ts_otime[0] = l.first().otime;
-        ts_otime[1] = l.last().otime;
-        ts_rtime[0] = l.first().rtime;
-        ts_rtime[1] = l.last().rtime;
+        for (int i = 0; i < received; i++)
+        {
+            if (order[i] < maxId)
+            {
+                reordered++;
+            }
+            else
+            {
+                maxId = order[i];
+            }
+        }
 
-        srate = (double) definition->packetSize * l.size() / (ts_otime[1] - ts_otime[0]) * 1000000000;
-        rrate = (double) definition->packetSize * l.size() / (ts_rtime[1] - ts_rtime[0]) * 1000000000;
+        m_reordered.append(reordered);
 
         // ignore infinite rates
-        if (ts_otime[0] != ts_rtime[1] && ts_rtime[0] != ts_rtime[1])
+        if (ts_otime[0] != ts_otime[1] && ts_rtime[0] != ts_rtime[1])
         {
+            double bytes = (double) definition->packetSize * (received - 1);
+            double srate = bytes / (ts_otime[1] - ts_otime[0]) * 1000000000;
+            double rrate = bytes / (ts_rtime[1] - ts_rtime[0]) * 1000000000;
+
             m_recvSpeed.append(rrate / 1024);
             m_sendSpeed.append(srate / 1024);
-            //cout<<"sending @ "<<fixed<<setprecision(2)<<srate / 1048576 * 8<<" MBit/s"<<endl;
-            //cout<<"receiving @ "<<fixed<<setprecision(2)<<rrate / 1048576 * 8<<" MBit/s"<<endl;
+            m_dispersion.append((ts_rtime[1] - ts_rtime[0]) / (received - 1));
         }
         else
         {
@@ -132,6 +388,11 @@ void PacketTrainsMP::eval()
         }
     }
 
+    if (m_duplicates || m_invalid)
+    {
+        LOG_DEBUG(QString("Received %1 duplicate and %2 invalid packets").arg(m_duplicates).arg(m_invalid));
+    }
+
     emit finished();
 }
 
@@ -155,11 +416,12 @@ bool PacketTrainsMP::prepare(NetworkManager *networkManager, const MeasurementDe
 {
     Q_UNUSED(networkManager);
 
-    definition = measurementDefinition.dynamicCast<PacketTrainsDefinition>();
+    definition = measurementDefinition.dynamicCast<const PacketTrainsDefinition>();
 
     if (definition.isNull())
     {
         setErrorString("Definition is empty");
+        return false;
     }
 
     m_udpSocket = qobject_cast<QUdpSocket *>(peerSocket());
@@ -176,13 +438,21 @@ bool PacketTrainsMP::prepare(NetworkManager *networkManager, const MeasurementDe
     connect(m_udpSocket, SIGNAL(error(QAbstractSocket::SocketError)), this,
             SLOT(handleError(QAbstractSocket::SocketError)));
 
-    m_packetsReceived = 0;
-    m_rec.clear();
+    // Allocate everything we need while receiving upfront
+    int packets = definition->iterations * definition->trainLength;
 
-    for (int i = 0; i < definition->iterations; i++)
-    {
-        m_rec.append(QList<msg>());
-    }
+    m_ring.fill(msg(), packets);
+    m_received.fill(false, packets);
+    m_trainReceived.fill(0, definition->iterations);
+    m_buffer.resize(maxBatch * qMax<int>(definition->packetSize, sizeof(msg)));
+    m_duplicates = 0;
+    m_invalid = 0;
+
+    m_sendSpeed.clear();
+    m_recvSpeed.clear();
+    m_dispersion.clear();
+    m_loss.clear();
+    m_reordered.clear();
 
     return true;
 }
@@ -190,6 +460,7 @@ bool PacketTrainsMP::prepare(NetworkManager *networkManager, const MeasurementDe
 bool PacketTrainsMP::stop()
 {
     m_timeout.stop();
+    closeDescriptor();
     return true;
 }
 
@@ -198,6 +469,25 @@ Result PacketTrainsMP::result() const
     QVariantMap map;
     map.insert("sending_speed", listToVariant(m_sendSpeed));
     map.insert("receiving_speed", listToVariant(m_recvSpeed));
+    map.insert("receive_dispersion", listToVariant(m_dispersion));
+    map.insert("loss", listToVariant(m_loss));
+    map.insert("reordered", listToVariant(m_reordered));
+    map.insert("duplicates", m_duplicates);
+
+    switch (m_timestampSource)
+    {
+    case HardwareTimestamp:
+        map.insert("timestamps", "hardware");
+        break;
+
+    case KernelTimestamp:
+        map.insert("timestamps", "kernel");
+        break;
+
+    default:
+        map.insert("timestamps", "user");
+        break;
+    }
 
     return Result(map, getMeasurementUuid());
 }
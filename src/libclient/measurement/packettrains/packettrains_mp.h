@@ -4,6 +4,9 @@
 #include <QTimer>
 #include <QUdpSocket>
 #include <QElapsedTimer>
+#include <QBitArray>
+#include <QVector>
+#include <QSocketNotifier>
 
 #include "../measurement.h"
 #include "packettrainsdefinition.h"
@@ -13,20 +16,51 @@ class PacketTrainsMP : public Measurement
     Q_OBJECT
 public:
     explicit PacketTrainsMP();
+    ~PacketTrainsMP();
     Status status() const;
     bool prepare(NetworkManager *networkManager, const MeasurementDefinitionPtr &measurementDefinition);
     bool start();
     bool stop();
     Result result() const;
 
+    enum TimestampSource
+    {
+        UserTimestamp,
+        KernelTimestamp,
+        HardwareTimestamp
+    };
+
 private:
+    bool openDescriptor();
+    void closeDescriptor();
+    void enableTimestamps();
+    bool readBatch();
+    void recordPacket(const char *data, qint64 size, qint64 timestamp);
+
     PacketTrainsDefinitionPtr definition;
     QUdpSocket *m_udpSocket;
     QTimer m_timer;
-    QList<QList<struct msg> > m_rec;
-    quint16 m_packetsReceived;
+
+    // Own copy of the socket for recvmmsg(), QUdpSocket no longer reads it
+    int m_descriptor;
+    QSocketNotifier *m_notifier;
+
+    // Preallocated ring with one slot per packet (iteration * trainLength + id)
+    QVector<msg> m_ring;
+    QBitArray m_received;
+    QVector<int> m_trainReceived;
+    quint32 m_duplicates;
+    quint32 m_invalid;
+
+    // Receive buffers, reused for every datagram
+    QByteArray m_buffer;
+    TimestampSource m_timestampSource;
+
     QList<int> m_sendSpeed;
     QList<int> m_recvSpeed;
+    QList<qint64> m_dispersion;
+    QList<int> m_loss;
+    QList<int> m_reordered;
 
     QTimer m_timeout;
 
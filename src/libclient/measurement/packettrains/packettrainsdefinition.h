@@ -9,7 +9,7 @@
 
 class PacketTrainsDefinition;
 
-typedef QSharedPointer<PacketTrainsDefinition> PacketTrainsDefinitionPtr;
+typedef QSharedPointer<const PacketTrainsDefinition> PacketTrainsDefinitionPtr;
 typedef QList<PacketTrainsDefinitionPtr> PacketTrainsDefinitionList;
 
 class PacketTrainsDefinition : public MeasurementDefinition
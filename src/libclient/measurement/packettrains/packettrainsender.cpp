@@ -0,0 +1,224 @@
+#include "packettrainsender.h"
+#include "packettrainspacer.h"
+#include "packettrainsdefinition.h"
+
+#include <QUdpSocket>
+
+#ifdef Q_OS_WIN
+#include <WinSock2.h>
+#else
+#include <arpa/inet.h>
+#endif
+
+#if defined(Q_OS_LINUX) && !defined(Q_OS_ANDROID)
+#define PACKETTRAINS_SENDMMSG
+#include <string.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#endif
+
+#ifdef PACKETTRAINS_SENDMMSG
+struct PacketTrainSender::Destination
+{
+    struct sockaddr_storage address;
+    socklen_t length;
+};
+
+namespace
+{
+    bool destinationFor(int fd, const QHostAddress &host, quint16 port, struct sockaddr_storage *address,
+                        socklen_t *length)
+    {
+        struct sockaddr_storage local;
+        socklen_t localLength = sizeof(local);
+
+        if (getsockname(fd, (struct sockaddr *)&local, &localLength) != 0)
+        {
+            return false;
+        }
+
+        memset(address, 0, sizeof(*address));
+
+        if (local.ss_family == AF_INET && host.protocol() == QAbstractSocket::IPv4Protocol)
+        {
+            struct sockaddr_in *addr = (struct sockaddr_in *)address;
+            addr->sin_family = AF_INET;
+            addr->sin_port = htons(port);
+            addr->sin_addr.s_addr = htonl(host.toIPv4Address());
+            *length = sizeof(*addr);
+            return true;
+        }
+
+        if (local.ss_family == AF_INET6)
+        {
+            struct sockaddr_in6 *addr = (struct sockaddr_in6 *)address;
+            addr->sin6_family = AF_INET6;
+            addr->sin6_port = htons(port);
+
+            if (host.protocol() == QAbstractSocket::IPv4Protocol)
+            {
+                // dual-stack socket, use the v4-mapped address
+                quint32 ipv4 = htonl(host.toIPv4Address());
+                addr->sin6_addr.s6_addr[10] = 0xff;
+                addr->sin6_addr.s6_addr[11] = 0xff;
+                memcpy(&addr->sin6_addr.s6_addr[12], &ipv4, sizeof(ipv4));
+            }
+            else
+            {
+                Q_IPV6ADDR ipv6 = host.toIPv6Address();
+                memcpy(addr->sin6_addr.s6_addr, &ipv6, sizeof(ipv6));
+            }
+
+            *length = sizeof(*addr);
+            return true;
+        }
+
+        return false;
+    }
+}
+#else
+struct PacketTrainSender::Destination
+{
+};
+#endif
+
+PacketTrainSender::PacketTrainSender(QUdpSocket *socket, const QHostAddress &address, quint16 port, int packetSize)
+: m_socket(socket)
+, m_address(address)
+, m_port(port)
+, m_packetSize(packetSize)
+, m_destination(NULL)
+, m_buffer(maxBatch * packetSize, 0)
+, m_trainLength(0)
+, m_firstSent(-1)
+, m_lastSent(-1)
+{
+#ifdef PACKETTRAINS_SENDMMSG
+    m_destination = new Destination;
+
+    if (!destinationFor(socket->socketDescriptor(), address, port, &m_destination->address, &m_destination->length))
+    {
+        delete m_destination;
+        m_destination = NULL;
+    }
+#endif
+}
+
+PacketTrainSender::~PacketTrainSender()
+{
+    delete m_destination;
+}
+
+int PacketTrainSender::send(quint16 iter, int trainLength, qint64 start, qint64 gap)
+{
+    int packets = 0;
+    int id = 0;
+
+    m_trainLength = trainLength;
+    m_firstSent = -1;
+    m_lastSent = -1;
+
+    while (id < trainLength)
+    {
+        int count = batchSize(id, trainLength, gap);
+
+        PacketTrainsPacer::waitUntil(start + id * gap);
+        qint64 sent = PacketTrainsPacer::now();
+
+        // every packet carries its own send time, the receiver derives the
+        // sending rate from them
+        for (int i = 0; i < count; ++i)
+        {
+            struct msg *message = reinterpret_cast<msg *>(m_buffer.data() + i * m_packetSize);
+            message->iter = htons(iter);
+            message->id = id + i;
+            message->otime = sent + i * gap;
+        }
+
+        packets += sendBatch(count);
+
+        if (m_firstSent < 0)
+        {
+            m_firstSent = sent;
+        }
+
+        id += count;
+    }
+
+    // the last batch left only once the system call returned
+    m_lastSent = PacketTrainsPacer::now();
+
+    return packets;
+}
+
+qint64 PacketTrainSender::firstSent() const
+{
+    return m_firstSent;
+}
+
+qint64 PacketTrainSender::lastSent() const
+{
+    return m_lastSent;
+}
+
+qint64 PacketTrainSender::achievedDispersion() const
+{
+    if (m_trainLength < 2 || m_firstSent < 0)
+    {
+        return 0;
+    }
+
+    return (m_lastSent - m_firstSent) / (m_trainLength - 1);
+}
+
+int PacketTrainSender::batchSize(int id, int trainLength, qint64 gap)
+{
+    int count = 1;
+
+    while (count < maxBatch && id + count < trainLength && gap < syscallCost)
+    {
+        count++;
+    }
+
+    return count;
+}
+
+int PacketTrainSender::sendBatch(int count)
+{
+#ifdef PACKETTRAINS_SENDMMSG
+    if (m_destination && count > 1)
+    {
+        struct mmsghdr messages[maxBatch];
+        struct iovec iovecs[maxBatch];
+
+        memset(messages, 0, sizeof(messages));
+
+        for (int i = 0; i < count; ++i)
+        {
+            iovecs[i].iov_base = m_buffer.data() + i * m_packetSize;
+            iovecs[i].iov_len = m_packetSize;
+
+            messages[i].msg_hdr.msg_name = &m_destination->address;
+            messages[i].msg_hdr.msg_namelen = m_destination->length;
+            messages[i].msg_hdr.msg_iov = &iovecs[i];
+            messages[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        int sent = sendmmsg(m_socket->socketDescriptor(), messages, count, 0);
+        return sent < 0 ? 0 : sent;
+    }
+#endif
+
+    int packets = 0;
+
+    for (int i = 0; i < count; ++i)
+    {
+        if (m_socket->writeDatagram(m_buffer.constData() + i * m_packetSize, m_packetSize, m_address, m_port)
+            == m_packetSize)
+        {
+            packets++;
+        }
+    }
+
+    return packets;
+}
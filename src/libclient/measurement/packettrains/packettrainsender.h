@@ -0,0 +1,55 @@
+#ifndef PACKETTRAINSENDER_H
+#define PACKETTRAINSENDER_H
+
+#include "../../export.h"
+
+#include <QByteArray>
+#include <QHostAddress>
+
+class QUdpSocket;
+
+// Sends packet trains paced by PacketTrainsPacer. Gaps shorter than a
+// system call can't be paced, such packets are handed to the kernel with
+// one system call (sendmmsg() on Linux).
+class CLIENT_API PacketTrainSender
+{
+public:
+    PacketTrainSender(QUdpSocket *socket, const QHostAddress &address, quint16 port, int packetSize);
+    ~PacketTrainSender();
+
+    // Sends trainLength packets, packet i is due at start + i * gap.
+    // Returns the number of packets the kernel accepted.
+    int send(quint16 iter, int trainLength, qint64 start, qint64 gap);
+
+    // Time before the first and after the last packet of the previous
+    // train were handed to the kernel
+    qint64 firstSent() const;
+    qint64 lastSent() const;
+
+    // Mean achieved gap of the previous train in ns
+    qint64 achievedDispersion() const;
+
+    // Number of packets sent together starting at packet id
+    static int batchSize(int id, int trainLength, qint64 gap);
+
+    static const qint64 syscallCost = 2000; // 2 µs
+    static const int maxBatch = 32;
+
+private:
+    int sendBatch(int count);
+
+    QUdpSocket *m_socket;
+    QHostAddress m_address;
+    quint16 m_port;
+    int m_packetSize;
+
+    struct Destination;
+    Destination *m_destination;
+
+    QByteArray m_buffer;
+    int m_trainLength;
+    qint64 m_firstSent;
+    qint64 m_lastSent;
+};
+
+#endif // PACKETTRAINSENDER_H
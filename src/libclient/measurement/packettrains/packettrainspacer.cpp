@@ -0,0 +1,74 @@
+#include "packettrainspacer.h"
+
+#if defined(Q_OS_LINUX)
+#include <errno.h>
+#include <time.h>
+#else
+#include <QElapsedTimer>
+#include <chrono>
+#include <thread>
+#endif
+
+#if defined(Q_OS_LINUX)
+qint64 PacketTrainsPacer::now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * Q_INT64_C(1000000000) + ts.tv_nsec;
+}
+
+void PacketTrainsPacer::waitUntil(qint64 deadline)
+{
+    qint64 wakeup = deadline - spinThreshold;
+
+    if (wakeup > now())
+    {
+        struct timespec ts;
+        ts.tv_sec = wakeup / Q_INT64_C(1000000000);
+        ts.tv_nsec = wakeup % Q_INT64_C(1000000000);
+
+        // absolute sleeps don't accumulate errors when interrupted
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+        {
+        }
+    }
+
+    while (now() < deadline)
+    {
+    }
+}
+#else
+namespace
+{
+    const QElapsedTimer &monotonicTimer()
+    {
+        static QElapsedTimer timer;
+
+        if (!timer.isValid())
+        {
+            timer.start();
+        }
+
+        return timer;
+    }
+}
+
+qint64 PacketTrainsPacer::now()
+{
+    return monotonicTimer().nsecsElapsed();
+}
+
+void PacketTrainsPacer::waitUntil(qint64 deadline)
+{
+    qint64 remaining = deadline - now() - spinThreshold;
+
+    if (remaining > 0)
+    {
+        std::this_thread::sleep_for(std::chrono::nanoseconds(remaining));
+    }
+
+    while (now() < deadline)
+    {
+    }
+}
+#endif
@@ -0,0 +1,22 @@
+#ifndef PACKETTRAINSPACER_H
+#define PACKETTRAINSPACER_H
+
+#include "../../export.h"
+
+// Schedules packets on absolute points of a monotonic clock. Waiting
+// is done by sleeping until shortly before the deadline and spinning
+// for the rest, which keeps sub-100 µs gaps accurate.
+class CLIENT_API PacketTrainsPacer
+{
+public:
+    // Monotonic time in nanoseconds (CLOCK_MONOTONIC where available)
+    static qint64 now();
+
+    // Blocks until now() >= deadline
+    static void waitUntil(qint64 deadline);
+
+    // Remaining time for which we busy-wait instead of sleeping
+    static const qint64 spinThreshold = 100000;
+};
+
+#endif // PACKETTRAINSPACER_H
@@ -40,7 +40,7 @@ void Ping::setStatus(Status status)
 bool Ping::prepare(NetworkManager *networkManager, const MeasurementDefinitionPtr &measurementDefinition)
 {
     Q_UNUSED(networkManager);
-    definition = measurementDefinition.dynamicCast<PingDefinition>();
+    definition = measurementDefinition.dynamicCast<const PingDefinition>();
     return true;
 }
 
@@ -14,6 +14,7 @@
 #include <Ws2ipdef.h>
 #include <WS2tcpip.h>
 #undef min
+#undef max
 #include<pcap.h>
 #include <cstring>
 #elif defined(Q_OS_LINUX) || defined(Q_OS_MAC)
@@ -125,6 +126,7 @@ public:
     bool start();
     bool stop();
     Result result() const;
+    bool reset();
     void waitForFinished();
     float averagePingTime() const;
 
@@ -152,6 +154,11 @@ private:
     pcap_t *m_capture;
     sockaddr_any m_destAddress;
 
+    // udp socket kept open between runs, see reset()
+    int m_warmSocket;
+    int m_warmFamily;
+    int m_warmTtl;
+
     // for system ping only
     QProcess process;
     QTextStream stream;
@@ -7,7 +7,7 @@
 
 class PingDefinition;
 
-typedef QSharedPointer<PingDefinition> PingDefinitionPtr;
+typedef QSharedPointer<const PingDefinition> PingDefinitionPtr;
 typedef QList<PingDefinitionPtr> PingDefinitionList;
 
 class PingDefinition : public MeasurementDefinition
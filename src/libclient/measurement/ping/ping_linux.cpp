@@ -21,6 +21,7 @@
 #include <QThread>
 
 #include "ping.h"
+#include "../streamingstats.h"
 #include "../../log/logger.h"
 #include "../../client.h"
 #include "../../trafficbudgetmanager.h"
@@ -81,6 +82,20 @@ namespace
 
         return payload;
     }
+
+    // Throw away replies and icmp errors left over from an earlier run
+    void drainSocket(int sock)
+    {
+        char buf[1500];
+
+        while (recv(sock, buf, sizeof(buf), MSG_ERRQUEUE | MSG_DONTWAIT) >= 0)
+        {
+        }
+
+        while (recv(sock, buf, sizeof(buf), MSG_DONTWAIT) >= 0)
+        {
+        }
+    }
 }
 
 Ping::Ping(QObject *parent)
@@ -91,6 +106,9 @@ Ping::Ping(QObject *parent)
 , m_device(NULL)
 , m_capture(NULL)
 , m_destAddress()
+, m_warmSocket(-1)
+, m_warmFamily(AF_UNSPEC)
+, m_warmTtl(0)
 , stream(&process)
 {
     connect(this, SIGNAL(error(const QString &)), this,
@@ -104,6 +122,11 @@ Ping::~Ping()
         process.kill();
         process.waitForFinished(500);
     }
+
+    if (m_warmSocket >= 0)
+    {
+        close(m_warmSocket);
+    }
 }
 
 Measurement::Status Ping::status() const
@@ -124,7 +147,7 @@ bool Ping::prepare(NetworkManager *networkManager, const MeasurementDefinitionPt
 {
     Q_UNUSED(networkManager);
 
-    definition = measurementDefinition.dynamicCast<PingDefinition>();
+    definition = measurementDefinition.dynamicCast<const PingDefinition>();
 
     if (definition.isNull())
     {
@@ -211,7 +234,25 @@ bool Ping::start()
         return true;
     }
 
-    probe.sock = initSocket();
+    int ttl = definition->ttl ? definition->ttl : 64;
+
+    if (m_warmSocket >= 0 && definition->type == ping::Udp &&
+        m_warmFamily == m_destAddress.sa.sa_family && m_warmTtl == ttl)
+    {
+        probe.sock = m_warmSocket;
+        drainSocket(probe.sock);
+    }
+    else
+    {
+        if (m_warmSocket >= 0)
+        {
+            close(m_warmSocket);
+        }
+
+        probe.sock = initSocket();
+    }
+
+    m_warmSocket = -1;
 
     if (probe.sock < 0)
     {
@@ -226,7 +267,18 @@ bool Ping::start()
         QThread::msleep(definition->interval);
     }
 
-    close(probe.sock);
+    // Only an unconnected udp socket on an ephemeral port is safe to keep, a
+    // fixed source port would block other measurements from binding it
+    if (definition->type == ping::Udp && definition->sourcePort == 0)
+    {
+        m_warmSocket = probe.sock;
+        m_warmFamily = m_destAddress.sa.sa_family;
+        m_warmTtl = ttl;
+    }
+    else
+    {
+        close(probe.sock);
+    }
 
     foreach (const PingProbe &probe, m_pingProbes)
     {
@@ -268,11 +320,9 @@ Result Ping::result() const
 {
     QVariantMap res;
     QVariantList roundTripMs;
-    float avg = 0.0;
-    QList<float> tmpPingTime = pingTime;
+    StreamingStats stats;
 
-    // calculate average and fill ping times
-    foreach (float val, tmpPingTime)
+    foreach (float val, pingTime)
     {
         roundTripMs << val;
 
@@ -282,32 +332,16 @@ Result Ping::result() const
             continue;
         }
 
-        avg += val;
-    }
-
-    // exclude timeouts from the stats
-    tmpPingTime.removeAll(0.0);
-
-    // get max and min
-    QList<float>::const_iterator it = std::max_element(tmpPingTime.begin(), tmpPingTime.end());
-    float max = *it;
-    it = std::min_element(tmpPingTime.begin(), tmpPingTime.end());
-    float min = *it;
-
-    qreal sq_sum = std::inner_product(tmpPingTime.begin(), tmpPingTime.end(), tmpPingTime.begin(), 0.0);
-    qreal stdev = 0.0;
-
-    if (tmpPingTime.size() > 0)
-    {
-        avg /= tmpPingTime.size();
-        // calculate standard deviation
-        stdev = qSqrt(sq_sum / tmpPingTime.size() - avg * avg);
+        stats.add(val);
     }
 
-    res.insert("round_trip_avg", avg);
-    res.insert("round_trip_min", min);
-    res.insert("round_trip_max", max);
-    res.insert("round_trip_stdev", stdev);
+    res.insert("round_trip_avg", stats.mean());
+    res.insert("round_trip_min", stats.min());
+    res.insert("round_trip_max", stats.max());
+    res.insert("round_trip_stdev", stats.stdev());
+    res.insert("round_trip_p50", stats.quantile(0.5));
+    res.insert("round_trip_p90", stats.quantile(0.9));
+    res.insert("round_trip_p99", stats.quantile(0.99));
     res.insert("round_trip_ms", roundTripMs);
     res.insert("round_trip_sent", m_pingsSent);  // count successfull pings only
     res.insert("round_trip_received", m_pingsReceived);
@@ -924,6 +958,29 @@ void Ping::readyRead()
     }
 }
 
+bool Ping::reset()
+{
+    Measurement::reset();
+
+    if (!definition.isNull() && definition->type == ping::System)
+    {
+        process.kill();
+        process.waitForFinished(500);
+        process.disconnect(this);
+    }
+
+    definition.clear();
+    currentStatus = Unknown;
+    m_pingProbes.clear();
+    pingTime.clear();
+    m_pingsSent = 0;
+    m_pingsReceived = 0;
+    memset(&m_destAddress, 0, sizeof(m_destAddress));
+
+    // m_warmSocket stays open for the next run
+    return true;
+}
+
 void Ping::waitForFinished()
 {
     process.waitForFinished(1000);
@@ -11,6 +11,7 @@
 #include <QThread>
 
 #include "ping.h"
+#include "../streamingstats.h"
 #include "../../log/logger.h"
 #include "../../client.h"
 #include "../../trafficbudgetmanager.h"
@@ -150,6 +151,9 @@ Ping::Ping(QObject *parent)
 , m_device(NULL)
 , m_capture(NULL)
 , m_destAddress()
+, m_warmSocket(-1)
+, m_warmFamily(0)
+, m_warmTtl(0)
 , stream(&process)
 {
     connect(this, SIGNAL(error(const QString &)), this,
@@ -183,7 +187,7 @@ bool Ping::prepare(NetworkManager *networkManager, const MeasurementDefinitionPt
 {
     Q_UNUSED(networkManager);
 
-    definition = measurementDefinition.dynamicCast<PingDefinition>();
+    definition = measurementDefinition.dynamicCast<const PingDefinition>();
 
     if (definition->type != ping::System)
     {
@@ -326,11 +330,9 @@ Result Ping::result() const
 {
     QVariantMap res;
     QVariantList roundTripMs;
-    float avg = 0.0;
-    QList<float> tmpPingTime = pingTime;
+    StreamingStats stats;
 
-    // calculate average and fill ping times
-    foreach (float val, tmpPingTime)
+    foreach (float val, pingTime)
     {
         roundTripMs << val;
 
@@ -340,32 +342,16 @@ Result Ping::result() const
             continue;
         }
 
-        avg += val;
+        stats.add(val);
     }
 
-    // exclude timeouts from the stats
-    tmpPingTime.removeAll(0.0);
-
-    // get max and min
-    QList<float>::const_iterator it = std::max_element(tmpPingTime.begin(), tmpPingTime.end());
-    float max = *it;
-    it = std::min_element(tmpPingTime.begin(), tmpPingTime.end());
-    float min = *it;
-
-    qreal sq_sum = std::inner_product(tmpPingTime.begin(), tmpPingTime.end(), tmpPingTime.begin(), 0.0);
-    qreal stdev = 0.0;
-
-    if (tmpPingTime.size() > 0)
-    {
-        avg /= tmpPingTime.size();
-        // calculate standard deviation
-        stdev = qSqrt(sq_sum / tmpPingTime.size() - avg * avg);
-    }
-
-    res.insert("round_trip_avg", avg);
-    res.insert("round_trip_min", min);
-    res.insert("round_trip_max", max);
-    res.insert("round_trip_stdev", stdev);
+    res.insert("round_trip_avg", stats.mean());
+    res.insert("round_trip_min", stats.min());
+    res.insert("round_trip_max", stats.max());
+    res.insert("round_trip_stdev", stats.stdev());
+    res.insert("round_trip_p50", stats.quantile(0.5));
+    res.insert("round_trip_p90", stats.quantile(0.9));
+    res.insert("round_trip_p99", stats.quantile(0.99));
     res.insert("round_trip_ms", roundTripMs);
     res.insert("round_trip_sent", m_pingsSent);  // count successfull pings only
     res.insert("round_trip_received", m_pingsReceived);
@@ -962,6 +948,28 @@ void Ping::readyRead()
     }
 }
 
+bool Ping::reset()
+{
+    Measurement::reset();
+
+    if (!definition.isNull() && definition->type == ping::System)
+    {
+        process.kill();
+        process.waitForFinished(500);
+        process.disconnect(this);
+    }
+
+    definition.clear();
+    currentStatus = Unknown;
+    m_pingProbes.clear();
+    pingTime.clear();
+    m_pingsSent = 0;
+    m_pingsReceived = 0;
+    memset(&m_destAddress, 0, sizeof(m_destAddress));
+
+    return true;
+}
+
 void Ping::waitForFinished()
 {
     process.waitForFinished(1000);
@@ -1,4 +1,5 @@
 #include "ping.h"
+#include "../streamingstats.h"
 #include "../../log/logger.h"
 #include "../../client.h"
 #include "../../trafficbudgetmanager.h"
@@ -496,6 +497,9 @@ Ping::Ping(QObject *parent)
 , m_device(NULL)
 , m_capture(NULL)
 , m_destAddress()
+, m_warmSocket(-1)
+, m_warmFamily(0)
+, m_warmTtl(0)
 , stream(&process)
 {
     connect(this, SIGNAL(error(const QString &)), this,
@@ -535,7 +539,7 @@ bool Ping::prepare(NetworkManager *networkManager, const MeasurementDefinitionPt
     char address[INET6_ADDRSTRLEN] = "";
     struct bpf_program fcode;
 
-    definition = measurementDefinition.dynamicCast<PingDefinition>();
+    definition = measurementDefinition.dynamicCast<const PingDefinition>();
 
     if (definition.isNull())
     {
@@ -729,11 +733,9 @@ Result Ping::result() const
 {
     QVariantMap res;
     QVariantList roundTripMs;
-    float avg = 0.0;
-    QList<float> tmpPingTime = pingTime;
+    StreamingStats stats;
 
-    // calculate average and fill ping times
-    foreach (float val, tmpPingTime)
+    foreach (float val, pingTime)
     {
         roundTripMs << val;
 
@@ -743,32 +745,16 @@ Result Ping::result() const
             continue;
         }
 
-        avg += val;
+        stats.add(val);
     }
 
-    // exclude timeouts from the stats
-    tmpPingTime.removeAll(0.0);
-
-    // get max and min
-    QList<float>::const_iterator it = std::max_element(tmpPingTime.begin(), tmpPingTime.end());
-    float max = *it;
-    it = std::min_element(tmpPingTime.begin(), tmpPingTime.end());
-    float min = *it;
-
-    qreal sq_sum = std::inner_product(tmpPingTime.begin(), tmpPingTime.end(), tmpPingTime.begin(), 0.0);
-    qreal stdev = 0.0;
-
-    if (tmpPingTime.size() > 0)
-    {
-        avg /= tmpPingTime.size();
-        // calculate standard deviation
-        stdev = qSqrt(sq_sum / tmpPingTime.size() - avg * avg);
-    }
-
-    res.insert("round_trip_avg", avg);
-    res.insert("round_trip_min", min);
-    res.insert("round_trip_max", max);
-    res.insert("round_trip_stdev", stdev);
+    res.insert("round_trip_avg", stats.mean());
+    res.insert("round_trip_min", stats.min());
+    res.insert("round_trip_max", stats.max());
+    res.insert("round_trip_stdev", stats.stdev());
+    res.insert("round_trip_p50", stats.quantile(0.5));
+    res.insert("round_trip_p90", stats.quantile(0.9));
+    res.insert("round_trip_p99", stats.quantile(0.99));
     res.insert("round_trip_ms", roundTripMs);
     res.insert("round_trip_sent", m_pingsSent);  // count successfull pings only
     res.insert("round_trip_received", m_pingsReceived);
@@ -1319,6 +1305,14 @@ void Ping::readyRead()
     }
 }
 
+bool Ping::reset()
+{
+    Measurement::reset();
+
+    // the pcap capture is bound to the previous destination
+    return false;
+}
+
 void Ping::waitForFinished()
 {
     process.waitForFinished(1000);
@@ -0,0 +1,742 @@
+#include "pingmesh.h"
+#include "../../log/logger.h"
+#include "../../client.h"
+#include "../../trafficbudgetmanager.h"
+#include "../../timing/clock.h"
+
+#include <QHostInfo>
+#include <QSocketNotifier>
+
+#include <limits>
+
+#if defined(Q_OS_LINUX)
+#define HAVE_ERRQUEUE
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/errqueue.h>
+#include <netinet/in.h>
+#if defined(Q_OS_ANDROID)
+#include <netinet/in6.h>
+#endif
+#include <sys/socket.h>
+#include <sys/time.h>
+#endif
+
+LOGGER(PingMesh);
+
+namespace
+{
+    // Target index and sequence number at the start of every payload
+    const int headerSize = 2 * sizeof(quint32);
+
+#ifdef HAVE_ERRQUEUE
+    union sockaddr_any
+    {
+        struct sockaddr sa;
+        struct sockaddr_in sin;
+        struct sockaddr_in6 sin6;
+    };
+
+    qint64 currentTime()
+    {
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+        return qint64(tv.tv_sec) * 1000000 + tv.tv_usec;
+    }
+
+    QByteArray toSockAddr(const QHostAddress &address, quint16 port)
+    {
+        sockaddr_any addr;
+        memset(&addr, 0, sizeof(addr));
+
+        if (address.protocol() == QAbstractSocket::IPv4Protocol)
+        {
+            addr.sin.sin_family = AF_INET;
+            addr.sin.sin_port = htons(port);
+            addr.sin.sin_addr.s_addr = htonl(address.toIPv4Address());
+            return QByteArray((const char *)&addr.sin, sizeof(addr.sin));
+        }
+
+        Q_IPV6ADDR ip6 = address.toIPv6Address();
+        addr.sin6.sin6_family = AF_INET6;
+        addr.sin6.sin6_port = htons(port);
+        memcpy(&addr.sin6.sin6_addr, &ip6, sizeof(ip6));
+        return QByteArray((const char *)&addr.sin6, sizeof(addr.sin6));
+    }
+
+    QHostAddress fromSockAddr(const struct sockaddr *addr)
+    {
+        QHostAddress address;
+        address.setAddress(addr);
+        return address;
+    }
+#endif
+}
+
+PingMesh::Target::Target()
+: sent(0)
+{
+}
+
+PingMesh::PingMesh(QObject *parent)
+: Measurement(parent)
+, currentStatus(Unknown)
+, sock4(-1)
+, sock6(-1)
+, notifier4(NULL)
+, notifier6(NULL)
+, startTime(0)
+, nextProbe(0)
+, totalProbes(0)
+{
+    sendTimer.setTimerType(Qt::PreciseTimer);
+    drainTimer.setSingleShot(true);
+
+    connect(&sendTimer, SIGNAL(timeout()), this, SLOT(sendDue()));
+    connect(&drainTimer, SIGNAL(timeout()), this, SLOT(finish()));
+}
+
+PingMesh::~PingMesh()
+{
+    closeSockets();
+}
+
+Measurement::Status PingMesh::status() const
+{
+    return currentStatus;
+}
+
+void PingMesh::setStatus(Status status)
+{
+    if (currentStatus != status)
+    {
+        currentStatus = status;
+        emit statusChanged(status);
+    }
+}
+
+bool PingMesh::prepare(NetworkManager *networkManager, const MeasurementDefinitionPtr &measurementDefinition)
+{
+    Q_UNUSED(networkManager);
+
+    if (!prepareTargets(measurementDefinition))
+    {
+        return false;
+    }
+
+    // Without prepareAsync() nobody resolves the hostnames
+    foreach (const Target &target, targets)
+    {
+        if (target.address.isNull())
+        {
+            setErrorString(QString("hostname '%1' is not resolved").arg(target.host));
+            return false;
+        }
+    }
+
+    return finishPrepare();
+}
+
+bool PingMesh::prepareTargets(const MeasurementDefinitionPtr &measurementDefinition)
+{
+    definition = measurementDefinition.dynamicCast<const PingMeshDefinition>();
+
+    if (definition.isNull())
+    {
+        setErrorString("Definition is empty");
+        return false;
+    }
+
+#ifndef HAVE_ERRQUEUE
+    setErrorString("pingmesh is not supported on this platform");
+    return false;
+#else
+    if (definition->targets.isEmpty())
+    {
+        setErrorString("no targets");
+        return false;
+    }
+
+    if (definition->payload < headerSize || definition->payload > 1400)
+    {
+        setErrorString(QString("payload must be between %1 and 1400 bytes").arg(headerSize));
+        return false;
+    }
+
+    if (definition->count == 0 || definition->interval == 0)
+    {
+        setErrorString("count and interval must not be zero");
+        return false;
+    }
+
+    if (definition->receiveTimeout > 60000)
+    {
+        setErrorString("receive timeout is too large (> 60 s)");
+        return false;
+    }
+
+    abortLookups();
+    payload.clear();
+    targets.clear();
+    targets.reserve(definition->targets.size());
+
+    foreach (const QString &host, definition->targets)
+    {
+        Target target;
+        target.host = host;
+
+        QHostAddress address;
+
+        if (address.setAddress(host))
+        {
+            setAddress(&target, address);
+        }
+
+        targets.append(target);
+    }
+
+    return true;
+#endif
+}
+
+bool PingMesh::prepareAsync(NetworkManager *networkManager, const MeasurementDefinitionPtr &measurementDefinition)
+{
+    Q_UNUSED(networkManager);
+
+    if (!prepareTargets(measurementDefinition))
+    {
+        return false;
+    }
+
+    // All lookups run in parallel, the last one to finish completes the preparation
+    for (int i = 0; i < targets.size(); ++i)
+    {
+        if (targets.at(i).address.isNull())
+        {
+            lookups.insert(QHostInfo::lookupHost(targets.at(i).host, this, SLOT(lookedUp(QHostInfo))), i);
+        }
+    }
+
+    if (lookups.isEmpty())
+    {
+        if (!finishPrepare())
+        {
+            return false;
+        }
+
+        emit prepared();
+    }
+
+    return true;
+}
+
+void PingMesh::lookedUp(const QHostInfo &hostInfo)
+{
+    if (!lookups.contains(hostInfo.lookupId()))
+    {
+        return;
+    }
+
+    Target &target = targets[lookups.take(hostInfo.lookupId())];
+
+    foreach (const QHostAddress &address, hostInfo.addresses())
+    {
+        if (address.protocol() == QAbstractSocket::IPv4Protocol ||
+            address.protocol() == QAbstractSocket::IPv6Protocol)
+        {
+            setAddress(&target, address);
+            break;
+        }
+    }
+
+    if (target.address.isNull())
+    {
+        LOG_WARNING(QString("could not resolve hostname '%1': %2").arg(target.host).arg(hostInfo.errorString()));
+    }
+
+    if (!lookups.isEmpty())
+    {
+        return;
+    }
+
+    if (finishPrepare())
+    {
+        emit prepared();
+    }
+    else
+    {
+        emit error(errorString());
+    }
+}
+
+void PingMesh::setAddress(Target *target, const QHostAddress &address)
+{
+#ifdef HAVE_ERRQUEUE
+    target->address = address;
+    target->sockAddr = toSockAddr(address, definition->destinationPort ? definition->destinationPort : 33434);
+    target->sendTimes.fill(0, definition->count);
+#else
+    Q_UNUSED(target);
+    Q_UNUSED(address);
+#endif
+}
+
+void PingMesh::abortLookups()
+{
+    foreach (int id, lookups.keys())
+    {
+        QHostInfo::abortHostLookup(id);
+    }
+
+    lookups.clear();
+}
+
+bool PingMesh::finishPrepare()
+{
+    bool resolved = false;
+
+    foreach (const Target &target, targets)
+    {
+        resolved |= !target.address.isNull();
+    }
+
+    if (!resolved)
+    {
+        setErrorString("could not resolve any target");
+        return false;
+    }
+
+    if (!Client::instance()->trafficBudgetManager()->addUsedTraffic(estimateTraffic()))
+    {
+        setErrorString("not enough traffic available");
+        return false;
+    }
+
+    // The payload is built once, every probe only rewrites its header
+    payload.fill('x', definition->payload);
+
+    if (definition->payload > headerSize + 15)
+    {
+        payload.replace(definition->payload - 15, 15, " measure-it.net");
+    }
+
+    return true;
+}
+
+bool PingMesh::start()
+{
+    // Only a finished preparation builds the payload
+    if (payload.isEmpty())
+    {
+        setErrorString("not prepared");
+        return false;
+    }
+
+    setStatus(PingMesh::Running);
+
+    bool haveV4 = false;
+    bool haveV6 = false;
+
+    foreach (const Target &target, targets)
+    {
+        haveV4 |= target.address.protocol() == QAbstractSocket::IPv4Protocol;
+        haveV6 |= target.address.protocol() == QAbstractSocket::IPv6Protocol;
+    }
+
+#ifdef HAVE_ERRQUEUE
+    if (haveV4 && (sock4 = openSocket(AF_INET)) >= 0)
+    {
+        notifier4 = new QSocketNotifier(sock4, QSocketNotifier::Read, this);
+        connect(notifier4, SIGNAL(activated(int)), this, SLOT(readSocket(int)));
+    }
+
+    if (haveV6 && (sock6 = openSocket(AF_INET6)) >= 0)
+    {
+        notifier6 = new QSocketNotifier(sock6, QSocketNotifier::Read, this);
+        connect(notifier6, SIGNAL(activated(int)), this, SLOT(readSocket(int)));
+    }
+#endif
+
+    if (sock4 < 0 && sock6 < 0)
+    {
+        setErrorString("could not open a socket");
+        setStatus(PingMesh::Error);
+        return false;
+    }
+
+    startTime = Clock::monotonic();
+    nextProbe = 0;
+    totalProbes = quint64(targets.size()) * definition->count;
+
+    // Wake up for every probe unless that is more often than once per ms,
+    // then sendDue() catches up in batches
+    sendTimer.start(qMax(1, int(definition->interval / targets.size())));
+    sendDue();
+
+    return true;
+}
+
+bool PingMesh::stop()
+{
+    abortLookups();
+    sendTimer.stop();
+    drainTimer.stop();
+    closeSockets();
+
+    return true;
+}
+
+Result PingMesh::result() const
+{
+    QVariantMap res;
+    QVariantList list;
+    quint64 sent = 0;
+    quint64 received = 0;
+
+    foreach (const Target &target, targets)
+    {
+        QVariantMap map;
+        map.insert("host", target.host);
+
+        if (target.address.isNull())
+        {
+            map.insert("error", "could not resolve hostname");
+            list << map;
+            continue;
+        }
+
+        quint32 targetReceived = target.rtt.count();
+
+        map.insert("address", target.address.toString());
+        map.insert("round_trip_min", target.rtt.min());
+        map.insert("round_trip_avg", target.rtt.mean());
+        map.insert("round_trip_max", target.rtt.max());
+        map.insert("round_trip_stdev", target.rtt.stdev());
+        map.insert("round_trip_p50", target.rtt.quantile(0.5));
+        map.insert("round_trip_p90", target.rtt.quantile(0.9));
+        map.insert("round_trip_p99", target.rtt.quantile(0.99));
+        map.insert("round_trip_sent", target.sent);
+        map.insert("round_trip_received", targetReceived);
+        map.insert("round_trip_loss", target.sent ? (target.sent - targetReceived) / float(target.sent) : 0);
+        list << map;
+
+        sent += target.sent;
+        received += targetReceived;
+    }
+
+    res.insert("targets", list);
+    res.insert("probes_sent", sent);
+    res.insert("probes_received", received);
+
+    return Result(res);
+}
+
+bool PingMesh::reset()
+{
+    Measurement::reset();
+
+    abortLookups();
+    sendTimer.stop();
+    drainTimer.stop();
+    closeSockets();
+
+    definition.clear();
+    currentStatus = Unknown;
+    targets.clear();
+    payload.clear();
+    startTime = 0;
+    nextProbe = 0;
+    totalProbes = 0;
+
+    return true;
+}
+
+quint32 PingMesh::estimateTraffic() const
+{
+    // Same estimation per probe as the udp ping: ethernet, ip and udp
+    // headers both ways plus the icmp error
+    quint64 est = 0;
+
+    foreach (const Target &target, targets)
+    {
+        if (target.address.protocol() == QAbstractSocket::IPv4Protocol)
+        {
+            est += 2 * 14 + 2 * 20 + 2 * (8 + definition->payload) + 36;
+        }
+        else if (target.address.protocol() == QAbstractSocket::IPv6Protocol)
+        {
+            est += 2 * 14 + 2 * 40 + 2 * (8 + definition->payload) + 56;
+        }
+    }
+
+    est *= definition->count;
+
+    return quint32(qMin(est, quint64(std::numeric_limits<quint32>::max())));
+}
+
+int PingMesh::openSocket(int family)
+{
+#ifdef HAVE_ERRQUEUE
+    int ttl = definition->ttl ? definition->ttl : 64;
+    int n = 1;
+    int sock = socket(family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_UDP);
+
+    if (sock < 0)
+    {
+        LOG_ERROR(QString("socket: %1").arg(QString::fromLocal8Bit(strerror(errno))));
+        return -1;
+    }
+
+    if (family == AF_INET)
+    {
+        if (setsockopt(sock, SOL_IP, IP_RECVERR, &n, sizeof(n)) < 0 ||
+            setsockopt(sock, SOL_IP, IP_TTL, &ttl, sizeof(ttl)) < 0)
+        {
+            LOG_ERROR(QString("setsockopt: %1").arg(QString::fromLocal8Bit(strerror(errno))));
+            goto cleanup;
+        }
+    }
+    else
+    {
+        if (setsockopt(sock, IPPROTO_IPV6, IPV6_RECVERR, &n, sizeof(n)) < 0 ||
+            setsockopt(sock, IPPROTO_IPV6, IPV6_UNICAST_HOPS, &ttl, sizeof(ttl)) < 0)
+        {
+            LOG_ERROR(QString("setsockopt: %1").arg(QString::fromLocal8Bit(strerror(errno))));
+            goto cleanup;
+        }
+    }
+
+    // Kernel receive time stamps keep the event loop latency out of the rtt
+    if (setsockopt(sock, SOL_SOCKET, SO_TIMESTAMP, &n, sizeof(n)) < 0)
+    {
+        LOG_ERROR(QString("setsockopt SO_TIMESTAMP: %1").arg(QString::fromLocal8Bit(strerror(errno))));
+        goto cleanup;
+    }
+
+    return sock;
+
+cleanup:
+    close(sock);
+#else
+    Q_UNUSED(family);
+#endif
+    return -1;
+}
+
+void PingMesh::closeSockets()
+{
+    delete notifier4;
+    notifier4 = NULL;
+    delete notifier6;
+    notifier6 = NULL;
+
+#ifdef HAVE_ERRQUEUE
+    if (sock4 >= 0)
+    {
+        close(sock4);
+    }
+
+    if (sock6 >= 0)
+    {
+        close(sock6);
+    }
+#endif
+
+    sock4 = -1;
+    sock6 = -1;
+}
+
+void PingMesh::sendDue()
+{
+    // Probe k goes to target k % n at k * interval / n, so all targets are
+    // interleaved and each one sees the configured interval
+    qint64 elapsed = (Clock::monotonic() - startTime) / 1000000;
+    quint64 due = qMin(totalProbes, quint64(elapsed) * targets.size() / definition->interval + 1);
+
+    while (nextProbe < due)
+    {
+        sendProbe(nextProbe % targets.size(), nextProbe / targets.size());
+        ++nextProbe;
+    }
+
+    if (nextProbe == totalProbes && sendTimer.isActive())
+    {
+        sendTimer.stop();
+        drainTimer.start(definition->receiveTimeout);
+    }
+}
+
+void PingMesh::sendProbe(int index, quint32 sequence)
+{
+#ifdef HAVE_ERRQUEUE
+    Target &target = targets[index];
+
+    if (target.address.isNull())
+    {
+        return;
+    }
+
+    int sock = target.address.protocol() == QAbstractSocket::IPv4Protocol ? sock4 : sock6;
+
+    if (sock < 0)
+    {
+        return;
+    }
+
+    quint32 header[2] = { quint32(index), sequence };
+    memcpy(payload.data(), header, sizeof(header));
+
+    qint64 sendTime = currentTime();
+
+    if (sendto(sock, payload.constData(), payload.size(), 0, (const struct sockaddr *)target.sockAddr.constData(),
+               target.sockAddr.size()) < 0)
+    {
+        LOG_DEBUG(QString("send to %1: %2").arg(target.host).arg(QString::fromLocal8Bit(strerror(errno))));
+        return;
+    }
+
+    target.sendTimes[sequence] = sendTime;
+    target.sent++;
+#else
+    Q_UNUSED(index);
+    Q_UNUSED(sequence);
+#endif
+}
+
+void PingMesh::readSocket(int sock)
+{
+    receive(sock);
+}
+
+void PingMesh::receive(int sock)
+{
+#ifdef HAVE_ERRQUEUE
+    char buf[1500];
+    char control[256];
+    sockaddr_any from;
+    struct iovec iov;
+    struct msghdr msg;
+
+    // Icmp errors first, then udp answers from targets which echo
+    int flags = MSG_ERRQUEUE | MSG_DONTWAIT;
+
+    forever
+    {
+        memset(&msg, 0, sizeof(msg));
+        iov.iov_base = buf;
+        iov.iov_len = sizeof(buf);
+        msg.msg_name = &from;
+        msg.msg_namelen = sizeof(from);
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        ssize_t size = recvmsg(sock, &msg, flags);
+
+        if (size < 0)
+        {
+            if (flags & MSG_ERRQUEUE)
+            {
+                flags = MSG_DONTWAIT;
+                continue;
+            }
+
+            break;
+        }
+
+        if (size < headerSize)
+        {
+            continue;
+        }
+
+        qint64 receiveTime = 0;
+        QHostAddress source = fromSockAddr(&from.sa);
+        bool reply = !(flags & MSG_ERRQUEUE);
+
+        for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm))
+        {
+            if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SO_TIMESTAMP)
+            {
+                struct timeval *tv = (struct timeval *)CMSG_DATA(cm);
+                receiveTime = qint64(tv->tv_sec) * 1000000 + tv->tv_usec;
+            }
+            else if ((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+                     (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR))
+            {
+                struct sock_extended_err *ee = (struct sock_extended_err *)CMSG_DATA(cm);
+
+                // Only the port unreachable of the target itself is an answer,
+                // the sender of the icmp error is the offender
+                if (ee->ee_origin == SO_EE_ORIGIN_ICMP || ee->ee_origin == SO_EE_ORIGIN_ICMP6)
+                {
+                    source = fromSockAddr(SO_EE_OFFENDER(ee));
+                    reply = true;
+                }
+            }
+        }
+
+        if (!reply)
+        {
+            continue;
+        }
+
+        if (!receiveTime)
+        {
+            receiveTime = currentTime();
+        }
+
+        quint32 header[2];
+        memcpy(header, buf, sizeof(header));
+        handleReply(header[0], header[1], receiveTime, source);
+    }
+#else
+    Q_UNUSED(sock);
+#endif
+}
+
+void PingMesh::handleReply(quint32 index, quint32 sequence, qint64 receiveTime, const QHostAddress &from)
+{
+    if (index >= quint32(targets.size()))
+    {
+        return;
+    }
+
+    Target &target = targets[index];
+
+    if (sequence >= quint32(target.sendTimes.size()) || !target.sendTimes.at(sequence) || from != target.address)
+    {
+        return;
+    }
+
+    float rtt = (receiveTime - target.sendTimes.at(sequence)) / 1000.;
+
+    // Answered, duplicates are ignored from now on
+    target.sendTimes[sequence] = 0;
+
+    if (rtt < 0 || rtt >= definition->receiveTimeout)
+    {
+        return;
+    }
+
+    target.rtt.add(rtt);
+}
+
+void PingMesh::finish()
+{
+    if (sock4 >= 0)
+    {
+        receive(sock4);
+    }
+
+    if (sock6 >= 0)
+    {
+        receive(sock6);
+    }
+
+    closeSockets();
+
+    setStatus(PingMesh::Finished);
+    emit Measurement::finished();
+}
@@ -0,0 +1,96 @@
+#ifndef PINGMESH_H
+#define PINGMESH_H
+
+#include "../measurement.h"
+#include "pingmesh_definition.h"
+#include "../streamingstats.h"
+
+#include <QHostAddress>
+#include <QTimer>
+#include <QVector>
+#include <QHash>
+
+class QSocketNotifier;
+class QHostInfo;
+
+// Udp ping to many targets at once. The probes of all targets are spread
+// evenly over the interval and sent from one socket per address family,
+// icmp errors are matched back to the target and sequence in the payload.
+// Hostnames are resolved in parallel by prepareAsync(), targets which can
+// not be resolved are reported in the result and skipped. prepare() alone
+// only accepts addresses.
+class PingMesh : public Measurement
+{
+    Q_OBJECT
+
+public:
+    explicit PingMesh(QObject *parent = 0);
+    ~PingMesh();
+
+    // Measurement interface
+    Status status() const;
+    bool prepare(NetworkManager *networkManager, const MeasurementDefinitionPtr &measurementDefinition);
+    bool prepareAsync(NetworkManager *networkManager, const MeasurementDefinitionPtr &measurementDefinition);
+    bool start();
+    bool stop();
+    Result result() const;
+    bool reset();
+
+private:
+    struct Target
+    {
+        Target();
+
+        QString host;
+        QHostAddress address;
+        QByteArray sockAddr;
+
+        // Send time in us per sequence, 0 if unsent or already answered
+        QVector<qint64> sendTimes;
+
+        quint32 sent;
+        StreamingStats rtt;
+    };
+
+    quint32 estimateTraffic() const;
+    void setStatus(Status status);
+    bool prepareTargets(const MeasurementDefinitionPtr &measurementDefinition);
+    void setAddress(Target *target, const QHostAddress &address);
+    bool finishPrepare();
+    void abortLookups();
+    int openSocket(int family);
+    void closeSockets();
+    void sendProbe(int index, quint32 sequence);
+    void receive(int sock);
+    void handleReply(quint32 index, quint32 sequence, qint64 receiveTime, const QHostAddress &from);
+
+    PingMeshDefinitionPtr definition;
+    Status currentStatus;
+    QVector<Target> targets;
+
+    // Target index per pending host lookup id
+    QHash<int, int> lookups;
+
+    int sock4;
+    int sock6;
+    QSocketNotifier *notifier4;
+    QSocketNotifier *notifier6;
+
+    QTimer sendTimer;
+    QTimer drainTimer;
+    qint64 startTime;
+    quint64 nextProbe;
+    quint64 totalProbes;
+    QByteArray payload;
+
+signals:
+    void statusChanged(Status status);
+
+private slots:
+    void lookedUp(const QHostInfo &hostInfo);
+    void sendDue();
+    void readSocket(int sock);
+    void finish();
+};
+
+#endif // PINGMESH_H
@@ -0,0 +1,54 @@
+#include "pingmesh_definition.h"
+
+PingMeshDefinition::PingMeshDefinition(const QStringList &targets, const quint32 &count, const quint32 &interval,
+                                       const quint32 &receiveTimeout, const int &ttl,
+                                       const quint16 &destinationPort, const quint32 &payload)
+: targets(targets)
+, count(count)
+, interval(interval)
+, receiveTimeout(receiveTimeout)
+, ttl(ttl)
+, destinationPort(destinationPort)
+, payload(payload)
+{
+}
+
+PingMeshDefinition::~PingMeshDefinition()
+{
+}
+
+PingMeshDefinitionPtr PingMeshDefinition::fromVariant(const QVariant &variant)
+{
+    QVariantMap map = variant.toMap();
+
+    QStringList targets;
+
+    foreach (const QString &target, map.value("targets").toStringList())
+    {
+        if (!target.isEmpty() && !targets.contains(target))
+        {
+            targets.append(target);
+        }
+    }
+
+    return PingMeshDefinitionPtr(new PingMeshDefinition(targets,
+                                                        map.value("count", 3).toUInt(),
+                                                        map.value("interval", 1000).toUInt(),
+                                                        map.value("timeout", 1000).toUInt(),
+                                                        map.value("ttl", 64).toInt(),
+                                                        map.value("destination_port", 33434).toUInt(),
+                                                        map.value("payload", 74).toUInt()));
+}
+
+QVariant PingMeshDefinition::toVariant() const
+{
+    QVariantMap map;
+    map.insert("targets", targets);
+    map.insert("count", count);
+    map.insert("interval", interval);
+    map.insert("timeout", receiveTimeout);
+    map.insert("ttl", ttl);
+    map.insert("destination_port", destinationPort);
+    map.insert("payload", payload);
+    return map;
+}
@@ -0,0 +1,37 @@
+#ifndef PINGMESH_DEFINITION_H
+#define PINGMESH_DEFINITION_H
+
+#include "../measurementdefinition.h"
+
+#include <QStringList>
+
+class PingMeshDefinition;
+
+typedef QSharedPointer<const PingMeshDefinition> PingMeshDefinitionPtr;
+typedef QList<PingMeshDefinitionPtr> PingMeshDefinitionList;
+
+class PingMeshDefinition : public MeasurementDefinition
+{
+public:
+    PingMeshDefinition(const QStringList &targets, const quint32 &count, const quint32 &interval,
+                       const quint32 &receiveTimeout, const int &ttl, const quint16 &destinationPort,
+                       const quint32 &payload);
+    ~PingMeshDefinition();
+
+    // Storage
+    static PingMeshDefinitionPtr fromVariant(const QVariant &variant);
+
+    // Getters
+    QStringList targets;
+    quint32 count;    // probes per target
+    quint32 interval; // ms between two probes to the same target
+    quint32 receiveTimeout;
+    int ttl;
+    quint16 destinationPort;
+    quint32 payload;
+
+    // Serializable interface
+    QVariant toVariant() const;
+};
+
+#endif // PINGMESH_DEFINITION_H
@@ -0,0 +1,21 @@
+#include "pingmesh_plugin.h"
+#include "pingmesh.h"
+#include "pingmesh_definition.h"
+
+QStringList PingMeshPlugin::measurements() const
+{
+    return QStringList()
+           << "pingmesh";
+}
+
+MeasurementPtr PingMeshPlugin::createMeasurement(const QString &name)
+{
+    Q_UNUSED(name);
+    return MeasurementPtr(new PingMesh);
+}
+
+MeasurementDefinitionPtr PingMeshPlugin::createMeasurementDefinition(const QString &name, const QVariant &data)
+{
+    Q_UNUSED(name);
+    return PingMeshDefinition::fromVariant(data);
+}
@@ -0,0 +1,18 @@
+#ifndef PINGMESH_PLUGIN_H
+#define PINGMESH_PLUGIN_H
+
+#include "../measurement.h"
+#include "../measurementdefinition.h"
+#include "../measurementplugin.h"
+
+class PingMeshPlugin : public MeasurementPlugin
+{
+public:
+    // MeasurementPlugin interface
+    QStringList measurements() const;
+
+    MeasurementPtr createMeasurement(const QString &name);
+    MeasurementDefinitionPtr createMeasurementDefinition(const QString &name, const QVariant &data);
+};
+
+#endif // PINGMESH_PLUGIN_H
@@ -4,15 +4,13 @@
 #include "../../client.h"
 #include "../../trafficbudgetmanager.h"
 
-#include <QHostInfo>
-
 LOGGER(ReverseDnslookup);
 
 ReverseDnslookup::ReverseDnslookup(QObject *parent)
 : Measurement(parent)
 , m_currentStatus(ReverseDnslookup::Unknown)
-, m_lookupId(0)
 {
+    connect(&m_resolver, SIGNAL(finished()), this, SLOT(handleServers()));
 }
 
 ReverseDnslookup::~ReverseDnslookup()
@@ -22,7 +20,7 @@ ReverseDnslookup::~ReverseDnslookup()
 bool ReverseDnslookup::prepare(NetworkManager *networkManager, const MeasurementDefinitionPtr &measurementDefinition)
 {
     Q_UNUSED(networkManager);
-    m_definition = measurementDefinition.dynamicCast<ReverseDnslookupDefinition>();
+    m_definition = measurementDefinition.dynamicCast<const ReverseDnslookupDefinition>();
 
     if (m_definition.isNull())
     {
@@ -31,12 +29,32 @@ bool ReverseDnslookup::prepare(NetworkManager *networkManager, const Measurement
     }
 
     m_currentStatus = ReverseDnslookup::Unknown;
+    m_reverseDnslookupAddresses.clear();
+
+    foreach (const QString &ip, m_definition->ips)
+    {
+        QHostAddress address(ip);
+
+        if (address.isNull())
+        {
+            setErrorString(QString("Invalid address: %1").arg(ip));
+            return false;
+        }
+
+        m_reverseDnslookupAddresses.append(address);
+    }
+
+    if (m_reverseDnslookupAddresses.isEmpty())
+    {
+        setErrorString("No address to look up");
+        return false;
+    }
 
     /*
      * worst case: 512 bytes
      * best case: 80 bytes
      */
-    if (!Client::instance()->trafficBudgetManager()->addUsedTraffic(592))
+    if (!Client::instance()->trafficBudgetManager()->addUsedTraffic(592 * m_reverseDnslookupAddresses.size()))
     {
         setErrorString("not enough traffic available");
         return false;
@@ -47,21 +65,21 @@ bool ReverseDnslookup::prepare(NetworkManager *networkManager, const Measurement
 
 bool ReverseDnslookup::start()
 {
-    m_lookupId = QHostInfo::lookupHost(m_definition->ip, this, SLOT(handleServers(QHostInfo)));
+    setStatus(ReverseDnslookup::Running);
+
+    // All addresses are resolved in parallel, cached names answer at once
+    m_resolver.lookup(m_reverseDnslookupAddresses);
     return true;
 }
 
-void ReverseDnslookup::handleServers(QHostInfo info)
+void ReverseDnslookup::handleServers()
 {
     // Check the lookup succeeded.
-    if (info.error() != QHostInfo::NoError)
+    if (m_resolver.hostName(m_reverseDnslookupAddresses.first()).isEmpty())
     {
-        emit error(QString("IP lookup failed: %1").arg(info.errorString()));
+        emit error(QString("IP lookup failed: no name for %1").arg(m_reverseDnslookupAddresses.first().toString()));
     }
 
-    m_reverseDnslookupOutput = info.hostName();
-    m_reverseDnslookupAddresses = info.addresses();
-
     setStatus(ReverseDnslookup::Finished);
     emit finished();
 }
@@ -83,7 +101,7 @@ void ReverseDnslookup::setStatus(Status status)
 
 bool ReverseDnslookup::stop()
 {
-    QHostInfo::abortHostLookup(m_lookupId);
+    m_resolver.disconnect(this);
     return true;
 }
 
@@ -91,16 +109,26 @@ Result ReverseDnslookup::result() const
 {
     QVariantMap res;
 
-    res.insert("hostname", m_reverseDnslookupOutput);
-    res.insert("address", listToVariant(m_reverseDnslookupAddresses));
+    QVariantList hostnames;
+
+    foreach (const QHostAddress &address, m_reverseDnslookupAddresses)
+    {
+        QVariantMap map;
+        map.insert("address", address.toString());
+        map.insert("hostname", m_resolver.hostName(address));
+        hostnames << map;
+    }
+
+    res.insert("hostname", m_resolver.hostName(m_reverseDnslookupAddresses.value(0)));
+    res.insert("address", listToVariant(m_reverseDnslookupAddresses.mid(0, 1)));
+    res.insert("hostnames", hostnames);
+    res.insert("cache_hits", m_resolver.cacheHits());
 
     return Result(res);
 }
 
 void ReverseDnslookup::started()
 {
-    m_reverseDnslookupOutput.clear();
-
     setStatus(ReverseDnslookup::Running);
 }
 
@@ -3,8 +3,7 @@
 
 #include "../measurement.h"
 #include "reverseDnslookup_definition.h"
-
-#include <QHostInfo>
+#include "../../network/reverseresolver.h"
 
 class ReverseDnslookup : public Measurement
 {
@@ -25,15 +24,14 @@ private:
     void setStatus(Status status);
 
     Status m_currentStatus;
-    int m_lookupId;
     ReverseDnslookupDefinitionPtr m_definition;
-    QString m_reverseDnslookupOutput;
+    ReverseResolver m_resolver;
     QList<QHostAddress> m_reverseDnslookupAddresses;
 
 private slots:
     void started();
     void finished();
-    void handleServers(QHostInfo info);
+    void handleServers();
 
 signals:
     void statusChanged(Status status);
@@ -3,6 +3,10 @@
 ReverseDnslookupDefinition::ReverseDnslookupDefinition(const QString &ip)
 : ip(ip)
 {
+    if (!ip.isEmpty())
+    {
+        ips.append(ip);
+    }
 }
 
 ReverseDnslookupDefinition::~ReverseDnslookupDefinition()
@@ -13,11 +17,23 @@ QVariant ReverseDnslookupDefinition::toVariant() const
 {
     QVariantMap map;
     map.insert("ip", ip);
+    map.insert("ips", ips);
     return map;
 }
 
 ReverseDnslookupDefinitionPtr ReverseDnslookupDefinition::fromVariant(const QVariant &variant)
 {
     QVariantMap map = variant.toMap();
-    return ReverseDnslookupDefinitionPtr(new ReverseDnslookupDefinition(map.value("ip").toString()));
+
+    ReverseDnslookupDefinition *definition = new ReverseDnslookupDefinition(map.value("ip").toString());
+
+    foreach (const QString &ip, map.value("ips").toStringList())
+    {
+        if (!definition->ips.contains(ip))
+        {
+            definition->ips.append(ip);
+        }
+    }
+
+    return ReverseDnslookupDefinitionPtr(definition);
 }
@@ -3,9 +3,11 @@
 
 #include "../measurementdefinition.h"
 
+#include <QStringList>
+
 class ReverseDnslookupDefinition;
 
-typedef QSharedPointer<ReverseDnslookupDefinition> ReverseDnslookupDefinitionPtr;
+typedef QSharedPointer<const ReverseDnslookupDefinition> ReverseDnslookupDefinitionPtr;
 typedef QList<ReverseDnslookupDefinitionPtr> ReverseDnslookupDefinitionList;
 
 class ReverseDnslookupDefinition : public MeasurementDefinition
@@ -20,6 +22,9 @@ public:
     // Getters
     QString ip;
 
+    // All addresses to resolve, including ip
+    QStringList ips;
+
     // Serializable interface
     QVariant toVariant() const;
 };
@@ -0,0 +1,257 @@
+#include "streamingstats.h"
+
+#include <QtMath>
+
+namespace
+{
+    // At 1% accuracy this spans more than eight decades
+    const int maxBins = 1024;
+    const double minIndexable = 1e-9;
+}
+
+StreamingStats::StreamingStats(double relativeAccuracy)
+: m_gamma((1 + relativeAccuracy) / (1 - relativeAccuracy))
+, m_logGamma(qLn(m_gamma))
+, m_count(0)
+, m_mean(0)
+, m_m2(0)
+, m_min(0)
+, m_max(0)
+, m_zeroCount(0)
+, m_offset(0)
+{
+}
+
+void StreamingStats::add(double value)
+{
+    if (m_count == 0 || value < m_min)
+    {
+        m_min = value;
+    }
+
+    if (m_count == 0 || value > m_max)
+    {
+        m_max = value;
+    }
+
+    ++m_count;
+
+    double delta = value - m_mean;
+    m_mean += delta / m_count;
+    m_m2 += delta * (value - m_mean);
+
+    addToSketch(value, 1);
+}
+
+void StreamingStats::merge(const StreamingStats &other)
+{
+    if (other.m_count == 0)
+    {
+        return;
+    }
+
+    if (m_count == 0)
+    {
+        double gamma = m_gamma;
+        double logGamma = m_logGamma;
+        *this = other;
+
+        // Keep our own accuracy, re-bucket below if it differs
+        if (gamma == other.m_gamma)
+        {
+            return;
+        }
+
+        m_gamma = gamma;
+        m_logGamma = logGamma;
+        m_zeroCount = 0;
+        m_bins.clear();
+    }
+    else
+    {
+        // Chan et al. for the combined mean and variance
+        quint64 count = m_count + other.m_count;
+        double delta = other.m_mean - m_mean;
+
+        m_mean += delta * other.m_count / count;
+        m_m2 += other.m_m2 + delta * delta * m_count * other.m_count / count;
+        m_count = count;
+        m_min = qMin(m_min, other.m_min);
+        m_max = qMax(m_max, other.m_max);
+    }
+
+    if (m_gamma == other.m_gamma)
+    {
+        m_zeroCount += other.m_zeroCount;
+
+        for (int i = 0; i < other.m_bins.size(); ++i)
+        {
+            if (other.m_bins.at(i))
+            {
+                int index = other.m_offset + i;
+
+                if (m_bins.isEmpty() || index < m_offset || index >= m_offset + m_bins.size())
+                {
+                    index = extend(index);
+                }
+
+                m_bins[index - m_offset] += other.m_bins.at(i);
+            }
+        }
+    }
+    else
+    {
+        addToSketch(0, other.m_zeroCount);
+
+        for (int i = 0; i < other.m_bins.size(); ++i)
+        {
+            if (other.m_bins.at(i))
+            {
+                addToSketch(2 * qPow(other.m_gamma, other.m_offset + i) / (other.m_gamma + 1), other.m_bins.at(i));
+            }
+        }
+    }
+}
+
+void StreamingStats::clear()
+{
+    m_count = 0;
+    m_mean = 0;
+    m_m2 = 0;
+    m_min = 0;
+    m_max = 0;
+    m_zeroCount = 0;
+    m_offset = 0;
+    m_bins.clear();
+}
+
+quint64 StreamingStats::count() const
+{
+    return m_count;
+}
+
+double StreamingStats::sum() const
+{
+    return m_mean * m_count;
+}
+
+double StreamingStats::mean() const
+{
+    return m_mean;
+}
+
+double StreamingStats::variance() const
+{
+    return m_count ? m_m2 / m_count : 0;
+}
+
+double StreamingStats::stdev() const
+{
+    return qSqrt(variance());
+}
+
+double StreamingStats::min() const
+{
+    return m_min;
+}
+
+double StreamingStats::max() const
+{
+    return m_max;
+}
+
+double StreamingStats::quantile(double q) const
+{
+    if (m_count == 0)
+    {
+        return 0;
+    }
+
+    // The extremes are known exactly
+    if (q <= 0)
+    {
+        return m_min;
+    }
+
+    if (q >= 1)
+    {
+        return m_max;
+    }
+
+    // Rank of the wanted sample, counted from zero
+    double rank = q * (m_count - 1);
+    quint64 seen = m_zeroCount;
+
+    if (seen > rank)
+    {
+        return qBound(m_min, 0.0, m_max);
+    }
+
+    for (int i = 0; i < m_bins.size(); ++i)
+    {
+        seen += m_bins.at(i);
+
+        if (seen > rank)
+        {
+            // Midpoint of the bucket in relative terms
+            double value = 2 * qPow(m_gamma, m_offset + i) / (m_gamma + 1);
+            return qBound(m_min, value, m_max);
+        }
+    }
+
+    return m_max;
+}
+
+void StreamingStats::addToSketch(double value, quint64 count)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    if (value < minIndexable)
+    {
+        m_zeroCount += count;
+        return;
+    }
+
+    int index = qCeil(qLn(value) / m_logGamma);
+
+    if (m_bins.isEmpty() || index < m_offset || index >= m_offset + m_bins.size())
+    {
+        index = extend(index);
+    }
+
+    m_bins[index - m_offset] += count;
+}
+
+int StreamingStats::extend(int index)
+{
+    if (m_bins.isEmpty())
+    {
+        m_offset = index;
+        m_bins.fill(0, 1);
+        return index;
+    }
+
+    int low = qMin(index, m_offset);
+    int high = qMax(index, m_offset + m_bins.size() - 1);
+
+    // Too wide, the lowest buckets are collapsed so the high quantiles stay accurate
+    if (high - low + 1 > maxBins)
+    {
+        low = high - maxBins + 1;
+    }
+
+    QVector<quint64> bins(high - low + 1, 0);
+
+    for (int i = 0; i < m_bins.size(); ++i)
+    {
+        bins[qMax(low, m_offset + i) - low] += m_bins.at(i);
+    }
+
+    m_bins = bins;
+    m_offset = low;
+
+    return qMax(index, low);
+}
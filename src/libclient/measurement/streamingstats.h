@@ -0,0 +1,54 @@
+#ifndef STREAMINGSTATS_H
+#define STREAMINGSTATS_H
+
+#include "../export.h"
+
+#include <QVector>
+
+// Single pass statistics over a stream of non-negative samples such as
+// round trip times or throughputs. Mean and variance use Welford's method,
+// quantiles come from a log-bucketed sketch whose estimates are within the
+// relative accuracy of the true value. Memory does not grow with the number
+// of samples and two instances merge exactly.
+class CLIENT_API StreamingStats
+{
+public:
+    explicit StreamingStats(double relativeAccuracy = 0.01);
+
+    void add(double value);
+    void merge(const StreamingStats &other);
+    void clear();
+
+    quint64 count() const;
+    double sum() const;
+    double mean() const;
+
+    // Population variance, like the stdev in all results so far
+    double variance() const;
+    double stdev() const;
+
+    // 0 without samples
+    double min() const;
+    double max() const;
+    double quantile(double q) const;
+
+private:
+    void addToSketch(double value, quint64 count);
+    int extend(int index);
+
+    double m_gamma;
+    double m_logGamma;
+
+    quint64 m_count;
+    double m_mean;
+    double m_m2;
+    double m_min;
+    double m_max;
+
+    // Samples too small for a bucket, zeros included
+    quint64 m_zeroCount;
+    int m_offset;
+    QVector<quint64> m_bins;
+};
+
+#endif // STREAMINGSTATS_H
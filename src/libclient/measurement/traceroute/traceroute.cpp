@@ -1,5 +1,6 @@
 #include "../../log/logger.h"
 #include "traceroute.h"
+#include "../streamingstats.h"
 
 #if defined(Q_OS_LINUX) || defined(Q_OS_MAC)
 #include <arpa/inet.h>
@@ -18,6 +19,9 @@ Traceroute::Traceroute(QObject *parent)
 , m_ping()
 , endOfRoute(false)
 , ttl(0)
+, destinationPort(0)
+, sourcePort(0)
+, waitingForNames(false)
 {
 }
 
@@ -43,7 +47,13 @@ bool Traceroute::prepare(NetworkManager *networkManager,
                          const MeasurementDefinitionPtr &measurementDefinition)
 {
     Q_UNUSED(networkManager);
-    definition = measurementDefinition.dynamicCast<TracerouteDefinition>();
+    definition = measurementDefinition.dynamicCast<const TracerouteDefinition>();
+
+    if (definition.isNull())
+    {
+        setErrorString("Definition is empty");
+        return false;
+    }
 
     if (definition->type != ping::Udp)
     {
@@ -54,14 +64,18 @@ bool Traceroute::prepare(NetworkManager *networkManager,
     // initialize ports randomly if not given
     qsrand(QDateTime::currentMSecsSinceEpoch());
 
-    if (definition->destinationPort == 0)
+    // the definition is shared between runs, so the ports are chosen here
+    destinationPort = definition->destinationPort;
+    sourcePort = definition->sourcePort;
+
+    if (destinationPort == 0)
     {
-        definition->destinationPort = (qrand() % 64511) + 1024; // range 1024 - 65535
+        destinationPort = (qrand() % 64511) + 1024; // range 1024 - 65535
     }
 
-    if (definition->sourcePort == 0)
+    if (sourcePort == 0)
     {
-        definition->sourcePort = (qrand() % 64511) + 1024; // range 1024 - 65535
+        sourcePort = (qrand() % 64511) + 1024; // range 1024 - 65535
     }
 
     connect(&m_ping, SIGNAL(destinationUnreachable(const PingProbe &)),
@@ -78,6 +92,15 @@ bool Traceroute::prepare(NetworkManager *networkManager,
 
     connect(&m_ping, SIGNAL(finished()), this, SLOT(pingFinished()));
 
+    if (definition->resolveHops)
+    {
+        // A slow name server must not hold back the result for long
+        resolver.setTimeout(1000);
+        resolver.setRetries(1);
+
+        connect(&resolver, SIGNAL(finished()), this, SLOT(namesResolved()));
+    }
+
     connect(&m_ping, SIGNAL(error(const QString &)), &m_ping,
             SLOT(setErrorString(const QString &)));
 
@@ -103,12 +126,12 @@ Result Traceroute::result() const
     QVariantList pings;
     QVariantMap hop;
     QVariantMap probe;
-    QList<quint64> pingTime;
+    StreamingStats rttStats;
 
     for (int i = 0; i < hops.size(); i += definition->count)
     {
         pings.clear();
-        pingTime.clear();
+        rttStats.clear();
 
         for (quint32 k = 0; k < definition->count; k++)
         {
@@ -120,7 +143,7 @@ Result Traceroute::result() const
             // use only successful pings for the statistics
             if (hops[i + k].response != traceroute::TIMEOUT)
             {
-                pingTime.append(hops[i + k].probe.recvTime - hops[i + k].probe.sendTime);
+                rttStats.add(hops[i + k].probe.recvTime - hops[i + k].probe.sendTime);
             }
 
             probe.insert("response", hops[i + k].response);
@@ -129,40 +152,23 @@ Result Traceroute::result() const
             pings.append(probe);
         }
 
-        quint64 min = 0, max = 0;
-        qreal avg = 0.0, sq_sum = 0.0, stdev = 0.0;
+        hop.insert("hop", QString(inet_ntoa(hops[i].probe.source.sin.sin_addr)));
 
-        // do statistics only when there are pings
-        if (pingTime.size() > 0)
+        if (definition->resolveHops)
         {
-            // get max and min
-            QList<quint64>::const_iterator it = std::max_element(pingTime.begin(), pingTime.end());
-            max = *it;
-            it = std::min_element(pingTime.begin(), pingTime.end());
-            min = *it;
-
-            // calculate average and fill ping times
-            foreach (quint64 val, pingTime)
-            {
-                avg += val;
-            }
-
-            sq_sum = std::inner_product(pingTime.begin(), pingTime.end(), pingTime.begin(), 0.0);
-            stdev = 0.0;
-
-            avg /= pingTime.size();
-            // calculate standard deviation
-            stdev = qSqrt(sq_sum / pingTime.size() - avg * avg);
+            hop.insert("hostname", resolver.hostName(QHostAddress(&hops[i].probe.source.sa)));
         }
 
-        hop.insert("hop", QString(inet_ntoa(hops[i].probe.source.sin.sin_addr)));
         hop.insert("pings", pings);
         hop.insert("ttl", i / 3 + 1);
-        hop.insert("rtt_min", min);
-        hop.insert("rtt_max", max);
-        hop.insert("rtt_avg", avg);
-        hop.insert("rtt_stdev", stdev);
-        hop.insert("rtt_count", pingTime.size());
+        hop.insert("rtt_min", rttStats.min());
+        hop.insert("rtt_max", rttStats.max());
+        hop.insert("rtt_avg", rttStats.mean());
+        hop.insert("rtt_stdev", rttStats.stdev());
+        hop.insert("rtt_p50", rttStats.quantile(0.5));
+        hop.insert("rtt_p90", rttStats.quantile(0.9));
+        hop.insert("rtt_p99", rttStats.quantile(0.99));
+        hop.insert("rtt_count", rttStats.count());
 
         res << hop;
     }
@@ -178,23 +184,21 @@ void Traceroute::ping()
 {
     if (++ttl == 20)
     {
-        emit finished();
+        finish();
         return;
     }
 
-    PingDefinition pingDef(definition->host,
-                                 definition->count,
-                                 definition->interval,
-                                 definition->receiveTimeout,
-                                 ttl,
-                                 definition->destinationPort,
-                                 definition->sourcePort,
-                                 definition->payload,
-                                 definition->type);
-
-    if (m_ping.prepare(NULL, PingPlugin().createMeasurementDefinition(
-                           "ping",
-                           pingDef.toVariant())))
+    PingDefinitionPtr pingDef(new PingDefinition(definition->host,
+                                                 definition->count,
+                                                 definition->interval,
+                                                 definition->receiveTimeout,
+                                                 ttl,
+                                                 destinationPort,
+                                                 sourcePort,
+                                                 definition->payload,
+                                                 definition->type));
+
+    if (m_ping.prepare(NULL, pingDef))
     {
         m_ping.start();
     }
@@ -232,12 +236,54 @@ void Traceroute::udpResponse(const PingProbe &probe)
 
 void Traceroute::pingFinished()
 {
+    if (definition->resolveHops)
+    {
+        resolveHops();
+    }
+
     if (endOfRoute)
     {
-        emit finished();
+        finish();
     }
     else
     {
         ping();
     }
 }
+
+void Traceroute::finish()
+{
+    // Only the names of the last hops can still be outstanding
+    if (definition->resolveHops && resolver.isRunning())
+    {
+        waitingForNames = true;
+        return;
+    }
+
+    emit finished();
+}
+
+void Traceroute::resolveHops()
+{
+    // The names are looked up while the next ttl is probed
+    QList<QHostAddress> addresses;
+
+    foreach (const Hop &hop, hops)
+    {
+        if (hop.response != traceroute::TIMEOUT)
+        {
+            addresses.append(QHostAddress(&hop.probe.source.sa));
+        }
+    }
+
+    resolver.lookup(addresses);
+}
+
+void Traceroute::namesResolved()
+{
+    if (waitingForNames)
+    {
+        waitingForNames = false;
+        emit finished();
+    }
+}
@@ -8,9 +8,9 @@
 #include "../measurement.h"
 #include "../../task/task.h"
 #include "../ping/ping.h"
-#include "../ping/ping_plugin.h"
 #include "../ping/ping_definition.h"
 #include "traceroute_definition.h"
+#include "../../network/reverseresolver.h"
 
 namespace traceroute
 {
@@ -47,6 +47,8 @@ public:
 private:
     void setStatus(Status status);
     void ping();
+    void finish();
+    void resolveHops();
 
     TracerouteDefinitionPtr definition;
     Status currentStatus;
@@ -54,6 +56,10 @@ private:
     QList<Hop> hops;
     bool endOfRoute;
     int ttl;
+    quint16 destinationPort;
+    quint16 sourcePort;
+    ReverseResolver resolver;
+    bool waitingForNames;
 
 signals:
     void statusChanged(Status status);
@@ -65,6 +71,7 @@ public slots:
     void timeout(const PingProbe &probe);
     void udpResponse(const PingProbe &probe);
     void pingFinished();
+    void namesResolved();
 };
 
 #endif // TRACEROUTE_H
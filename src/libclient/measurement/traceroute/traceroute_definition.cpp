@@ -7,7 +7,8 @@ TracerouteDefinition::TracerouteDefinition(const QString &host,
                                            const quint16 &destinationPort,
                                            const quint16 &sourcePort,
                                            const quint32 &payload,
-                                           const ping::PingType &type)
+                                           const ping::PingType &type,
+                                           bool resolveHops)
 : host(host)
 , count(count)
 , interval(interval)
@@ -16,6 +17,7 @@ TracerouteDefinition::TracerouteDefinition(const QString &host,
 , sourcePort(sourcePort)
 , payload(payload)
 , type(type)
+, resolveHops(resolveHops)
 {
 }
 
@@ -35,7 +37,8 @@ TracerouteDefinitionPtr TracerouteDefinition::fromVariant(const QVariant &varian
                                        map.value("source_port", 33434).toUInt(),
                                        map.value("payload", 74).toUInt(),
                                        pingTypeFromString(map.value(
-                                                              "ping_type", "Udp").toString().toLatin1())));
+                                                              "ping_type", "Udp").toString().toLatin1()),
+                                       map.value("resolve_hops", false).toBool()));
 }
 
 QVariant TracerouteDefinition::toVariant() const
@@ -49,5 +52,6 @@ QVariant TracerouteDefinition::toVariant() const
     map.insert("source_port", sourcePort);
     map.insert("payload", payload);
     map.insert("ping_type", pingTypeToString(type));
+    map.insert("resolve_hops", resolveHops);
     return map;
 }
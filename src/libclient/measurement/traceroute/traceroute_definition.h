@@ -7,7 +7,7 @@
 
 class TracerouteDefinition;
 
-typedef QSharedPointer<TracerouteDefinition> TracerouteDefinitionPtr;
+typedef QSharedPointer<const TracerouteDefinition> TracerouteDefinitionPtr;
 typedef QList<TracerouteDefinitionPtr> TracerouteDefinitionList;
 
 class TracerouteDefinition : public MeasurementDefinition
@@ -17,7 +17,7 @@ public:
                          const quint32 &interval, const quint32 &receiveTimeout,
                          const quint16 &destinationPort,
                          const quint16 &sourcePort, const quint32 &payload,
-                         const ping::PingType &type);
+                         const ping::PingType &type, bool resolveHops = false);
     ~TracerouteDefinition();
 
     // Storage
@@ -33,6 +33,9 @@ public:
     quint32 payload;
     ping::PingType type;
 
+    // Look up the hop names while probing continues
+    bool resolveHops;
+
     // Serializable interface
     QVariant toVariant() const;
 };
@@ -0,0 +1,207 @@
+#include "internetgateway.h"
+#include "../../log/logger.h"
+#include "../../timing/clock.h"
+
+#include <QMutex>
+#include <QSet>
+#include <QNetworkInterface>
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrentRun>
+
+#include <miniupnpc/miniupnpc.h>
+
+#ifndef FALSE
+#define FALSE 0
+#define TRUE 1
+#endif
+
+LOGGER(InternetGatewayCache);
+
+namespace
+{
+    // How long the discovery waits for answers in ms
+    const int discoveryDelay = 2000;
+
+    struct Cache
+    {
+        Cache()
+        : expiry(0)
+        , ttl(10 * 60 * 1000)
+        {
+        }
+
+        QMutex mutex;
+        InternetGatewayList gateways;
+        qint64 expiry; // monotonic ns, 0 if never discovered
+        int ttl;
+    };
+
+    Q_GLOBAL_STATIC(Cache, cache)
+
+    struct Pools
+    {
+        Pools()
+        {
+            jobs.setMaxThreadCount(4);
+
+            // one discovery per interface or one request per gateway service
+            requests.setMaxThreadCount(16);
+        }
+
+        QThreadPool jobs;
+        QThreadPool requests;
+    };
+
+    Q_GLOBAL_STATIC(Pools, pools)
+
+    InternetGatewayList discoverOn(const QString &interfaceAddress)
+    {
+        InternetGatewayList gateways;
+        int error = 0;
+
+        QByteArray multicastIf = interfaceAddress.toLatin1();
+        UPNPDev *devlist = ::upnpDiscover(discoveryDelay, multicastIf.isEmpty() ? NULL : multicastIf.constData(),
+                                          NULL, FALSE, FALSE, &error);
+
+        for (UPNPDev *dev = devlist; dev; dev = dev->pNext)
+        {
+            UPNPUrls urls;
+            IGDdatas data;
+            char lanaddr[64];
+
+            // only look at this device, the list is walked here
+            UPNPDev *next = dev->pNext;
+            dev->pNext = NULL;
+
+            if (UPNP_GetValidIGD(dev, &urls, &data, lanaddr, sizeof(lanaddr)) > 0)
+            {
+                InternetGateway gateway;
+                gateway.controlUrl = urls.controlURL;
+                gateway.serviceType = data.first.servicetype;
+                gateway.cifControlUrl = urls.controlURL_CIF;
+                gateway.cifServiceType = data.CIF.servicetype;
+                gateway.rootDescUrl = urls.rootdescURL;
+                gateway.lanAddress = QLatin1String(lanaddr);
+                gateways.append(gateway);
+            }
+
+            FreeUPNPUrls(&urls);
+            dev->pNext = next;
+        }
+
+        freeUPNPDevlist(devlist);
+
+        return gateways;
+    }
+}
+
+InternetGatewayList InternetGatewayCache::gateways()
+{
+    Cache *c = cache();
+
+    {
+        QMutexLocker locker(&c->mutex);
+
+        if (c->expiry > Clock::monotonic())
+        {
+            return c->gateways;
+        }
+    }
+
+    return discover();
+}
+
+InternetGatewayList InternetGatewayCache::discover()
+{
+    QStringList addresses;
+
+    foreach (const QNetworkInterface &iface, QNetworkInterface::allInterfaces())
+    {
+        QNetworkInterface::InterfaceFlags flags = iface.flags();
+
+        if (flags & QNetworkInterface::IsLoopBack || !(flags & QNetworkInterface::IsUp) ||
+            !(flags & QNetworkInterface::CanMulticast))
+        {
+            continue;
+        }
+
+        foreach (const QNetworkAddressEntry &entry, iface.addressEntries())
+        {
+            if (entry.ip().protocol() == QAbstractSocket::IPv4Protocol)
+            {
+                addresses.append(entry.ip().toString());
+                break;
+            }
+        }
+    }
+
+    if (addresses.isEmpty())
+    {
+        // let miniupnpc pick the interface
+        addresses.append(QString());
+    }
+
+    // every interface waits for the full delay, so ask them all at once
+    QList<QFuture<InternetGatewayList> > futures;
+
+    foreach (const QString &address, addresses)
+    {
+        futures.append(QtConcurrent::run(requestPool(), &discoverOn, address));
+    }
+
+    InternetGatewayList gateways;
+    QSet<QByteArray> controlUrls;
+
+    foreach (QFuture<InternetGatewayList> future, futures)
+    {
+        foreach (const InternetGateway &gateway, future.result())
+        {
+            // the same gateway answers on several interfaces
+            if (!controlUrls.contains(gateway.controlUrl))
+            {
+                controlUrls.insert(gateway.controlUrl);
+                gateways.append(gateway);
+            }
+        }
+    }
+
+    LOG_DEBUG(QString("Found %1 gateways on %2 interfaces").arg(gateways.size()).arg(addresses.size()));
+
+    Cache *c = cache();
+    QMutexLocker locker(&c->mutex);
+    c->gateways = gateways;
+    c->expiry = Clock::monotonic() + c->ttl * Q_INT64_C(1000000);
+
+    return gateways;
+}
+
+void InternetGatewayCache::invalidate()
+{
+    Cache *c = cache();
+    QMutexLocker locker(&c->mutex);
+    c->expiry = 0;
+}
+
+void InternetGatewayCache::setTtl(int msecs)
+{
+    Cache *c = cache();
+    QMutexLocker locker(&c->mutex);
+    c->ttl = msecs;
+}
+
+int InternetGatewayCache::ttl()
+{
+    Cache *c = cache();
+    QMutexLocker locker(&c->mutex);
+    return c->ttl;
+}
+
+QThreadPool *InternetGatewayCache::jobPool()
+{
+    return &pools()->jobs;
+}
+
+QThreadPool *InternetGatewayCache::requestPool()
+{
+    return &pools()->requests;
+}
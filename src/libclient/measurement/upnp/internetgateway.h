@@ -0,0 +1,45 @@
+#ifndef INTERNETGATEWAY_H
+#define INTERNETGATEWAY_H
+
+#include "../../export.h"
+
+#include <QList>
+#include <QByteArray>
+#include <QString>
+
+class QThreadPool;
+
+// Control URLs of an internet gateway device as found by UPnP discovery
+struct CLIENT_API InternetGateway
+{
+    QByteArray controlUrl;
+    QByteArray serviceType;
+    QByteArray cifControlUrl; // common interface config service
+    QByteArray cifServiceType;
+    QByteArray rootDescUrl;
+    QString lanAddress;
+};
+
+typedef QList<InternetGateway> InternetGatewayList;
+
+// Process wide cache of the discovered gateways. Discovery runs on all
+// interfaces in parallel and blocks the calling thread.
+class CLIENT_API InternetGatewayCache
+{
+public:
+    // Cached gateways, discovers them again once the ttl expired
+    static InternetGatewayList gateways();
+    static InternetGatewayList discover();
+
+    static void invalidate();
+
+    static void setTtl(int msecs);
+    static int ttl();
+
+    // Thread pools for the blocking miniupnpc calls, kept apart from the
+    // global pool. Jobs may wait for requests, requests never wait.
+    static QThreadPool *jobPool();
+    static QThreadPool *requestPool();
+};
+
+#endif // INTERNETGATEWAY_H
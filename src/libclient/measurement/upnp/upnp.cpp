@@ -2,6 +2,7 @@
 
 #include "../../log/logger.h"
 #include <QMetaEnum>
+#include <QtConcurrent/QtConcurrentRun>
 #include "../../types.h"
 
 LOGGER(UPnP);
@@ -15,220 +16,255 @@ LOGGER(UPnP);
 #define TRUE 1
 #endif
 
-UPnP::UPnP(QObject *parent)
-: Measurement(parent)
+namespace
 {
-}
+    QStringList GetValuesFromNameValueList(struct NameValueParserData *pdata,
+                                           const char *Name)
+    {
+        QStringList ret;
+        struct NameValue *nv;
 
-UPnP::~UPnP()
-{
-}
+        for (nv = pdata->l_head;
+             (nv != NULL);
+             nv = nv->l_next)
+        {
+            if (strcmp(nv->name, Name) == 0)
+            {
+                ret.append(nv->value);
+            }
+        }
 
-Measurement::Status UPnP::status() const
-{
-    return Unknown;
-}
+        return ret;
+    }
 
-bool UPnP::prepare(NetworkManager *networkManager, const MeasurementDefinitionPtr &measurementDefinition)
-{
-    Q_UNUSED(networkManager);
-    Q_UNUSED(measurementDefinition);
-    return true;
-}
+    UPnP::UPnPHash queryConnection(const InternetGateway &gateway)
+    {
+        UPnP::UPnPHash resultHash;
+        const char *controlUrl = gateway.controlUrl.constData();
+        const char *serviceType = gateway.serviceType.constData();
 
-QStringList GetValuesFromNameValueList(struct NameValueParserData *pdata,
-                                       const char *Name)
-{
-    QStringList ret;
-    struct NameValue *nv;
+        char externalIP[40];
 
-    for (nv = pdata->l_head;
-         (nv != NULL);
-         nv = nv->l_next)
-    {
-        if (strcmp(nv->name, Name) == 0)
+        if (UPNPCOMMAND_SUCCESS == UPNP_GetExternalIPAddress(controlUrl, serviceType, externalIP))
         {
-            ret.append(nv->value);
+            resultHash.insert(UPnP::ExternalIpAddress, QLatin1String(externalIP));
         }
-    }
 
-    return ret;
-}
+        char connectionType[64];
 
-bool UPnP::start()
-{
-    int error = 0;
+        if (UPNPCOMMAND_SUCCESS == UPNP_GetConnectionTypeInfo(controlUrl, serviceType, connectionType))
+        {
+            resultHash.insert(UPnP::ConnectionType, QLatin1String(connectionType));
+        }
 
-    UPNPDev *devlist = ::upnpDiscover(2000, NULL, NULL, FALSE, FALSE, &error);
-    UPNPDev *devlistBegin = devlist;
+        char status[100];
+        unsigned int uptime = 0;
+        char lastConnectionError[128];
 
-    // get interface list
-    /*foreach(interface, interfaces) {
-        newdevlist = ::upnpDiscover(2000, interface, NULL, FALSE, FALSE, &error);
+        if (UPNPCOMMAND_SUCCESS == UPNP_GetStatusInfo(controlUrl, serviceType, status, &uptime,
+                                                      lastConnectionError))
+        {
+            resultHash.insert(UPnP::Status, status);
+            resultHash.insert(UPnP::Uptime, uptime);
+            resultHash.insert(UPnP::LastConnectionError, lastConnectionError);
+        }
 
-        // go to end of list and append
-    }*/
+        return resultHash;
+    }
 
-    while (devlist)
+    UPnP::UPnPHash queryFirewall(const InternetGateway &gateway)
     {
-        UPNPUrls urls;
-        IGDdatas data;
-        char lanaddr[64];
-        UPnPHash resultHash;
+        UPnP::UPnPHash resultHash;
+        const char *controlUrl = gateway.controlUrl.constData();
+        const char *serviceType = gateway.serviceType.constData();
 
-        int code = UPNP_GetValidIGD(devlist, &urls, &data, lanaddr, sizeof(lanaddr));
+        quint32 num;
 
-        if (code > 0)   // TODO maybe distinguish between the return codes (1,2,3) to add information what happend to the result
+        if (UPNPCOMMAND_SUCCESS == UPNP_GetPortMappingNumberOfEntries(controlUrl, serviceType, &num))
         {
-            resultHash.insert(LanIpAddress, QLatin1String(lanaddr));
+            resultHash.insert(UPnP::NumberOfPortMappings, num);
+        }
 
-            char externalIP[40];
+        // TODO GetListOfPortMappings do we need this?
 
-            if (UPNPCOMMAND_SUCCESS == UPNP_GetExternalIPAddress(urls.controlURL,
-                                                                 data.first.servicetype,
-                                                                 externalIP))
-            {
-                resultHash.insert(ExternalIpAddress, QLatin1String(externalIP));
-            }
+        int firewallEnabled, inboundPinholeAllowed;
 
-            char connectionType[64];
+        if (UPNPCOMMAND_SUCCESS == UPNP_GetFirewallStatus(controlUrl, serviceType, &firewallEnabled,
+                                                          &inboundPinholeAllowed))
+        {
+            resultHash.insert(UPnP::FirewallEnabled, firewallEnabled);
+            resultHash.insert(UPnP::InboundPinholeAllowed, inboundPinholeAllowed);
+        }
 
-            if (UPNPCOMMAND_SUCCESS == UPNP_GetConnectionTypeInfo(urls.controlURL,
-                                                                  data.first.servicetype,
-                                                                  connectionType))
-            {
-                resultHash.insert(ConnectionType, QLatin1String(connectionType));
-            }
+        return resultHash;
+    }
 
-            quint32 uplink, downlink;
+    UPnP::UPnPHash queryLinkLayer(const InternetGateway &gateway)
+    {
+        UPnP::UPnPHash resultHash;
+        quint32 uplink, downlink;
 
-            if (UPNPCOMMAND_SUCCESS == UPNP_GetLinkLayerMaxBitRates(urls.controlURL_CIF,
-                                                                    data.CIF.servicetype,
-                                                                    &downlink, &uplink))
-            {
-                resultHash.insert(LinkLayerMaxDownload, downlink);
-                resultHash.insert(LinkLayerMaxUpload, uplink);
-            }
+        if (UPNPCOMMAND_SUCCESS == UPNP_GetLinkLayerMaxBitRates(gateway.cifControlUrl.constData(),
+                                                                gateway.cifServiceType.constData(),
+                                                                &downlink, &uplink))
+        {
+            resultHash.insert(UPnP::LinkLayerMaxDownload, downlink);
+            resultHash.insert(UPnP::LinkLayerMaxUpload, uplink);
+        }
 
-            quint32 bytesSent, bytesReceived, packetsSent, packetsReceived;
+        return resultHash;
+    }
 
-            bytesSent = UPNP_GetTotalBytesSent(urls.controlURL_CIF,
-                                               data.CIF.servicetype);
+    UPnP::UPnPHash queryDescription(const InternetGateway &gateway)
+    {
+        UPnP::UPnPHash resultHash;
+        int bufferSize = 0;
 
-            if ((unsigned int)UPNPCOMMAND_HTTP_ERROR != bytesSent)
+        if (char *buffer = (char *)miniwget(gateway.rootDescUrl.constData(), &bufferSize, 0))
+        {
+            NameValueParserData pdata;
+            ParseNameValue(buffer, bufferSize, &pdata);
+            free(buffer);
+            buffer = NULL;
+
+            QStringList modelName = GetValuesFromNameValueList(&pdata, "modelName");
+
+            if (!modelName.isEmpty())
             {
-                resultHash.insert(TotalBytesSent, bytesSent);
+                resultHash.insert(UPnP::ModelName, modelName.last());
             }
 
-            bytesReceived = UPNP_GetTotalBytesReceived(urls.controlURL_CIF,
-                                                       data.CIF.servicetype);
+            QStringList manufacturer = GetValuesFromNameValueList(&pdata, "manufacturer");
 
-            if ((unsigned int)UPNPCOMMAND_HTTP_ERROR != bytesReceived)
+            if (!manufacturer.isEmpty())
             {
-                resultHash.insert(TotalBytesReceived, bytesReceived);
+                resultHash.insert(UPnP::Manufacturer, manufacturer.last());
             }
 
-            packetsSent = UPNP_GetTotalPacketsSent(urls.controlURL_CIF,
-                                                   data.CIF.servicetype);
+            QStringList friendlyName = GetValuesFromNameValueList(&pdata, "friendlyName");
 
-            if ((unsigned int)UPNPCOMMAND_HTTP_ERROR != packetsSent)
+            if (!friendlyName.isEmpty())
             {
-                resultHash.insert(TotalPacketsSent, packetsSent);
+                resultHash.insert(UPnP::FriendlyName, friendlyName.last());
             }
 
+            ClearNameValueList(&pdata);
+        }
 
-            packetsReceived = UPNP_GetTotalPacketsReceived(urls.controlURL_CIF,
-                                                           data.CIF.servicetype);
+        return resultHash;
+    }
 
-            if ((unsigned int)UPNPCOMMAND_HTTP_ERROR != packetsReceived)
-            {
-                resultHash.insert(TotalPacketsReceived, packetsReceived);
-            }
+    QList<UPnP::UPnPHash> queryAll()
+    {
+        QList<UPnP::UPnPHash> results;
 
+        foreach (const InternetGateway &gateway, InternetGatewayCache::gateways())
+        {
+            results.append(UPnP::query(gateway));
+        }
 
-            char status[100];
-            unsigned int uptime = 0;
-            char lastConnectionError[128];
+        return results;
+    }
+}
 
-            if (UPNPCOMMAND_SUCCESS == UPNP_GetStatusInfo(urls.controlURL,
-                                                          data.first.servicetype,
-                                                          status,
-                                                          &uptime,
-                                                          lastConnectionError))
-            {
-                resultHash.insert(Status, status);
-                resultHash.insert(Uptime, uptime);
-                resultHash.insert(LastConnectionError, lastConnectionError);
-            }
+UPnP::UPnP(QObject *parent)
+: Measurement(parent)
+{
+    connect(&watcher, SIGNAL(finished()), this, SLOT(queryFinished()));
+}
 
-            quint32 num;
+UPnP::~UPnP()
+{
+    watcher.waitForFinished();
+}
 
-            if (UPNPCOMMAND_SUCCESS == UPNP_GetPortMappingNumberOfEntries(urls.controlURL,
-                                                                          data.first.servicetype,
-                                                                          &num))
-            {
-                resultHash.insert(NumberOfPortMappings, num);
-            }
+Measurement::Status UPnP::status() const
+{
+    return watcher.isRunning() ? Running : Unknown;
+}
+
+bool UPnP::prepare(NetworkManager *networkManager, const MeasurementDefinitionPtr &measurementDefinition)
+{
+    Q_UNUSED(networkManager);
+    Q_UNUSED(measurementDefinition);
+    return true;
+}
 
-            // TODO GetListOfPortMappings do we need this?
+UPnP::UPnPHash UPnP::queryCounters(const InternetGateway &gateway)
+{
+    UPnPHash resultHash;
+    const char *controlUrl = gateway.cifControlUrl.constData();
+    const char *serviceType = gateway.cifServiceType.constData();
 
-            int firewallEnabled, inboundPinholeAllowed;
+    quint32 bytesSent, bytesReceived, packetsSent, packetsReceived;
 
-            if (UPNPCOMMAND_SUCCESS == UPNP_GetFirewallStatus(urls.controlURL,
-                                                              data.first.servicetype,
-                                                              &firewallEnabled,
-                                                              &inboundPinholeAllowed))
-            {
-                resultHash.insert(FirewallEnabled, firewallEnabled);
-                resultHash.insert(InboundPinholeAllowed, inboundPinholeAllowed);
-            }
+    bytesSent = UPNP_GetTotalBytesSent(controlUrl, serviceType);
 
-            int bufferSize = 0;
+    if ((unsigned int)UPNPCOMMAND_HTTP_ERROR != bytesSent)
+    {
+        resultHash.insert(TotalBytesSent, bytesSent);
+    }
 
-            if (char *buffer = (char *)miniwget(urls.rootdescURL, &bufferSize, 0))
-            {
-                NameValueParserData pdata;
-                ParseNameValue(buffer, bufferSize, &pdata);
-                free(buffer);
-                buffer = NULL;
+    bytesReceived = UPNP_GetTotalBytesReceived(controlUrl, serviceType);
 
-                QStringList modelName = GetValuesFromNameValueList(&pdata, "modelName");
+    if ((unsigned int)UPNPCOMMAND_HTTP_ERROR != bytesReceived)
+    {
+        resultHash.insert(TotalBytesReceived, bytesReceived);
+    }
 
-                if (!modelName.isEmpty())
-                {
-                    resultHash.insert(ModelName, modelName.last());
-                }
+    packetsSent = UPNP_GetTotalPacketsSent(controlUrl, serviceType);
 
-                QStringList manufacturer = GetValuesFromNameValueList(&pdata, "manufacturer");
+    if ((unsigned int)UPNPCOMMAND_HTTP_ERROR != packetsSent)
+    {
+        resultHash.insert(TotalPacketsSent, packetsSent);
+    }
 
-                if (!manufacturer.isEmpty())
-                {
-                    resultHash.insert(Manufacturer, manufacturer.last());
-                }
+    packetsReceived = UPNP_GetTotalPacketsReceived(controlUrl, serviceType);
 
-                QStringList friendlyName = GetValuesFromNameValueList(&pdata, "friendlyName");
+    if ((unsigned int)UPNPCOMMAND_HTTP_ERROR != packetsReceived)
+    {
+        resultHash.insert(TotalPacketsReceived, packetsReceived);
+    }
 
-                if (!friendlyName.isEmpty())
-                {
-                    resultHash.insert(FriendlyName, friendlyName.last());
-                }
+    return resultHash;
+}
 
-                ClearNameValueList(&pdata);
-            }
-        }
+UPnP::UPnPHash UPnP::query(const InternetGateway &gateway)
+{
+    // each group is an independent SOAP (or HTTP) exchange with the gateway
+    QList<QFuture<UPnPHash> > futures;
+    futures.append(QtConcurrent::run(InternetGatewayCache::requestPool(), &queryConnection, gateway));
+    futures.append(QtConcurrent::run(InternetGatewayCache::requestPool(), &queryFirewall, gateway));
+    futures.append(QtConcurrent::run(InternetGatewayCache::requestPool(), &queryLinkLayer, gateway));
+    futures.append(QtConcurrent::run(InternetGatewayCache::requestPool(), &queryDescription, gateway));
 
-        FreeUPNPUrls(&urls);
+    UPnPHash resultHash = queryCounters(gateway);
+    resultHash.insert(LanIpAddress, gateway.lanAddress);
 
-        results.append(resultHash);
-        devlist = devlist->pNext;
+    foreach (QFuture<UPnPHash> future, futures)
+    {
+        resultHash.unite(future.result());
     }
 
-    freeUPNPDevlist(devlistBegin);
+    return resultHash;
+}
+
+bool UPnP::start()
+{
+    // discovery and queries block, keep them off the executor and the global pool
+    results.clear();
+    watcher.setFuture(QtConcurrent::run(InternetGatewayCache::jobPool(), &queryAll));
 
-    emit finished();
     return true; // TODO return false if something went wrong or if there are no results
 }
 
+void UPnP::queryFinished()
+{
+    results = watcher.result();
+
+    emit finished();
+}
+
 bool UPnP::stop()
 {
     return true;
@@ -2,7 +2,10 @@
 #define UPNP_H
 
 #include "../measurement.h"
+#include "internetgateway.h"
+
 #include <QStringList>
+#include <QFutureWatcher>
 
 class UPnP : public Measurement
 {
@@ -43,9 +46,20 @@ public:
         FriendlyName
     };
 
-private:
     typedef QHash<DataType, QVariant> UPnPHash;
+
+    // Traffic counters of a gateway, cheap enough for periodic sampling
+    static UPnPHash queryCounters(const InternetGateway &gateway);
+
+    // All values of a gateway, the SOAP requests run concurrently
+    static UPnPHash query(const InternetGateway &gateway);
+
+private slots:
+    void queryFinished();
+
+private:
     QList<UPnPHash> results;
+    QFutureWatcher<QList<UPnPHash> > watcher;
 };
 
 #endif // UPNP_H
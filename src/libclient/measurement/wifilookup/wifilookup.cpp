@@ -42,7 +42,7 @@ bool WifiLookup::prepare(NetworkManager *networkManager,
                          const MeasurementDefinitionPtr &measurementDefinition)
 {
     Q_UNUSED(networkManager);
-    definition = measurementDefinition.dynamicCast<WifiLookupDefinition>();
+    definition = measurementDefinition.dynamicCast<const WifiLookupDefinition>();
     setErrorString("not implemented");
     return false;
 }
@@ -66,7 +66,7 @@ bool WifiLookup::prepare(NetworkManager *networkManager,
                          const MeasurementDefinitionPtr &measurementDefinition)
 {
     Q_UNUSED(networkManager);
-    definition = measurementDefinition.dynamicCast<WifiLookupDefinition>();
+    definition = measurementDefinition.dynamicCast<const WifiLookupDefinition>();
     return true;
 }
 
@@ -5,7 +5,7 @@
 
 class WifiLookupDefinition;
 
-typedef QSharedPointer<WifiLookupDefinition> WifiLookupDefinitionPtr;
+typedef QSharedPointer<const WifiLookupDefinition> WifiLookupDefinitionPtr;
 typedef QList<WifiLookupDefinitionPtr> WifiLookupDefinitionList;
 
 class WifiLookupDefinition: public MeasurementDefinition
@@ -0,0 +1,1062 @@
+#include "dnsclient.h"
+#include "../log/logger.h"
+#include "../timing/clock.h"
+
+#include <QUdpSocket>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QHash>
+#include <QFile>
+#include <QTextStream>
+#include <QUrl>
+#include <QDataStream>
+#include <QtEndian>
+
+#if defined(Q_OS_ANDROID)
+#include <sys/system_properties.h>
+#elif defined(Q_OS_WIN)
+#include <WinSock2.h>
+#include <IPHlpApi.h>
+#pragma comment(lib, "IPHLPAPI.lib")
+#endif
+
+LOGGER(DnsClient);
+
+namespace
+{
+    const int headerSize = 12;
+
+    // Flags of the header
+    const quint16 responseFlag = 0x8000;
+    const quint16 truncatedFlag = 0x0200;
+    const quint16 recursionDesiredFlag = 0x0100;
+
+    const quint16 classInternet = 1;
+
+    // Compression pointers may not loop forever
+    const int maxPointers = 16;
+
+    const struct
+    {
+        quint16 type;
+        const char *name;
+    } recordTypes[] =
+    {
+        { DnsClient::A, "A" },
+        { DnsClient::NS, "NS" },
+        { DnsClient::CNAME, "CNAME" },
+        { DnsClient::SOA, "SOA" },
+        { DnsClient::PTR, "PTR" },
+        { DnsClient::MX, "MX" },
+        { DnsClient::TXT, "TXT" },
+        { DnsClient::AAAA, "AAAA" },
+        { DnsClient::ANY, "ANY" }
+    };
+
+    quint16 readUInt16(const QByteArray &data, int offset)
+    {
+        return qFromBigEndian<quint16>((const uchar *)data.constData() + offset);
+    }
+
+    quint32 readUInt32(const QByteArray &data, int offset)
+    {
+        return qFromBigEndian<quint32>((const uchar *)data.constData() + offset);
+    }
+
+    bool readName(const QByteArray &data, int *offset, QString *name)
+    {
+        QStringList labels;
+        int pos = *offset;
+        int pointers = 0;
+        bool jumped = false;
+
+        forever
+        {
+            if (pos >= data.size())
+            {
+                return false;
+            }
+
+            quint8 length = data.at(pos);
+
+            if ((length & 0xc0) == 0xc0)
+            {
+                if (pos + 1 >= data.size() || ++pointers > maxPointers)
+                {
+                    return false;
+                }
+
+                if (!jumped)
+                {
+                    *offset = pos + 2;
+                    jumped = true;
+                }
+
+                pos = ((length & 0x3f) << 8) | (quint8)data.at(pos + 1);
+                continue;
+            }
+
+            if (length == 0)
+            {
+                if (!jumped)
+                {
+                    *offset = pos + 1;
+                }
+
+                break;
+            }
+
+            if (pos + 1 + length > data.size())
+            {
+                return false;
+            }
+
+            labels.append(QString::fromLatin1(data.mid(pos + 1, length)));
+            pos += 1 + length;
+        }
+
+        *name = labels.join('.');
+        return true;
+    }
+
+    bool readRecordData(const QByteArray &data, int offset, quint16 type, quint16 length, QString *value)
+    {
+        switch (type)
+        {
+        case DnsClient::A:
+            if (length != 4)
+            {
+                return false;
+            }
+
+            *value = QHostAddress(readUInt32(data, offset)).toString();
+            return true;
+
+        case DnsClient::AAAA:
+        {
+            if (length != 16)
+            {
+                return false;
+            }
+
+            Q_IPV6ADDR address;
+            memcpy(&address, data.constData() + offset, 16);
+            *value = QHostAddress(address).toString();
+            return true;
+        }
+
+        case DnsClient::NS:
+        case DnsClient::CNAME:
+        case DnsClient::PTR:
+            return readName(data, &offset, value);
+
+        case DnsClient::MX:
+        {
+            if (length < 3)
+            {
+                return false;
+            }
+
+            quint16 preference = readUInt16(data, offset);
+            offset += 2;
+
+            QString exchange;
+
+            if (!readName(data, &offset, &exchange))
+            {
+                return false;
+            }
+
+            *value = QString("%1 %2").arg(preference).arg(exchange);
+            return true;
+        }
+
+        case DnsClient::SOA:
+        {
+            QString mname, rname;
+
+            if (!readName(data, &offset, &mname) || !readName(data, &offset, &rname) || offset + 4 > data.size())
+            {
+                return false;
+            }
+
+            *value = QString("%1 %2 %3").arg(mname).arg(rname).arg(readUInt32(data, offset));
+            return true;
+        }
+
+        case DnsClient::TXT:
+        {
+            QByteArray text;
+            int end = offset + length;
+
+            while (offset < end)
+            {
+                quint8 size = data.at(offset);
+
+                if (offset + 1 + size > end)
+                {
+                    return false;
+                }
+
+                text.append(data.mid(offset + 1, size));
+                offset += 1 + size;
+            }
+
+            *value = QString::fromUtf8(text);
+            return true;
+        }
+
+        default:
+            *value = QString::fromLatin1(data.mid(offset, length).toHex());
+            return true;
+        }
+    }
+
+    bool isSameAddress(const QHostAddress &first, const QHostAddress &second)
+    {
+        // Dual stack sockets report v4 senders as mapped v6 addresses
+        bool firstV4 = false, secondV4 = false;
+        quint32 firstAddress = first.toIPv4Address(&firstV4);
+        quint32 secondAddress = second.toIPv4Address(&secondV4);
+
+        if (firstV4 && secondV4)
+        {
+            return firstAddress == secondAddress;
+        }
+
+        return first == second;
+    }
+
+    // Resolvers may randomize the case of the name (0x20 encoding)
+    bool isSameQuestion(const DnsClient::Query &query, const QString &name, quint16 type)
+    {
+        QString expected = QString::fromLatin1(QUrl::toAce(query.name));
+
+        if (expected.endsWith('.'))
+        {
+            expected.chop(1);
+        }
+
+        return type == query.type && name.compare(expected, Qt::CaseInsensitive) == 0;
+    }
+}
+
+DnsClient::Query::Query()
+: type(DnsClient::A)
+, port(53)
+, sendTime(0)
+, receiveTime(0)
+, sendMonotonic(0)
+, receiveMonotonic(0)
+, attempts(0)
+, rcode(-1)
+, truncated(false)
+, tcp(false)
+, finished(false)
+{
+}
+
+qint64 DnsClient::Query::latency() const
+{
+    if (rcode == -1 || receiveMonotonic == 0)
+    {
+        return -1;
+    }
+
+    // Clock::now() steps with the ntp correction, the latency must not
+    return receiveMonotonic - sendMonotonic;
+}
+
+qint64 DnsClient::Query::minimumTtl() const
+{
+    qint64 ttl = -1;
+
+    foreach (const Answer &answer, answers)
+    {
+        if (ttl == -1 || answer.ttl < ttl)
+        {
+            ttl = answer.ttl;
+        }
+    }
+
+    return ttl;
+}
+
+class DnsClient::Private : public QObject
+{
+    Q_OBJECT
+
+public:
+    Private(DnsClient *q)
+    : q(q)
+    , timeout(2000)
+    , retries(2)
+    , tcpFallback(true)
+    , running(false)
+    , outstanding(0)
+    {
+        timer.setSingleShot(true);
+
+        connect(&socket, SIGNAL(readyRead()), this, SLOT(readDatagrams()));
+        connect(&timer, SIGNAL(timeout()), this, SLOT(checkTimeouts()));
+    }
+
+    DnsClient *q;
+
+    QUdpSocket socket;
+    QTimer timer;
+
+    QList<DnsClient::Query> queries;
+    QList<QList<quint16> > ids; // one per attempt, the last is current
+    QList<qint64> deadlines; // monotonic ns, 0 while idle
+
+    // All ids of unfinished queries, late answers to earlier attempts count
+    QHash<quint16, int> pending;
+
+    struct SendTime
+    {
+        qint64 time;
+        qint64 monotonic;
+    };
+
+    QHash<quint16, SendTime> sendTimes;
+    QHash<int, QTcpSocket *> tcpSockets;
+    QHash<QTcpSocket *, QByteArray> tcpBuffers;
+
+    int timeout;
+    int retries;
+    bool tcpFallback;
+    bool running;
+    int outstanding;
+    QString errorString;
+
+    // Functions
+    quint16 newId(int index);
+    void enqueue(int index);
+    void send(int index);
+    void sendTcp(int index);
+    void closeTcp(int index);
+    void finish(int index, const QString &errorString = QString());
+    void scheduleTimer();
+
+public slots:
+    void readDatagrams();
+    void checkTimeouts();
+    void tcpConnected();
+    void tcpReadyRead();
+    void tcpError();
+};
+
+quint16 DnsClient::Private::newId(int index)
+{
+    quint16 id;
+
+    do
+    {
+        id = qrand() & 0xffff;
+    }
+    while (pending.contains(id));
+
+    ids[index].append(id);
+    pending.insert(id, index);
+    return id;
+}
+
+void DnsClient::Private::enqueue(int index)
+{
+    ids[index].clear();
+    ++outstanding;
+}
+
+void DnsClient::Private::send(int index)
+{
+    DnsClient::Query &query = queries[index];
+    quint16 id = newId(index);
+    QByteArray packet = DnsClient::encodeQuery(id, query.name, query.type);
+
+    if (packet.isEmpty())
+    {
+        finish(index, QString("Invalid name: %1").arg(query.name));
+        return;
+    }
+
+    // Every attempt has its own id, so an answer is timed against the
+    // attempt it belongs to
+    ++query.attempts;
+    query.sendTime = Clock::now();
+    query.sendMonotonic = Clock::monotonic();
+
+    SendTime sent = { query.sendTime, query.sendMonotonic };
+    sendTimes.insert(id, sent);
+    deadlines[index] = query.sendMonotonic + timeout * Q_INT64_C(1000000);
+
+    if (socket.writeDatagram(packet, query.server, query.port) == -1)
+    {
+        finish(index, socket.errorString());
+    }
+}
+
+void DnsClient::Private::sendTcp(int index)
+{
+    DnsClient::Query &query = queries[index];
+
+    QTcpSocket *tcp = new QTcpSocket(this);
+    tcp->setProperty("index", index);
+    tcpSockets.insert(index, tcp);
+
+    connect(tcp, SIGNAL(connected()), this, SLOT(tcpConnected()));
+    connect(tcp, SIGNAL(readyRead()), this, SLOT(tcpReadyRead()));
+    connect(tcp, SIGNAL(error(QAbstractSocket::SocketError)), this, SLOT(tcpError()));
+
+    // The timing covers the connection setup as well
+    query.tcp = true;
+    query.sendTime = Clock::now();
+    query.sendMonotonic = Clock::monotonic();
+    deadlines[index] = query.sendMonotonic + timeout * Q_INT64_C(1000000);
+
+    tcp->connectToHost(query.server, query.port);
+    scheduleTimer();
+}
+
+void DnsClient::Private::closeTcp(int index)
+{
+    QTcpSocket *tcp = tcpSockets.take(index);
+
+    if (!tcp)
+    {
+        return;
+    }
+
+    tcpBuffers.remove(tcp);
+    tcp->disconnect(this);
+    tcp->abort();
+    tcp->deleteLater();
+}
+
+void DnsClient::Private::finish(int index, const QString &errorString)
+{
+    DnsClient::Query &query = queries[index];
+
+    if (query.finished)
+    {
+        return;
+    }
+
+    closeTcp(index);
+
+    foreach (quint16 id, ids.at(index))
+    {
+        pending.remove(id);
+        sendTimes.remove(id);
+    }
+
+    deadlines[index] = 0;
+
+    query.finished = true;
+    query.errorString = errorString;
+
+    --outstanding;
+    emit q->queryFinished(index);
+
+    if (outstanding == 0 && running)
+    {
+        running = false;
+        timer.stop();
+        socket.close();
+
+        emit q->finished();
+    }
+}
+
+void DnsClient::Private::scheduleTimer()
+{
+    qint64 next = 0;
+
+    foreach (qint64 deadline, deadlines)
+    {
+        if (deadline != 0 && (next == 0 || deadline < next))
+        {
+            next = deadline;
+        }
+    }
+
+    if (next == 0)
+    {
+        timer.stop();
+        return;
+    }
+
+    timer.start((int)qMax<qint64>(0, (next - Clock::monotonic()) / 1000000 + 1));
+}
+
+void DnsClient::Private::readDatagrams()
+{
+    // finish() closes the socket once the last query is answered
+    while (running && socket.hasPendingDatagrams())
+    {
+        QByteArray data;
+        data.resize(socket.pendingDatagramSize());
+
+        QHostAddress sender;
+        quint16 senderPort;
+        socket.readDatagram(data.data(), data.size(), &sender, &senderPort);
+
+        qint64 receiveTime = Clock::now();
+        qint64 receiveMonotonic = Clock::monotonic();
+
+        quint16 id;
+        int rcode;
+        bool truncated;
+        QList<DnsClient::Answer> answers;
+        QString questionName;
+        quint16 questionType = 0;
+
+        if (!DnsClient::decodeResponse(data, &id, &rcode, &truncated, &answers, &questionName, &questionType))
+        {
+            LOG_DEBUG(QString("Ignoring invalid response from %1").arg(sender.toString()));
+            continue;
+        }
+
+        int index = pending.value(id, -1);
+
+        if (index == -1 || tcpSockets.contains(index))
+        {
+            continue;
+        }
+
+        DnsClient::Query &query = queries[index];
+
+        if (!isSameAddress(sender, query.server) || senderPort != query.port)
+        {
+            LOG_DEBUG(QString("Ignoring response from unexpected server %1").arg(sender.toString()));
+            continue;
+        }
+
+        if (!isSameQuestion(query, questionName, questionType))
+        {
+            LOG_DEBUG(QString("Ignoring response for %1 from %2").arg(questionName).arg(sender.toString()));
+            continue;
+        }
+
+        if (sendTimes.contains(id))
+        {
+            const SendTime &sent = sendTimes[id];
+            query.sendTime = sent.time;
+            query.sendMonotonic = sent.monotonic;
+        }
+
+        query.receiveTime = receiveTime;
+        query.receiveMonotonic = receiveMonotonic;
+        query.rcode = rcode;
+        query.truncated = truncated;
+        query.answers = answers;
+
+        if (truncated && tcpFallback)
+        {
+            sendTcp(index);
+        }
+        else
+        {
+            finish(index);
+        }
+    }
+}
+
+void DnsClient::Private::checkTimeouts()
+{
+    qint64 now = Clock::monotonic();
+
+    for (int i = 0; i < queries.size(); ++i)
+    {
+        if (deadlines.at(i) == 0 || deadlines.at(i) > now)
+        {
+            continue;
+        }
+
+        if (tcpSockets.contains(i))
+        {
+            finish(i, "Timeout over tcp");
+        }
+        else if (queries.at(i).attempts <= retries)
+        {
+            send(i);
+        }
+        else
+        {
+            finish(i, "Timeout");
+        }
+    }
+
+    scheduleTimer();
+}
+
+void DnsClient::Private::tcpConnected()
+{
+    QTcpSocket *tcp = qobject_cast<QTcpSocket *>(sender());
+    int index = tcp->property("index").toInt();
+    const DnsClient::Query &query = queries.at(index);
+
+    QByteArray packet = DnsClient::encodeQuery(ids.at(index).last(), query.name, query.type);
+
+    // Messages over tcp are prefixed by their length
+    QByteArray frame;
+    frame.append((char)(packet.size() >> 8));
+    frame.append((char)(packet.size() & 0xff));
+    frame.append(packet);
+
+    tcp->write(frame);
+}
+
+void DnsClient::Private::tcpReadyRead()
+{
+    QTcpSocket *tcp = qobject_cast<QTcpSocket *>(sender());
+    int index = tcp->property("index").toInt();
+
+    QByteArray &buffer = tcpBuffers[tcp];
+    buffer.append(tcp->readAll());
+
+    if (buffer.size() < 2 || buffer.size() < 2 + readUInt16(buffer, 0))
+    {
+        return;
+    }
+
+    QByteArray data = buffer.mid(2, readUInt16(buffer, 0));
+    DnsClient::Query &query = queries[index];
+
+    quint16 id;
+    int rcode;
+    bool truncated;
+    QList<DnsClient::Answer> answers;
+    QString questionName;
+    quint16 questionType = 0;
+
+    if (!DnsClient::decodeResponse(data, &id, &rcode, &truncated, &answers, &questionName, &questionType) ||
+        id != ids.at(index).last() || !isSameQuestion(query, questionName, questionType))
+    {
+        finish(index, "Invalid response over tcp");
+        return;
+    }
+
+    query.receiveTime = Clock::now();
+    query.receiveMonotonic = Clock::monotonic();
+    query.rcode = rcode;
+    query.truncated = truncated;
+    query.answers = answers;
+
+    finish(index);
+}
+
+void DnsClient::Private::tcpError()
+{
+    QTcpSocket *tcp = qobject_cast<QTcpSocket *>(sender());
+    finish(tcp->property("index").toInt(), tcp->errorString());
+}
+
+DnsClient::DnsClient(QObject *parent)
+: QObject(parent)
+, d(new Private(this))
+{
+}
+
+DnsClient::~DnsClient()
+{
+    delete d;
+}
+
+void DnsClient::setTimeout(int timeout)
+{
+    d->timeout = timeout;
+}
+
+int DnsClient::timeout() const
+{
+    return d->timeout;
+}
+
+void DnsClient::setRetries(int retries)
+{
+    d->retries = retries;
+}
+
+int DnsClient::retries() const
+{
+    return d->retries;
+}
+
+void DnsClient::setTcpFallback(bool enabled)
+{
+    d->tcpFallback = enabled;
+}
+
+bool DnsClient::tcpFallback() const
+{
+    return d->tcpFallback;
+}
+
+int DnsClient::addQuery(const QString &name, quint16 type, const QHostAddress &server, quint16 port)
+{
+    Query query;
+    query.name = name;
+    query.type = type;
+    query.server = server;
+    query.port = port;
+
+    int index = d->queries.size();
+    d->queries.append(query);
+    d->ids.append(QList<quint16>());
+    d->deadlines.append(0);
+
+    if (d->running)
+    {
+        d->enqueue(index);
+        d->send(index);
+        d->scheduleTimer();
+    }
+
+    return index;
+}
+
+void DnsClient::clear()
+{
+    abort();
+
+    d->queries.clear();
+    d->ids.clear();
+    d->deadlines.clear();
+}
+
+bool DnsClient::start()
+{
+    if (d->running)
+    {
+        d->errorString = "Already running";
+        return false;
+    }
+
+    QList<int> indexes;
+
+    for (int i = 0; i < d->queries.size(); ++i)
+    {
+        if (!d->queries.at(i).finished)
+        {
+            indexes.append(i);
+        }
+    }
+
+    if (indexes.isEmpty())
+    {
+        d->errorString = "No queries to send";
+        return false;
+    }
+
+    // Dual stack, the same socket reaches v4 and v6 servers
+    if (d->socket.state() != QAbstractSocket::BoundState && !d->socket.bind(QHostAddress::Any, 0))
+    {
+        d->errorString = d->socket.errorString();
+        return false;
+    }
+
+    d->running = true;
+
+    // All queries are registered before the first is sent so that an
+    // early failure does not finish the whole run
+    foreach (int index, indexes)
+    {
+        d->enqueue(index);
+    }
+
+    foreach (int index, indexes)
+    {
+        if (!d->queries.at(index).finished)
+        {
+            d->send(index);
+        }
+    }
+
+    d->scheduleTimer();
+    return true;
+}
+
+void DnsClient::abort()
+{
+    for (int i = 0; i < d->queries.size(); ++i)
+    {
+        Query &query = d->queries[i];
+
+        if (d->deadlines.at(i) == 0 && !d->tcpSockets.contains(i))
+        {
+            continue;
+        }
+
+        d->closeTcp(i);
+        d->deadlines[i] = 0;
+
+        query.finished = true;
+        query.errorString = "Aborted";
+    }
+
+    d->pending.clear();
+    d->sendTimes.clear();
+    d->outstanding = 0;
+    d->running = false;
+    d->timer.stop();
+    d->socket.close();
+}
+
+bool DnsClient::isRunning() const
+{
+    return d->running;
+}
+
+QString DnsClient::errorString() const
+{
+    return d->errorString;
+}
+
+QList<DnsClient::Query> DnsClient::queries() const
+{
+    return d->queries;
+}
+
+DnsClient::Query DnsClient::query(int index) const
+{
+    return d->queries.value(index);
+}
+
+QString DnsClient::typeToString(quint16 type)
+{
+    for (size_t i = 0; i < sizeof(recordTypes) / sizeof(recordTypes[0]); ++i)
+    {
+        if (recordTypes[i].type == type)
+        {
+            return recordTypes[i].name;
+        }
+    }
+
+    return QString("TYPE%1").arg(type);
+}
+
+quint16 DnsClient::typeFromString(const QString &type)
+{
+    for (size_t i = 0; i < sizeof(recordTypes) / sizeof(recordTypes[0]); ++i)
+    {
+        if (type.compare(recordTypes[i].name, Qt::CaseInsensitive) == 0)
+        {
+            return recordTypes[i].type;
+        }
+    }
+
+    return 0;
+}
+
+QString DnsClient::rcodeToString(int rcode)
+{
+    switch (rcode)
+    {
+    case -1:
+        return QString();
+
+    case 0:
+        return "NoError";
+
+    case 1:
+        return "FormErr";
+
+    case 2:
+        return "ServFail";
+
+    case 3:
+        return "NXDomain";
+
+    case 4:
+        return "NotImp";
+
+    case 5:
+        return "Refused";
+
+    default:
+        return QString("RCode%1").arg(rcode);
+    }
+}
+
+QList<QHostAddress> DnsClient::systemNameservers()
+{
+    QList<QHostAddress> servers;
+
+#if defined(Q_OS_ANDROID)
+    const char *properties[] = { "net.dns1", "net.dns2" };
+
+    for (int i = 0; i < 2; ++i)
+    {
+        char value[PROP_VALUE_MAX];
+
+        if (__system_property_get(properties[i], value) > 0)
+        {
+            QHostAddress address(QString::fromLatin1(value));
+
+            if (!address.isNull())
+            {
+                servers.append(address);
+            }
+        }
+    }
+#elif defined(Q_OS_WIN)
+    ULONG size = 0;
+    ::GetNetworkParams(NULL, &size);
+
+    QByteArray buffer(size, 0);
+    FIXED_INFO *info = (FIXED_INFO *)buffer.data();
+
+    if (::GetNetworkParams(info, &size) == NO_ERROR)
+    {
+        for (IP_ADDR_STRING *server = &info->DnsServerList; server; server = server->Next)
+        {
+            QHostAddress address(QString::fromLatin1(server->IpAddress.String));
+
+            if (!address.isNull())
+            {
+                servers.append(address);
+            }
+        }
+    }
+#else
+    QFile file("/etc/resolv.conf");
+
+    if (file.open(QIODevice::ReadOnly))
+    {
+        QTextStream stream(&file);
+        QString line = stream.readLine();
+
+        while (!line.isNull())
+        {
+            QStringList parts = line.simplified().split(' ');
+
+            if (parts.size() >= 2 && parts.at(0) == "nameserver")
+            {
+                // Scoped v6 addresses carry the interface after a '%'
+                QHostAddress address(parts.at(1));
+
+                if (!address.isNull())
+                {
+                    servers.append(address);
+                }
+            }
+
+            line = stream.readLine();
+        }
+    }
+#endif
+
+    return servers;
+}
+
+QByteArray DnsClient::encodeQuery(quint16 id, const QString &name, quint16 type)
+{
+    QByteArray ace = QUrl::toAce(name);
+
+    if (ace.isEmpty() && !name.isEmpty())
+    {
+        return QByteArray();
+    }
+
+    QByteArray packet;
+    packet.reserve(headerSize + ace.size() + 6);
+
+    QDataStream out(&packet, QIODevice::WriteOnly);
+    out << id << recursionDesiredFlag << (quint16)1 << (quint16)0 << (quint16)0 << (quint16)0;
+
+    foreach (const QByteArray &label, ace.split('.'))
+    {
+        if (label.isEmpty())
+        {
+            continue;
+        }
+
+        if (label.size() > 63)
+        {
+            return QByteArray();
+        }
+
+        out << (quint8)label.size();
+        out.writeRawData(label.constData(), label.size());
+    }
+
+    out << (quint8)0 << type << classInternet;
+
+    return packet;
+}
+
+bool DnsClient::decodeResponse(const QByteArray &data, quint16 *id, int *rcode, bool *truncated,
+                               QList<Answer> *answers, QString *questionName, quint16 *questionType)
+{
+    if (data.size() < headerSize)
+    {
+        return false;
+    }
+
+    quint16 flags = readUInt16(data, 2);
+
+    if (!(flags & responseFlag))
+    {
+        return false;
+    }
+
+    *id = readUInt16(data, 0);
+    *rcode = flags & 0x0f;
+    *truncated = flags & truncatedFlag;
+    answers->clear();
+
+    quint16 questionCount = readUInt16(data, 4);
+    quint16 answerCount = readUInt16(data, 6);
+    int offset = headerSize;
+
+    for (int i = 0; i < questionCount; ++i)
+    {
+        QString name;
+
+        if (!readName(data, &offset, &name) || offset + 4 > data.size())
+        {
+            return *truncated;
+        }
+
+        if (i == 0 && questionName)
+        {
+            *questionName = name;
+        }
+
+        if (i == 0 && questionType)
+        {
+            *questionType = readUInt16(data, offset);
+        }
+
+        offset += 4;
+    }
+
+    for (int i = 0; i < answerCount; ++i)
+    {
+        Answer answer;
+
+        if (!readName(data, &offset, &answer.name) || offset + 10 > data.size())
+        {
+            // Truncated responses may end in the middle of a record
+            return *truncated;
+        }
+
+        answer.type = readUInt16(data, offset);
+        answer.ttl = readUInt32(data, offset + 4);
+        quint16 length = readUInt16(data, offset + 8);
+        offset += 10;
+
+        if (offset + length > data.size() || !readRecordData(data, offset, answer.type, length, &answer.value))
+        {
+            return *truncated;
+        }
+
+        offset += length;
+        answers->append(answer);
+    }
+
+    return true;
+}
+
+#include "dnsclient.moc"
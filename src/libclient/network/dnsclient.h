@@ -0,0 +1,116 @@
+#ifndef DNSCLIENT_H
+#define DNSCLIENT_H
+
+#include "../export.h"
+
+#include <QObject>
+#include <QHostAddress>
+#include <QStringList>
+
+// Asynchronous stub resolver for measurements. All queries are sent in
+// parallel from one udp socket, truncated answers are repeated over tcp.
+// Every query records its timing, the response code and the answers.
+class CLIENT_API DnsClient : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum RecordType
+    {
+        A = 1,
+        NS = 2,
+        CNAME = 5,
+        SOA = 6,
+        PTR = 12,
+        MX = 15,
+        TXT = 16,
+        AAAA = 28,
+        ANY = 255
+    };
+
+    struct Answer
+    {
+        QString name;
+        quint16 type;
+        quint32 ttl;
+        QString value;
+    };
+
+    struct Query
+    {
+        Query();
+
+        QString name;
+        quint16 type;
+        QHostAddress server;
+        quint16 port;
+
+        // Corrected time in ns since epoch of the attempt that was answered
+        // (of the last attempt while there is no answer), 0 if unset
+        qint64 sendTime;
+        qint64 receiveTime;
+
+        // Monotonic ns of the same events, the latency is based on these
+        qint64 sendMonotonic;
+        qint64 receiveMonotonic;
+
+        int attempts;
+        int rcode; // -1 without a response
+        bool truncated;
+        bool tcp;
+        bool finished;
+        QList<Answer> answers;
+        QString errorString;
+
+        // In ns, -1 without a response
+        qint64 latency() const;
+
+        // Lowest ttl of the answers, -1 without answers
+        qint64 minimumTtl() const;
+    };
+
+    explicit DnsClient(QObject *parent = 0);
+    ~DnsClient();
+
+    // Time in ms until a query is repeated or given up
+    void setTimeout(int timeout);
+    int timeout() const;
+
+    void setRetries(int retries);
+    int retries() const;
+
+    void setTcpFallback(bool enabled);
+    bool tcpFallback() const;
+
+    // Returns the index of the query, queries added while running are sent at once
+    int addQuery(const QString &name, quint16 type, const QHostAddress &server, quint16 port = 53);
+    void clear();
+
+    bool start();
+    void abort();
+    bool isRunning() const;
+    QString errorString() const;
+
+    QList<Query> queries() const;
+    Query query(int index) const;
+
+    static QString typeToString(quint16 type);
+    static quint16 typeFromString(const QString &type); // 0 if unknown
+    static QString rcodeToString(int rcode);
+    static QList<QHostAddress> systemNameservers();
+
+    // Wire format (RFC 1035), the question of a response is optionally returned
+    static QByteArray encodeQuery(quint16 id, const QString &name, quint16 type);
+    static bool decodeResponse(const QByteArray &data, quint16 *id, int *rcode, bool *truncated,
+                               QList<Answer> *answers, QString *questionName = 0, quint16 *questionType = 0);
+
+signals:
+    void queryFinished(int index);
+    void finished();
+
+protected:
+    class Private;
+    Private *d;
+};
+
+#endif // DNSCLIENT_H
@@ -0,0 +1,315 @@
+#include "keepaliveservice.h"
+#include "../connectiontester.h"
+#include "../log/logger.h"
+
+#include <QUdpSocket>
+#include <QPointer>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+LOGGER(KeepaliveService);
+
+namespace
+{
+    const int defaultMinimumInterval = 10000;
+    const int defaultMaximumInterval = 30 * 60 * 1000;
+
+    // Grow by a quarter while the binding holds, back off to three
+    // quarters of an interval which lost it
+    const qreal growFactor = 1.25;
+    const qreal backoffFactor = 0.75;
+}
+
+class KeepaliveService::Private : public QObject
+{
+    Q_OBJECT
+
+public:
+    Private(KeepaliveService *q)
+    : q(q)
+    , serverPort(0)
+    , interval(0)
+    , minimumInterval(defaultMinimumInterval)
+    , maximumInterval(defaultMaximumInterval)
+    , bindingTimeout(0)
+    , mappedPort(0)
+    , sentInterval(0)
+    , running(false)
+    {
+        timer.setSingleShot(true);
+        timer.setTimerType(Qt::VeryCoarseTimer);
+
+        connect(&timer, SIGNAL(timeout()), q, SLOT(sendKeepalive()));
+    }
+
+    KeepaliveService *q;
+
+    // Properties
+    QPointer<QUdpSocket> socket;
+    QHostAddress serverAddress;
+    quint16 serverPort;
+    QString sessionId;
+
+    int interval;
+    int minimumInterval;
+    int maximumInterval;
+    int bindingTimeout;
+
+    quint16 mappedPort; // source port the server saw last time
+    int sentInterval; // time between the last two keepalives
+    QElapsedTimer lastSent;
+    bool running;
+
+    QByteArray packet;
+    QTimer timer;
+
+    // Functions
+    void buildPacket();
+    void setInterval(int value);
+    void adapt(quint16 port);
+};
+
+void KeepaliveService::Private::buildPacket()
+{
+    QStringList srcIp;
+    srcIp.append(ConnectionTester().localIpAddress());
+
+    QVariantMap map;
+    map.insert("type", "keepalive");
+    map.insert("session_id", sessionId);
+    map.insert("src_ip", srcIp);
+    map.insert("src_port", socket ? socket->localPort() : 0);
+
+    packet = QJsonDocument::fromVariant(map).toJson(QJsonDocument::Compact);
+
+    LOG_DEBUG(QString("Keepalive packet rebuilt (%1 bytes)").arg(packet.size()));
+}
+
+void KeepaliveService::Private::setInterval(int value)
+{
+    value = qBound(minimumInterval, value, maximumInterval);
+
+    if (bindingTimeout > 0)
+    {
+        value = qMin(value, (int)(bindingTimeout * backoffFactor));
+    }
+
+    if (value == interval)
+    {
+        return;
+    }
+
+    interval = value;
+    LOG_DEBUG(QString("Keepalive interval set to %1 sec.").arg(interval / 1000));
+
+    emit q->intervalChanged(interval);
+}
+
+void KeepaliveService::Private::adapt(quint16 port)
+{
+    if (mappedPort != 0 && port != mappedPort)
+    {
+        // the NAT dropped the binding while we were waiting
+        int waited = sentInterval > 0 ? sentInterval : interval;
+
+        if (bindingTimeout == 0 || waited < bindingTimeout)
+        {
+            bindingTimeout = waited;
+        }
+
+        LOG_INFO(QString("NAT binding expired after less than %1 sec.").arg(bindingTimeout / 1000));
+        setInterval((int)(waited * backoffFactor));
+    }
+    else if (mappedPort != 0)
+    {
+        setInterval((int)(interval * growFactor));
+    }
+
+    mappedPort = port;
+}
+
+KeepaliveService::KeepaliveService(QObject *parent)
+: QObject(parent)
+, d(new Private(this))
+{
+}
+
+KeepaliveService::~KeepaliveService()
+{
+    delete d;
+}
+
+void KeepaliveService::setSocket(QUdpSocket *socket)
+{
+    d->socket = socket;
+    d->mappedPort = 0;
+    d->lastSent.invalidate();
+    d->packet.clear();
+}
+
+QUdpSocket *KeepaliveService::socket() const
+{
+    return d->socket;
+}
+
+void KeepaliveService::setServer(const QHostAddress &address, quint16 port)
+{
+    if (d->serverAddress == address && d->serverPort == port)
+    {
+        return;
+    }
+
+    // a different server means a different binding
+    d->serverAddress = address;
+    d->serverPort = port;
+    d->mappedPort = 0;
+    d->bindingTimeout = 0;
+}
+
+QHostAddress KeepaliveService::serverAddress() const
+{
+    return d->serverAddress;
+}
+
+quint16 KeepaliveService::serverPort() const
+{
+    return d->serverPort;
+}
+
+void KeepaliveService::setSessionId(const QString &sessionId)
+{
+    if (d->sessionId != sessionId)
+    {
+        d->sessionId = sessionId;
+        d->packet.clear();
+    }
+}
+
+QString KeepaliveService::sessionId() const
+{
+    return d->sessionId;
+}
+
+void KeepaliveService::setInterval(int interval)
+{
+    d->setInterval(interval);
+}
+
+int KeepaliveService::interval() const
+{
+    return d->interval;
+}
+
+void KeepaliveService::setIntervalRange(int minimum, int maximum)
+{
+    d->minimumInterval = minimum;
+    d->maximumInterval = qMax(minimum, maximum);
+    d->setInterval(d->interval);
+}
+
+int KeepaliveService::bindingTimeout() const
+{
+    return d->bindingTimeout;
+}
+
+void KeepaliveService::start()
+{
+    if (d->interval <= 0)
+    {
+        LOG_ERROR("Keepalive interval not set");
+        return;
+    }
+
+    d->running = true;
+    d->timer.start(d->interval);
+}
+
+void KeepaliveService::stop()
+{
+    d->running = false;
+    d->timer.stop();
+}
+
+bool KeepaliveService::isRunning() const
+{
+    return d->running;
+}
+
+QByteArray KeepaliveService::packet() const
+{
+    return d->packet;
+}
+
+bool KeepaliveService::processReply(const QByteArray &datagram, const QHostAddress &host, quint16 port)
+{
+    if (host != d->serverAddress || port != d->serverPort)
+    {
+        return false;
+    }
+
+    QJsonObject root = QJsonDocument::fromJson(datagram).object();
+
+    if (root.value("type").toString() != "keepalive")
+    {
+        return false;
+    }
+
+    // servers which do not reflect the port leave the interval alone
+    quint16 mappedPort = root.value("src_port").toInt();
+
+    if (mappedPort != 0)
+    {
+        d->adapt(mappedPort);
+    }
+
+    return true;
+}
+
+void KeepaliveService::sendKeepalive()
+{
+    // one wakeup per keepalive, picking up interval changes
+    if (d->running)
+    {
+        d->timer.start(d->interval);
+    }
+
+    if (d->socket.isNull() || d->serverAddress.isNull())
+    {
+        LOG_WARNING("Invalid keepalive address (normal at first app start)");
+        return;
+    }
+
+    if (d->sessionId.isEmpty())
+    {
+        LOG_WARNING("Empty session id");
+        return;
+    }
+
+    if (d->packet.isEmpty())
+    {
+        d->buildPacket();
+    }
+
+    d->sentInterval = d->lastSent.isValid() ? d->lastSent.restart() : d->interval;
+
+    if (!d->lastSent.isValid())
+    {
+        d->lastSent.start();
+    }
+
+    d->socket->writeDatagram(d->packet, d->serverAddress, d->serverPort);
+
+    LOG_DEBUG("Alive packet sent");
+}
+
+void KeepaliveService::invalidatePacket()
+{
+    // a new interface most likely also means a new NAT
+    d->packet.clear();
+    d->mappedPort = 0;
+    d->lastSent.invalidate();
+}
+
+#include "keepaliveservice.moc"
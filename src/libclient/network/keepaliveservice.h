@@ -0,0 +1,63 @@
+#ifndef KEEPALIVESERVICE_H
+#define KEEPALIVESERVICE_H
+
+#include "../export.h"
+
+#include <QObject>
+#include <QHostAddress>
+
+class QUdpSocket;
+
+// Keeps the NAT binding of the peer socket open by sending keepalives to
+// the alive server. The packet is built once and only rebuilt when the
+// session or the local interfaces change. If the server reflects the
+// source port it saw, the interval grows until the binding changes and
+// then settles just below the measured binding timeout.
+class CLIENT_API KeepaliveService : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit KeepaliveService(QObject *parent = 0);
+    ~KeepaliveService();
+
+    void setSocket(QUdpSocket *socket);
+    QUdpSocket *socket() const;
+
+    void setServer(const QHostAddress &address, quint16 port);
+    QHostAddress serverAddress() const;
+    quint16 serverPort() const;
+
+    void setSessionId(const QString &sessionId);
+    QString sessionId() const;
+
+    // Starting interval and the bounds for the adaption in ms
+    void setInterval(int interval);
+    int interval() const;
+    void setIntervalRange(int minimum, int maximum);
+
+    // The binding timeout found by probing in ms, 0 if unknown
+    int bindingTimeout() const;
+
+    void start();
+    void stop();
+    bool isRunning() const;
+
+    QByteArray packet() const;
+
+    // Returns true if the datagram was a reply of the alive server
+    bool processReply(const QByteArray &datagram, const QHostAddress &host, quint16 port);
+
+public slots:
+    void sendKeepalive();
+    void invalidatePacket();
+
+signals:
+    void intervalChanged(int interval);
+
+protected:
+    class Private;
+    Private *d;
+};
+
+#endif // KEEPALIVESERVICE_H
@@ -6,12 +6,15 @@
 #include "../settings.h"
 #include "../timing/immediatetiming.h"
 #include "../timing/periodictiming.h"
-#include "../connectiontester.h"
+#include "../timing/clock.h"
 
 #include "tcpsocket.h"
 #include "udpsocket.h"
+#include "peerconnection.h"
+#include "keepaliveservice.h"
+#include "networkstate.h"
+#include "peerrequest.h"
 
-#include <QDataStream>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QPointer>
@@ -20,60 +23,36 @@
 #include <QUdpSocket>
 #include <QStringList>
 #include <QHash>
+#include <QCache>
 #include <QMutex>
+#include <QMutexLocker>
 #include <QReadWriteLock>
-#include <QTimer>
 #include <QDebug>
 #include <QDnsLookup>
 #include <QNetworkConfiguration>
 #include <QNetworkConfigurationManager>
 #include <QNetworkInterface>
-#if defined(Q_OS_ANDROID)
-#include <QAndroidJniObject>
-#endif
 
 LOGGER(NetworkManager);
 
-class PeerRequest
+namespace
 {
-public:
-    QVariant toVariant()
-    {
-        QVariantMap map;
-        map.insert("type", "peer_request");
-        map.insert("measurementDefinition", measurementDefinition);
-        map.insert("taskId", taskId.toInt());
-        map.insert("measurementUuid", measurementUuid);
-        map.insert("measurement", measurement);
-        map.insert("peer", peer);
-        map.insert("port", port);
-        map.insert("protocol", protocol);
-        return map;
-    }
+    // Offers we answered are remembered this long to drop retransmissions
+    const qint64 handledUuidTtl = Q_INT64_C(600) * 1000000000;
+    const int handledUuidLimit = 1024;
 
-    static PeerRequest fromVariant(const QVariant &variant)
+    // Peers which announced binary offers
+    const int binaryPeerLimit = 256;
+
+    QString peerKey(const QHostAddress &address)
     {
-        QVariantMap map = variant.toMap();
+        // Dual stack sockets report v4 senders as mapped v6 addresses
+        bool isV4 = false;
+        quint32 ipv4 = address.toIPv4Address(&isV4);
 
-        PeerRequest request;
-        request.measurementDefinition = map.value("measurementDefinition");
-        request.taskId = TaskId(map.value("taskId").toInt());
-        request.measurementUuid = map.value("measurementUuid").toUuid();
-        request.measurement = map.value("measurement").toString();
-        request.peer = map.value("peer").toString();
-        request.port = map.value("port").toUInt();
-        request.protocol = (NetworkManager::SocketType)map.value("protocol").toInt();
-        return request;
-    }
-
-    QVariant measurementDefinition;
-    TaskId taskId;
-    QUuid measurementUuid;
-    QString measurement;
-    QString peer;
-    quint16 port;
-    NetworkManager::SocketType protocol;
-};
+        return isV4 ? QHostAddress(ipv4).toString() : address.toString();
+    }
+}
 
 class NetworkManager::Private : public QObject
 {
@@ -82,13 +61,16 @@ class NetworkManager::Private : public QObject
 public:
     Private(NetworkManager *q)
     : q(q)
-#if defined(Q_OS_ANDROID)
-    , networkInfo("de/hsaugsburg/informatik/mplane/NetInfo")
-#endif
+    , handledMeasureUuids(handledUuidLimit)
+    , binaryPeers(binaryPeerLimit)
     {
-        connect(&timer, SIGNAL(timeout()), this, SLOT(timeout()));
         connect(&keepaliveAddressLookup, SIGNAL(finished()), this, SLOT(lookupFinished()));
 
+        // new interfaces change the local address in the keepalive packet
+        connect(&networkState, SIGNAL(changed()), &keepalive, SLOT(invalidatePacket()));
+        connect(&networkState, SIGNAL(interfacesUpChanged(bool)), this, SLOT(interfacesUpChanged(bool)));
+        connect(&networkState, SIGNAL(interfacesUpChanged(bool)), q, SIGNAL(interfacesUpChanged(bool)));
+
         keepaliveAddressLookup.setType(QDnsLookup::A);
     }
 
@@ -99,12 +81,19 @@ public:
     QHash<QString, QObject *> objectHash;
     QHash<QString, QAbstractSocket *> socketHash;
 
-    QTimer timer;
+    KeepaliveService keepalive;
     QPointer<QUdpSocket> socket;
     QPointer<Scheduler> scheduler;
     QPointer<Settings> settings;
 
-    QSet<QUuid> handledMeasureUuids;
+    // establishConnection() runs on the task executor thread, guards both caches
+    QMutex cacheMutex;
+
+    // Least recently seen offers are dropped first, the value is the expiry
+    QCache<QUuid, qint64> handledMeasureUuids;
+
+    // Binary control version per peer address, others get json offers
+    QCache<QString, quint8> binaryPeers;
 
     quint16 localPort;
 
@@ -113,12 +102,7 @@ public:
     QDnsLookup keepaliveAddressLookup;
 
     QNetworkConfigurationManager ncm;
-#if defined(Q_OS_ANDROID)
-    QAndroidJniObject networkInfo;
-#elif defined(Q_OS_IOS)
-#else
-    QNetworkInfo networkInfo;
-#endif
+    NetworkState networkState;
 
     // Functions
     QAbstractSocket *createSocket(NetworkManager::SocketType socketType);
@@ -126,13 +110,21 @@ public:
     void updateSocket();
     void updateTimer();
     void processDatagram(const QByteArray &datagram, const QHostAddress &host, quint16 port);
+    void processPeerRequest(const PeerRequest &request, const QHostAddress &host, quint16 port);
+
+    bool isHandled(const QUuid &uuid);
+    void setHandled(const QUuid &uuid);
+
+    bool isBinaryPeer(const QHostAddress &address);
+    void updateBinaryPeer(const QHostAddress &address, quint8 version);
 
 public slots:
     void socketDestroyed(QObject *obj);
     void responseChanged();
-    void timeout();
+    void apiKeyChanged(const QString &apiKey);
     void onDatagramReady();
     void lookupFinished();
+    void interfacesUpChanged(bool up);
 };
 
 QAbstractSocket *NetworkManager::Private::createSocket(NetworkManager::SocketType socketType)
@@ -201,6 +193,8 @@ void NetworkManager::Private::updateSocket()
     {
         LOG_ERROR(QString("Unable to bind port %1: %2").arg(keepaliveHost.port).arg(socket->errorString()));
     }
+
+    keepalive.setSocket(socket);
 }
 
 void NetworkManager::Private::updateTimer()
@@ -222,16 +216,10 @@ void NetworkManager::Private::updateTimer()
         LOG_ERROR("Keepalive interval < 1 sec will not be accepted.");
         return;
     }
-    else
-    {
-        if (timer.interval() != interval)
-        {
-            LOG_DEBUG(QString("Keepalive set to %1 sec.").arg(interval / 1000));
-        }
-    }
 
-    timer.setInterval(interval);
-    timer.start();
+    // the configured interval is where probing for the binding timeout starts
+    keepalive.setInterval(interval);
+    keepalive.start();
 }
 
 class NetworkManagerMeasurementObserver : public MeasurementObserver
@@ -266,6 +254,56 @@ public:
     }
 };
 
+bool NetworkManager::Private::isHandled(const QUuid &uuid)
+{
+    QMutexLocker locker(&cacheMutex);
+    qint64 *expiry = handledMeasureUuids.object(uuid);
+
+    if (!expiry)
+    {
+        return false;
+    }
+
+    if (*expiry < Clock::monotonic())
+    {
+        handledMeasureUuids.remove(uuid);
+        return false;
+    }
+
+    return true;
+}
+
+void NetworkManager::Private::setHandled(const QUuid &uuid)
+{
+    QMutexLocker locker(&cacheMutex);
+    handledMeasureUuids.insert(uuid, new qint64(Clock::monotonic() + handledUuidTtl));
+}
+
+bool NetworkManager::Private::isBinaryPeer(const QHostAddress &address)
+{
+    if (address.isNull())
+    {
+        return false;
+    }
+
+    QMutexLocker locker(&cacheMutex);
+    return binaryPeers.contains(peerKey(address));
+}
+
+void NetworkManager::Private::updateBinaryPeer(const QHostAddress &address, quint8 version)
+{
+    QMutexLocker locker(&cacheMutex);
+
+    if (version == 0)
+    {
+        binaryPeers.remove(peerKey(address));
+    }
+    else
+    {
+        binaryPeers.insert(peerKey(address), new quint8(version));
+    }
+}
+
 void NetworkManager::Private::processDatagram(const QByteArray &datagram, const QHostAddress &host, quint16 port)
 {
     QString hostAndPort = QString("%1:%2").arg(host.toString()).arg(port);
@@ -276,9 +314,26 @@ void NetworkManager::Private::processDatagram(const QByteArray &datagram, const
         return;
     }
 
-    LOG_DEBUG(QString("Received datagram from %1: %2").arg(hostAndPort).arg(QString::fromUtf8(datagram)));
+    LOG_DEBUG(QString("Received datagram from %1 (%2 bytes)").arg(hostAndPort).arg(datagram.size()));
+
+    if (PeerRequest::isBinary(datagram))
+    {
+        PeerRequest request;
+        QString errorString;
+
+        if (!PeerRequest::fromBinary(datagram, &request, &errorString))
+        {
+            LOG_ERROR(QString("Invalid peer request from %1: %2").arg(hostAndPort).arg(errorString));
+            return;
+        }
+
+        updateBinaryPeer(host, request.binaryVersion);
+        processPeerRequest(request, host, port);
+        return;
+    }
+
     //    if (settings->config()->keepaliveAddress() == hostAndPort) {
-    // Master server
+    // Master server and peers which only speak json
     QJsonParseError error;
     QJsonDocument document = QJsonDocument::fromJson(datagram, &error);
 
@@ -296,38 +351,8 @@ void NetworkManager::Private::processDatagram(const QByteArray &datagram, const
 
         PeerRequest request = PeerRequest::fromVariant(document.toVariant());
 
-        if (handledMeasureUuids.contains(request.measurementUuid))
-        {
-            LOG_DEBUG("Measurement uuid is already handled, skipping second try");
-            return;
-        }
-
-        handledMeasureUuids.insert(request.measurementUuid);
-
-        MeasurementObserver *observer = NULL;
-
-        if (request.protocol == NetworkManager::UdpSocket)
-        {
-            NetworkManagerMeasurementObserver *tempObs = new NetworkManagerMeasurementObserver;
-            tempObs->networkManager = q;
-            tempObs->socketType = request.protocol;
-            tempObs->localPort = 5106; // TODO: Don't hardcode this here
-            tempObs->host = host; //request.peer;
-            tempObs->port = port;
-            tempObs->measurementUuid = request.measurementUuid;
-
-            observer = tempObs;
-        }
-
-        // TODO: We can't assign the Peer socket to Measurement since this is created in a separate thread
-        //        and we can't access.
-
-        TimingPtr timing(new ImmediateTiming);
-        ScheduleDefinition testDefinition(ScheduleId(0), request.taskId, request.measurement, timing,
-                                      request.measurementDefinition, Precondition());
-
-        // Bypass scheduler and run directly on the executor
-        scheduler->executor()->execute(testDefinition, observer);
+        updateBinaryPeer(host, request.binaryVersion);
+        processPeerRequest(request, host, port);
     }
     else
     {
@@ -339,48 +364,66 @@ void NetworkManager::Private::processDatagram(const QByteArray &datagram, const
     //    }
 }
 
-void NetworkManager::Private::responseChanged()
+void NetworkManager::Private::processPeerRequest(const PeerRequest &request, const QHostAddress &host, quint16 port)
 {
-    // Update the keepalive host address
-    keepaliveHost = NetworkHelper::remoteHost(settings->config()->keepaliveAddress());
-
-    updateSocket();
-    //updateTimer(); TODO: deactivated for now
-
-    // Lookup the host
-    keepaliveAddressLookup.setName(keepaliveHost.host);
-    keepaliveAddressLookup.lookup();
-}
-
-void NetworkManager::Private::timeout()
-{
-    if (keepaliveAddress.isNull())
+    if (isHandled(request.measurementUuid))
     {
-        LOG_WARNING("Invalid keepalive address (normal at first app start)");
+        LOG_DEBUG("Measurement uuid is already handled, skipping second try");
         return;
     }
 
-    QString sessionId = settings->apiKey();
+    setHandled(request.measurementUuid);
 
-    if (sessionId.isEmpty())
+    MeasurementObserver *observer = NULL;
+
+    if (request.protocol == NetworkManager::UdpSocket)
     {
-        LOG_WARNING("Empty session id");
-        return;
+        NetworkManagerMeasurementObserver *tempObs = new NetworkManagerMeasurementObserver;
+        tempObs->networkManager = q;
+        tempObs->socketType = request.protocol;
+        tempObs->localPort = 5106; // TODO: Don't hardcode this here
+        tempObs->host = host; //request.peer;
+        tempObs->port = port;
+        tempObs->measurementUuid = request.measurementUuid;
+
+        observer = tempObs;
     }
 
-    QStringList srcIp;
-    srcIp.append(ConnectionTester().localIpAddress());
+    // TODO: We can't assign the Peer socket to Measurement since this is created in a separate thread
+    //        and we can't access.
+
+    TimingPtr timing(new ImmediateTiming);
+    ScheduleDefinition testDefinition(ScheduleId(0), request.taskId, request.measurement, timing,
+                                      request.measurementDefinition, Precondition());
+
+    // Bypass scheduler and run directly on the executor
+    scheduler->executor()->execute(testDefinition, observer);
+}
 
-    QVariantMap map;
-    map.insert("type", "keepalive");
-    map.insert("session_id", sessionId);
-    map.insert("src_ip", srcIp);
-    map.insert("src_port", localPort);
+void NetworkManager::Private::responseChanged()
+{
+    // Update the keepalive host address
+    keepaliveHost = NetworkHelper::remoteHost(settings->config()->keepaliveAddress());
 
-    QByteArray data = QJsonDocument::fromVariant(map).toJson();
-    socket->writeDatagram(data, keepaliveAddress, keepaliveHost.port);
+    updateSocket();
+    updateTimer();
 
-    LOG_DEBUG("Alive packet sent");
+    if (QHostAddress(keepaliveHost.host).isNull())
+    {
+        // Lookup the host
+        keepaliveAddressLookup.setName(keepaliveHost.host);
+        keepaliveAddressLookup.lookup();
+    }
+    else
+    {
+        keepaliveAddress = QHostAddress(keepaliveHost.host);
+        keepalive.setServer(keepaliveAddress, keepaliveHost.port);
+    }
+}
+
+void NetworkManager::Private::apiKeyChanged(const QString &apiKey)
+{
+    keepalive.setSessionId(apiKey);
 }
 
 void NetworkManager::Private::onDatagramReady()
@@ -394,6 +437,11 @@ void NetworkManager::Private::onDatagramReady()
         quint16 port;
         socket->readDatagram(datagram.data(), datagram.size(), &host, &port);
 
+        if (keepalive.processReply(datagram, host, port))
+        {
+            continue;
+        }
+
         // Process the datagram
         processDatagram(datagram, host, port);
     }
@@ -401,7 +449,6 @@ void NetworkManager::Private::onDatagramReady()
 
 void NetworkManager::Private::lookupFinished()
 {
-    return; // TODO disabled for now
     // Check for errors
     if (keepaliveAddressLookup.error() != QDnsLookup::NoError)
     {
@@ -416,12 +463,30 @@ void NetworkManager::Private::lookupFinished()
         if (!value.isNull())
         {
             keepaliveAddress = value;
-            timeout();
+            keepalive.setServer(keepaliveAddress, keepaliveHost.port);
+            keepalive.sendKeepalive();
             break;
         }
     }
 }
 
+void NetworkManager::Private::interfacesUpChanged(bool up)
+{
+    if (!up)
+    {
+        LOG_INFO("All interfaces are down");
+        return;
+    }
+
+    LOG_INFO("Interfaces are up again");
+
+    // The NAT binding did not survive the outage
+    if (keepalive.isRunning())
+    {
+        keepalive.sendKeepalive();
+    }
+}
+
 NetworkManager::NetworkManager(QObject *parent)
 : QObject(parent)
 , d(new Private(this))
@@ -436,9 +501,11 @@ NetworkManager::~NetworkManager()
 bool NetworkManager::init(Scheduler *scheduler, Settings *settings)
 {
     connect(settings->config(), SIGNAL(responseChanged()), d, SLOT(responseChanged()));
+    connect(settings, SIGNAL(apiKeyChanged(QString)), d, SLOT(apiKeyChanged(QString)));
 
     d->scheduler = scheduler;
     d->settings = settings;
+    d->keepalive.setSessionId(settings->apiKey());
     d->responseChanged();
 
     emit d->ncm.updateConfigurations();
@@ -455,7 +522,7 @@ void NetworkManager::setRunning(bool running)
 
     if (!running)
     {
-        d->timer.stop();
+        d->keepalive.stop();
     }
     else
     {
@@ -465,60 +532,22 @@ void NetworkManager::setRunning(bool running)
 
 bool NetworkManager::isRunning() const
 {
-    return d->timer.isActive();
+    return d->keepalive.isRunning();
 }
 
 bool NetworkManager::onMobileConnection() const
 {
-#if defined(Q_OS_ANDROID)
-     return d->networkInfo.callMethod<jboolean>("isOnMobileConnection");
-#else
-    QNetworkInfo::NetworkMode mode = connectionMode();
-
-    if (mode != QNetworkInfo::WlanMode && mode != QNetworkInfo::EthernetMode)
-    {
-        LOG_DEBUG(QString("Connection type: %1").arg(mode));
-        return true;
-    }
-
-    return false;
-#endif
+    return NetworkState::snapshot()->mobileConnection;
 }
 
 QNetworkInfo::NetworkMode NetworkManager::connectionMode() const
 {
-    QNetworkInfo::NetworkMode mode;
-
-#if defined(Q_OS_ANDROID)
-    mode = static_cast<QNetworkInfo::NetworkMode>(d->networkInfo.callMethod<jint>("connectionMode"));
-#elif defined(Q_OS_IOS)
-    mode = QNetworkInfo::WlanMode;
-#else
-    mode = d->networkInfo.currentNetworkMode();
-    // QNetworkInfo does not check for the linux "Predictable Network Interface Names".
-    // The following code fixes this.
-    if (mode == QNetworkInfo::UnknownMode)
-    {
-        QList<QNetworkConfiguration> confList = d->ncm.allConfigurations(QNetworkConfiguration::Active);
-
-        foreach (const QNetworkConfiguration &conf, confList)
-        {
-            QString name = conf.name();
-
-            if (name.contains("enp"))
-            {
-                return QNetworkInfo::EthernetMode;
-            }
-
-            if (name.contains("wlp"))
-            {
-                return QNetworkInfo::WlanMode;
-            }
-        }
-    }
-#endif
+    return NetworkState::snapshot()->connectionMode;
+}
 
-    return mode;
+NetworkState *NetworkManager::networkState() const
+{
+    return &d->networkState;
 }
 
 QAbstractSocket *NetworkManager::connection(const QString &hostname, NetworkManager::SocketType socketType) const
@@ -543,11 +572,12 @@ QAbstractSocket *NetworkManager::createConnection(NetworkManager::SocketType soc
     return socket;
 }
 
-QAbstractSocket *NetworkManager::establishConnection(const QString &hostname,
-                                                     const TaskId &taskId,
-                                                     const QString &measurement,
-                                                     MeasurementDefinitionPtr measurementDefinition,
-                                                     NetworkManager::SocketType socketType)
+PeerConnection *NetworkManager::establishConnection(const QString &hostname,
+                                                    const TaskId &taskId,
+                                                    const QString &measurement,
+                                                    const MeasurementDefinitionPtr &measurementDefinition,
+                                                    const QUuid &measurementUuid,
+                                                    NetworkManager::SocketType socketType)
 {
     QAbstractSocket *socket = d->createSocket(socketType);
 
@@ -568,19 +598,17 @@ QAbstractSocket *NetworkManager::establishConnection(const QString &hostname,
         return NULL;
     }
 
-    measurementDefinition->measurementUuid = QUuid::createUuid();
-
     PeerRequest request;
     request.measurement = measurement;
     request.taskId = taskId;
     request.measurementDefinition = measurementDefinition->toVariant();
-    request.measurementUuid = measurementDefinition->measurementUuid;
+    request.measurementUuid = measurementUuid;
     request.peer = remote.host;
     request.port = aliveRemote.port;
     request.protocol = socketType;
 
     // If for some reason our packet gets routed back to us, don't handle it
-    d->handledMeasureUuids.insert(measurementDefinition->measurementUuid);
+    d->setHandled(measurementUuid);
 
     QUdpSocket *testSocket = d->socket.data();
 
@@ -599,62 +627,23 @@ QAbstractSocket *NetworkManager::establishConnection(const QString &hostname,
         testSocket = udpSocket;
     }
 
-    QByteArray data = QJsonDocument::fromVariant(request.toVariant()).toJson();
-
-    // Step one: Send test offer to peer directly
-    testSocket->writeDatagram(data, QHostAddress(remote.host), d->localPort);
-
-    // Step two: Send test offer to peer via alive-server
-    //testSocket->writeDatagram(data, d->keepaliveAddress, aliveRemote.port); // TODO deactivated for now
+    // Peers which never announced the binary form only understand json
+    QByteArray data;
 
-    LOG_TRACE("Sent test offer to peer and alive-server");
-
-    if (socketType != UdpSocket)
+    if (d->isBinaryPeer(QHostAddress(remote.host)))
     {
-        // Final step: Connect to remote host
-        //if (socket->waitForReadyRead(5000))
-        //    return socket;
-
-        const int tries = 20;
-
-        for (int i = 0; i < tries; ++i)
-        {
-            socket->connectToHost(remote.host, remote.port);
-
-            if (socket->waitForConnected(5000 / tries))
-            {
-                return socket;
-            }
-        }
-
-        LOG_ERROR(QString("Unable to connect tcp socket in %3 tries to %1: %2").arg(hostname).arg(socket->errorString()).arg(
-                      tries));
+        data = request.toBinary();
     }
     else
     {
-        if (!testSocket->waitForReadyRead(5000))
-        {
-            LOG_ERROR("Remote did not answer for 5 sec, aborting connection.");
-        }
-        else
-        {
-            // TODO: Read the first (empty) datagram
-            QHostAddress packetHost;
-            testSocket->readDatagram(0, 0, &packetHost);
-
-            if (packetHost != QHostAddress(remote.host))
-            {
-                LOG_ERROR("Received connection packet from wrong host!");
-            }
-            else
-            {
-                return socket;
-            }
-        }
+        data = QJsonDocument::fromVariant(request.toVariant()).toJson(QJsonDocument::Compact);
     }
 
-    delete socket;
-    return NULL;
+    // TODO: Send test offer to peer via alive-server (deactivated for now)
+
+    // The handshake sends the offer and then connects (tcp) or waits for
+    // the acknowledgement (udp) while the event loop keeps running
+    return new PeerConnection(socket, testSocket, socketType, remote.host, remote.port, data, d->localPort);
 }
 
 QTcpServer *NetworkManager::createServerSocket()
@@ -666,24 +655,7 @@ QTcpServer *NetworkManager::createServerSocket()
 
 bool NetworkManager::allInterfacesDown() const
 {
-    QNetworkInterface::InterfaceFlags flags;
-
-    foreach (const QNetworkInterface &iface, QNetworkInterface::allInterfaces())
-    {
-        flags = iface.flags();
-
-        if (flags & QNetworkInterface::IsLoopBack)
-        {
-            continue;
-        }
-
-        if (flags & (QNetworkInterface::IsUp | QNetworkInterface::IsRunning))
-        {
-            return false;
-        }
-    }
-
-    return true;
+    return !NetworkState::snapshot()->interfacesUp;
 }
 
 #include "networkmanager.moc"
@@ -30,6 +30,8 @@ class Scheduler;
 class Settings;
 class QUdpSocket;
 class QTcpServer;
+class PeerConnection;
+class NetworkState;
 
 // TODO: This class has to be thread safe!
 class CLIENT_API NetworkManager : public QObject
@@ -47,8 +49,10 @@ public:
     void setRunning(bool running);
     bool isRunning() const;
 
+    // Read from the cached network state
     bool onMobileConnection() const;
     QNetworkInfo::NetworkMode connectionMode() const;
+    NetworkState *networkState() const;
 
     enum SocketType
     {
@@ -62,17 +66,22 @@ public:
 
     // Creates a new connection
     QAbstractSocket *createConnection(SocketType socketType);
-    QAbstractSocket *establishConnection(const QString &hostname,
-                                         const TaskId &taskId,
-                                         const QString &measurement,
-                                         MeasurementDefinitionPtr measurementDefinition,
-                                         NetworkManager::SocketType socketType);
+
+    // Offers a test to the peer and connects without blocking, the caller
+    // owns the returned handshake and takes the socket once connected
+    PeerConnection *establishConnection(const QString &hostname,
+                                        const TaskId &taskId,
+                                        const QString &measurement,
+                                        const MeasurementDefinitionPtr &measurementDefinition,
+                                        const QUuid &measurementUuid,
+                                        NetworkManager::SocketType socketType);
 
     QTcpServer *createServerSocket();
     bool allInterfacesDown() const;
 
 signals:
     void runningChanged();
+    void interfacesUpChanged(bool up);
 
 protected:
     class Private;
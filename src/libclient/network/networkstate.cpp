@@ -0,0 +1,390 @@
+#include "networkstate.h"
+#include "../log/logger.h"
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QTimer>
+#include <QSocketNotifier>
+#include <QNetworkInterface>
+#include <QNetworkConfiguration>
+#include <QNetworkConfigurationManager>
+#include <QFile>
+#include <QTextStream>
+#include <QStringList>
+#if defined(Q_OS_ANDROID)
+#include <QAndroidJniObject>
+#endif
+
+#if defined(Q_OS_LINUX) && !defined(Q_OS_ANDROID)
+#define HAVE_RTNETLINK
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#endif
+
+LOGGER(NetworkState);
+
+namespace
+{
+    // Events come in bursts when an interface goes up, rebuild once after
+    const int refreshDelay = 100;
+
+    // The published snapshot, shared by all instances
+    QMutex mutex;
+    NetworkState::SnapshotPtr current;
+    int instances = 0;
+}
+
+NetworkState::Snapshot::Snapshot()
+: interfacesUp(false)
+, connectionMode(QNetworkInfo::UnknownMode)
+, mobileConnection(false)
+{
+}
+
+class NetworkState::Private : public QObject
+{
+    Q_OBJECT
+
+public:
+    Private(NetworkState *q)
+    : q(q)
+    , fd(-1)
+    , notifier(NULL)
+#if defined(Q_OS_ANDROID)
+    , networkInfo("de/hsaugsburg/informatik/mplane/NetInfo")
+#endif
+    {
+        refreshTimer.setSingleShot(true);
+        refreshTimer.setInterval(refreshDelay);
+
+        connect(&refreshTimer, SIGNAL(timeout()), q, SLOT(refresh()));
+
+        // Connection modes are not visible to netlink
+        connect(&ncm, SIGNAL(configurationChanged(QNetworkConfiguration)), this, SLOT(scheduleRefresh()));
+        connect(&ncm, SIGNAL(onlineStateChanged(bool)), this, SLOT(scheduleRefresh()));
+    }
+
+    ~Private()
+    {
+#ifdef HAVE_RTNETLINK
+        if (fd != -1)
+        {
+            ::close(fd);
+        }
+#endif
+    }
+
+    NetworkState *q;
+
+    int fd;
+    QSocketNotifier *notifier;
+    QTimer refreshTimer;
+
+    QNetworkConfigurationManager ncm;
+#if defined(Q_OS_ANDROID)
+    QAndroidJniObject networkInfo;
+#elif defined(Q_OS_IOS)
+#else
+    QNetworkInfo networkInfo;
+#endif
+
+    // Functions
+    bool openNetlink();
+    NetworkState::Snapshot *build();
+    QNetworkInfo::NetworkMode connectionMode();
+    bool mobileConnection(QNetworkInfo::NetworkMode mode);
+
+public slots:
+    void scheduleRefresh();
+    void readNetlink();
+};
+
+bool NetworkState::Private::openNetlink()
+{
+#ifdef HAVE_RTNETLINK
+    fd = ::socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC | SOCK_NONBLOCK, NETLINK_ROUTE);
+
+    if (fd == -1)
+    {
+        LOG_WARNING(QString("Unable to open netlink socket: %1").arg(strerror(errno)));
+        return false;
+    }
+
+    struct sockaddr_nl addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR | RTMGRP_IPV4_ROUTE | RTMGRP_IPV6_ROUTE;
+
+    if (::bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1)
+    {
+        LOG_WARNING(QString("Unable to bind netlink socket: %1").arg(strerror(errno)));
+        ::close(fd);
+        fd = -1;
+        return false;
+    }
+
+    notifier = new QSocketNotifier(fd, QSocketNotifier::Read, this);
+    connect(notifier, SIGNAL(activated(int)), this, SLOT(readNetlink()));
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+void NetworkState::Private::scheduleRefresh()
+{
+    if (!refreshTimer.isActive())
+    {
+        refreshTimer.start();
+    }
+}
+
+void NetworkState::Private::readNetlink()
+{
+#ifdef HAVE_RTNETLINK
+    char buffer[8192];
+    bool relevant = false;
+
+    forever
+    {
+        ssize_t size = ::recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+
+        if (size == -1)
+        {
+            // The kernel dropped events, the state has to be read again
+            if (errno == ENOBUFS)
+            {
+                relevant = true;
+                continue;
+            }
+
+            break;
+        }
+
+        if (size == 0)
+        {
+            break;
+        }
+
+        int length = size;
+
+        for (struct nlmsghdr *header = (struct nlmsghdr *)buffer; NLMSG_OK(header, length);
+             header = NLMSG_NEXT(header, length))
+        {
+            switch (header->nlmsg_type)
+            {
+            case RTM_NEWLINK:
+            case RTM_DELLINK:
+            case RTM_NEWADDR:
+            case RTM_DELADDR:
+            case RTM_NEWROUTE:
+            case RTM_DELROUTE:
+                relevant = true;
+                break;
+
+            default:
+                break;
+            }
+        }
+    }
+
+    if (relevant)
+    {
+        scheduleRefresh();
+    }
+#endif
+}
+
+NetworkState::Snapshot *NetworkState::Private::build()
+{
+    NetworkState::Snapshot *snapshot = new NetworkState::Snapshot;
+
+    foreach (const QNetworkInterface &iface, QNetworkInterface::allInterfaces())
+    {
+        QNetworkInterface::InterfaceFlags flags = iface.flags();
+
+        if (flags & QNetworkInterface::IsLoopBack)
+        {
+            continue;
+        }
+
+        if (!(flags & (QNetworkInterface::IsUp | QNetworkInterface::IsRunning)))
+        {
+            continue;
+        }
+
+        snapshot->interfacesUp = true;
+
+        foreach (const QNetworkAddressEntry &entry, iface.addressEntries())
+        {
+            snapshot->localAddresses.append(entry.ip());
+        }
+    }
+
+#ifdef Q_OS_LINUX
+    QFile file("/proc/net/route");
+
+    if (file.open(QIODevice::ReadOnly))
+    {
+        QTextStream stream(&file);
+        QString line = stream.readLine();
+
+        while (!line.isEmpty())
+        {
+            QStringList parts = line.split('\t');
+
+            // Destination 0.0.0.0 is the default route, the address is in host order
+            if (parts.size() > 2 && parts.at(1) == "00000000")
+            {
+                QString ip = parts.at(2);
+                QStringList realIp;
+
+                for (int pos = 0; pos < ip.size(); pos += 2)
+                {
+                    realIp.prepend(QString::number(ip.mid(pos, 2).toInt(NULL, 16)));
+                }
+
+                snapshot->defaultGateway = realIp.join(".");
+                snapshot->defaultInterface = parts.at(0);
+                break;
+            }
+
+            line = stream.readLine();
+        }
+    }
+#endif
+
+    snapshot->connectionMode = connectionMode();
+    snapshot->mobileConnection = mobileConnection(snapshot->connectionMode);
+
+    return snapshot;
+}
+
+QNetworkInfo::NetworkMode NetworkState::Private::connectionMode()
+{
+    QNetworkInfo::NetworkMode mode;
+
+#if defined(Q_OS_ANDROID)
+    mode = static_cast<QNetworkInfo::NetworkMode>(networkInfo.callMethod<jint>("connectionMode"));
+#elif defined(Q_OS_IOS)
+    mode = QNetworkInfo::WlanMode;
+#else
+    mode = networkInfo.currentNetworkMode();
+    // QNetworkInfo does not check for the linux "Predictable Network Interface Names".
+    // The following code fixes this.
+    if (mode == QNetworkInfo::UnknownMode)
+    {
+        QList<QNetworkConfiguration> confList = ncm.allConfigurations(QNetworkConfiguration::Active);
+
+        foreach (const QNetworkConfiguration &conf, confList)
+        {
+            QString name = conf.name();
+
+            if (name.contains("enp"))
+            {
+                return QNetworkInfo::EthernetMode;
+            }
+
+            if (name.contains("wlp"))
+            {
+                return QNetworkInfo::WlanMode;
+            }
+        }
+    }
+#endif
+
+    return mode;
+}
+
+bool NetworkState::Private::mobileConnection(QNetworkInfo::NetworkMode mode)
+{
+#if defined(Q_OS_ANDROID)
+    Q_UNUSED(mode);
+    return networkInfo.callMethod<jboolean>("isOnMobileConnection");
+#else
+    return mode != QNetworkInfo::WlanMode && mode != QNetworkInfo::EthernetMode;
+#endif
+}
+
+NetworkState::NetworkState(QObject *parent)
+: QObject(parent)
+, d(new Private(this))
+{
+    {
+        QMutexLocker locker(&mutex);
+        ++instances;
+    }
+
+    if (!d->openNetlink())
+    {
+        LOG_INFO("Watching network configurations instead of netlink");
+    }
+
+    refresh();
+}
+
+NetworkState::~NetworkState()
+{
+    {
+        QMutexLocker locker(&mutex);
+
+        if (--instances == 0)
+        {
+            current.clear();
+        }
+    }
+
+    delete d;
+}
+
+NetworkState::SnapshotPtr NetworkState::snapshot()
+{
+    QMutexLocker locker(&mutex);
+    return current;
+}
+
+bool NetworkState::isWatching() const
+{
+    return d->fd != -1;
+}
+
+void NetworkState::refresh()
+{
+    SnapshotPtr snapshot(d->build());
+    SnapshotPtr previous;
+
+    {
+        QMutexLocker locker(&mutex);
+        previous = current;
+        current = snapshot;
+    }
+
+    if (!previous)
+    {
+        return;
+    }
+
+    if (previous->interfacesUp != snapshot->interfacesUp ||
+        previous->defaultGateway != snapshot->defaultGateway ||
+        previous->localAddresses != snapshot->localAddresses ||
+        previous->connectionMode != snapshot->connectionMode ||
+        previous->mobileConnection != snapshot->mobileConnection)
+    {
+        LOG_DEBUG(QString("Network changed: gateway %1 on %2, connection type %3")
+                  .arg(snapshot->defaultGateway).arg(snapshot->defaultInterface).arg(snapshot->connectionMode));
+
+        emit changed();
+    }
+
+    if (previous->interfacesUp != snapshot->interfacesUp)
+    {
+        emit interfacesUpChanged(snapshot->interfacesUp);
+    }
+}
+
+#include "networkstate.moc"
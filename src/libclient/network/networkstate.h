@@ -0,0 +1,54 @@
+#ifndef NETWORKSTATE_H
+#define NETWORKSTATE_H
+
+#include "networkmanager.h"
+
+#include <QObject>
+#include <QHostAddress>
+#include <QSharedPointer>
+
+// Keeps the state of the local interfaces so that it can be read before
+// every task without asking the system. On linux the state is rebuilt on
+// rtnetlink link, address and route events, elsewhere on changes of the
+// network configurations. Readers get an immutable snapshot.
+class CLIENT_API NetworkState : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Snapshot
+    {
+        Snapshot();
+
+        bool interfacesUp;
+        QString defaultGateway;
+        QString defaultInterface;
+        QList<QHostAddress> localAddresses;
+        QNetworkInfo::NetworkMode connectionMode;
+        bool mobileConnection;
+    };
+
+    typedef QSharedPointer<const Snapshot> SnapshotPtr;
+
+    explicit NetworkState(QObject *parent = 0);
+    ~NetworkState();
+
+    // Thread safe, NULL while no NetworkState exists
+    static SnapshotPtr snapshot();
+
+    // True if kernel events are received
+    bool isWatching() const;
+
+public slots:
+    void refresh();
+
+signals:
+    void changed();
+    void interfacesUpChanged(bool up);
+
+protected:
+    class Private;
+    Private *d;
+};
+
+#endif // NETWORKSTATE_H
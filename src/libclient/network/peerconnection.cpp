@@ -0,0 +1,295 @@
+#include "peerconnection.h"
+#include "../log/logger.h"
+
+#include <QUdpSocket>
+#include <QPointer>
+#include <QTimer>
+
+LOGGER(PeerConnection);
+
+namespace
+{
+    // The peer has this long to answer the test offer
+    const int connectTimeout = 5000;
+
+    // Pause between attempts, doubled after every failure
+    const int initialRetryDelay = 50;
+    const int maximumRetryDelay = 1000;
+
+    // Resend the offer in case the datagram was lost
+    const int initialOfferDelay = 250;
+}
+
+class PeerConnection::Private : public QObject
+{
+    Q_OBJECT
+
+public:
+    Private(PeerConnection *q)
+    : q(q)
+    , socketType(NetworkManager::TcpSocket)
+    , port(0)
+    , offerPort(0)
+    , attempts(0)
+    , retryDelay(initialRetryDelay)
+    , finished(false)
+    {
+        retryTimer.setSingleShot(true);
+        deadlineTimer.setSingleShot(true);
+
+        connect(&retryTimer, SIGNAL(timeout()), this, SLOT(retry()));
+        connect(&deadlineTimer, SIGNAL(timeout()), this, SLOT(timeout()));
+    }
+
+    PeerConnection *q;
+
+    // Properties
+    QPointer<QAbstractSocket> socket;
+    QPointer<QUdpSocket> offerSocket;
+    NetworkManager::SocketType socketType;
+
+    QString host;
+    quint16 port;
+    QByteArray offer;
+    quint16 offerPort;
+
+    int attempts;
+    int retryDelay;
+    bool finished;
+    QString errorString;
+
+    QTimer retryTimer;
+    QTimer deadlineTimer;
+
+    // Functions
+    void start();
+    void connectToHost();
+    void sendOffer();
+    void succeed();
+    void fail(const QString &message);
+    void stop();
+
+public slots:
+    void retry();
+    void timeout();
+    void socketConnected();
+    void socketError(QAbstractSocket::SocketError socketError);
+    void datagramReady();
+};
+
+void PeerConnection::Private::start()
+{
+    if (offerSocket.isNull())
+    {
+        errorString = "No socket to send the test offer";
+
+        // let the caller connect to the signals first
+        QMetaObject::invokeMethod(this, "timeout", Qt::QueuedConnection);
+        return;
+    }
+
+    // Send test offer to peer directly
+    sendOffer();
+
+    LOG_TRACE("Sent test offer to peer");
+
+    deadlineTimer.start(connectTimeout);
+
+    if (socketType == NetworkManager::TcpSocket)
+    {
+        connect(socket.data(), SIGNAL(connected()), this, SLOT(socketConnected()));
+        connect(socket.data(), SIGNAL(error(QAbstractSocket::SocketError)), this,
+                SLOT(socketError(QAbstractSocket::SocketError)));
+        connectToHost();
+    }
+    else
+    {
+        connect(offerSocket.data(), SIGNAL(readyRead()), this, SLOT(datagramReady()));
+        retryDelay = initialOfferDelay;
+        retryTimer.start(retryDelay);
+    }
+}
+
+void PeerConnection::Private::connectToHost()
+{
+    ++attempts;
+    socket->abort();
+    socket->connectToHost(host, port);
+}
+
+void PeerConnection::Private::sendOffer()
+{
+    offerSocket->writeDatagram(offer, QHostAddress(host), offerPort);
+}
+
+void PeerConnection::Private::succeed()
+{
+    stop();
+
+    LOG_DEBUG(QString("Connected to peer %1:%2").arg(host).arg(port));
+    emit q->connected();
+}
+
+void PeerConnection::Private::fail(const QString &message)
+{
+    stop();
+
+    errorString = message;
+    LOG_ERROR(message);
+
+    delete socket.data();
+    emit q->error(message);
+}
+
+void PeerConnection::Private::stop()
+{
+    finished = true;
+    retryTimer.stop();
+    deadlineTimer.stop();
+
+    if (socket)
+    {
+        socket->disconnect(this);
+    }
+
+    if (offerSocket)
+    {
+        offerSocket->disconnect(this);
+    }
+}
+
+void PeerConnection::Private::retry()
+{
+    if (finished)
+    {
+        return;
+    }
+
+    if (socketType == NetworkManager::TcpSocket)
+    {
+        connectToHost();
+    }
+    else
+    {
+        sendOffer();
+        retryDelay = qMin(retryDelay * 2, maximumRetryDelay);
+        retryTimer.start(retryDelay);
+    }
+}
+
+void PeerConnection::Private::timeout()
+{
+    if (finished)
+    {
+        return;
+    }
+
+    if (!errorString.isEmpty())
+    {
+        fail(errorString);
+    }
+    else if (socketType == NetworkManager::TcpSocket)
+    {
+        fail(QString("Unable to connect tcp socket in %1 tries to %2:%3: %4").arg(attempts).arg(host)
+             .arg(port).arg(socket ? socket->errorString() : QString()));
+    }
+    else
+    {
+        fail(QString("Remote did not answer for %1 sec, aborting connection.").arg(connectTimeout / 1000));
+    }
+}
+
+void PeerConnection::Private::socketConnected()
+{
+    succeed();
+}
+
+void PeerConnection::Private::socketError(QAbstractSocket::SocketError socketError)
+{
+    Q_UNUSED(socketError);
+
+    if (finished || retryTimer.isActive())
+    {
+        return;
+    }
+
+    // the peer may not be listening yet
+    retryTimer.start(retryDelay);
+    retryDelay = qMin(retryDelay * 2, maximumRetryDelay);
+}
+
+void PeerConnection::Private::datagramReady()
+{
+    while (!finished && offerSocket->hasPendingDatagrams())
+    {
+        // The peer acknowledges with an empty datagram
+        QHostAddress packetHost;
+        offerSocket->readDatagram(0, 0, &packetHost);
+
+        if (packetHost != QHostAddress(host))
+        {
+            LOG_ERROR("Received connection packet from wrong host!");
+            continue;
+        }
+
+        succeed();
+    }
+}
+
+PeerConnection::PeerConnection(QAbstractSocket *socket, QUdpSocket *offerSocket, NetworkManager::SocketType socketType,
+                               const QString &host, quint16 port, const QByteArray &offer, quint16 offerPort,
+                               QObject *parent)
+: QObject(parent)
+, d(new Private(this))
+{
+    d->socket = socket;
+    d->offerSocket = offerSocket;
+    d->socketType = socketType;
+    d->host = host;
+    d->port = port;
+    d->offer = offer;
+    d->offerPort = offerPort;
+
+    d->start();
+}
+
+PeerConnection::~PeerConnection()
+{
+    abort();
+    delete d;
+}
+
+bool PeerConnection::isFinished() const
+{
+    return d->finished;
+}
+
+QString PeerConnection::errorString() const
+{
+    return d->errorString;
+}
+
+QAbstractSocket *PeerConnection::takeSocket()
+{
+    if (!d->finished || !d->errorString.isEmpty())
+    {
+        return NULL;
+    }
+
+    QAbstractSocket *socket = d->socket.data();
+    d->socket.clear();
+    return socket;
+}
+
+void PeerConnection::abort()
+{
+    if (!d->finished)
+    {
+        d->stop();
+        d->errorString = "Connection aborted";
+    }
+
+    delete d->socket.data();
+}
+
+#include "peerconnection.moc"
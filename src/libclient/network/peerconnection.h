@@ -0,0 +1,40 @@
+#ifndef PEERCONNECTION_H
+#define PEERCONNECTION_H
+
+#include "networkmanager.h"
+
+class QUdpSocket;
+
+// Handshake with a measurement peer which runs on the event loop of the
+// calling thread. Emits either connected() or error() exactly once.
+class CLIENT_API PeerConnection : public QObject
+{
+    Q_OBJECT
+
+public:
+    ~PeerConnection();
+
+    bool isFinished() const;
+    QString errorString() const;
+
+    // Hands over the connected socket, the caller becomes its owner
+    QAbstractSocket *takeSocket();
+
+    void abort();
+
+signals:
+    void connected();
+    void error(const QString &message);
+
+protected:
+    friend class NetworkManager;
+
+    PeerConnection(QAbstractSocket *socket, QUdpSocket *offerSocket, NetworkManager::SocketType socketType,
+                   const QString &host, quint16 port, const QByteArray &offer, quint16 offerPort,
+                   QObject *parent = 0);
+
+    class Private;
+    Private *d;
+};
+
+#endif // PEERCONNECTION_H
@@ -0,0 +1,176 @@
+#include "peerrequest.h"
+
+#include <QDataStream>
+#include <QJsonDocument>
+
+namespace
+{
+    const quint16 controlMagic = 0x4750;
+    const quint8 controlVersion = 1;
+    const int controlHeaderSize = 6;
+
+    enum ControlType
+    {
+        PeerRequestType = 1
+    };
+
+    void writeString(QDataStream &out, const QString &string)
+    {
+        QByteArray utf8 = string.toUtf8().left(0xffff);
+        out << (quint16)utf8.size();
+        out.writeRawData(utf8.constData(), utf8.size());
+    }
+
+    bool readString(QDataStream &in, QString *string)
+    {
+        quint16 length = 0;
+        in >> length;
+
+        QByteArray utf8(length, Qt::Uninitialized);
+
+        if (in.readRawData(utf8.data(), length) != length)
+        {
+            return false;
+        }
+
+        *string = QString::fromUtf8(utf8);
+        return true;
+    }
+}
+
+PeerRequest::PeerRequest()
+: port(0)
+, protocol(NetworkManager::UdpSocket)
+, binaryVersion(controlVersion)
+{
+}
+
+QVariant PeerRequest::toVariant() const
+{
+    QVariantMap map;
+    map.insert("type", "peer_request");
+    map.insert("measurementDefinition", measurementDefinition);
+    map.insert("taskId", taskId.toInt());
+    map.insert("measurementUuid", measurementUuid);
+    map.insert("measurement", measurement);
+    map.insert("peer", peer);
+    map.insert("port", port);
+    map.insert("protocol", protocol);
+    map.insert("binaryVersion", (int)binaryVersion);
+    return map;
+}
+
+PeerRequest PeerRequest::fromVariant(const QVariant &variant)
+{
+    QVariantMap map = variant.toMap();
+
+    PeerRequest request;
+    request.measurementDefinition = map.value("measurementDefinition");
+    request.taskId = TaskId(map.value("taskId").toInt());
+    request.measurementUuid = map.value("measurementUuid").toUuid();
+    request.measurement = map.value("measurement").toString();
+    request.peer = map.value("peer").toString();
+    request.port = map.value("port").toUInt();
+    request.protocol = (NetworkManager::SocketType)map.value("protocol").toInt();
+    request.binaryVersion = map.value("binaryVersion", 0).toUInt();
+    return request;
+}
+
+QByteArray PeerRequest::toBinary() const
+{
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out << (qint32)taskId.toInt();
+
+    QByteArray uuid = measurementUuid.toRfc4122();
+    out.writeRawData(uuid.constData(), uuid.size());
+
+    out << port << (quint8)protocol;
+    writeString(out, measurement);
+    writeString(out, peer);
+
+    payload += QJsonDocument::fromVariant(measurementDefinition).toJson(QJsonDocument::Compact);
+
+    QByteArray datagram;
+    QDataStream header(&datagram, QIODevice::WriteOnly);
+    header << controlMagic << controlVersion << (quint8)PeerRequestType << (quint16)payload.size();
+
+    return datagram + payload;
+}
+
+bool PeerRequest::isBinary(const QByteArray &datagram)
+{
+    return datagram.size() >= controlHeaderSize && (quint8)datagram.at(0) == (controlMagic >> 8) &&
+           (quint8)datagram.at(1) == (controlMagic & 0xff);
+}
+
+bool PeerRequest::fromBinary(const QByteArray &datagram, PeerRequest *request, QString *errorString)
+{
+    QDataStream header(datagram);
+    quint16 magic;
+    quint8 version, type;
+    quint16 length;
+    header >> magic >> version >> type >> length;
+
+    if (magic != controlMagic || version != controlVersion)
+    {
+        *errorString = QString("unsupported version %1").arg(version);
+        return false;
+    }
+
+    if (type != PeerRequestType)
+    {
+        *errorString = QString("unknown message type %1").arg(type);
+        return false;
+    }
+
+    if (length != datagram.size() - controlHeaderSize)
+    {
+        *errorString = QString("length mismatch (%1 != %2)").arg(length).arg(datagram.size() - controlHeaderSize);
+        return false;
+    }
+
+    QByteArray payload = datagram.mid(controlHeaderSize);
+    QDataStream in(payload);
+
+    qint32 taskId;
+    QByteArray uuid(16, Qt::Uninitialized);
+    quint8 protocol;
+    in >> taskId;
+
+    if (in.readRawData(uuid.data(), uuid.size()) != uuid.size())
+    {
+        *errorString = "malformed payload";
+        return false;
+    }
+
+    in >> request->port >> protocol;
+
+    if (in.status() != QDataStream::Ok || !readString(in, &request->measurement) || !readString(in, &request->peer))
+    {
+        *errorString = "malformed payload";
+        return false;
+    }
+
+    QByteArray definition = payload.mid(in.device()->pos());
+
+    if (!definition.isEmpty())
+    {
+        QJsonParseError error;
+        QJsonDocument document = QJsonDocument::fromJson(definition, &error);
+
+        if (error.error != QJsonParseError::NoError)
+        {
+            *errorString = QString("malformed definition: %1").arg(error.errorString());
+            return false;
+        }
+
+        request->measurementDefinition = document.toVariant();
+    }
+
+    request->measurementUuid = QUuid::fromRfc4122(uuid);
+    request->taskId = TaskId(taskId);
+    request->protocol = (NetworkManager::SocketType)protocol;
+    request->binaryVersion = version;
+    return true;
+}
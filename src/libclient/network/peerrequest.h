@@ -0,0 +1,42 @@
+#ifndef PEERREQUEST_H
+#define PEERREQUEST_H
+
+#include "networkmanager.h"
+
+#include <QUuid>
+
+// Offer of a peer to run the server side of a measurement. Peers send it
+// as json or, since version 1, as a binary control message which starts
+// with "GP", a version and the type followed by the payload length.
+// Json offers carry the binary version the sender understands, so the
+// binary form is only sent to peers which announced it.
+//
+// Binary payload (version 1), integers in network byte order:
+//   qint32 task id, 16 bytes measurement uuid (RFC 4122), quint16 port,
+//   quint8 protocol, measurement and peer as quint16 length prefixed
+//   UTF-8, the rest is the measurement definition as compact json.
+class CLIENT_API PeerRequest
+{
+public:
+    PeerRequest();
+
+    QVariant toVariant() const;
+    static PeerRequest fromVariant(const QVariant &variant);
+
+    QByteArray toBinary() const;
+    static bool isBinary(const QByteArray &datagram);
+    static bool fromBinary(const QByteArray &datagram, PeerRequest *request, QString *errorString);
+
+    QVariant measurementDefinition;
+    TaskId taskId;
+    QUuid measurementUuid;
+    QString measurement;
+    QString peer;
+    quint16 port;
+    NetworkManager::SocketType protocol;
+
+    // Binary control version of the sender, 0 for peers which only speak json
+    quint8 binaryVersion;
+};
+
+#endif // PEERREQUEST_H
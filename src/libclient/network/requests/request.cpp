@@ -1,4 +1,5 @@
 #include "request.h"
+#include "../../storage/jsonwriter.h"
 
 class Request::Private
 {
@@ -19,6 +20,11 @@ Request::~Request()
     delete d;
 }
 
+QByteArray Request::toJson() const
+{
+    return JsonWriter::toJson(toVariant());
+}
+
 void Request::setDeviceId(const QString &deviceId)
 {
     if (d->deviceId != deviceId)
@@ -20,6 +20,9 @@ public:
 
     virtual QVariant toVariant() const = 0;
 
+    // Compact json of toVariant(), requests with large payloads write it directly
+    virtual QByteArray toJson() const;
+
     void setDeviceId(const QString &deviceId);
     QString deviceId() const;
 
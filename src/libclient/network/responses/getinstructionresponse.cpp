@@ -23,9 +23,21 @@ QString GetInstructionResponse::killSwitch() const
     return m_killSwitch;
 }
 
+QString GetInstructionResponse::version() const
+{
+    return m_version;
+}
+
+bool GetInstructionResponse::isDelta() const
+{
+    return m_delta;
+}
+
 bool GetInstructionResponse::fillFromVariant(const QVariantMap &variant)
 {
     m_killSwitch= variant.value("kill_switch").toString();
+    m_version = variant.value("version").toString();
+    m_delta = variant.value("delta", false).toBool();
 
     m_taskIds.clear();
 
@@ -48,6 +60,8 @@ bool GetInstructionResponse::fillFromVariant(const QVariantMap &variant)
       m_removeScheduleIds.append(ScheduleId(entry.toInt()));
     }
 
+    LOG_DEBUG(QString("Received %1 instructions (version %2)").arg(m_delta ? "delta" : "full")
+              .arg(m_version.isEmpty() ? "none" : m_version));
     LOG_DEBUG(QString("Received %1 tasks").arg(m_taskIds.size()));
     LOG_DEBUG(QString("Received %1 schedules").arg(m_scheduleIds.size()));
     LOG_DEBUG(QString("Received %1 remove schedules").arg(m_removeScheduleIds.size()));
@@ -10,6 +10,7 @@ class GetInstructionResponse : public Response
 public:
     GetInstructionResponse(QObject *parent = 0)
     : Response(parent)
+    , m_delta(false)
     {
     }
 
@@ -17,6 +18,11 @@ public:
     QList<ScheduleId> scheduleIds() const;
     QList<ScheduleId> removeScheduleIds() const;
     QString killSwitch() const;
+
+    // Delta responses only list schedules changed or removed since the requested version
+    QString version() const;
+    bool isDelta() const;
+
     bool fillFromVariant(const QVariantMap &variant);
 
 protected:
@@ -24,6 +30,8 @@ protected:
     QList<ScheduleId> m_scheduleIds;
     QList<ScheduleId> m_removeScheduleIds;
     QString m_killSwitch;
+    QString m_version;
+    bool m_delta;
 };
 
 
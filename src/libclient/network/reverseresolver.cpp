@@ -0,0 +1,310 @@
+#include "reverseresolver.h"
+#include "dnsclient.h"
+#include "../log/logger.h"
+#include "../timing/clock.h"
+
+#include <QCache>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSet>
+#include <QStringList>
+
+LOGGER(ReverseResolver);
+
+namespace
+{
+    const int defaultCacheLimit = 4096;
+
+    // Names without PTR records are remembered for a while as well
+    const qint64 negativeTtl = 300;
+    const qint64 maximumTtl = 86400;
+
+    struct CacheEntry
+    {
+        QString hostName;
+        qint64 expiry; // monotonic ns
+    };
+
+    struct HostNameCache
+    {
+        HostNameCache()
+        : entries(defaultCacheLimit)
+        {
+        }
+
+        QMutex mutex;
+        QCache<QString, CacheEntry> entries;
+    };
+
+    Q_GLOBAL_STATIC(HostNameCache, hostNameCache)
+
+    void insertCache(const QHostAddress &address, const QString &hostName, qint64 ttl)
+    {
+        CacheEntry *entry = new CacheEntry;
+        entry->hostName = hostName;
+        entry->expiry = Clock::monotonic() + qMin(ttl, maximumTtl) * Q_INT64_C(1000000000);
+
+        QMutexLocker locker(&hostNameCache()->mutex);
+        hostNameCache()->entries.insert(address.toString(), entry);
+    }
+}
+
+class ReverseResolver::Private : public QObject
+{
+    Q_OBJECT
+
+public:
+    Private(ReverseResolver *q)
+    : q(q)
+    , port(53)
+    , cacheHits(0)
+    {
+        connect(&client, SIGNAL(queryFinished(int)), this, SLOT(queryFinished(int)));
+        connect(&client, SIGNAL(finished()), this, SLOT(clientFinished()));
+    }
+
+    ReverseResolver *q;
+
+    DnsClient client;
+    QHostAddress server;
+    quint16 port;
+
+    QHash<int, QHostAddress> queries;
+    QSet<QString> inFlight;
+    QHash<QString, QString> hostNames;
+    int cacheHits;
+
+public slots:
+    void queryFinished(int index);
+    void clientFinished();
+};
+
+void ReverseResolver::Private::queryFinished(int index)
+{
+    QHostAddress address = queries.take(index);
+    DnsClient::Query query = client.query(index);
+
+    QString hostName;
+    qint64 ttl = -1;
+
+    foreach (const DnsClient::Answer &answer, query.answers)
+    {
+        if (answer.type != DnsClient::PTR)
+        {
+            continue;
+        }
+
+        if (hostName.isEmpty())
+        {
+            hostName = answer.value;
+        }
+
+        if (ttl == -1 || answer.ttl < ttl)
+        {
+            ttl = answer.ttl;
+        }
+    }
+
+    // Timeouts and server failures are not cached
+    if (!hostName.isEmpty())
+    {
+        insertCache(address, hostName, ttl);
+    }
+    else if (query.rcode == 0 || query.rcode == 3)
+    {
+        insertCache(address, hostName, negativeTtl);
+    }
+
+    hostNames.insert(address.toString(), hostName);
+    inFlight.remove(address.toString());
+
+    emit q->resolved(address, hostName);
+}
+
+void ReverseResolver::Private::clientFinished()
+{
+    if (inFlight.isEmpty())
+    {
+        emit q->finished();
+    }
+}
+
+ReverseResolver::ReverseResolver(QObject *parent)
+: QObject(parent)
+, d(new Private(this))
+{
+}
+
+ReverseResolver::~ReverseResolver()
+{
+    delete d;
+}
+
+void ReverseResolver::setServer(const QHostAddress &server, quint16 port)
+{
+    d->server = server;
+    d->port = port;
+}
+
+QHostAddress ReverseResolver::server() const
+{
+    return d->server;
+}
+
+void ReverseResolver::setTimeout(int timeout)
+{
+    d->client.setTimeout(timeout);
+}
+
+void ReverseResolver::setRetries(int retries)
+{
+    d->client.setRetries(retries);
+}
+
+void ReverseResolver::lookup(const QList<QHostAddress> &addresses)
+{
+    if (d->server.isNull())
+    {
+        QList<QHostAddress> servers = DnsClient::systemNameservers();
+
+        if (!servers.isEmpty())
+        {
+            d->server = servers.first();
+        }
+    }
+
+    QList<QHostAddress> unresolved;
+
+    foreach (const QHostAddress &address, addresses)
+    {
+        QString key = address.toString();
+        QString hostName;
+
+        if (address.isNull() || d->hostNames.contains(key) || d->inFlight.contains(key))
+        {
+            continue;
+        }
+
+        if (cachedHostName(address, &hostName))
+        {
+            ++d->cacheHits;
+            d->hostNames.insert(key, hostName);
+            emit resolved(address, hostName);
+            continue;
+        }
+
+        if (d->server.isNull())
+        {
+            LOG_WARNING(QString("No name server to resolve %1").arg(key));
+            d->hostNames.insert(key, QString());
+            emit resolved(address, QString());
+            continue;
+        }
+
+        int index = d->client.addQuery(reverseName(address), DnsClient::PTR, d->server, d->port);
+        d->queries.insert(index, address);
+        d->inFlight.insert(key);
+        unresolved.append(address);
+    }
+
+    // Once the client has the queries, its finished() signal reports ours,
+    // even if all of them already failed within start()
+    bool handedOver = !unresolved.isEmpty() && (d->client.isRunning() || d->client.start());
+
+    if (!unresolved.isEmpty() && !handedOver)
+    {
+        LOG_WARNING(QString("Unable to resolve addresses: %1").arg(d->client.errorString()));
+        d->client.clear();
+        d->queries.clear();
+        d->inFlight.clear();
+
+        foreach (const QHostAddress &address, unresolved)
+        {
+            d->hostNames.insert(address.toString(), QString());
+            emit resolved(address, QString());
+        }
+    }
+
+    // Keep finished() asynchronous even if everything came from the cache
+    if (!handedOver && d->inFlight.isEmpty())
+    {
+        QMetaObject::invokeMethod(this, "finished", Qt::QueuedConnection);
+    }
+}
+
+bool ReverseResolver::isRunning() const
+{
+    return !d->inFlight.isEmpty();
+}
+
+QString ReverseResolver::hostName(const QHostAddress &address) const
+{
+    return d->hostNames.value(address.toString());
+}
+
+QHash<QString, QString> ReverseResolver::hostNames() const
+{
+    return d->hostNames;
+}
+
+int ReverseResolver::cacheHits() const
+{
+    return d->cacheHits;
+}
+
+QString ReverseResolver::reverseName(const QHostAddress &address)
+{
+    bool isV4 = false;
+    quint32 v4 = address.toIPv4Address(&isV4);
+
+    if (isV4)
+    {
+        return QString("%1.%2.%3.%4.in-addr.arpa").arg(v4 & 0xff).arg((v4 >> 8) & 0xff).arg((v4 >> 16) & 0xff)
+               .arg(v4 >> 24);
+    }
+
+    // One label per nibble, starting with the lowest
+    Q_IPV6ADDR v6 = address.toIPv6Address();
+    QStringList nibbles;
+
+    for (int i = 15; i >= 0; --i)
+    {
+        nibbles << QString::number(v6[i] & 0x0f, 16) << QString::number(v6[i] >> 4, 16);
+    }
+
+    return nibbles.join('.') + ".ip6.arpa";
+}
+
+bool ReverseResolver::cachedHostName(const QHostAddress &address, QString *hostName)
+{
+    QMutexLocker locker(&hostNameCache()->mutex);
+    CacheEntry *entry = hostNameCache()->entries.object(address.toString());
+
+    if (!entry)
+    {
+        return false;
+    }
+
+    if (entry->expiry <= Clock::monotonic())
+    {
+        hostNameCache()->entries.remove(address.toString());
+        return false;
+    }
+
+    *hostName = entry->hostName;
+    return true;
+}
+
+void ReverseResolver::setCacheLimit(int entries)
+{
+    QMutexLocker locker(&hostNameCache()->mutex);
+    hostNameCache()->entries.setMaxCost(entries);
+}
+
+void ReverseResolver::clearCache()
+{
+    QMutexLocker locker(&hostNameCache()->mutex);
+    hostNameCache()->entries.clear();
+}
+
+#include "reverseresolver.moc"
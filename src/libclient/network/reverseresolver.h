@@ -0,0 +1,53 @@
+#ifndef REVERSERESOLVER_H
+#define REVERSERESOLVER_H
+
+#include "../export.h"
+
+#include <QObject>
+#include <QHostAddress>
+#include <QHash>
+
+// Resolves the names of many addresses in parallel with PTR queries. The
+// names are kept in a cache shared by all instances which respects the
+// ttl of the answers and forgets the least recently used entries first.
+class CLIENT_API ReverseResolver : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ReverseResolver(QObject *parent = 0);
+    ~ReverseResolver();
+
+    // Defaults to the first system name server
+    void setServer(const QHostAddress &server, quint16 port = 53);
+    QHostAddress server() const;
+
+    void setTimeout(int timeout);
+    void setRetries(int retries);
+
+    // Cached addresses are answered at once, all others are queried in
+    // parallel. May be called again while the previous lookups are running.
+    void lookup(const QList<QHostAddress> &addresses);
+    bool isRunning() const;
+
+    // Empty if the address has no name or is not resolved yet
+    QString hostName(const QHostAddress &address) const;
+    QHash<QString, QString> hostNames() const;
+    int cacheHits() const;
+
+    static QString reverseName(const QHostAddress &address);
+
+    static bool cachedHostName(const QHostAddress &address, QString *hostName);
+    static void setCacheLimit(int entries);
+    static void clearCache();
+
+signals:
+    void resolved(const QHostAddress &address, const QString &hostName);
+    void finished();
+
+protected:
+    class Private;
+    Private *d;
+};
+
+#endif // REVERSERESOLVER_H
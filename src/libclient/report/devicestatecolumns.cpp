@@ -0,0 +1,249 @@
+#include "devicestatecolumns.h"
+#include "../storage/jsonwriter.h"
+
+#include <QSet>
+
+#include <limits>
+
+namespace
+{
+    bool isInteger(const QVariant &value)
+    {
+        switch (value.userType())
+        {
+        case QMetaType::Int:
+        case QMetaType::UInt:
+        case QMetaType::Short:
+        case QMetaType::UShort:
+        case QMetaType::Long:
+        case QMetaType::LongLong:
+            return true;
+        case QMetaType::ULong:
+        case QMetaType::ULongLong:
+            // Differences are taken as qint64
+            return value.toULongLong() <= quint64(std::numeric_limits<qint64>::max());
+        default:
+            return false;
+        }
+    }
+
+    // QJsonDocument turns null into an invalid QVariant or a nullptr one
+    bool isNull(const QVariant &value)
+    {
+        return !value.isValid() || value.userType() == QMetaType::Nullptr;
+    }
+}
+
+DeviceStateColumns::DeviceStateColumns()
+: m_count(0)
+{
+}
+
+DeviceStateColumns::DeviceStateColumns(const QList<QVariantMap> &snapshots)
+: m_count(snapshots.size())
+{
+    QSet<QString> keys;
+
+    foreach (const QVariantMap &snapshot, snapshots)
+    {
+        for (QVariantMap::const_iterator i = snapshot.constBegin(); i != snapshot.constEnd(); ++i)
+        {
+            keys.insert(i.key());
+        }
+    }
+
+    QStringList names = keys.toList();
+    names.sort();
+
+    foreach (const QString &name, names)
+    {
+        Column column;
+        column.name = name;
+        column.delta = true;
+
+        // Counters change a little all the time, their differences are shorter
+        foreach (const QVariantMap &snapshot, snapshots)
+        {
+            if (!isInteger(snapshot.value(name)))
+            {
+                column.delta = false;
+                break;
+            }
+        }
+
+        QVariant previous;
+        int previousIndex = 0;
+
+        for (int i = 0; i < snapshots.size(); ++i)
+        {
+            QVariant value = snapshots.at(i).value(name);
+
+            if (i > 0 && value == previous)
+            {
+                continue;
+            }
+
+            column.at.append(i - previousIndex);
+
+            if (column.delta && i > 0)
+            {
+                column.values.append(value.toLongLong() - previous.toLongLong());
+            }
+            else
+            {
+                column.values.append(value);
+            }
+
+            previous = value;
+            previousIndex = i;
+        }
+
+        m_columns.append(column);
+    }
+}
+
+int DeviceStateColumns::count() const
+{
+    return m_count;
+}
+
+QList<QVariantMap> DeviceStateColumns::snapshots() const
+{
+    QList<QVariantMap> snapshots;
+    snapshots.reserve(m_count);
+
+    for (int i = 0; i < m_count; ++i)
+    {
+        snapshots.append(QVariantMap());
+    }
+
+    foreach (const Column &column, m_columns)
+    {
+        int index = 0;
+        qint64 sum = 0;
+
+        for (int k = 0; k < column.at.size() && k < column.values.size(); ++k)
+        {
+            if (column.at.at(k) < 0)
+            {
+                break;
+            }
+
+            index += column.at.at(k);
+
+            if (index >= m_count)
+            {
+                break;
+            }
+
+            int end = m_count;
+
+            if (k + 1 < column.at.size() && column.at.at(k + 1) >= 0)
+            {
+                end = qMin(index + column.at.at(k + 1), m_count);
+            }
+
+            QVariant value = column.values.at(k);
+
+            if (column.delta)
+            {
+                sum = k ? sum + value.toLongLong() : value.toLongLong();
+                value = sum;
+            }
+            else if (isNull(value))
+            {
+                continue;
+            }
+
+            for (int i = index; i < end; ++i)
+            {
+                snapshots[i].insert(column.name, value);
+            }
+        }
+    }
+
+    return snapshots;
+}
+
+void DeviceStateColumns::writeJson(JsonWriter *writer) const
+{
+    writer->beginObject();
+    writer->name("columns");
+    writer->beginObject();
+
+    foreach (const Column &column, m_columns)
+    {
+        writer->name(column.name);
+        writer->beginObject();
+        writer->name("at");
+        writer->beginArray();
+
+        foreach (int at, column.at)
+        {
+            writer->write(at);
+        }
+
+        writer->endArray();
+        writer->name(column.delta ? "delta" : "value");
+        writer->write(QVariant(column.values));
+        writer->endObject();
+    }
+
+    writer->endObject();
+    writer->name("count");
+    writer->write(m_count);
+    writer->endObject();
+}
+
+DeviceStateColumns DeviceStateColumns::fromVariant(const QVariant &variant)
+{
+    QVariantMap map = variant.toMap();
+    QVariantMap columns = map.value("columns").toMap();
+
+    DeviceStateColumns states;
+    states.m_count = qMax(0, map.value("count").toInt());
+
+    for (QVariantMap::const_iterator i = columns.constBegin(); i != columns.constEnd(); ++i)
+    {
+        QVariantMap values = i.value().toMap();
+
+        Column column;
+        column.name = i.key();
+        column.delta = values.contains("delta");
+        column.values = values.value(column.delta ? "delta" : "value").toList();
+
+        foreach (const QVariant &at, values.value("at").toList())
+        {
+            column.at.append(at.toInt());
+        }
+
+        states.m_columns.append(column);
+    }
+
+    return states;
+}
+
+QVariant DeviceStateColumns::toVariant() const
+{
+    QVariantMap columns;
+
+    foreach (const Column &column, m_columns)
+    {
+        QVariantList at;
+
+        foreach (int distance, column.at)
+        {
+            at.append(distance);
+        }
+
+        QVariantMap map;
+        map.insert("at", at);
+        map.insert(column.delta ? "delta" : "value", column.values);
+        columns.insert(column.name, map);
+    }
+
+    QVariantMap map;
+    map.insert("columns", columns);
+    map.insert("count", m_count);
+    return map;
+}
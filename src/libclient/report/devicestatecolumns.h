@@ -0,0 +1,49 @@
+#ifndef DEVICESTATECOLUMNS_H
+#define DEVICESTATECOLUMNS_H
+
+#include "../serializable.h"
+
+#include <QList>
+#include <QStringList>
+
+class JsonWriter;
+
+// The device state snapshots (LocalInformation::getVariables()) of a report
+// stored column by column. A column keeps a value only at the snapshots where
+// it changes, integer columns as the difference to the previous change:
+//
+//   {"count": 4, "columns": {"used_traffic": {"at": [0, 2], "delta": [1000, 250]}, ...}}
+//
+// "at" holds the distance to the previous change, the first one counts from
+// zero. Keys missing in a snapshot are stored as null.
+class CLIENT_API DeviceStateColumns : public Serializable
+{
+public:
+    DeviceStateColumns();
+    explicit DeviceStateColumns(const QList<QVariantMap> &snapshots);
+
+    int count() const;
+    QList<QVariantMap> snapshots() const;
+
+    void writeJson(JsonWriter *writer) const;
+
+    // Storage
+    static DeviceStateColumns fromVariant(const QVariant &variant);
+
+    // Serializable interface
+    QVariant toVariant() const;
+
+private:
+    struct Column
+    {
+        QString name;
+        QList<int> at;
+        QVariantList values;
+        bool delta;
+    };
+
+    int m_count;
+    QList<Column> m_columns;
+};
+
+#endif // DEVICESTATECOLUMNS_H
@@ -1,8 +1,47 @@
 #include "report.h"
+#include "devicestatecolumns.h"
 #include "../types.h"
+#include "../storage/jsonwriter.h"
+#include "../storage/jsonreader.h"
 
 #include <QUuid>
 
+namespace
+{
+    const int storageFormatVersion = 2;
+
+    // The pre and post info of every result in turn
+    DeviceStateColumns deviceStates(const ResultList &results)
+    {
+        QList<QVariantMap> snapshots;
+        snapshots.reserve(2 * results.size());
+
+        foreach (const Result &result, results)
+        {
+            snapshots.append(result.preInfo());
+            snapshots.append(result.postInfo());
+        }
+
+        return DeviceStateColumns(snapshots);
+    }
+
+    void resolveDeviceStates(ResultList *results, const DeviceStateColumns &states)
+    {
+        if (states.count() != 2 * results->size())
+        {
+            return;
+        }
+
+        QList<QVariantMap> snapshots = states.snapshots();
+
+        for (int i = 0; i < results->size(); ++i)
+        {
+            (*results)[i].setPreInfo(snapshots.at(2 * i));
+            (*results)[i].setPostInfo(snapshots.at(2 * i + 1));
+        }
+    }
+}
+
 class ReportData : public QSharedData
 {
 public:
@@ -63,11 +102,18 @@ void Report::setTaskId(const TaskId &id)
 Report Report::fromVariant(const QVariant &variant)
 {
     QVariantMap map = variant.toMap();
+    ResultList results = listFromVariant<Result>(map.value("results"));
+
+    // The upload format and older reports have the device state in each result
+    if (map.contains("device_state"))
+    {
+        resolveDeviceStates(&results, DeviceStateColumns::fromVariant(map.value("device_state")));
+    }
 
     return Report(TaskId(map.value("task_id").toInt()),
                   map.value("report_time").toDateTime(),
                   map.value("app_version").toString(),
-                  listFromVariant<Result>(map.value("results")));
+                  results);
 }
 
 TaskId Report::taskId() const
@@ -107,10 +153,143 @@ ResultList Report::results() const
 
 QVariant Report::toVariant() const
 {
+    return toVariant(UploadFormat);
+}
+
+QVariant Report::toVariant(Format format) const
+{
+    QVariantList results;
+
+    foreach (const Result &result, d->results)
+    {
+        results.append(format == StorageFormat ? result.toVariantStripped() : result.toVariant());
+    }
+
     QVariantMap map;
     map.insert("task_id", taskId().toInt());
     map.insert("report_time", dateTime());
     map.insert("app_version", appVersion());
-    map.insert("results", listToVariant(results()));
+    map.insert("results", results);
+
+    if (format == StorageFormat)
+    {
+        map.insert("format_version", storageFormatVersion);
+        map.insert("device_state", deviceStates(d->results).toVariant());
+    }
+
     return map;
 }
+
+void Report::writeJson(JsonWriter *writer, Format format) const
+{
+    writer->beginObject();
+    writer->name("app_version");
+    writer->write(d->appVersion);
+
+    if (format == StorageFormat)
+    {
+        writer->name("device_state");
+        deviceStates(d->results).writeJson(writer);
+        writer->name("format_version");
+        writer->write(storageFormatVersion);
+    }
+
+    writer->name("report_time");
+    writer->write(d->dateTime);
+    writer->name("results");
+    writer->beginArray();
+
+    foreach (const Result &result, d->results)
+    {
+        if (format == StorageFormat)
+        {
+            result.writeJsonStripped(writer);
+        }
+        else
+        {
+            result.writeJson(writer);
+        }
+    }
+
+    writer->endArray();
+    writer->name("task_id");
+    writer->write(d->taskId.toInt());
+    writer->endObject();
+}
+
+QByteArray Report::toJson(Format format) const
+{
+    QByteArray json;
+    JsonWriter writer(&json);
+    writeJson(&writer, format);
+    return json;
+}
+
+Report Report::readJson(JsonReader *reader)
+{
+    Report report;
+    QVariant states;
+
+    if (reader->token() != JsonReader::BeginObject)
+    {
+        reader->skipValue();
+        return report;
+    }
+
+    while (reader->next() == JsonReader::Name)
+    {
+        QString name = reader->string();
+        reader->next();
+
+        if (name == QLatin1String("task_id"))
+        {
+            report.d->taskId = TaskId(int(reader->toInteger()));
+        }
+        else if (name == QLatin1String("report_time"))
+        {
+            report.d->dateTime = reader->toDateTime();
+        }
+        else if (name == QLatin1String("app_version"))
+        {
+            report.d->appVersion = reader->string();
+        }
+        else if (name == QLatin1String("device_state"))
+        {
+            states = reader->readValue();
+        }
+        else if (name == QLatin1String("results") && reader->token() == JsonReader::BeginArray)
+        {
+            while (reader->next() != JsonReader::EndArray && !reader->hasError())
+            {
+                report.d->results.append(Result::readJson(reader));
+            }
+        }
+        else
+        {
+            reader->skipValue();
+        }
+    }
+
+    if (states.isValid())
+    {
+        resolveDeviceStates(&report.d->results, DeviceStateColumns::fromVariant(states));
+    }
+
+    return report;
+}
+
+bool Report::fromJson(const QByteArray &json, Report *report, QString *errorString)
+{
+    JsonReader reader(json);
+    reader.next();
+
+    *report = readJson(&reader);
+
+    if (reader.next() != JsonReader::EndDocument)
+    {
+        *errorString = reader.errorString();
+        return false;
+    }
+
+    return true;
+}
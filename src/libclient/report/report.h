@@ -10,6 +10,15 @@ typedef QList<Report> ReportList;
 class CLIENT_API Report : public Serializable
 {
 public:
+    // Where the device state of the results goes
+    enum Format
+    {
+        // pre_info and post_info in every result, what the collector reads
+        UploadFormat,
+        // format_version 2, one device_state member with DeviceStateColumns
+        StorageFormat
+    };
+
     Report();
     Report(const Report &other);
     Report(const TaskId &taskId, const QDateTime &dateTime, const QString &appVersion, const ResultList &results);
@@ -41,6 +50,14 @@ public:
 
     // Serializable interface
     QVariant toVariant() const;
+    QVariant toVariant(Format format) const;
+
+    // Same json as toVariant(), written and read without the QVariantMap.
+    // Reading takes both formats.
+    void writeJson(JsonWriter *writer, Format format = UploadFormat) const;
+    QByteArray toJson(Format format = UploadFormat) const;
+    static Report readJson(JsonReader *reader);
+    static bool fromJson(const QByteArray &json, Report *report, QString *errorString);
 
 private:
     QSharedDataPointer<class ReportData> d;
@@ -1,18 +1,26 @@
 #include "reportstorage.h"
 #include "../storage/storagepaths.h"
 #include "../log/logger.h"
+#include "../storage/jsonwriter.h"
 #include "types.h"
 
 #include <QPointer>
 #include <QDir>
 #include <QCoreApplication>
 #include <QUuid>
-#include <QJsonDocument>
 #include <QFile>
 #include <QDebug>
 
 LOGGER(ReportStorage);
 
+namespace
+{
+    bool isWhitespace(char c)
+    {
+        return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+    }
+}
+
 class ReportStorage::Private : public QObject
 {
     Q_OBJECT
@@ -58,7 +66,6 @@ public:
     // Functions
     void store(const Report &report, bool localStore = true);
     void storeLocalCopy(const Report &report);
-    QVariantList loadLocalCopy(const Report &report) const;
     QString fileNameForReport(const Report &report) const;
     QString fileNameForLocalCopy(const Report &report) const;
 
@@ -70,13 +77,11 @@ public slots:
 
 void ReportStorage::Private::store(const Report &report, bool localStore)
 {
-    QJsonDocument document = QJsonDocument::fromVariant(report.toVariant());
-
     QFile file(dir.absoluteFilePath(fileNameForReport(report)));
 
     if (file.open(QIODevice::WriteOnly))
     {
-        file.write(document.toJson());
+        file.write(report.toJson(Report::StorageFormat));
         file.close();
     }
     else
@@ -92,55 +97,74 @@ void ReportStorage::Private::store(const Report &report, bool localStore)
 
 void ReportStorage::Private::storeLocalCopy(const Report &report)
 {
+    QFile file(localCopyDir.absoluteFilePath(fileNameForLocalCopy(report)));
 
-    QVariantList results(loadLocalCopy(report));
-
-    if (report.results().length() > 0)
+    if (!file.open(QIODevice::ReadWrite))
     {
-        // only add the last (latest) result to avoid duplicates
-        results.append(report.results()[report.results().length()-1].toVariantStripped());
+        LOG_ERROR(QString("Unable to open file: %1").arg(file.errorString()));
+        return;
     }
 
-    QJsonDocument document = QJsonDocument::fromVariant(results);
-    QFile file(localCopyDir.absoluteFilePath(fileNameForLocalCopy(report)));
+    // The local copy is one json array, new results go in front of its
+    // closing bracket instead of parsing and rewriting the whole file
+    QByteArray data = file.readAll();
+    int begin = 0;
+    int end = data.size();
 
-    if (file.open(QIODevice::WriteOnly))
+    while (end > begin && isWhitespace(data.at(end - 1)))
     {
-        file.write(document.toJson());
-        file.close();
+        --end;
     }
-    else
+
+    while (begin < end && isWhitespace(data.at(begin)))
     {
-        LOG_ERROR(QString("Unable to open file: %1").arg(file.errorString()));
+        ++begin;
     }
-}
 
-QVariantList ReportStorage::Private::loadLocalCopy(const Report &report) const
-{
-    QVariantList out;
-    QFile file(localCopyDir.absoluteFilePath(fileNameForLocalCopy(report)));
+    QByteArray tail;
+    qint64 position = 0;
 
-    if (!file.exists())
+    if (end - begin >= 2 && data.at(begin) == '[' && data.at(end - 1) == ']')
     {
-        return out;
-    }
+        position = end - 1;
 
-    file.open(QIODevice::ReadOnly);
+        int last = end - 1;
 
-    // Error checking
-    QJsonParseError error;
-    QJsonDocument document = QJsonDocument::fromJson(file.readAll(), &error);
+        while (last > begin + 1 && isWhitespace(data.at(last - 1)))
+        {
+            --last;
+        }
 
-    if (error.error == QJsonParseError::NoError)
-    {
-        out = document.toVariant().toList();
+        if (last > begin + 1)
+        {
+            tail.append(',');
+        }
     }
     else
     {
-        LOG_ERROR(QString("Error loading file %1: %2").arg(file.fileName()).arg(error.errorString()));
+        if (begin != end)
+        {
+            LOG_ERROR(QString("Error loading file %1: not a json array").arg(file.fileName()));
+        }
+
+        tail.append('[');
+    }
+
+    ResultList results = report.results();
+
+    if (results.length() > 0)
+    {
+        // only add the last (latest) result to avoid duplicates
+        JsonWriter writer(&tail);
+        results.at(results.length() - 1).writeJsonStripped(&writer);
     }
 
-    return out;
+    tail.append(']');
+
+    if (!file.seek(position) || file.write(tail) != tail.size() || !file.resize(position + tail.size()))
+    {
+        LOG_ERROR(QString("Unable to write file: %1").arg(file.errorString()));
+    }
 }
 
 QString ReportStorage::Private::fileNameForReport(const Report &report) const
@@ -208,18 +232,16 @@ void ReportStorage::loadData()
         QFile file(d->dir.absoluteFilePath(fileName));
         file.open(QIODevice::ReadOnly);
 
-        // Error checking
-        QJsonParseError error;
-        QJsonDocument document = QJsonDocument::fromJson(file.readAll(), &error);
+        Report report;
+        QString errorString;
 
-        if (error.error == QJsonParseError::NoError)
+        if (Report::fromJson(file.readAll(), &report, &errorString))
         {
-            Report report = Report::fromVariant(document.toVariant());
             d->scheduler->addReport(report);
         }
         else
         {
-            LOG_ERROR(QString("Error loading file %1: %2").arg(d->dir.absoluteFilePath(fileName)).arg(error.errorString()));
+            LOG_ERROR(QString("Error loading file %1: %2").arg(d->dir.absoluteFilePath(fileName)).arg(errorString));
         }
     }
 
@@ -2,8 +2,7 @@
 #include "../task/taskexecutor.h"
 #include "../log/logger.h"
 #include "../timing/ondemandtiming.h"
-#include "client.h"
-#include "controller/ntpcontroller.h"
+#include "../timing/clock.h"
 
 #include <QDir>
 #include <QTimer>
@@ -11,9 +10,26 @@
 #include <QDebug>
 #include <QPointer>
 #include <QSet>
+#include <QVector>
+
+#include <algorithm>
 
 LOGGER(Scheduler);
 
+namespace
+{
+    struct PendingEntry
+    {
+        qint64 nextRun;
+        ScheduleDefinition test;
+
+        bool operator<(const PendingEntry &other) const
+        {
+            return nextRun < other.nextRun;
+        }
+    };
+}
+
 class Scheduler::Private : public QObject
 {
     Q_OBJECT
@@ -46,6 +62,7 @@ public:
     void updateTimer();
     int enqueue(const ScheduleDefinition &testDefinition);
     int dequeue(const ScheduleId &id);
+    void update(const ScheduleDefinitionList &enqueued, const QList<ScheduleId> &dequeued);
 
 public slots:
     void timeout();
@@ -81,18 +98,25 @@ void Scheduler::Private::updateTimer()
 int Scheduler::Private::enqueue(const ScheduleDefinition &testDefinition)
 {
     // abort if test-id is already in scheduler or if the test has no next run time
-    if (testIds.contains(testDefinition.id()) || !testDefinition.timing()->nextRun().isValid())
+    if (testIds.contains(testDefinition.id()))
     {
         return -1;
     }
 
-    qint64 timeLeft = testDefinition.timing()->timeLeft();
+    // compare all entries against the same point in time
+    qint64 now = Clock::now();
+    qint64 nextRun = testDefinition.timing()->nextRunNsecs(now);
+
+    if (nextRun == 0)
+    {
+        return -1;
+    }
 
     for (int i = 0; i < tests.size(); i++)
     {
         const ScheduleDefinition &td = tests.at(i);
 
-        if (timeLeft < td.timing()->timeLeft())
+        if (nextRun < td.timing()->nextRunNsecs(now))
         {
             tests.insert(i, testDefinition);
             testIds.insert(testDefinition.id());
@@ -110,6 +134,7 @@ int Scheduler::Private::enqueue(const ScheduleDefinition &testDefinition)
 
     tests.append(testDefinition);
     testIds.insert(testDefinition.id());
+    allTestIds.insert(testDefinition.id());
 
     // update the timer if the list was empty
     if (tests.size() == 1)
@@ -126,6 +151,12 @@ int Scheduler::Private::dequeue(const ScheduleId &id)
     td.setId(id);
 
     int position = tests.indexOf(td);
+
+    if (position == -1)
+    {
+        return -1;
+    }
+
     tests.removeAt(position);
     testIds.remove(id);
     allTestIds.remove(id);
@@ -140,15 +171,132 @@ int Scheduler::Private::dequeue(const ScheduleId &id)
     return position;
 }
 
+void Scheduler::Private::update(const ScheduleDefinitionList &enqueued, const QList<ScheduleId> &dequeued)
+{
+    QSet<ScheduleId> removeIds = dequeued.toSet();
+    ScheduleDefinitionList removed;
+    ScheduleDefinitionList added;
+
+    // an id which is dequeued and enqueued again is replaced
+    if (!removeIds.isEmpty())
+    {
+        ScheduleDefinitionList remaining;
+        remaining.reserve(tests.size());
+
+        foreach (const ScheduleDefinition &td, tests)
+        {
+            if (removeIds.contains(td.id()))
+            {
+                removed.append(td);
+                testIds.remove(td.id());
+                allTestIds.remove(td.id());
+            }
+            else
+            {
+                remaining.append(td);
+            }
+        }
+
+        tests = remaining;
+
+        for (int i = onDemandTests.size() - 1; i >= 0; i--)
+        {
+            const ScheduleDefinition &td = onDemandTests.at(i);
+
+            if (removeIds.contains(td.id()))
+            {
+                onDemandTestIds.remove(td.id());
+                allTestIds.remove(td.id());
+                onDemandTests.removeAt(i);
+            }
+        }
+    }
+
+    // compare all entries against the same point in time
+    qint64 now = Clock::now();
+    QVector<PendingEntry> pending;
+    pending.reserve(enqueued.size());
+
+    foreach (const ScheduleDefinition &td, enqueued)
+    {
+        if (allTestIds.contains(td.id()))
+        {
+            continue;
+        }
+
+        if (td.timing()->type() == "ondemand")
+        {
+            onDemandTests.append(td);
+            onDemandTestIds.insert(td.id());
+            allTestIds.insert(td.id());
+            continue;
+        }
+
+        PendingEntry entry;
+        entry.nextRun = td.timing()->nextRunNsecs(now);
+        entry.test = td;
+
+        if (entry.nextRun != 0)
+        {
+            pending.append(entry);
+            testIds.insert(td.id());
+            allTestIds.insert(td.id());
+        }
+    }
+
+    // sort the new entries once and merge them into the queue
+    std::stable_sort(pending.begin(), pending.end());
+
+    if (!pending.isEmpty())
+    {
+        ScheduleDefinitionList merged;
+        merged.reserve(tests.size() + pending.size());
+
+        int next = 0;
+
+        foreach (const ScheduleDefinition &td, tests)
+        {
+            qint64 nextRun = td.timing()->nextRunNsecs(now);
+
+            while (next < pending.size() && pending.at(next).nextRun < nextRun)
+            {
+                merged.append(pending.at(next).test);
+                added.append(pending.at(next).test);
+                next++;
+            }
+
+            merged.append(td);
+        }
+
+        for (; next < pending.size(); next++)
+        {
+            merged.append(pending.at(next).test);
+            added.append(pending.at(next).test);
+        }
+
+        tests = merged;
+    }
+
+    if (added.isEmpty() && removed.isEmpty())
+    {
+        return;
+    }
+
+    LOG_DEBUG(QString("Scheduler updated: %1 added, %2 removed").arg(added.size()).arg(removed.size()));
+
+    updateTimer();
+    emit q->testsChanged(added, removed);
+}
+
 void Scheduler::Private::timeout()
 {
     // get the test and execute it
     ScheduleDefinition td = tests.at(0);
 
-    QDateTime t = td.timing()->lastExecution();
+    qint64 lastExecution = td.timing()->lastExecutionNsecs();
 
     // don't schedule if this measurement was executed in the last 1,5s
-    if (t.isValid() && t.msecsTo(Client::instance()->ntpController()->currentDateTime()) < 1500)
+    if (lastExecution != 0 && Clock::now() - lastExecution < Q_INT64_C(1500000000))
     {
         LOG_DEBUG("Scheduler timeout to soon after last execution, skipping.")
         updateTimer();
@@ -209,7 +357,10 @@ void Scheduler::enqueue(const ScheduleDefinition &testDefinition)
     {
         int pos = d->enqueue(testDefinition);
 
-        emit testAdded(testDefinition, pos);
+        if (pos != -1)
+        {
+            emit testAdded(testDefinition, pos);
+        }
     }
     else
     {
@@ -221,7 +372,39 @@ void Scheduler::enqueue(const ScheduleDefinition &testDefinition)
 
 void Scheduler::dequeue(const ScheduleId &id)
 {
-    d->dequeue(id);
+    if (d->onDemandTestIds.contains(id))
+    {
+        for (int i = 0; i < d->onDemandTests.size(); i++)
+        {
+            if (d->onDemandTests.at(i).id() == id)
+            {
+                d->onDemandTests.removeAt(i);
+                break;
+            }
+        }
+
+        d->onDemandTestIds.remove(id);
+        d->allTestIds.remove(id);
+    }
+    else
+    {
+        d->dequeue(id);
+    }
+}
+
+void Scheduler::update(const ScheduleDefinitionList &enqueued, const QList<ScheduleId> &dequeued)
+{
+    d->update(enqueued, dequeued);
+}
+
+void Scheduler::enqueueMany(const ScheduleDefinitionList &testDefinitions)
+{
+    d->update(testDefinitions, QList<ScheduleId>());
+}
+
+void Scheduler::dequeueMany(const QList<ScheduleId> &ids)
+{
+    d->update(ScheduleDefinitionList(), ids);
 }
 
 void Scheduler::execute(const ScheduleDefinition &testDefinition)
@@ -246,17 +429,9 @@ int Scheduler::executeOnDemandTest(const ScheduleId &id)
     return -1;
 }
 
-bool Scheduler::knownTestId(const ScheduleId &id)
+bool Scheduler::knownTestId(const ScheduleId &id) const
 {
-    foreach (const ScheduleId &testId, d->allTestIds)
-    {
-        if (testId == id)
-        {
-            return true;
-        }
-    }
-
-    return false;
+    return d->allTestIds.contains(id);
 }
 
 #include "scheduler.moc"
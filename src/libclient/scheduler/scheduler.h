@@ -21,15 +21,21 @@ public:
     void enqueue(const ScheduleDefinition &testDefinition);
     void dequeue(const ScheduleId &id);
 
+    // Batch mutations: one sort, one timer update and a single testsChanged()
+    void update(const ScheduleDefinitionList &enqueued, const QList<ScheduleId> &dequeued);
+    void enqueueMany(const ScheduleDefinitionList &testDefinitions);
+    void dequeueMany(const QList<ScheduleId> &ids);
+
     void execute(const ScheduleDefinition &testDefinition);
     int executeOnDemandTest(const ScheduleId &id);
 
-    bool knownTestId(const ScheduleId &id);
+    bool knownTestId(const ScheduleId &id) const;
 
 signals:
     void testAdded(const ScheduleDefinition &test, int position);
     void testRemoved(const ScheduleDefinition &test, int position);
     void testMoved(const ScheduleDefinition &test, int from, int to);
+    void testsChanged(const ScheduleDefinitionList &added, const ScheduleDefinitionList &removed);
 
 protected:
     class Private;
@@ -26,6 +26,7 @@ public slots:
     void testAdded(const ScheduleDefinition &test, int position);
     void testRemoved(const ScheduleDefinition &test, int position);
     void testMoved(const ScheduleDefinition &test, int from, int to);
+    void testsChanged();
 
     void onTimeout();
 };
@@ -56,6 +57,12 @@ void SchedulerModel::Private::testMoved(const ScheduleDefinition &test, int from
     q->endMoveRows();
 }
 
+void SchedulerModel::Private::testsChanged()
+{
+    // batch updates are cheaper as a single reset than as row inserts
+    q->reset();
+}
+
 void SchedulerModel::Private::onTimeout()
 {
     QModelIndex topLeft = q->index(0,0);
@@ -90,6 +97,8 @@ void SchedulerModel::setScheduler(Scheduler *scheduler)
                                                                                                          int)));
         disconnect(d->scheduler.data(), SIGNAL(testMoved(ScheduleDefinition, int, int)), d, SLOT(testMoved(ScheduleDefinition,
                                                                                                           int, int)));
+        disconnect(d->scheduler.data(), SIGNAL(testsChanged(ScheduleDefinitionList, ScheduleDefinitionList)), d,
+                   SLOT(testsChanged()));
     }
 
     d->scheduler = scheduler;
@@ -100,6 +109,8 @@ void SchedulerModel::setScheduler(Scheduler *scheduler)
         connect(d->scheduler.data(), SIGNAL(testRemoved(ScheduleDefinition, int)), d, SLOT(testRemoved(ScheduleDefinition, int)));
         connect(d->scheduler.data(), SIGNAL(testMoved(ScheduleDefinition, int, int)), d, SLOT(testMoved(ScheduleDefinition, int,
                                                                                                        int)));
+        connect(d->scheduler.data(), SIGNAL(testsChanged(ScheduleDefinitionList, ScheduleDefinitionList)), d,
+                SLOT(testsChanged()));
     }
 
     emit schedulerChanged();
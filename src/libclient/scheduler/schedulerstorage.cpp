@@ -1,10 +1,15 @@
 #include "schedulerstorage.h"
 #include "scheduler.h"
 #include "../storage/storagepaths.h"
+#include "../timing/timingfactory.h"
 #include "../log/logger.h"
 #include "types.h"
 
 #include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QHash>
 #include <QPointer>
 #include <QDebug>
 #include <QCoreApplication>
@@ -12,6 +17,41 @@
 
 LOGGER(SchedulerStorage);
 
+namespace
+{
+    // "GSCH" followed by the schema version
+    const quint32 magic = 0x47534348;
+    const quint32 schemaVersion = 1;
+
+    const char *storeFileName = "schedules.dat";
+
+    // Rewrite the snapshot if the log grew this much beyond the live schedules
+    const int compactionSlack = 64;
+
+    enum Operation
+    {
+        AddOperation = 1,
+        RemoveOperation = 2
+    };
+
+    QByteArray encode(Operation operation, const ScheduleDefinition &test)
+    {
+        QByteArray record;
+        QDataStream out(&record, QIODevice::WriteOnly);
+        out.setVersion(QDataStream::Qt_5_0);
+
+        out << (quint8)operation << (qint32)test.id().toInt();
+
+        if (operation == AddOperation)
+        {
+            out << (qint32)test.taskId().toInt() << test.name() << test.timing()->toVariant()
+                << test.precondition().toVariant() << test.measurementDefinitionData();
+        }
+
+        return record;
+    }
+}
+
 class SchedulerStorage::Private : public QObject
 {
     Q_OBJECT
@@ -41,34 +81,207 @@ public:
     QDir dir;
 
     // Functions
-    void store(const ScheduleDefinition &test);
-    QString fileNameForTest(const ScheduleDefinition &test) const;
+    QString storePath() const;
+    bool writeSnapshot(const ScheduleDefinitionList &tests);
+    void append(const QList<QByteArray> &records);
+    bool readStore(ScheduleDefinitionList *tests, int *records);
+    ScheduleDefinitionList readLegacyFiles();
 
 public slots:
     void testAdded(const ScheduleDefinition &test, int position);
     void testRemoved(const ScheduleDefinition &test, int position);
+    void testsChanged(const ScheduleDefinitionList &added, const ScheduleDefinitionList &removed);
 };
 
-void SchedulerStorage::Private::store(const ScheduleDefinition &test)
+QString SchedulerStorage::Private::storePath() const
+{
+    return dir.absoluteFilePath(storeFileName);
+}
+
+bool SchedulerStorage::Private::writeSnapshot(const ScheduleDefinitionList &tests)
 {
-    QJsonDocument document = QJsonDocument::fromVariant(test.toVariant());
+    QSaveFile file(storePath());
+
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        LOG_ERROR(QString("Unable to open file: %1").arg(file.errorString()));
+        return false;
+    }
 
-    QFile file(dir.absoluteFilePath(fileNameForTest(test)));
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << magic << schemaVersion;
 
-    if (file.open(QIODevice::WriteOnly))
+    foreach (const ScheduleDefinition &test, tests)
     {
-        file.write(document.toJson());
-        file.close();
+        out << encode(AddOperation, test);
     }
-    else
+
+    if (!file.commit())
+    {
+        LOG_ERROR(QString("Unable to write file: %1").arg(file.errorString()));
+        return false;
+    }
+
+    return true;
+}
+
+void SchedulerStorage::Private::append(const QList<QByteArray> &records)
+{
+    QFile file(storePath());
+    bool exists = file.exists();
+
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append))
     {
         LOG_ERROR(QString("Unable to open file: %1").arg(file.errorString()));
+        return;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_0);
+
+    if (!exists)
+    {
+        out << magic << schemaVersion;
+    }
+
+    foreach (const QByteArray &record, records)
+    {
+        out << record;
+    }
+}
+
+bool SchedulerStorage::Private::readStore(ScheduleDefinitionList *tests, int *records)
+{
+    QFile file(storePath());
+
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        return false;
+    }
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_0);
+
+    quint32 fileMagic = 0, fileVersion = 0;
+    in >> fileMagic >> fileVersion;
+
+    if (fileMagic != magic || fileVersion != schemaVersion)
+    {
+        LOG_ERROR(QString("Unsupported schedule store %1 (version %2)").arg(storePath()).arg(fileVersion));
+        return false;
+    }
+
+    // replay the log, later records replace earlier ones
+    QHash<int, int> index;
+    *records = 0;
+
+    while (!in.atEnd())
+    {
+        QByteArray record;
+        in >> record;
+
+        if (in.status() != QDataStream::Ok)
+        {
+            // a crash while appending leaves a truncated record
+            LOG_WARNING("Schedule store is truncated, ignoring the last record");
+            break;
+        }
+
+        QDataStream data(record);
+        data.setVersion(QDataStream::Qt_5_0);
+
+        quint8 operation;
+        qint32 id;
+        data >> operation >> id;
+
+        ++*records;
+
+        if (operation == RemoveOperation)
+        {
+            if (index.contains(id))
+            {
+                (*tests)[index.take(id)] = ScheduleDefinition();
+            }
+
+            continue;
+        }
+
+        qint32 taskId;
+        QString name;
+        QVariant timing;
+        QVariant precondition;
+        QByteArray options;
+        data >> taskId >> name >> timing >> precondition >> options;
+
+        if (data.status() != QDataStream::Ok)
+        {
+            LOG_WARNING(QString("Skipping invalid schedule record %1").arg(id));
+            continue;
+        }
+
+        // the measurement definition stays serialized until the task executes
+        ScheduleDefinition test(ScheduleId(id), TaskId(taskId), name, TimingFactory::timingFromVariant(timing),
+                                QVariant(), Precondition::fromVariant(precondition));
+        test.setMeasurementDefinitionData(options);
+
+        if (index.contains(id))
+        {
+            (*tests)[index.value(id)] = test;
+        }
+        else
+        {
+            index.insert(id, tests->size());
+            tests->append(test);
+        }
+    }
+
+    // drop the slots of removed schedules
+    for (int i = tests->size() - 1; i >= 0; --i)
+    {
+        if (tests->at(i).isNull())
+        {
+            tests->removeAt(i);
+        }
     }
+
+    return true;
 }
 
-QString SchedulerStorage::Private::fileNameForTest(const ScheduleDefinition &test) const
+ScheduleDefinitionList SchedulerStorage::Private::readLegacyFiles()
 {
-    return QString::number(test.id().toInt());
+    // schema 0 used one json file per schedule named by the id
+    ScheduleDefinitionList tests;
+
+    foreach (const QString &fileName, dir.entryList(QStringList() << "[0-9]*", QDir::Files))
+    {
+        QFile file(dir.absoluteFilePath(fileName));
+
+        if (!file.open(QIODevice::ReadOnly))
+        {
+            LOG_DEBUG(QString("Error opening %1: %2").arg(dir.absoluteFilePath(fileName)).arg(file.errorString()));
+            continue;
+        }
+
+        QJsonParseError error;
+        QJsonDocument document = QJsonDocument::fromJson(file.readAll(), &error);
+
+        if (error.error == QJsonParseError::NoError)
+        {
+            ScheduleDefinition test = ScheduleDefinition::fromVariant(document.toVariant());
+
+            if (!test.isNull())
+            {
+                tests.append(test);
+            }
+        }
+        else
+        {
+            LOG_ERROR(QString("Error reading %1: %2").arg(dir.absoluteFilePath(fileName)).arg(error.errorString()));
+        }
+    }
+
+    return tests;
 }
 
 void SchedulerStorage::Private::testAdded(const ScheduleDefinition &test, int position)
@@ -80,23 +293,37 @@ void SchedulerStorage::Private::testAdded(const ScheduleDefinition &test, int po
         return;
     }
 
-    store(test);
+    append(QList<QByteArray>() << encode(AddOperation, test));
 }
 
 void SchedulerStorage::Private::testRemoved(const ScheduleDefinition &test, int position)
 {
     Q_UNUSED(position);
 
-    QString fileName = fileNameForTest(test);
+    append(QList<QByteArray>() << encode(RemoveOperation, test));
+}
 
-    if (!dir.remove(fileName))
+void SchedulerStorage::Private::testsChanged(const ScheduleDefinitionList &added, const ScheduleDefinitionList &removed)
+{
+    if (loading)
+    {
+        return;
+    }
+
+    // the whole batch goes to disk with one write
+    QList<QByteArray> records;
+
+    foreach (const ScheduleDefinition &test, removed)
     {
-        LOG_WARNING(QString("Unable to remove file: %1").arg(dir.absoluteFilePath(fileName)));
+        records.append(encode(RemoveOperation, test));
     }
-    else
+
+    foreach (const ScheduleDefinition &test, added)
     {
-        LOG_DEBUG(QString("Deleted file: %1").arg(dir.absoluteFilePath(fileName)));
+        records.append(encode(AddOperation, test));
     }
+
+    append(records);
 }
 
 SchedulerStorage::SchedulerStorage(Scheduler *scheduler, QObject *parent)
@@ -107,6 +334,8 @@ SchedulerStorage::SchedulerStorage(Scheduler *scheduler, QObject *parent)
 
     connect(scheduler, SIGNAL(testAdded(ScheduleDefinition, int)), d, SLOT(testAdded(ScheduleDefinition, int)));
     connect(scheduler, SIGNAL(testRemoved(ScheduleDefinition, int)), d, SLOT(testRemoved(ScheduleDefinition, int)));
+    connect(scheduler, SIGNAL(testsChanged(ScheduleDefinitionList, ScheduleDefinitionList)), d,
+            SLOT(testsChanged(ScheduleDefinitionList, ScheduleDefinitionList)));
 }
 
 SchedulerStorage::~SchedulerStorage()
@@ -116,42 +345,40 @@ SchedulerStorage::~SchedulerStorage()
 
 void SchedulerStorage::storeData()
 {
-    foreach (const ScheduleDefinition &test, d->scheduler->tests())
-    {
-        d->store(test);
-    }
+    d->writeSnapshot(d->scheduler->tests());
 }
 
 void SchedulerStorage::loadData()
 {
     d->loading = true;
 
-    foreach (const QString &fileName, d->dir.entryList(QDir::Files))
+    ScheduleDefinitionList tests;
+    int records = 0;
+
+    if (d->readStore(&tests, &records))
     {
-        QFile file(d->dir.absoluteFilePath(fileName));
+        d->scheduler->enqueueMany(tests);
 
-        if (!file.open(QIODevice::ReadOnly))
+        if (records > tests.size() * 2 + compactionSlack)
         {
-            LOG_DEBUG(QString("Error opening %1: %2").arg(d->dir.absoluteFilePath(fileName)).arg(file.errorString()));
-            continue;
+            LOG_DEBUG(QString("Compacting schedule store (%1 records, %2 schedules)").arg(records).arg(tests.size()));
+            d->writeSnapshot(d->scheduler->tests());
         }
+    }
+    else if (!QFile::exists(d->storePath()))
+    {
+        tests = d->readLegacyFiles();
+        d->scheduler->enqueueMany(tests);
 
-        QJsonParseError error;
-        QJsonDocument document = QJsonDocument::fromJson(file.readAll(), &error);
-
-        if (error.error == QJsonParseError::NoError)
+        if (!tests.isEmpty() && d->writeSnapshot(d->scheduler->tests()))
         {
-            ScheduleDefinition test = ScheduleDefinition::fromVariant(document.toVariant());
+            LOG_INFO(QString("Migrated %1 schedules to %2").arg(tests.size()).arg(d->storePath()));
 
-            if (!test.isNull())
+            foreach (const QString &fileName, d->dir.entryList(QStringList() << "[0-9]*", QDir::Files))
             {
-                d->scheduler->enqueue(test);
+                d->dir.remove(fileName);
             }
         }
-        else
-        {
-            LOG_ERROR(QString("Error reading %1: %2").arg(d->dir.absoluteFilePath(fileName)).arg(error.errorString()));
-        }
     }
 
     d->loading = false;
@@ -279,6 +279,16 @@ quint32 Settings::backlog() const
     return d->settings.value("backlog", 10).toUInt();
 }
 
+void Settings::setScheduleVersion(const QString &version)
+{
+    d->settings.setValue("schedule-version", version);
+}
+
+QString Settings::scheduleVersion() const
+{
+    return d->settings.value("schedule-version").toString();
+}
+
 GetConfigResponse *Settings::config() const
 {
     return &d->config;
@@ -78,6 +78,10 @@ public:
     void setBacklog(quint32 backlog);
     quint32 backlog() const;
 
+    // Last schedule version applied from the supervisor, empty forces a full sync
+    void setScheduleVersion(const QString &version);
+    QString scheduleVersion() const;
+
     GetConfigResponse *config() const;
 
     void clear();
@@ -0,0 +1,618 @@
+#include "jsonreader.h"
+
+namespace
+{
+    // Same nesting limit as QJsonDocument
+    const int maxDepth = 1024;
+
+    bool isDigit(char c)
+    {
+        return c >= '0' && c <= '9';
+    }
+
+    bool readHex(const char **pos, const char *end, uint *unit)
+    {
+        if (end - *pos < 4)
+        {
+            return false;
+        }
+
+        *unit = 0;
+
+        for (int i = 0; i < 4; ++i)
+        {
+            char c = *(*pos)++;
+            *unit <<= 4;
+
+            if (isDigit(c))
+            {
+                *unit |= c - '0';
+            }
+            else if (c >= 'a' && c <= 'f')
+            {
+                *unit |= c - 'a' + 10;
+            }
+            else if (c >= 'A' && c <= 'F')
+            {
+                *unit |= c - 'A' + 10;
+            }
+            else
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    void appendUtf8(QByteArray *utf8, uint ucs4)
+    {
+        if (ucs4 < 0x80)
+        {
+            utf8->append(char(ucs4));
+        }
+        else if (ucs4 < 0x800)
+        {
+            utf8->append(char(0xc0 | (ucs4 >> 6)));
+            utf8->append(char(0x80 | (ucs4 & 0x3f)));
+        }
+        else if (ucs4 < 0x10000)
+        {
+            utf8->append(char(0xe0 | (ucs4 >> 12)));
+            utf8->append(char(0x80 | ((ucs4 >> 6) & 0x3f)));
+            utf8->append(char(0x80 | (ucs4 & 0x3f)));
+        }
+        else
+        {
+            utf8->append(char(0xf0 | (ucs4 >> 18)));
+            utf8->append(char(0x80 | ((ucs4 >> 12) & 0x3f)));
+            utf8->append(char(0x80 | ((ucs4 >> 6) & 0x3f)));
+            utf8->append(char(0x80 | (ucs4 & 0x3f)));
+        }
+    }
+}
+
+JsonReader::JsonReader(const QByteArray &data)
+: m_begin(data.constData())
+, m_pos(data.constData())
+, m_end(data.constData() + data.size())
+, m_state(ValueExpected)
+, m_closeAllowed(false)
+, m_token(NoToken)
+, m_integer(0)
+, m_double(0)
+, m_isInteger(false)
+, m_bool(false)
+{
+}
+
+JsonReader::Token JsonReader::next()
+{
+    if (m_token == Error || m_token == EndDocument)
+    {
+        return m_token;
+    }
+
+    skipWhitespace();
+
+    if (m_state == SeparatorExpected)
+    {
+        if (m_stack.isEmpty())
+        {
+            if (m_pos != m_end)
+            {
+                return fail("garbage after the document");
+            }
+
+            return m_token = EndDocument;
+        }
+
+        if (m_pos == m_end)
+        {
+            return fail("unexpected end of data");
+        }
+
+        char c = *m_pos++;
+        char bracket = m_stack.last();
+
+        if (c == '}' && bracket == '{')
+        {
+            return close(EndObject);
+        }
+        else if (c == ']' && bracket == '[')
+        {
+            return close(EndArray);
+        }
+        else if (c != ',')
+        {
+            --m_pos;
+            return fail("',' expected");
+        }
+
+        m_state = bracket == '{' ? NameExpected : ValueExpected;
+        m_closeAllowed = false;
+        skipWhitespace();
+    }
+
+    if (m_pos == m_end)
+    {
+        return fail("unexpected end of data");
+    }
+
+    if (m_state == NameExpected)
+    {
+        if (*m_pos == '}' && m_closeAllowed)
+        {
+            ++m_pos;
+            return close(EndObject);
+        }
+
+        if (*m_pos != '"')
+        {
+            return fail("name expected");
+        }
+
+        if (!readString())
+        {
+            return Error;
+        }
+
+        skipWhitespace();
+
+        if (m_pos == m_end || *m_pos != ':')
+        {
+            return fail("':' expected");
+        }
+
+        ++m_pos;
+        m_state = ValueExpected;
+        m_closeAllowed = false;
+        return m_token = Name;
+    }
+
+    switch (*m_pos)
+    {
+    case '{':
+        return open('{', BeginObject);
+    case '[':
+        return open('[', BeginArray);
+    case ']':
+        if (m_closeAllowed)
+        {
+            ++m_pos;
+            return close(EndArray);
+        }
+        break;
+    case '"':
+        if (!readString())
+        {
+            return Error;
+        }
+
+        m_state = SeparatorExpected;
+        return m_token = String;
+    case 't':
+        return readLiteral("true", Bool, true);
+    case 'f':
+        return readLiteral("false", Bool, false);
+    case 'n':
+        return readLiteral("null", Null, false);
+    default:
+        if (*m_pos == '-' || isDigit(*m_pos))
+        {
+            return readNumber();
+        }
+        break;
+    }
+
+    return fail("value expected");
+}
+
+JsonReader::Token JsonReader::token() const
+{
+    return m_token;
+}
+
+QString JsonReader::string() const
+{
+    if (m_token == String || m_token == Name)
+    {
+        return m_string;
+    }
+
+    return QString();
+}
+
+bool JsonReader::isInteger() const
+{
+    return m_token == Number && m_isInteger;
+}
+
+qint64 JsonReader::toInteger() const
+{
+    if (m_token != Number)
+    {
+        return 0;
+    }
+
+    // Rounds like QVariant::toLongLong() did for the doubles of QJsonDocument
+    return m_isInteger ? m_integer : qRound64(m_double);
+}
+
+double JsonReader::toDouble() const
+{
+    return m_token == Number ? m_double : 0;
+}
+
+bool JsonReader::toBool() const
+{
+    return m_token == Bool && m_bool;
+}
+
+QDateTime JsonReader::toDateTime() const
+{
+    if (m_token != String)
+    {
+        return QDateTime();
+    }
+
+    return QDateTime::fromString(m_string, Qt::ISODate);
+}
+
+QVariant JsonReader::readValue()
+{
+    switch (m_token)
+    {
+    case BeginObject:
+    {
+        QVariantMap map;
+
+        while (next() == Name)
+        {
+            QString name = m_string;
+            next();
+            map.insert(name, readValue());
+        }
+
+        return map;
+    }
+
+    case BeginArray:
+    {
+        QVariantList list;
+
+        while (next() != EndArray && m_token != Error)
+        {
+            list.append(readValue());
+        }
+
+        return list;
+    }
+
+    case String:
+        return m_string;
+
+    case Number:
+        if (!m_isInteger)
+        {
+            return m_double;
+        }
+        else if (m_integer == int(m_integer))
+        {
+            return int(m_integer);
+        }
+
+        return m_integer;
+
+    case Bool:
+        return m_bool;
+
+    default:
+        return QVariant();
+    }
+}
+
+void JsonReader::skipValue()
+{
+    if (m_token != BeginObject && m_token != BeginArray)
+    {
+        return;
+    }
+
+    // The container is closed once the stack drops below its level
+    int depth = m_stack.size();
+
+    while (next() != Error && m_stack.size() >= depth)
+    {
+    }
+}
+
+bool JsonReader::hasError() const
+{
+    return m_token == Error;
+}
+
+QString JsonReader::errorString() const
+{
+    return m_errorString;
+}
+
+QVariant JsonReader::toVariant(const QByteArray &json, QString *errorString)
+{
+    JsonReader reader(json);
+    reader.next();
+
+    QVariant value = reader.readValue();
+
+    if (reader.next() != EndDocument)
+    {
+        if (errorString)
+        {
+            *errorString = reader.errorString();
+        }
+
+        return QVariant();
+    }
+
+    return value;
+}
+
+JsonReader::Token JsonReader::fail(const QString &errorString)
+{
+    m_errorString = QString("%1 at offset %2").arg(errorString).arg(m_pos - m_begin);
+    return m_token = Error;
+}
+
+bool JsonReader::readString()
+{
+    const char *start = ++m_pos;
+
+    // Most strings have nothing to unescape and are converted in one go
+    while (m_pos != m_end && *m_pos != '"' && *m_pos != '\\' && uchar(*m_pos) >= 0x20)
+    {
+        ++m_pos;
+    }
+
+    if (m_pos != m_end && *m_pos == '"')
+    {
+        m_string = QString::fromUtf8(start, int(m_pos - start));
+        ++m_pos;
+        return true;
+    }
+
+    QByteArray utf8(start, int(m_pos - start));
+
+    while (m_pos != m_end)
+    {
+        char c = *m_pos++;
+
+        if (c == '"')
+        {
+            m_string = QString::fromUtf8(utf8);
+            return true;
+        }
+
+        if (uchar(c) < 0x20)
+        {
+            --m_pos;
+            fail("control character in string");
+            return false;
+        }
+
+        if (c != '\\')
+        {
+            utf8.append(c);
+            continue;
+        }
+
+        if (m_pos == m_end)
+        {
+            break;
+        }
+
+        switch (*m_pos++)
+        {
+        case '"':
+            utf8.append('"');
+            break;
+        case '\\':
+            utf8.append('\\');
+            break;
+        case '/':
+            utf8.append('/');
+            break;
+        case 'b':
+            utf8.append('\b');
+            break;
+        case 'f':
+            utf8.append('\f');
+            break;
+        case 'n':
+            utf8.append('\n');
+            break;
+        case 'r':
+            utf8.append('\r');
+            break;
+        case 't':
+            utf8.append('\t');
+            break;
+        case 'u':
+        {
+            uint unit;
+
+            if (!readHex(&m_pos, m_end, &unit))
+            {
+                fail("invalid unicode escape");
+                return false;
+            }
+
+            uint low;
+
+            if (QChar::isHighSurrogate(unit) && m_end - m_pos >= 6 && m_pos[0] == '\\' && m_pos[1] == 'u')
+            {
+                const char *pos = m_pos + 2;
+
+                if (readHex(&pos, m_end, &low) && QChar::isLowSurrogate(low))
+                {
+                    m_pos = pos;
+                    unit = QChar::surrogateToUcs4(ushort(unit), ushort(low));
+                }
+            }
+
+            if (QChar::isSurrogate(unit))
+            {
+                unit = QChar::ReplacementCharacter;
+            }
+
+            appendUtf8(&utf8, unit);
+            break;
+        }
+        default:
+            --m_pos;
+            fail("invalid escape sequence");
+            return false;
+        }
+    }
+
+    fail("unterminated string");
+    return false;
+}
+
+JsonReader::Token JsonReader::readNumber()
+{
+    const char *start = m_pos;
+
+    if (*m_pos == '-')
+    {
+        ++m_pos;
+    }
+
+    const char *digits = m_pos;
+
+    while (m_pos != m_end && isDigit(*m_pos))
+    {
+        ++m_pos;
+    }
+
+    int digitCount = int(m_pos - digits);
+    bool integer = true;
+
+    if (!digitCount)
+    {
+        return fail("invalid number");
+    }
+
+    if (m_pos != m_end && *m_pos == '.')
+    {
+        const char *fraction = ++m_pos;
+        integer = false;
+
+        while (m_pos != m_end && isDigit(*m_pos))
+        {
+            ++m_pos;
+        }
+
+        if (m_pos == fraction)
+        {
+            return fail("invalid number");
+        }
+    }
+
+    if (m_pos != m_end && (*m_pos == 'e' || *m_pos == 'E'))
+    {
+        ++m_pos;
+        integer = false;
+
+        if (m_pos != m_end && (*m_pos == '+' || *m_pos == '-'))
+        {
+            ++m_pos;
+        }
+
+        const char *exponent = m_pos;
+
+        while (m_pos != m_end && isDigit(*m_pos))
+        {
+            ++m_pos;
+        }
+
+        if (m_pos == exponent)
+        {
+            return fail("invalid number");
+        }
+    }
+
+    // Anything with 18 digits or less fits into a qint64
+    if (integer && digitCount <= 18)
+    {
+        qint64 value = 0;
+
+        for (const char *c = digits; c != m_pos; ++c)
+        {
+            value = value * 10 + (*c - '0');
+        }
+
+        m_integer = *start == '-' ? -value : value;
+        m_double = double(m_integer);
+        m_isInteger = true;
+    }
+    else
+    {
+        bool ok;
+        m_double = QByteArray(start, int(m_pos - start)).toDouble(&ok);
+        m_isInteger = false;
+
+        if (!ok)
+        {
+            m_pos = start;
+            return fail("invalid number");
+        }
+    }
+
+    m_state = SeparatorExpected;
+    return m_token = Number;
+}
+
+JsonReader::Token JsonReader::readLiteral(const char *literal, Token token, bool value)
+{
+    int length = int(qstrlen(literal));
+
+    if (m_end - m_pos < length || qstrncmp(m_pos, literal, length) != 0)
+    {
+        return fail("invalid literal");
+    }
+
+    m_pos += length;
+    m_bool = value;
+    m_state = SeparatorExpected;
+    return m_token = token;
+}
+
+JsonReader::Token JsonReader::open(char bracket, Token token)
+{
+    if (m_stack.size() >= maxDepth)
+    {
+        return fail("nesting too deep");
+    }
+
+    ++m_pos;
+    m_stack.append(bracket);
+    m_state = bracket == '{' ? NameExpected : ValueExpected;
+    m_closeAllowed = true;
+    return m_token = token;
+}
+
+JsonReader::Token JsonReader::close(Token token)
+{
+    m_stack.removeLast();
+    m_state = SeparatorExpected;
+    m_closeAllowed = false;
+    return m_token = token;
+}
+
+void JsonReader::skipWhitespace()
+{
+    while (m_pos != m_end && (*m_pos == ' ' || *m_pos == '\n' || *m_pos == '\r' || *m_pos == '\t'))
+    {
+        ++m_pos;
+    }
+}
@@ -0,0 +1,102 @@
+#ifndef JSONREADER_H
+#define JSONREADER_H
+
+#include "../export.h"
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QVarLengthArray>
+#include <QVariant>
+
+// Pull parser for json, the counterpart of JsonWriter. Every next() moves
+// to the following token, callers pick what they need and skip the rest:
+//
+//   reader.next(); // BeginObject
+//   while (reader.next() == JsonReader::Name)
+//   {
+//       QString name = reader.string();
+//       reader.next();
+//       ...
+//   }
+//
+// The data has to outlive the reader.
+class CLIENT_API JsonReader
+{
+public:
+    enum Token
+    {
+        NoToken,
+        BeginObject,
+        EndObject,
+        BeginArray,
+        EndArray,
+        Name,
+        String,
+        Number,
+        Bool,
+        Null,
+        EndDocument,
+        Error
+    };
+
+    explicit JsonReader(const QByteArray &data);
+
+    Token next();
+    Token token() const;
+
+    // Values of the current token
+    QString string() const;
+    bool isInteger() const;
+    qint64 toInteger() const;
+    double toDouble() const;
+    bool toBool() const;
+    QDateTime toDateTime() const;
+
+    // Reads the value starting at the current token completely, objects
+    // become a QVariantMap and arrays a QVariantList
+    QVariant readValue();
+
+    // Moves past the value starting at the current token
+    void skipValue();
+
+    bool hasError() const;
+    QString errorString() const;
+
+    // Convenience for a whole document
+    static QVariant toVariant(const QByteArray &json, QString *errorString = 0);
+
+private:
+    enum State
+    {
+        ValueExpected,
+        NameExpected,
+        SeparatorExpected
+    };
+
+    Token fail(const QString &errorString);
+    bool readString();
+    Token readNumber();
+    Token readLiteral(const char *literal, Token token, bool value);
+    Token open(char bracket, Token token);
+    Token close(Token token);
+    void skipWhitespace();
+
+    const char *m_begin;
+    const char *m_pos;
+    const char *m_end;
+
+    State m_state;
+    bool m_closeAllowed;
+    QVarLengthArray<char, 16> m_stack;
+
+    Token m_token;
+    QString m_string;
+    qint64 m_integer;
+    double m_double;
+    bool m_isInteger;
+    bool m_bool;
+
+    QString m_errorString;
+};
+
+#endif // JSONREADER_H
@@ -0,0 +1,440 @@
+#include "jsonwriter.h"
+
+#include <QStringList>
+#include <QLocale>
+
+namespace
+{
+    const char hexDigits[] = "0123456789abcdef";
+
+    // Writes one utf-16 unit below 0x800, escaped where json asks for it
+    char *appendEscaped(char *out, ushort unit)
+    {
+        if (unit >= 0x80)
+        {
+            *out++ = char(0xc0 | (unit >> 6));
+            *out++ = char(0x80 | (unit & 0x3f));
+            return out;
+        }
+
+        if (unit >= 0x20 && unit != '"' && unit != '\\')
+        {
+            *out++ = char(unit);
+            return out;
+        }
+
+        *out++ = '\\';
+
+        switch (unit)
+        {
+        case '"':
+            *out++ = '"';
+            break;
+        case '\\':
+            *out++ = '\\';
+            break;
+        case '\b':
+            *out++ = 'b';
+            break;
+        case '\f':
+            *out++ = 'f';
+            break;
+        case '\n':
+            *out++ = 'n';
+            break;
+        case '\r':
+            *out++ = 'r';
+            break;
+        case '\t':
+            *out++ = 't';
+            break;
+        default:
+            *out++ = 'u';
+            *out++ = '0';
+            *out++ = '0';
+            *out++ = hexDigits[unit >> 4];
+            *out++ = hexDigits[unit & 0xf];
+            break;
+        }
+
+        return out;
+    }
+
+    // Escapes take at most six bytes per utf-16 unit, plus the quotes
+    int maxEscapedSize(int length)
+    {
+        return 6 * length + 2;
+    }
+}
+
+JsonWriter::JsonWriter(QByteArray *buffer)
+: m_buffer(buffer)
+, m_needsSeparator(false)
+{
+}
+
+void JsonWriter::beginObject()
+{
+    separate();
+    m_buffer->append('{');
+    m_needsSeparator = false;
+}
+
+void JsonWriter::endObject()
+{
+    m_buffer->append('}');
+    m_needsSeparator = true;
+}
+
+void JsonWriter::beginArray()
+{
+    separate();
+    m_buffer->append('[');
+    m_needsSeparator = false;
+}
+
+void JsonWriter::endArray()
+{
+    m_buffer->append(']');
+    m_needsSeparator = true;
+}
+
+void JsonWriter::name(const char *name)
+{
+    separate();
+    writeLatin1(name);
+    m_buffer->append(':');
+    m_needsSeparator = false;
+}
+
+void JsonWriter::name(const QString &name)
+{
+    separate();
+    writeString(name.constData(), name.constData() + name.size());
+    m_buffer->append(':');
+    m_needsSeparator = false;
+}
+
+void JsonWriter::writeNull()
+{
+    separate();
+    m_buffer->append("null", 4);
+    m_needsSeparator = true;
+}
+
+void JsonWriter::write(bool value)
+{
+    separate();
+
+    if (value)
+    {
+        m_buffer->append("true", 4);
+    }
+    else
+    {
+        m_buffer->append("false", 5);
+    }
+
+    m_needsSeparator = true;
+}
+
+void JsonWriter::write(int value)
+{
+    write(qint64(value));
+}
+
+void JsonWriter::write(qint64 value)
+{
+    separate();
+
+    if (value < 0)
+    {
+        m_buffer->append('-');
+
+        // -(value + 1) + 1 so the minimum does not overflow
+        writeDigits(quint64(-(value + 1)) + 1);
+    }
+    else
+    {
+        writeDigits(quint64(value));
+    }
+
+    m_needsSeparator = true;
+}
+
+void JsonWriter::write(quint64 value)
+{
+    separate();
+    writeDigits(value);
+    m_needsSeparator = true;
+}
+
+void JsonWriter::write(double value)
+{
+    // Like QJsonDocument, json has no representation for inf and nan
+    if (!qIsFinite(value))
+    {
+        writeNull();
+        return;
+    }
+
+    separate();
+#if QT_VERSION >= QT_VERSION_CHECK(5, 7, 0)
+    m_buffer->append(QByteArray::number(value, 'g', QLocale::FloatingPointShortest));
+#else
+    m_buffer->append(QByteArray::number(value, 'g', 17));
+#endif
+    m_needsSeparator = true;
+}
+
+void JsonWriter::write(const char *value)
+{
+    separate();
+    writeLatin1(value);
+    m_needsSeparator = true;
+}
+
+void JsonWriter::write(const QString &value)
+{
+    separate();
+    writeString(value.constData(), value.constData() + value.size());
+    m_needsSeparator = true;
+}
+
+void JsonWriter::write(const QDateTime &value)
+{
+    // QJsonDocument::fromVariant() turns invalid dates into null and valid
+    // ones into what QVariant::toString() returns
+    if (!value.isValid())
+    {
+        writeNull();
+        return;
+    }
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 8, 0)
+    write(value.toString(Qt::ISODateWithMs));
+#else
+    write(value.toString(Qt::ISODate));
+#endif
+}
+
+void JsonWriter::write(const QVariant &value)
+{
+    switch (value.userType())
+    {
+    case QMetaType::UnknownType:
+    case QMetaType::Nullptr:
+        writeNull();
+        break;
+
+    case QMetaType::Bool:
+        write(value.toBool());
+        break;
+
+    case QMetaType::Int:
+    case QMetaType::UInt:
+    case QMetaType::Short:
+    case QMetaType::UShort:
+    case QMetaType::Char:
+    case QMetaType::SChar:
+    case QMetaType::UChar:
+    case QMetaType::Long:
+    case QMetaType::LongLong:
+        write(value.toLongLong());
+        break;
+
+    case QMetaType::ULong:
+    case QMetaType::ULongLong:
+        write(value.toULongLong());
+        break;
+
+    case QMetaType::Float:
+    case QMetaType::Double:
+        write(value.toDouble());
+        break;
+
+    case QMetaType::QString:
+        write(*static_cast<const QString *>(value.constData()));
+        break;
+
+    case QMetaType::QDateTime:
+        write(*static_cast<const QDateTime *>(value.constData()));
+        break;
+
+    case QMetaType::QStringList:
+    {
+        beginArray();
+
+        foreach (const QString &string, *static_cast<const QStringList *>(value.constData()))
+        {
+            write(string);
+        }
+
+        endArray();
+        break;
+    }
+
+    case QMetaType::QVariantList:
+    {
+        beginArray();
+
+        foreach (const QVariant &item, *static_cast<const QVariantList *>(value.constData()))
+        {
+            write(item);
+        }
+
+        endArray();
+        break;
+    }
+
+    case QMetaType::QVariantMap:
+    {
+        const QVariantMap &map = *static_cast<const QVariantMap *>(value.constData());
+
+        beginObject();
+
+        for (QVariantMap::const_iterator i = map.constBegin(); i != map.constEnd(); ++i)
+        {
+            name(i.key());
+            write(i.value());
+        }
+
+        endObject();
+        break;
+    }
+
+    case QMetaType::QVariantHash:
+    {
+        const QVariantHash &hash = *static_cast<const QVariantHash *>(value.constData());
+
+        beginObject();
+
+        for (QVariantHash::const_iterator i = hash.constBegin(); i != hash.constEnd(); ++i)
+        {
+            name(i.key());
+            write(i.value());
+        }
+
+        endObject();
+        break;
+    }
+
+    default:
+    {
+        // Same fallback as QJsonValue::fromVariant()
+        QString string = value.toString();
+
+        if (string.isEmpty())
+        {
+            writeNull();
+        }
+        else
+        {
+            write(string);
+        }
+
+        break;
+    }
+    }
+}
+
+QByteArray JsonWriter::toJson(const QVariant &value)
+{
+    QByteArray json;
+    JsonWriter writer(&json);
+    writer.write(value);
+    return json;
+}
+
+void JsonWriter::separate()
+{
+    if (m_needsSeparator)
+    {
+        m_buffer->append(',');
+    }
+}
+
+void JsonWriter::writeDigits(quint64 value)
+{
+    char digits[20];
+    int count = 0;
+
+    do
+    {
+        digits[count++] = char('0' + value % 10);
+        value /= 10;
+    } while (value);
+
+    int offset = m_buffer->size();
+    m_buffer->resize(offset + count);
+    char *out = m_buffer->data() + offset;
+
+    while (count)
+    {
+        *out++ = digits[--count];
+    }
+}
+
+void JsonWriter::writeString(const QChar *begin, const QChar *end)
+{
+    int offset = m_buffer->size();
+    m_buffer->resize(offset + maxEscapedSize(int(end - begin)));
+
+    char *start = m_buffer->data();
+    char *out = start + offset;
+    *out++ = '"';
+
+    for (const QChar *c = begin; c != end; ++c)
+    {
+        uint unit = c->unicode();
+
+        if (unit < 0x800)
+        {
+            out = appendEscaped(out, ushort(unit));
+            continue;
+        }
+
+        if (QChar::isHighSurrogate(unit) && c + 1 != end && c[1].isLowSurrogate())
+        {
+            uint ucs4 = QChar::surrogateToUcs4(ushort(unit), c[1].unicode());
+            ++c;
+
+            *out++ = char(0xf0 | (ucs4 >> 18));
+            *out++ = char(0x80 | ((ucs4 >> 12) & 0x3f));
+            *out++ = char(0x80 | ((ucs4 >> 6) & 0x3f));
+            *out++ = char(0x80 | (ucs4 & 0x3f));
+            continue;
+        }
+
+        if (QChar::isSurrogate(unit))
+        {
+            unit = QChar::ReplacementCharacter;
+        }
+
+        *out++ = char(0xe0 | (unit >> 12));
+        *out++ = char(0x80 | ((unit >> 6) & 0x3f));
+        *out++ = char(0x80 | (unit & 0x3f));
+    }
+
+    *out++ = '"';
+    m_buffer->resize(int(out - start));
+}
+
+void JsonWriter::writeLatin1(const char *string)
+{
+    int length = int(qstrlen(string));
+    int offset = m_buffer->size();
+    m_buffer->resize(offset + maxEscapedSize(length));
+
+    char *start = m_buffer->data();
+    char *out = start + offset;
+    *out++ = '"';
+
+    for (const char *c = string; *c; ++c)
+    {
+        out = appendEscaped(out, uchar(*c));
+    }
+
+    *out++ = '"';
+    m_buffer->resize(int(out - start));
+}
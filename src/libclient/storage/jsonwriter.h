@@ -0,0 +1,61 @@
+#ifndef JSONWRITER_H
+#define JSONWRITER_H
+
+#include "../export.h"
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QVariant>
+
+// Appends compact json straight to a byte array, without building the
+// QVariant and QJsonValue trees QJsonDocument::fromVariant() needs. The
+// output reads back to the same values as QJsonDocument would have written.
+//
+// Members are written as name() followed by one value, separators are
+// inserted as needed:
+//
+//   writer.beginObject();
+//   writer.name("task_id");
+//   writer.write(42);
+//   writer.endObject();
+class CLIENT_API JsonWriter
+{
+public:
+    explicit JsonWriter(QByteArray *buffer);
+
+    void beginObject();
+    void endObject();
+    void beginArray();
+    void endArray();
+
+    // Starts the next member of the current object
+    void name(const char *name);
+    void name(const QString &name);
+
+    void writeNull();
+    void write(bool value);
+    void write(int value);
+    void write(qint64 value);
+    void write(quint64 value);
+    void write(double value);
+    void write(const char *value);
+    void write(const QString &value);
+    void write(const QDateTime &value);
+
+    // Everything QJsonValue::fromVariant() understands
+    void write(const QVariant &value);
+
+    // Convenience for a single value
+    static QByteArray toJson(const QVariant &value);
+
+private:
+    void separate();
+    void writeDigits(quint64 value);
+    void writeString(const QChar *begin, const QChar *end);
+    void writeLatin1(const char *string);
+
+    QByteArray *m_buffer;
+    bool m_needsSeparator;
+};
+
+#endif // JSONWRITER_H
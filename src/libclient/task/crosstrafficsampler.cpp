@@ -0,0 +1,369 @@
+#include "crosstrafficsampler.h"
+#include "../measurement/upnp/upnp.h"
+#include "../measurement/upnp/internetgateway.h"
+#include "../timing/clock.h"
+#include "../log/logger.h"
+
+#include <QTimer>
+#include <QFile>
+#include <QFutureWatcher>
+#include <QtConcurrent/QtConcurrentRun>
+
+LOGGER(CrossTrafficSampler);
+
+namespace
+{
+    const int defaultInterval = 1000;
+
+    // Difference of two counter readings, the gateway counters wrap at 4 GiB.
+    // Consecutive samples are close enough together to wrap at most once.
+    quint64 counterDelta(quint32 from, quint32 to)
+    {
+        return to >= from ? to - from : Q_UINT64_C(0x100000000) - from + to;
+    }
+}
+
+CrossTrafficSampler::Sample::Sample()
+: time(0)
+, hasLocal(false)
+, localReceived(0)
+, localSent(0)
+, hasGateway(false)
+, gatewayReceived(0)
+, gatewaySent(0)
+{
+}
+
+class CrossTrafficSampler::Private : public QObject
+{
+    Q_OBJECT
+
+public:
+    // A child of the sampler, so the timer and the watcher move to the
+    // thread of the task executor with it
+    Private(CrossTrafficSampler *q)
+    : QObject(q)
+    , q(q)
+    , gateway(true)
+    , running(false)
+    , pending(false)
+    , stopping(false)
+    , finalSample(false)
+    {
+        timer.setInterval(defaultInterval);
+
+        connect(&timer, SIGNAL(timeout()), this, SLOT(sample()));
+        connect(&watcher, SIGNAL(finished()), this, SLOT(sampleFinished()));
+    }
+
+    CrossTrafficSampler *q;
+
+    // Properties
+    bool gateway;
+    bool running;
+    bool pending; // a sample is being taken on the thread pool
+    bool stopping; // stop() was called, the final sample is not in yet
+    bool finalSample;
+    QTimer timer;
+    QFutureWatcher<CrossTrafficSampler::Sample> watcher;
+    QList<CrossTrafficSampler::Sample> samples;
+
+public slots:
+    void sample();
+    void sampleFinished();
+};
+
+void CrossTrafficSampler::Private::sample()
+{
+    // the gateway may be slow to answer, skip a tick rather than queue up
+    if (pending)
+    {
+        return;
+    }
+
+    pending = true;
+    watcher.setFuture(QtConcurrent::run(InternetGatewayCache::jobPool(), &CrossTrafficSampler::takeSample, gateway));
+}
+
+void CrossTrafficSampler::Private::sampleFinished()
+{
+    if (!pending)
+    {
+        return;
+    }
+
+    pending = false;
+    samples.append(watcher.result());
+
+    if (!stopping)
+    {
+        return;
+    }
+
+    // a sample started before stop() is not the final one
+    if (!finalSample)
+    {
+        finalSample = true;
+        sample();
+        return;
+    }
+
+    stopping = false;
+    emit q->stopped();
+}
+
+CrossTrafficSampler::CrossTrafficSampler(QObject *parent)
+: QObject(parent)
+, d(new Private(this))
+{
+}
+
+CrossTrafficSampler::~CrossTrafficSampler()
+{
+    d->watcher.waitForFinished();
+    delete d;
+}
+
+void CrossTrafficSampler::setInterval(int interval)
+{
+    d->timer.setInterval(interval);
+}
+
+int CrossTrafficSampler::interval() const
+{
+    return d->timer.interval();
+}
+
+void CrossTrafficSampler::setGatewayEnabled(bool enabled)
+{
+    d->gateway = enabled;
+}
+
+bool CrossTrafficSampler::isGatewayEnabled() const
+{
+    return d->gateway;
+}
+
+void CrossTrafficSampler::start()
+{
+    d->watcher.waitForFinished();
+    d->pending = false;
+    d->stopping = false;
+    d->finalSample = false;
+    d->samples.clear();
+    d->running = true;
+
+    d->sample();
+    d->timer.start();
+}
+
+void CrossTrafficSampler::stop()
+{
+    if (!d->running)
+    {
+        return;
+    }
+
+    d->running = false;
+    d->stopping = true;
+    d->timer.stop();
+
+    // the gateway is queried on the thread pool like for every other sample,
+    // a pending one is collected first
+    if (!d->pending)
+    {
+        d->finalSample = true;
+        d->sample();
+    }
+}
+
+bool CrossTrafficSampler::isRunning() const
+{
+    return d->running;
+}
+
+QList<CrossTrafficSampler::Sample> CrossTrafficSampler::samples() const
+{
+    return d->samples;
+}
+
+QVariant CrossTrafficSampler::result() const
+{
+    if (d->samples.size() < 2)
+    {
+        return QVariant();
+    }
+
+    QVariantList samples;
+    const Sample *first = NULL;
+    const Sample *last = NULL;
+    quint64 gatewayReceived = 0;
+    quint64 gatewaySent = 0;
+
+    foreach (const Sample &sample, d->samples)
+    {
+        QVariantList row;
+        row << (sample.time - d->samples.first().time) / 1000000;
+        row << (sample.hasLocal ? QVariant(sample.localReceived) : QVariant());
+        row << (sample.hasLocal ? QVariant(sample.localSent) : QVariant());
+        row << (sample.hasGateway ? QVariant(sample.gatewayReceived) : QVariant());
+        row << (sample.hasGateway ? QVariant(sample.gatewaySent) : QVariant());
+        samples.append(QVariant(row));
+
+        if (sample.hasLocal && sample.hasGateway)
+        {
+            if (!first)
+            {
+                first = &sample;
+            }
+            else
+            {
+                // summed up per interval, the counters may wrap several times
+                gatewayReceived += counterDelta(last->gatewayReceived, sample.gatewayReceived);
+                gatewaySent += counterDelta(last->gatewaySent, sample.gatewaySent);
+            }
+
+            last = &sample;
+        }
+    }
+
+    QVariantMap map;
+    map.insert("interval", interval());
+    map.insert("samples", samples);
+
+    if (!first || first == last)
+    {
+        // without the gateway we can't tell our traffic from the others
+        LOG_DEBUG("No gateway counters, cross traffic is unknown");
+        map.insert("gateway", false);
+        return map;
+    }
+
+    quint64 localReceived = last->localReceived - first->localReceived;
+    quint64 localSent = last->localSent - first->localSent;
+
+    // the counters are not read at the very same instant, never go negative
+    quint64 crossReceived = gatewayReceived > localReceived ? gatewayReceived - localReceived : 0;
+    quint64 crossSent = gatewaySent > localSent ? gatewaySent - localSent : 0;
+    qint64 duration = (last->time - first->time) / 1000000;
+
+    map.insert("gateway", true);
+    map.insert("duration", duration);
+    map.insert("gateway_bytes_received", gatewayReceived);
+    map.insert("gateway_bytes_sent", gatewaySent);
+    map.insert("local_bytes_received", localReceived);
+    map.insert("local_bytes_sent", localSent);
+    map.insert("cross_bytes_received", crossReceived);
+    map.insert("cross_bytes_sent", crossSent);
+
+    if (duration > 0)
+    {
+        map.insert("cross_kBs_received", crossReceived / 1024.0 / (duration / 1000.0));
+        map.insert("cross_kBs_sent", crossSent / 1024.0 / (duration / 1000.0));
+    }
+
+    if (gatewayReceived > 0)
+    {
+        map.insert("cross_share_received", (qreal)crossReceived / gatewayReceived);
+    }
+
+    return map;
+}
+
+CrossTrafficSampler::Sample CrossTrafficSampler::takeSample(bool withGateway)
+{
+    Sample sample;
+    quint64 receivedBefore = 0, sentBefore = 0;
+
+    sample.time = Clock::monotonic();
+    sample.hasLocal = localCounters(&receivedBefore, &sentBefore);
+    sample.localReceived = receivedBefore;
+    sample.localSent = sentBefore;
+
+    if (!withGateway)
+    {
+        return sample;
+    }
+
+    InternetGatewayList gateways = InternetGatewayCache::gateways();
+
+    if (gateways.isEmpty())
+    {
+        return sample;
+    }
+
+    UPnP::UPnPHash counters = UPnP::queryCounters(gateways.first());
+
+    if (!counters.contains(UPnP::TotalBytesReceived) || !counters.contains(UPnP::TotalBytesSent))
+    {
+        return sample;
+    }
+
+    sample.hasGateway = true;
+    sample.gatewayReceived = counters.value(UPnP::TotalBytesReceived).toUInt();
+    sample.gatewaySent = counters.value(UPnP::TotalBytesSent).toUInt();
+
+    // the local reading closest to the gateway reading is the middle one
+    quint64 receivedAfter = 0, sentAfter = 0;
+    qint64 timeAfter = Clock::monotonic();
+
+    if (sample.hasLocal && localCounters(&receivedAfter, &sentAfter))
+    {
+        sample.localReceived = receivedBefore + (receivedAfter - receivedBefore) / 2;
+        sample.localSent = sentBefore + (sentAfter - sentBefore) / 2;
+    }
+
+    sample.time += (timeAfter - sample.time) / 2;
+
+    return sample;
+}
+
+bool CrossTrafficSampler::localCounters(quint64 *received, quint64 *sent)
+{
+#if defined(Q_OS_LINUX)
+    QFile file("/proc/net/dev");
+
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        return false;
+    }
+
+    // two header lines, then "iface: rx_bytes packets ... tx_bytes ..."
+    QList<QByteArray> lines = file.readAll().split('\n');
+    *received = 0;
+    *sent = 0;
+
+    for (int i = 2; i < lines.size(); ++i)
+    {
+        int colon = lines.at(i).indexOf(':');
+
+        if (colon < 0)
+        {
+            continue;
+        }
+
+        if (lines.at(i).left(colon).trimmed() == "lo")
+        {
+            continue;
+        }
+
+        QList<QByteArray> fields = lines.at(i).mid(colon + 1).simplified().split(' ');
+
+        if (fields.size() < 9)
+        {
+            continue;
+        }
+
+        *received += fields.at(0).toULongLong();
+        *sent += fields.at(8).toULongLong();
+    }
+
+    return true;
+#else
+    Q_UNUSED(received);
+    Q_UNUSED(sent);
+    return false;
+#endif
+}
+
+#include "crosstrafficsampler.moc"
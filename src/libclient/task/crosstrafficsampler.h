@@ -0,0 +1,68 @@
+#ifndef CROSSTRAFFICSAMPLER_H
+#define CROSSTRAFFICSAMPLER_H
+
+#include "../export.h"
+
+#include <QObject>
+#include <QVariant>
+
+// Samples the byte counters of the internet gateway (UPnP) and of the
+// local interfaces while a bandwidth measurement runs. Whatever the
+// gateway forwarded beyond our own traffic is cross traffic of other
+// hosts in the same network.
+class CLIENT_API CrossTrafficSampler : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit CrossTrafficSampler(QObject *parent = 0);
+    ~CrossTrafficSampler();
+
+    struct Sample
+    {
+        Sample();
+
+        qint64 time; // monotonic ns
+        bool hasLocal;
+        quint64 localReceived;
+        quint64 localSent;
+        bool hasGateway;
+        quint32 gatewayReceived; // the UPnP counters are 32 bit
+        quint32 gatewaySent;
+    };
+
+    // Sampling cadence in ms
+    void setInterval(int interval);
+    int interval() const;
+
+    // Query the gateway counters (on by default), only local ones otherwise
+    void setGatewayEnabled(bool enabled);
+    bool isGatewayEnabled() const;
+
+    bool isRunning() const;
+
+    QList<Sample> samples() const;
+
+    // Summary for Result::crossTraffic(), invalid without samples
+    QVariant result() const;
+
+    static Sample takeSample(bool withGateway);
+
+    // Summed counters of all non-loopback interfaces, false if unsupported
+    static bool localCounters(quint64 *received, quint64 *sent);
+
+public slots:
+    // The first sample is taken right away. The last one is taken in the
+    // background after stop(), stopped() is emitted once it is in.
+    void start();
+    void stop();
+
+signals:
+    void stopped();
+
+protected:
+    class Private;
+    Private *d;
+};
+
+#endif // CROSSTRAFFICSAMPLER_H
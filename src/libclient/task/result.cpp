@@ -1,11 +1,19 @@
 #include "result.h"
 #include "../types.h"
-#include "client.h"
-#include "controller/ntpcontroller.h"
+#include "../timing/clock.h"
+#include "../storage/jsonwriter.h"
+#include "../storage/jsonreader.h"
 
 class ResultData : public QSharedData
 {
 public:
+    ResultData()
+    : clockError(-1)
+    {
+    }
+
+    void writeJson(JsonWriter *writer, bool withInfo) const;
+
     QDateTime startDateTime;
     QDateTime endDateTime;
     QVariant conflictingTasks;
@@ -15,6 +23,7 @@ public:
     QVariantMap preInfo;
     QVariantMap postInfo;
     QString errorString;
+    qint64 clockError;
 };
 
 Result::Result()
@@ -25,7 +34,7 @@ Result::Result()
 Result::Result(const QString &errorString)
 : d(new ResultData)
 {
-    setStartDateTime(Client::instance()->ntpController()->currentDateTime());
+    setStartDateTime(Clock::currentDateTime());
     d->errorString = errorString;
 }
 
@@ -78,13 +87,16 @@ Result Result::fromVariant(const QVariant &variant)
 {
     QVariantMap map = variant.toMap();
 
-    return Result(map.value("start_time").toDateTime(),
+    Result result(map.value("start_time").toDateTime(),
                   map.value("end_time").toDateTime(),
                   map.value("probe_result").toMap(),
                   map.value("measure_uuid").toUuid(),
                   map.value("pre_info").toMap(),
                   map.value("post_info").toMap(),
                   map.value("error").toString());
+    result.setClockError(map.value("clock_error", -1).toLongLong());
+    result.setCrossTraffic(map.value("cross_traffic"));
+    return result;
 }
 
 void Result::setStartDateTime(const QDateTime &startDateTime)
@@ -152,6 +164,26 @@ QString Result::errorString() const
     return d->errorString;
 }
 
+void Result::setCrossTraffic(const QVariant &crossTraffic)
+{
+    d->crossTraffic = crossTraffic;
+}
+
+QVariant Result::crossTraffic() const
+{
+    return d->crossTraffic;
+}
+
+void Result::setClockError(qint64 clockError)
+{
+    d->clockError = clockError;
+}
+
+qint64 Result::clockError() const
+{
+    return d->clockError;
+}
+
 QVariant Result::toVariant() const
 {
     QVariantMap map;
@@ -162,7 +194,14 @@ QVariant Result::toVariant() const
     map.insert("pre_info", d->preInfo);
     map.insert("post_info", d->postInfo);
     map.insert("error", d->errorString);
+    map.insert("clock_error", d->clockError);
     map.insert("probe_result", d->probeResult);
+
+    if (d->crossTraffic.isValid())
+    {
+        map.insert("cross_traffic", d->crossTraffic);
+    }
+
     return map;
 }
 
@@ -174,6 +213,122 @@ QVariant Result::toVariantStripped() const
     map.insert("duration", d->startDateTime.msecsTo(d->endDateTime));
     map.insert("measure_uuid", uuidToString(d->measureUuid));
     map.insert("error", d->errorString);
+    map.insert("clock_error", d->clockError);
     map.insert("probe_result", d->probeResult);
+
+    if (d->crossTraffic.isValid())
+    {
+        map.insert("cross_traffic", d->crossTraffic);
+    }
+
     return map;
 }
+
+// Members are written in the key order of the QVariantMap of toVariant()
+void ResultData::writeJson(JsonWriter *writer, bool withInfo) const
+{
+    writer->beginObject();
+    writer->name("clock_error");
+    writer->write(clockError);
+
+    if (crossTraffic.isValid())
+    {
+        writer->name("cross_traffic");
+        writer->write(crossTraffic);
+    }
+
+    writer->name("duration");
+    writer->write(startDateTime.msecsTo(endDateTime));
+    writer->name("end_time");
+    writer->write(endDateTime);
+    writer->name("error");
+    writer->write(errorString);
+    writer->name("measure_uuid");
+    writer->write(uuidToString(measureUuid));
+
+    if (withInfo)
+    {
+        writer->name("post_info");
+        writer->write(QVariant(postInfo));
+        writer->name("pre_info");
+        writer->write(QVariant(preInfo));
+    }
+
+    writer->name("probe_result");
+    writer->write(QVariant(probeResult));
+    writer->name("start_time");
+    writer->write(startDateTime);
+    writer->endObject();
+}
+
+void Result::writeJson(JsonWriter *writer) const
+{
+    d->writeJson(writer, true);
+}
+
+void Result::writeJsonStripped(JsonWriter *writer) const
+{
+    d->writeJson(writer, false);
+}
+
+Result Result::readJson(JsonReader *reader)
+{
+    Result result;
+
+    if (reader->token() != JsonReader::BeginObject)
+    {
+        reader->skipValue();
+        return result;
+    }
+
+    ResultData *d = result.d.data();
+
+    while (reader->next() == JsonReader::Name)
+    {
+        QString name = reader->string();
+        reader->next();
+
+        if (name == QLatin1String("start_time"))
+        {
+            d->startDateTime = reader->toDateTime();
+        }
+        else if (name == QLatin1String("end_time"))
+        {
+            d->endDateTime = reader->toDateTime();
+        }
+        else if (name == QLatin1String("probe_result"))
+        {
+            d->probeResult = reader->readValue().toMap();
+        }
+        else if (name == QLatin1String("measure_uuid"))
+        {
+            d->measureUuid = QUuid(reader->string());
+        }
+        else if (name == QLatin1String("pre_info"))
+        {
+            d->preInfo = reader->readValue().toMap();
+        }
+        else if (name == QLatin1String("post_info"))
+        {
+            d->postInfo = reader->readValue().toMap();
+        }
+        else if (name == QLatin1String("error"))
+        {
+            d->errorString = reader->string();
+        }
+        else if (name == QLatin1String("clock_error"))
+        {
+            d->clockError = reader->token() == JsonReader::Number ? reader->toInteger() : -1;
+        }
+        else if (name == QLatin1String("cross_traffic"))
+        {
+            d->crossTraffic = reader->readValue();
+        }
+        else
+        {
+            reader->skipValue();
+        }
+    }
+
+    return result;
+}
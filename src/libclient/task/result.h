@@ -13,6 +13,9 @@
 class Result;
 typedef QList<Result> ResultList;
 
+class JsonWriter;
+class JsonReader;
+
 class CLIENT_API Result : public Serializable
 {
 public:
@@ -55,6 +58,14 @@ public:
     void setErrorString(const QString &errorString);
     QString errorString() const;
 
+    // Traffic of other hosts while the measurement ran, see CrossTrafficSampler
+    void setCrossTraffic(const QVariant &crossTraffic);
+    QVariant crossTraffic() const;
+
+    // Estimated clock error in µs (-1 = unknown)
+    void setClockError(qint64 clockError);
+    qint64 clockError() const;
+
     // Storage
     static Result fromVariant(const QVariant &variant);
 
@@ -62,6 +73,11 @@ public:
     QVariant toVariant() const;
     QVariant toVariantStripped() const;
 
+    // Same json as toVariant(), written and read without the QVariantMap
+    void writeJson(JsonWriter *writer) const;
+    void writeJsonStripped(JsonWriter *writer) const;
+    static Result readJson(JsonReader *reader);
+
 private:
     QSharedDataPointer<class ResultData> d;
 };
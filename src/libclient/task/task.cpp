@@ -1,18 +1,65 @@
 #include "task.h"
 #include "../types.h"
 #include "../timing/timingfactory.h"
+#include "../measurement/measurementfactory.h"
+#include "../storage/jsonwriter.h"
+#include "../storage/jsonreader.h"
+
+#include <QMutex>
+
+Q_GLOBAL_STATIC(MeasurementFactory, measurementFactory)
 
 class TaskData : public QSharedData
 {
 public:
+    TaskData()
+    : materialized(true)
+    {
+    }
+
+    TaskData(const TaskData &other)
+    : QSharedData(other)
+    , id(other.id)
+    , taskId(other.taskId)
+    , name(other.name)
+    , timing(other.timing)
+    , precondition(other.precondition)
+    {
+        QMutexLocker locker(&other.mutex);
+        measurementDefinition = other.measurementDefinition;
+        measurementDefinitionData = other.measurementDefinitionData;
+        materialized = other.materialized;
+        definition = other.definition;
+    }
+
     ScheduleId id;
     TaskId taskId;
     QString name;
     TimingPtr timing;
-    QVariant measurementDefinition;
     Precondition precondition;
+
+    // The definition is kept as json until it is needed, the mutex guards
+    // the parsing since schedules are shared with the executor thread
+    mutable QMutex mutex;
+    mutable QVariant measurementDefinition;
+    mutable QByteArray measurementDefinitionData;
+    mutable bool materialized;
+    mutable MeasurementDefinitionPtr definition;
+
+    // Functions
+    void materialize() const;
 };
 
+void TaskData::materialize() const
+{
+    if (!materialized)
+    {
+        measurementDefinition = JsonReader::toVariant(measurementDefinitionData);
+        measurementDefinitionData.clear();
+        materialized = true;
+    }
+}
+
 ScheduleDefinition::ScheduleDefinition()
 : d(new TaskData)
 {
@@ -66,7 +113,7 @@ QVariant ScheduleDefinition::toVariant() const
 
     task.insert("id", d->taskId.toInt());
     task.insert("method", d->name);
-    task.insert("options", d->measurementDefinition);
+    task.insert("options", measurementDefinition());
 
     map.insert("id", d->id.toInt());
     map.insert("timing", d->timing->toVariant());
@@ -103,6 +150,7 @@ TaskId ScheduleDefinition::taskId() const
 void ScheduleDefinition::setName(const QString &name)
 {
     d->name = name;
+    d->definition.clear();
 }
 
 QString ScheduleDefinition::name() const
@@ -123,13 +171,52 @@ TimingPtr ScheduleDefinition::timing() const
 void ScheduleDefinition::setMeasurementDefinition(const QVariant &measurementDefinition)
 {
     d->measurementDefinition = measurementDefinition;
+    d->measurementDefinitionData.clear();
+    d->materialized = true;
+    d->definition.clear();
 }
 
 QVariant ScheduleDefinition::measurementDefinition() const
 {
+    QMutexLocker locker(&d->mutex);
+    d->materialize();
+
     return d->measurementDefinition;
 }
 
+void ScheduleDefinition::setMeasurementDefinitionData(const QByteArray &data)
+{
+    d->measurementDefinition = QVariant();
+    d->measurementDefinitionData = data;
+    d->materialized = false;
+    d->definition.clear();
+}
+
+QByteArray ScheduleDefinition::measurementDefinitionData() const
+{
+    QMutexLocker locker(&d->mutex);
+
+    if (!d->materialized)
+    {
+        return d->measurementDefinitionData;
+    }
+
+    return JsonWriter::toJson(d->measurementDefinition);
+}
+
+MeasurementDefinitionPtr ScheduleDefinition::definition() const
+{
+    QMutexLocker locker(&d->mutex);
+
+    if (d->definition.isNull())
+    {
+        d->materialize();
+        d->definition = measurementFactory()->createMeasurementDefinition(d->name, d->measurementDefinition);
+    }
+
+    return d->definition;
+}
+
 void ScheduleDefinition::setPrecondition(const Precondition &precondition)
 {
     d->precondition = precondition;
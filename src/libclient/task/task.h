@@ -38,6 +38,13 @@ public:
     void setMeasurementDefinition(const QVariant &measurementDefinition);
     QVariant measurementDefinition() const;
 
+    // Compact json of the measurement definition, parsed on first access
+    void setMeasurementDefinitionData(const QByteArray &data);
+    QByteArray measurementDefinitionData() const;
+
+    // Typed definition, created once and shared by all runs (null if invalid)
+    MeasurementDefinitionPtr definition() const;
+
     void setPrecondition(const Precondition &precondition);
     Precondition precondition() const;
 
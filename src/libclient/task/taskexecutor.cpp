@@ -4,7 +4,9 @@
 #include "../network/networkmanager.h"
 #include "client.h"
 #include "controller/ntpcontroller.h"
+#include "../timing/clock.h"
 #include "localinformation.h"
+#include "crosstrafficsampler.h"
 
 #include <QThread>
 #include <QPointer>
@@ -12,22 +14,102 @@
 
 LOGGER(TaskExecutor);
 
+namespace
+{
+    // Throughput of these is skewed by other hosts sharing the uplink
+    bool isBandwidthMeasurement(const QString &name)
+    {
+        return name == "btc_ma" || name == "httpdownload" || name == "packettrains_ma";
+    }
+}
+
 class InternalTaskExecutor : public QObject
 {
     Q_OBJECT
 
 public:
+    InternalTaskExecutor()
+    : recyclable(false)
+    , crossTraffic(new CrossTrafficSampler(this))
+    {
+        factory.setPoolingEnabled(true);
+
+        connect(crossTraffic, SIGNAL(stopped()), this, SLOT(crossTrafficStopped()));
+    }
+
     MeasurementFactory factory;
     QPointer<NetworkManager> networkManager;
 
     ScheduleDefinition currentTest;
     MeasurementPtr measurement;
+    bool recyclable; // observers may keep a reference
+    CrossTrafficSampler *crossTraffic;
     QElapsedTimer timer;
 
+    // Held back until the cross traffic sampler took its final sample
+    Result pendingResult;
+
 private:
     LocalInformation localInformation;
 
+    void releaseMeasurement()
+    {
+        if (recyclable)
+        {
+            factory.recycle(currentTest.name(), measurement);
+        }
+
+        measurement.clear();
+
+        LOG_DEBUG(QString("Measurements allocated: %1, reused: %2").arg(factory.allocations()).arg(factory.reuses()));
+    }
+
+    void report(const Result &result)
+    {
+        if (!crossTraffic->isRunning())
+        {
+            emit finished(currentTest, result);
+            return;
+        }
+
+        pendingResult = result;
+        crossTraffic->stop();
+    }
+
+    void measurementFailed()
+    {
+        if (measurement.isNull())
+        {
+            // already reported through error()
+            return;
+        }
+
+        measurement->disconnect(this);
+
+        // the result should at least contain the errorString, as all the other
+        // fields will be empty
+        LOG_ERROR(QString("Finished execution of %1 (failed): %2").arg(currentTest.name()).arg(measurement->errorString()));
+
+        Result result;
+        result.setStartDateTime(measurement->startDateTime());
+        result.setEndDateTime(measurement->startDateTime().addMSecs(timer.elapsed()));
+        result.setPreInfo(measurement->preInfo());
+        result.setPostInfo(localInformation.getVariables());
+        result.setErrorString(measurement->errorString());
+        result.setClockError(Client::instance()->ntpController()->clockError());
+        report(result);
+
+        releaseMeasurement();
+    }
+
 public slots:
+    void crossTrafficStopped()
+    {
+        pendingResult.setCrossTraffic(crossTraffic->result());
+        emit finished(currentTest, pendingResult);
+        pendingResult = Result();
+    }
+
     void execute(const ScheduleDefinition &test, MeasurementObserver *observer)
     {
         LOG_INFO(QString("Starting execution of %1").arg(test.name()));
@@ -36,6 +118,7 @@ public slots:
 
         currentTest = test;
         measurement = factory.createMeasurement(test.name(), test.taskId());
+        recyclable = !observer;
 
         if (!measurement.isNull())
         {
@@ -58,35 +141,16 @@ public slots:
                 return;
             }
 
-            MeasurementDefinitionPtr definition = factory.createMeasurementDefinition(test.name(), test.measurementDefinition());
+            MeasurementDefinitionPtr definition = test.definition();
+
+            // the executor thread keeps running while the measurement
+            // prepares, start() follows in measurementPrepared()
+            connect(measurement.data(), SIGNAL(prepared()), this, SLOT(measurementPrepared()));
 
-            if (measurement->prepare(networkManager, definition))
+            if (!measurement->prepareAsync(networkManager, definition))
             {
-                // in case of no error this is the local information we want
-                // because it is right before the actual measurement
-                measurement->setPreInfo(localInformation.getVariables());
-                measurement->setStartDateTime(Client::instance()->ntpController()->currentDateTime());
-                timer.start();
-
-                if (measurement->start())
-                {
-                    return;
-                }
+                measurementFailed();
             }
-
-            // the result should at least contain the errorString, as all the other
-            // fields will be empty
-            LOG_ERROR(QString("Finished execution of %1 (failed): %2").arg(test.name()).arg(measurement->errorString()));
-
-            Result result;
-            result.setStartDateTime(measurement->startDateTime());
-            result.setEndDateTime(measurement->startDateTime().addMSecs(timer.elapsed()));
-            result.setPreInfo(measurement->preInfo());
-            result.setPostInfo(localInformation.getVariables());
-            result.setErrorString(measurement->errorString());
-            emit finished(test, result);
-
-            measurement.clear();
         }
         else
         {
@@ -95,6 +159,27 @@ public slots:
         }
     }
 
+    void measurementPrepared()
+    {
+        measurement->disconnect(this, SLOT(measurementPrepared()));
+
+        // in case of no error this is the local information we want
+        // because it is right before the actual measurement
+        measurement->setPreInfo(localInformation.getVariables());
+        measurement->setStartDateTime(Clock::currentDateTime());
+        timer.start();
+
+        if (isBandwidthMeasurement(currentTest.name()))
+        {
+            crossTraffic->start();
+        }
+
+        if (!measurement->start())
+        {
+            measurementFailed();
+        }
+    }
+
     void measurementFinished()
     {
         measurement->disconnect(this, SLOT(measurementFinished()));
@@ -108,14 +193,16 @@ public slots:
         result.setPreInfo(measurement->preInfo());
         result.setPostInfo(localInformation.getVariables());
         result.setErrorString(measurement->errorString()); // should be null
+        result.setClockError(Client::instance()->ntpController()->clockError());
+        report(result);
 
-        emit finished(currentTest, result);
         measurement->stop();
-        measurement.clear();
+        releaseMeasurement();
     }
 
     void measurementError(const QString &errorMsg)
     {
+        measurement->disconnect(this, SLOT(measurementPrepared()));
         measurement->disconnect(this, SLOT(measurementFinished()));
         measurement->disconnect(this, SLOT(measurementError(const QString &)));
 
@@ -127,10 +214,11 @@ public slots:
         result.setPreInfo(measurement->preInfo());
         result.setPostInfo(localInformation.getVariables());
         result.setErrorString(errorMsg);
-        emit finished(currentTest, result);
+        result.setClockError(Client::instance()->ntpController()->clockError());
+        report(result);
 
         measurement->stop();
-        measurement.clear();
+        releaseMeasurement();
     }
 
 signals:
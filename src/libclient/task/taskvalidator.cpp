@@ -42,6 +42,10 @@ TaskValidator::ValidationResult TaskValidator::validate(const ScheduleDefinition
         return Invalid;
     }
 
+    // Build the typed definition once, it is shared by all runs. Some
+    // measurements (upnp, wifilookup) don't need a definition at all.
+    testDefinition.definition();
+
     // Check the timing
     TimingPtr timing = testDefinition.timing();
 
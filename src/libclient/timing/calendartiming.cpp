@@ -1,8 +1,7 @@
 #include "calendartiming.h"
 #include "types.h"
 #include <algorithm>
-#include "client.h"
-#include "controller/ntpcontroller.h"
+#include "clock.h"
 
 const QList<int> CalendarTiming::AllMonths = QList<int>()<<1<<2<<3<<4<<5<<6<<7<<8<<9<<10<<11<<12;
 const QList<int> CalendarTiming::AllDaysOfWeek = QList<int>()<<1<<2<<3<<4<<5<<6<<7;
@@ -115,7 +114,7 @@ CalendarTiming::~CalendarTiming()
 
 bool CalendarTiming::reset()
 {
-    m_lastExecution = Client::instance()->ntpController()->currentDateTime();
+    m_lastExecution = Clock::now();
 
     return nextRun().isValid();
 }
@@ -131,7 +130,7 @@ QDateTime CalendarTiming::nextRun(const QDateTime &tzero) const
     }
     else
     {
-        now = Client::instance()->ntpController()->currentDateTime();
+        now = Clock::currentDateTime();
     }
 
     QDate date = now.date();
@@ -191,7 +190,7 @@ QDateTime CalendarTiming::nextRun(const QDateTime &tzero) const
                                 nextRun = QDateTime(nextRunDate, nextRunTime);
 
                                 // check if the calculated next run was already executed
-                                if (!m_lastExecution.isValid() || m_lastExecution.secsTo(nextRun) > 1)
+                                if (m_lastExecution == 0 || Clock::fromDateTime(nextRun) - m_lastExecution >= Q_INT64_C(2000000000))
                                 {
                                     found = true;
                                 }
@@ -0,0 +1,130 @@
+#include "clock.h"
+
+#include <QAtomicPointer>
+#include <QElapsedTimer>
+
+#if defined(Q_OS_LINUX)
+#include <time.h>
+#endif
+
+namespace
+{
+    struct Correction
+    {
+        qint64 base; // ns since epoch at monotonic zero
+        qint64 syncMonotonic; // ns
+        double drift; // ppm
+    };
+
+    // Snapshots are never modified while published. A reader would have to
+    // stall for several synchronizations before its slot is reused.
+    const int slotCount = 4;
+    Correction corrections[slotCount];
+    int nextSlot = 0;
+
+    QAtomicPointer<const Correction> current;
+
+    struct MonotonicTimer
+    {
+        MonotonicTimer()
+        {
+            timer.start();
+        }
+
+        QElapsedTimer timer;
+    };
+
+    Q_GLOBAL_STATIC(MonotonicTimer, monotonicTimer)
+
+    qint64 systemNow()
+    {
+#if defined(Q_OS_LINUX)
+        struct timespec ts;
+
+        if (clock_gettime(CLOCK_REALTIME, &ts) == 0)
+        {
+            return ts.tv_sec * Q_INT64_C(1000000000) + ts.tv_nsec;
+        }
+#endif
+
+        return QDateTime::currentMSecsSinceEpoch() * 1000000;
+    }
+}
+
+qint64 Clock::now()
+{
+    const Correction *correction = current.loadAcquire();
+
+    if (!correction)
+    {
+        // Without synchronization we stick to the system clock
+        return systemNow();
+    }
+
+    qint64 monotonicTime = monotonic();
+    qint64 sinceSync = monotonicTime - correction->syncMonotonic;
+
+    return correction->base + monotonicTime + (qint64)(sinceSync * correction->drift / 1000000.0);
+}
+
+qint64 Clock::nowMSecs()
+{
+    return now() / 1000000;
+}
+
+QDateTime Clock::currentDateTime()
+{
+    return QDateTime::fromMSecsSinceEpoch(nowMSecs());
+}
+
+qint64 Clock::monotonic()
+{
+#if defined(Q_OS_LINUX)
+    // CLOCK_BOOTTIME keeps running while the device is suspended
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_BOOTTIME, &ts) == 0)
+    {
+        return ts.tv_sec * Q_INT64_C(1000000000) + ts.tv_nsec;
+    }
+#endif
+
+    return monotonicTimer()->timer.nsecsElapsed();
+}
+
+QDateTime Clock::toDateTime(qint64 nsecs)
+{
+    if (nsecs == 0)
+    {
+        return QDateTime();
+    }
+
+    return QDateTime::fromMSecsSinceEpoch(nsecs / 1000000);
+}
+
+qint64 Clock::fromDateTime(const QDateTime &dateTime)
+{
+    if (!dateTime.isValid())
+    {
+        return 0;
+    }
+
+    return dateTime.toMSecsSinceEpoch() * 1000000;
+}
+
+void Clock::setCorrection(qint64 base, qint64 syncMonotonic, double drift)
+{
+    Correction *correction = &corrections[nextSlot];
+    nextSlot = (nextSlot + 1) % slotCount;
+
+    correction->base = base;
+    correction->syncMonotonic = syncMonotonic;
+    correction->drift = drift;
+
+    current.storeRelease(correction);
+}
+
+bool Clock::isCorrected()
+{
+    return current.loadAcquire() != NULL;
+}
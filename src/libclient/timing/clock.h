@@ -0,0 +1,31 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include "../export.h"
+
+#include <QDateTime>
+
+// Lock-free access to the ntp corrected time. All values are in ns, the
+// correction is published by the NtpController as an immutable snapshot.
+class CLIENT_API Clock
+{
+public:
+    // Corrected time since epoch
+    static qint64 now();
+    static qint64 nowMSecs();
+    static QDateTime currentDateTime();
+
+    // Monotonic time, keeps running while the device is suspended
+    static qint64 monotonic();
+
+    // Conversion at the serialization boundary, 0 is an invalid time
+    static QDateTime toDateTime(qint64 nsecs);
+    static qint64 fromDateTime(const QDateTime &dateTime);
+
+    // Publish a new correction: time = base + monotonic + drift since syncMonotonic.
+    // Only the NtpController calls this, always from the same thread.
+    static void setCorrection(qint64 base, qint64 syncMonotonic, double drift);
+    static bool isCorrected();
+};
+
+#endif // CLOCK_H
@@ -1,6 +1,5 @@
 #include "immediatetiming.h"
-#include "client.h"
-#include "controller/ntpcontroller.h"
+#include "clock.h"
 
 class ImmediateTiming::Private
 {
@@ -25,7 +24,12 @@ bool ImmediateTiming::reset()
 QDateTime ImmediateTiming::nextRun(const QDateTime &tzero) const
 {
     Q_UNUSED(tzero)
-    return Client::instance()->ntpController()->currentDateTime();
+    return Clock::currentDateTime();
+}
+
+qint64 ImmediateTiming::nextRunNsecs(qint64 tzero) const
+{
+    return tzero ? tzero : Clock::now();
 }
 
 bool ImmediateTiming::isValid() const
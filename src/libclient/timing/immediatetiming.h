@@ -16,6 +16,7 @@ public:
     QString type() const;
     bool reset();
     QDateTime nextRun(const QDateTime &tzero = QDateTime()) const;
+    qint64 nextRunNsecs(qint64 tzero = 0) const;
     bool isValid() const;
 
     // Serializable interface
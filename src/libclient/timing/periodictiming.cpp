@@ -1,12 +1,13 @@
 #include "periodictiming.h"
-#include "client.h"
-#include "../controller/ntpcontroller.h"
+#include "clock.h"
 
 class PeriodicTiming::Private
 {
 public:
     QDateTime start;
     QDateTime end;
+    qint64 startMSecs;
+    qint64 endMSecs;
     int period;
     int randomSpread;
     int randomDelay;
@@ -18,6 +19,8 @@ PeriodicTiming::PeriodicTiming(int period, const QDateTime &start, const QDateTi
     d->period = period;
     d->start = start;
     d->end = end;
+    d->startMSecs = start.isValid() ? start.toMSecsSinceEpoch() : 0;
+    d->endMSecs = end.isValid() ? end.toMSecsSinceEpoch() : 0;
     d->randomSpread = randomSpread;
 
     if (d->randomSpread)
@@ -43,49 +46,45 @@ QString PeriodicTiming::type() const
 
 bool PeriodicTiming::reset()
 {
-    m_lastExecution = Client::instance()->ntpController()->currentDateTime();
+    m_lastExecution = Clock::now();
 
-    return nextRun().isValid();
+    return nextRunNsecs(m_lastExecution) != 0;
 }
 
 QDateTime PeriodicTiming::nextRun(const QDateTime &tzero) const
 {
-    QDateTime nextRun;
-    QDateTime now;
+    return Clock::toDateTime(nextRunNsecs(Clock::fromDateTime(tzero)));
+}
 
-    if (tzero.isValid())
-    {
-        now = tzero;
-    }
-    else
-    {
-        now = Client::instance()->ntpController()->currentDateTime();
-    }
+qint64 PeriodicTiming::nextRunNsecs(qint64 tzero) const
+{
+    qint64 now = (tzero ? tzero : Clock::now()) / 1000000;
 
     // Check if the start time is reached
-    if (d->start > now)
+    if (d->start.isValid() && d->startMSecs > now)
     {
-        return d->start;
+        return d->startMSecs * 1000000;
     }
 
     if (!d->start.isValid())
     {
-        d->start = now;
+        d->start = QDateTime::fromMSecsSinceEpoch(now);
+        d->startMSecs = now;
     }
 
     // Calculate number of completed periods
-    quint64 completedPeriods = d->start.msecsTo(now) / d->period;
+    qint64 completedPeriods = (now - d->startMSecs) / d->period;
     // Add the already executed periods to the start time + 1
-    nextRun = d->start.addMSecs((completedPeriods + 1) * d->period);
+    qint64 nextRun = d->startMSecs + (completedPeriods + 1) * d->period;
 
     // Stop if we exceed the end time
-    if (d->end.isValid() && d->end < nextRun)
+    if (d->end.isValid() && d->endMSecs < nextRun)
     {
-        return QDateTime();
+        return 0;
     }
 
     // add random delay
-    return nextRun.addMSecs(d->randomDelay);
+    return (nextRun + d->randomDelay) * 1000000;
 }
 
 bool PeriodicTiming::isValid() const
@@ -1,11 +1,35 @@
 #include "timing.h"
+#include "clock.h"
+
+qint64 Timing::timeLeft() const
+{
+    qint64 now = Clock::now();
+    qint64 next = nextRunNsecs(now);
+
+    if (next == 0)
+    {
+        return 0;
+    }
+
+    return (next - now) / 1000000;
+}
 
 qint64 Timing::timeLeft(const QDateTime &when) const
 {
     return when.msecsTo(nextRun());
 }
 
-QDateTime Timing::lastExecution()
+QDateTime Timing::lastExecution() const
+{
+    return Clock::toDateTime(m_lastExecution);
+}
+
+qint64 Timing::lastExecutionNsecs() const
 {
     return m_lastExecution;
 }
+
+qint64 Timing::nextRunNsecs(qint64 tzero) const
+{
+    return Clock::fromDateTime(nextRun(Clock::toDateTime(tzero)));
+}
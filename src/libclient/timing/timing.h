@@ -13,18 +13,27 @@ typedef QSharedPointer<Timing> TimingPtr;
 class CLIENT_API Timing : public Serializable
 {
 public:
-    qint64 timeLeft(const QDateTime &when = QDateTime::currentDateTime()) const;
-    QDateTime lastExecution();
-
+    Timing() : m_lastExecution(0) {}
     virtual ~Timing() {}
 
+    qint64 timeLeft() const;
+    qint64 timeLeft(const QDateTime &when) const;
+    QDateTime lastExecution() const;
+
+    // Time of the last execution in ns since epoch, 0 if never executed
+    qint64 lastExecutionNsecs() const;
+
     virtual QString type() const = 0;
     virtual bool reset() = 0; // true = reset; false = stop execute
     virtual QDateTime nextRun(const QDateTime &tzero = QDateTime()) const = 0;
     virtual bool isValid() const = 0;
 
+    // Next run in ns since epoch (0 = no next run), tzero 0 means now.
+    // The default implementation goes through nextRun().
+    virtual qint64 nextRunNsecs(qint64 tzero = 0) const;
+
 protected:
-    QDateTime m_lastExecution;
+    qint64 m_lastExecution; // ns
 };
 
 #endif // TIMING_H
@@ -2,6 +2,7 @@
 #include "client.h"
 #include "settings.h"
 #include "log/logger.h"
+#include "storage/jsonwriter.h"
 
 #include <QTimer>
 #include <QPointer>
@@ -22,6 +23,7 @@ public:
     Private(WebRequester *q)
     : q(q)
     , status(WebRequester::Unknown)
+    , notModified(false)
     {
         connect(&timer, SIGNAL(timeout()), this, SLOT(timeout()));
 
@@ -37,6 +39,8 @@ public:
     QPointer<Request> request;
     QPointer<Response> response;
     QString errorString;
+    QByteArray eTag;
+    bool notModified;
 
     QJsonObject jsonData;
 
@@ -83,7 +87,19 @@ void WebRequester::Private::requestFinished()
     QNetworkReply *reply = qobject_cast<QNetworkReply *>(sender());
     QNetworkReply::NetworkError networkError = reply->error();
 
-    if (networkError == QNetworkReply::NoError)
+    if (reply->hasRawHeader("ETag"))
+    {
+        eTag = reply->rawHeader("ETag");
+    }
+
+    if (networkError == QNetworkReply::NoError &&
+        reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() == 304)
+    {
+        LOG_DEBUG(QString("Not modified: %1").arg(reply->url().path()));
+        notModified = true;
+        setStatus(WebRequester::Finished);
+    }
+    else if (networkError == QNetworkReply::NoError)
     {
         QJsonParseError jsonError;
         QByteArray data = reply->readAll();
@@ -284,6 +300,21 @@ bool WebRequester::isRunning() const
     return (d->status == Running);
 }
 
+void WebRequester::setETag(const QByteArray &eTag)
+{
+    d->eTag = eTag;
+}
+
+QByteArray WebRequester::eTag() const
+{
+    return d->eTag;
+}
+
+bool WebRequester::notModified() const
+{
+    return d->notModified;
+}
+
 QString WebRequester::errorString() const
 {
     return d->errorString;
@@ -349,6 +380,7 @@ void WebRequester::start()
         authentication = metaObject->classInfo(authenticationIdx).value();
     }
 
+    d->notModified = false;
     d->setStatus(Running);
 
     const Settings *settings = Client::instance()->settings();
@@ -357,9 +389,6 @@ void WebRequester::start()
     d->request->setDeviceId(settings->deviceId());
     d->request->setSessionId(settings->apiKey());
 
-
-    QVariantMap data = d->request->toVariant().toMap();
-
     QUrl url = d->url;
     url.setPath(path);
 
@@ -381,8 +410,14 @@ void WebRequester::start()
 
     }
 
+    if (!d->eTag.isEmpty())
+    {
+        request.setRawHeader("If-None-Match", d->eTag);
+    }
+
     if (httpMethod == "get")
     {
+        QVariantMap data = d->request->toVariant().toMap();
         QUrlQuery query(url);
 
         QMapIterator<QString, QVariant> iter(data);
@@ -405,9 +440,13 @@ void WebRequester::start()
         request.setUrl(url);
 
         // compress data, remove the first four bytes (which is the array length which does not belong there), convert to base64
-        QVariantMap map;
-        map.insert("data", qCompress(QJsonDocument::fromVariant(data).toJson(QJsonDocument::Compact)).remove(0,4).toBase64());
-        reply = Client::instance()->networkAccessManager()->post(request, QJsonDocument::fromVariant(map).toJson());
+        QByteArray body;
+        JsonWriter writer(&body);
+        writer.beginObject();
+        writer.name("data");
+        writer.write(qCompress(d->request->toJson()).remove(0,4).toBase64().constData());
+        writer.endObject();
+        reply = Client::instance()->networkAccessManager()->post(request, body);
     }
     else
     {
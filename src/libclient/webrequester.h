@@ -47,6 +47,13 @@ public:
 
     bool isRunning() const;
 
+    // Sent as If-None-Match, replaced by the ETag of each reply
+    void setETag(const QByteArray &eTag);
+    QByteArray eTag() const;
+
+    // True if the last reply was 304 Not Modified, the response is left untouched
+    bool notModified() const;
+
     Q_INVOKABLE QString errorString() const;
 
     Q_INVOKABLE QVariant jsonDataQml() const;
@@ -0,0 +1,68 @@
+#ifndef BENCHMARKDATA_H
+#define BENCHMARKDATA_H
+
+#include <report/report.h>
+
+#include <QUuid>
+
+// Results shaped like the ones of a ping task, with the device state
+// LocalInformation::getVariables() records before and after each run
+namespace BenchmarkData
+{
+    inline QVariantMap deviceState(int i)
+    {
+        QVariantMap map;
+        map.insert("cpu_usage", 12 + i % 5);
+        map.insert("free_memory", Q_INT64_C(512000000) - i * 4096);
+        map.insert("signal_strength", -67);
+        map.insert("battery_level", 100 - i % 100);
+        map.insert("available_disk_space", Q_INT64_C(8000000000));
+        map.insert("connection_mode", 3);
+        map.insert("tbm_active", true);
+        map.insert("available_traffic", Q_INT64_C(1000000000));
+        map.insert("available_mobile_traffic", Q_INT64_C(100000000));
+        map.insert("used_traffic", Q_INT64_C(1000) * i);
+        map.insert("used_mobile_traffic", 0);
+        return map;
+    }
+
+    inline Result result(int i)
+    {
+        QVariantList roundTrips;
+
+        for (int k = 0; k < 10; ++k)
+        {
+            roundTrips << 20.5 + k;
+        }
+
+        QVariantMap probe;
+        probe.insert("round_trip_avg", 25.0);
+        probe.insert("round_trip_min", 20.5);
+        probe.insert("round_trip_max", 29.5);
+        probe.insert("round_trip_stdev", 2.87);
+        probe.insert("round_trip_ms", roundTrips);
+        probe.insert("round_trip_sent", 10);
+        probe.insert("round_trip_received", 10);
+        probe.insert("round_trip_loss", 0);
+
+        QDateTime start(QDate(2021, 3, 1), QTime(12, 0, 0));
+        start = start.addSecs(i * 60);
+
+        return Result(start, start.addSecs(10), probe, QUuid::createUuid(), deviceState(i), deviceState(i + 1),
+                      QString());
+    }
+
+    inline Report report(int taskId, int results)
+    {
+        ResultList list;
+
+        for (int i = 0; i < results; ++i)
+        {
+            list.append(result(i));
+        }
+
+        return Report(TaskId(taskId), QDateTime(QDate(2021, 3, 1), QTime(12, 0, 0)), "1.0.0", list);
+    }
+}
+
+#endif // BENCHMARKDATA_H
@@ -0,0 +1,13 @@
+TEMPLATE = subdirs
+
+SUBDIRS += \
+	calendartiming \
+	datagram \
+	httpdownload \
+	logger \
+	reportstorage \
+	scheduler \
+	serialization
+
+# The harness measures cpu time with clock_gettime()
+!android:linux: SUBDIRS += loopback
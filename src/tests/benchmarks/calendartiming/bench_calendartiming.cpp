@@ -0,0 +1,56 @@
+#include <QtTest>
+
+#include <timing/calendartiming.h>
+
+class BenchCalendarTiming : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void nextRun_data()
+    {
+        QTest::addColumn<QList<int> >("months");
+        QTest::addColumn<QList<int> >("daysOfWeek");
+        QTest::addColumn<QList<int> >("daysOfMonth");
+        QTest::addColumn<QList<int> >("hours");
+
+        QList<int> midnight = QList<int>() << 0;
+
+        QTest::newRow("every second") << CalendarTiming::AllMonths << CalendarTiming::AllDaysOfWeek
+                                      << CalendarTiming::AllDaysOfMonth << CalendarTiming::AllHours;
+
+        // Only a few days per year match
+        QTest::newRow("monday the 31st") << CalendarTiming::AllMonths << (QList<int>() << 1) << (QList<int>() << 31)
+                                         << midnight;
+
+        // Searches up to the next leap year
+        QTest::newRow("leap day") << (QList<int>() << 2) << CalendarTiming::AllDaysOfWeek << (QList<int>() << 29)
+                                  << midnight;
+
+        // Never matches, the search runs until it gives up
+        QTest::newRow("impossible") << (QList<int>() << 2) << CalendarTiming::AllDaysOfWeek << (QList<int>() << 30)
+                                    << midnight;
+    }
+
+    void nextRun()
+    {
+        QFETCH(QList<int>, months);
+        QFETCH(QList<int>, daysOfWeek);
+        QFETCH(QList<int>, daysOfMonth);
+        QFETCH(QList<int>, hours);
+
+        CalendarTiming timing(QDateTime(), QDateTime(), months, daysOfWeek, daysOfMonth, hours,
+                              CalendarTiming::AllMinutes, CalendarTiming::AllSeconds);
+
+        QDateTime from(QDate(2021, 3, 1), QTime(12, 0, 0));
+
+        QBENCHMARK
+        {
+            timing.nextRun(from);
+        }
+    }
+};
+
+QTEST_MAIN(BenchCalendarTiming)
+
+#include "bench_calendartiming.moc"
@@ -0,0 +1,89 @@
+#include <QtTest>
+
+#include <network/peerrequest.h>
+#include <network/dnsclient.h>
+
+#include <QJsonDocument>
+#include <QJsonObject>
+
+// The parsing done by NetworkManager::processDatagram() for both formats
+// of a peer request, and the decoding of dns answers
+class BenchDatagram : public QObject
+{
+    Q_OBJECT
+
+private:
+    PeerRequest request()
+    {
+        QVariantMap definition;
+        definition.insert("host", "measure-it.net");
+        definition.insert("count", 3);
+        definition.insert("interval", 1000);
+
+        PeerRequest request;
+        request.measurementDefinition = definition;
+        request.taskId = TaskId(42);
+        request.measurementUuid = QUuid::createUuid();
+        request.measurement = "btc_ma";
+        request.peer = "192.0.2.1";
+        request.port = 5106;
+        request.protocol = NetworkManager::TcpSocket;
+        return request;
+    }
+
+private slots:
+    void peerRequestJson()
+    {
+        QByteArray datagram = QJsonDocument::fromVariant(request().toVariant()).toJson(QJsonDocument::Compact);
+
+        QBENCHMARK
+        {
+            QJsonParseError error;
+            QJsonDocument document = QJsonDocument::fromJson(datagram, &error);
+            document.object().value("error").toString();
+            PeerRequest::fromVariant(document.toVariant());
+        }
+    }
+
+    void peerRequestBinary()
+    {
+        QByteArray datagram = request().toBinary();
+        QVERIFY(PeerRequest::isBinary(datagram));
+
+        QBENCHMARK
+        {
+            PeerRequest parsed;
+            QString errorString;
+            PeerRequest::isBinary(datagram);
+            PeerRequest::fromBinary(datagram, &parsed, &errorString);
+        }
+    }
+
+    void dnsResponse()
+    {
+        // www.example.com AAAA with one answer, the name is compressed
+        QByteArray response = DnsClient::encodeQuery(0x1234, "www.example.com", DnsClient::AAAA);
+        response[2] = char(0x81);
+        response[3] = char(0x80);
+        response[7] = 1;
+        response.append(QByteArray::fromHex("c00c001c00010000012c0010"));
+        response.append(QByteArray::fromHex("20010db8000000000000000000000001"));
+
+        quint16 id;
+        int rcode;
+        bool truncated;
+        QList<DnsClient::Answer> answers;
+        QVERIFY(DnsClient::decodeResponse(response, &id, &rcode, &truncated, &answers));
+        QCOMPARE(answers.size(), 1);
+
+        QBENCHMARK
+        {
+            answers.clear();
+            DnsClient::decodeResponse(response, &id, &rcode, &truncated, &answers);
+        }
+    }
+};
+
+QTEST_MAIN(BenchDatagram)
+
+#include "bench_datagram.moc"
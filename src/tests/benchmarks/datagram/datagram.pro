@@ -0,0 +1,8 @@
+CONFIG += testcase benchmark
+CONFIG -= app_bundle
+QT += testlib network
+
+TARGET = bench_datagram
+SOURCES = bench_datagram.cpp
+
+include($$SOURCE_DIRECTORY/src/libclient/libclient.pri)
@@ -0,0 +1,70 @@
+#include <QtTest>
+
+#include <measurement/http/httpdownload.h>
+
+// The slot math HTTPDownload::calculateResults() runs for every thread
+class BenchHttpDownload : public QObject
+{
+    Q_OBJECT
+
+private:
+    void fill(DownloadThread *thread, int seconds)
+    {
+        // One read of 16 KiB every 100 us
+        for (qint64 nsecs = 0; nsecs < Q_INT64_C(1000000000) * seconds; nsecs += 100000)
+        {
+            thread->addSample(16384, nsecs);
+        }
+    }
+
+    void durations()
+    {
+        QTest::addColumn<int>("seconds");
+
+        QTest::newRow("1 s") << 1;
+        QTest::newRow("10 s") << 10;
+    }
+
+private slots:
+    void measurementSlots_data()
+    {
+        durations();
+    }
+
+    void measurementSlots()
+    {
+        QFETCH(int, seconds);
+
+        DownloadThread thread(QUrl("http://measure-it.net/file"), QHostInfo());
+        fill(&thread, seconds);
+
+        QBENCHMARK
+        {
+            thread.measurementSlots(250);
+        }
+    }
+
+    void averageThroughput_data()
+    {
+        durations();
+    }
+
+    void averageThroughput()
+    {
+        QFETCH(int, seconds);
+
+        DownloadThread thread(QUrl("http://measure-it.net/file"), QHostInfo());
+        fill(&thread, seconds);
+
+        qint64 start = thread.startTimeInNs();
+
+        QBENCHMARK
+        {
+            thread.averageThroughput(start + Q_INT64_C(100000000), start + Q_INT64_C(1000000000) * seconds);
+        }
+    }
+};
+
+QTEST_MAIN(BenchHttpDownload)
+
+#include "bench_httpdownload.moc"
@@ -0,0 +1,8 @@
+CONFIG += testcase benchmark
+CONFIG -= app_bundle
+QT += testlib network
+
+TARGET = bench_httpdownload
+SOURCES = bench_httpdownload.cpp
+
+include($$SOURCE_DIRECTORY/src/libclient/libclient.pri)
@@ -0,0 +1,108 @@
+#include <QtTest>
+#include <QtConcurrent/QtConcurrentRun>
+
+#include <log/logger.h>
+
+namespace
+{
+    const int messagesPerThread = 1000;
+
+    // Formatting is measured, writing to the terminal is not
+    void discardMessage(QtMsgType type, const QMessageLogContext &context, const QString &message)
+    {
+        Q_UNUSED(type);
+        Q_UNUSED(context);
+        Q_UNUSED(message);
+    }
+
+    class NullAppender : public LogAppender
+    {
+    public:
+        void log(Logger::Level level, const QString &name, const QString &funcName, const QString &message)
+        {
+            Q_UNUSED(level);
+            Q_UNUSED(name);
+            Q_UNUSED(funcName);
+            Q_UNUSED(message);
+        }
+    };
+
+    void logMessages(Logger *logger)
+    {
+        for (int i = 0; i < messagesPerThread; ++i)
+        {
+            logger->logInfo(Q_FUNC_INFO, "Scheduling timer executes ping in 1000 ms");
+        }
+    }
+}
+
+class BenchLogger : public QObject
+{
+    Q_OBJECT
+
+private:
+    QtMessageHandler previousHandler;
+    NullAppender appender;
+
+private slots:
+    void init()
+    {
+        Logger::addAppender(&appender);
+        previousHandler = qInstallMessageHandler(discardMessage);
+    }
+
+    void cleanup()
+    {
+        qInstallMessageHandler(previousHandler);
+        Logger::removeAppender(&appender);
+    }
+
+    void single()
+    {
+        Logger logger("Bench");
+
+        QBENCHMARK
+        {
+            logger.logInfo(Q_FUNC_INFO, "Scheduling timer executes ping in 1000 ms");
+        }
+    }
+
+    void contention_data()
+    {
+        QTest::addColumn<int>("threads");
+
+        QTest::newRow("1") << 1;
+        QTest::newRow("2") << 2;
+        QTest::newRow("4") << 4;
+        QTest::newRow("8") << 8;
+    }
+
+    // Every thread logs the same number of messages, all through one lock
+    void contention()
+    {
+        QFETCH(int, threads);
+
+        Logger logger("Bench");
+        QThreadPool pool;
+        pool.setMaxThreadCount(threads);
+
+        QBENCHMARK
+        {
+            QList<QFuture<void> > futures;
+
+            for (int i = 0; i < threads; ++i)
+            {
+                futures.append(QtConcurrent::run(&pool, logMessages, &logger));
+            }
+
+            foreach (QFuture<void> future, futures)
+            {
+                future.waitForFinished();
+            }
+        }
+    }
+};
+
+QTEST_MAIN(BenchLogger)
+
+#include "bench_logger.moc"
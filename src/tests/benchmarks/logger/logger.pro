@@ -0,0 +1,8 @@
+CONFIG += testcase benchmark
+CONFIG -= app_bundle
+QT += testlib network concurrent
+
+TARGET = bench_logger
+SOURCES = bench_logger.cpp
+
+include($$SOURCE_DIRECTORY/src/libclient/libclient.pri)
@@ -0,0 +1,305 @@
+#include <QtTest>
+
+#include "loopbackharness.h"
+
+#include <measurement/measurementfactory.h>
+
+// Runs the measurement agents end-to-end against the stand-in peers of
+// LoopbackHarness. Throughput measurements report the client cpu time in
+// ms per Gbit they move, the others how far their timing is off.
+class BenchLoopback : public QObject
+{
+    Q_OBJECT
+
+private:
+    struct Run
+    {
+        double clientCpu; // seconds
+        double peerCpu; // seconds
+        quint64 bytes;
+        qint64 duration; // ns from start() to finished()
+        Result result;
+    };
+
+    LoopbackHarness harness;
+    MeasurementFactory factory;
+    QElapsedTimer clock;
+    qint64 finishedAt;
+
+    bool waitFor(const QSignalSpy &done, const QSignalSpy &failed, int timeout)
+    {
+        QElapsedTimer timer;
+        timer.start();
+
+        while (done.isEmpty() && failed.isEmpty() && timer.elapsed() < timeout)
+        {
+            QTest::qWait(10);
+        }
+
+        return !done.isEmpty() && failed.isEmpty();
+    }
+
+    // Prepares and starts the measurement like the TaskExecutor does
+    bool run(const QString &name, const QVariantMap &options, int timeout, Run *run)
+    {
+        MeasurementPtr measurement = factory.createMeasurement(name, TaskId(1));
+        MeasurementDefinitionPtr definition = factory.createMeasurementDefinition(name, options);
+
+        QSignalSpy prepared(measurement.data(), SIGNAL(prepared()));
+        QSignalSpy finished(measurement.data(), SIGNAL(finished()));
+        QSignalSpy error(measurement.data(), SIGNAL(error(QString)));
+
+        connect(measurement.data(), SIGNAL(finished()), this, SLOT(stamp()));
+
+        if (!measurement->prepareAsync(harness.networkManager(), definition) || !waitFor(prepared, error, 10000))
+        {
+            qWarning("prepare: %s", qPrintable(measurement->errorString()));
+            return false;
+        }
+
+        harness.resetCounters();
+
+        double processCpu = LoopbackHarness::processCpuTime();
+        double peerCpu = harness.peerCpuTime();
+        qint64 startedAt = clock.nsecsElapsed();
+
+        if (!measurement->start() || !waitFor(finished, error, timeout))
+        {
+            qWarning("start: %s", qPrintable(measurement->errorString()));
+            measurement->stop();
+            return false;
+        }
+
+        run->peerCpu = harness.peerCpuTime() - peerCpu;
+        run->clientCpu = LoopbackHarness::processCpuTime() - processCpu - run->peerCpu;
+        run->bytes = harness.bytesForwarded();
+        run->duration = finishedAt - startedAt;
+        run->result = measurement->result();
+
+        measurement->stop();
+        return true;
+    }
+
+    void reportCpu(const Run &run)
+    {
+        QVERIFY(run.bytes > 0);
+
+        double gbit = run.bytes * 8 / 1e9;
+
+        qDebug("%.3f Gbit in %.0f ms, %.1f ms peer cpu", gbit, run.duration / 1e6, run.peerCpu * 1000);
+
+        QTest::setBenchmarkResult(run.clientCpu * 1000 / gbit, QTest::WalltimeMilliseconds);
+    }
+
+    void shaping()
+    {
+        QTest::addColumn<int>("delay");
+        QTest::addColumn<quint64>("rate");
+
+        QTest::newRow("unshaped") << 0 << quint64(0);
+        QTest::newRow("10 ms") << 10 << quint64(0);
+        QTest::newRow("10 ms, 1 Gbit/s") << 10 << quint64(125000000);
+    }
+
+protected slots:
+    void stamp()
+    {
+        finishedAt = clock.nsecsElapsed();
+    }
+
+private slots:
+    void initTestCase()
+    {
+        QStandardPaths::setTestModeEnabled(true);
+
+        if (!harness.start())
+        {
+            QSKIP(qPrintable(harness.errorString()));
+        }
+
+        clock.start();
+    }
+
+    void btc_data()
+    {
+        shaping();
+    }
+
+    void btc()
+    {
+        QFETCH(int, delay);
+        QFETCH(quint64, rate);
+
+        harness.setShaping(delay, 0, 0, rate);
+
+        QVariantMap options;
+        options.insert("host", LoopbackHarness::shapedAddress().toString());
+        options.insert("port", harness.btcPort());
+
+        Run result;
+        QVERIFY(run("btc_ma", options, 30000, &result));
+        QVERIFY(result.result.probeResult().value("kBs_avg").toDouble() > 0);
+
+        reportCpu(result);
+    }
+
+    void httpDownload_data()
+    {
+        shaping();
+    }
+
+    void httpDownload()
+    {
+        QFETCH(int, delay);
+        QFETCH(quint64, rate);
+
+        harness.setShaping(delay, 0, 0, rate);
+
+        QVariantMap options;
+        options.insert("url", QString("http://%1:%2/").arg(LoopbackHarness::shapedAddress().toString())
+                       .arg(harness.httpPort()));
+        options.insert("threads", 2);
+        options.insert("target_time", 2000);
+        options.insert("ramp_up_time", 1000);
+        options.insert("slot_length", 250);
+
+        Run result;
+        QVERIFY(run("httpdownload", options, 30000, &result));
+        QVERIFY(result.result.probeResult().value("bandwidth_bps_avg").toDouble() > 0);
+
+        reportCpu(result);
+    }
+
+    void packetTrains_data()
+    {
+        QTest::addColumn<int>("delay");
+        QTest::addColumn<int>("jitter");
+        QTest::addColumn<qreal>("loss");
+
+        QTest::newRow("unshaped") << 0 << 0 << 0.0;
+        QTest::newRow("10 ms, 1% loss") << 10 << 0 << 0.01;
+        QTest::newRow("10 ms +/- 2 ms") << 10 << 2 << 0.0;
+    }
+
+    // How close the sender gets to the dispersion it aims for
+    void packetTrains()
+    {
+        QFETCH(int, delay);
+        QFETCH(int, jitter);
+        QFETCH(qreal, loss);
+
+        harness.setShaping(delay, jitter, loss);
+
+        QSignalSpy peerFinished(&harness, SIGNAL(measurementFinished(QString, Result)));
+
+        QVariantMap options;
+        options.insert("host", LoopbackHarness::shapedAddress().toString());
+        options.insert("port", harness.packetTrainsPort());
+        options.insert("iterations", 10);
+        options.insert("delay", 10000000);
+
+        Run result;
+        QVERIFY(run("packettrains_ma", options, 30000, &result));
+        QTRY_VERIFY_WITH_TIMEOUT(!peerFinished.isEmpty(), 10000);
+
+        QVariantMap agent = result.result.probeResult();
+        QVariantList target = agent.value("target_dispersion").toList();
+        QVariantList achieved = agent.value("achieved_dispersion").toList();
+        QCOMPARE(achieved.size(), target.size());
+
+        double error = 0;
+
+        for (int i = 0; i < target.size(); ++i)
+        {
+            error += qAbs(achieved.at(i).toLongLong() - target.at(i).toLongLong());
+        }
+
+        error /= target.size();
+
+        QVariantMap peer = peerFinished.first().at(1).value<Result>().probeResult();
+
+        qDebug("loss %s, receive dispersion %s ns, %llu datagrams dropped, %.1f ms client cpu",
+               qPrintable(peer.value("loss").toStringList().join(" ")),
+               qPrintable(peer.value("receive_dispersion").toStringList().join(" ")),
+               (unsigned long long)harness.datagramsDropped(), result.clientCpu * 1000);
+
+        QTest::setBenchmarkResult(error / 1e6, QTest::WalltimeMilliseconds);
+    }
+
+    void pingMesh_data()
+    {
+        QTest::addColumn<int>("delay");
+
+        QTest::newRow("unshaped") << 0;
+        QTest::newRow("5 ms") << 5;
+        QTest::newRow("20 ms") << 20;
+    }
+
+    // The shaper and the echo add a known delay, how much more is measured
+    void pingMesh()
+    {
+        QFETCH(int, delay);
+
+        harness.setShaping(delay);
+
+        QVariantMap options;
+        options.insert("targets", QStringList() << LoopbackHarness::shapedAddress().toString());
+        options.insert("destination_port", harness.echoPort());
+        options.insert("count", 20);
+        options.insert("interval", 50);
+        options.insert("timeout", 500);
+
+        Run result;
+
+        if (!run("pingmesh", options, 10000, &result))
+        {
+            QSKIP("pingmesh is not available on this platform");
+        }
+
+        QVariantMap target = result.result.probeResult().value("targets").toList().value(0).toMap();
+        QCOMPARE(target.value("round_trip_received").toInt(), 20);
+
+        double rtt = target.value("round_trip_avg").toDouble();
+        qDebug("%.3f ms average, %.3f ms p99", rtt, target.value("round_trip_p99").toDouble());
+
+        QTest::setBenchmarkResult(rtt - 2 * delay, QTest::WalltimeMilliseconds);
+    }
+
+    // Nothing answers, so the measurement has to end on its own timer
+    void pingMeshTimeout()
+    {
+        harness.setShaping(0);
+
+        const int count = 5;
+        const int interval = 100;
+        const int timeout = 300;
+
+        QVariantMap options;
+        options.insert("targets", QStringList() << LoopbackHarness::peerAddress().toString());
+        options.insert("destination_port", harness.silentPort());
+        options.insert("count", count);
+        options.insert("interval", interval);
+        options.insert("timeout", timeout);
+
+        Run result;
+
+        if (!run("pingmesh", options, 10000, &result))
+        {
+            QSKIP("pingmesh is not available on this platform");
+        }
+
+        QCOMPARE(result.result.probeResult().value("probes_received").toInt(), 0);
+
+        double expected = (count - 1) * interval + timeout;
+        QTest::setBenchmarkResult(result.duration / 1e6 - expected, QTest::WalltimeMilliseconds);
+    }
+
+    void cleanupTestCase()
+    {
+        harness.stop();
+    }
+};
+
+QTEST_MAIN(BenchLoopback)
+
+#include "bench_loopback.moc"
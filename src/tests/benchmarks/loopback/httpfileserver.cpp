@@ -0,0 +1,162 @@
+#include "httpfileserver.h"
+
+#include <QTcpSocket>
+
+namespace
+{
+    const int chunkSize = 64 * 1024;
+
+    // Keep this much queued in the socket, the rest is produced on demand
+    const qint64 maxBuffered = 1024 * 1024;
+
+    // Give up on clients which never finish their request header
+    const int maxRequestSize = 8 * 1024;
+}
+
+HttpFileServer::HttpFileServer(QObject *parent)
+: QObject(parent)
+, m_chunk(chunkSize, 0)
+, m_fileSize(Q_INT64_C(10) * 1024 * 1024 * 1024)
+, m_bytesSent(0)
+{
+    connect(&m_server, SIGNAL(newConnection()), this, SLOT(newConnection()));
+}
+
+bool HttpFileServer::listen(const QHostAddress &address, quint16 port)
+{
+    return m_server.listen(address, port);
+}
+
+quint16 HttpFileServer::port() const
+{
+    return m_server.serverPort();
+}
+
+QString HttpFileServer::errorString() const
+{
+    return m_server.errorString();
+}
+
+void HttpFileServer::setFileSize(qint64 fileSize)
+{
+    m_fileSize = fileSize;
+}
+
+qint64 HttpFileServer::fileSize() const
+{
+    return m_fileSize;
+}
+
+quint64 HttpFileServer::bytesSent() const
+{
+    return m_bytesSent;
+}
+
+void HttpFileServer::resetCounters()
+{
+    m_bytesSent = 0;
+}
+
+void HttpFileServer::newConnection()
+{
+    while (m_server.hasPendingConnections())
+    {
+        QTcpSocket *socket = m_server.nextPendingConnection();
+
+        connect(socket, SIGNAL(readyRead()), this, SLOT(readRequest()));
+        connect(socket, SIGNAL(bytesWritten(qint64)), this, SLOT(socketWritten()));
+        connect(socket, SIGNAL(disconnected()), this, SLOT(clientDisconnected()));
+    }
+}
+
+void HttpFileServer::readRequest()
+{
+    QTcpSocket *socket = qobject_cast<QTcpSocket *>(sender());
+
+    if (m_remaining.contains(socket))
+    {
+        socket->readAll();
+        return;
+    }
+
+    QByteArray request = socket->peek(maxRequestSize);
+    int end = request.indexOf("\r\n\r\n");
+
+    if (end < 0)
+    {
+        if (request.size() >= maxRequestSize)
+        {
+            socket->abort();
+        }
+
+        return;
+    }
+
+    socket->read(end + 4);
+
+    // "GET /<size>?<query> HTTP/1.1"
+    QList<QByteArray> requestLine = request.left(request.indexOf("\r\n")).split(' ');
+
+    if (requestLine.size() != 3 || requestLine.at(0) != "GET")
+    {
+        socket->write("HTTP/1.1 405 Method Not Allowed\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+        socket->disconnectFromHost();
+        return;
+    }
+
+    QByteArray path = requestLine.at(1);
+    path = path.left(path.indexOf('?')).mid(1);
+
+    bool ok;
+    qint64 size = path.toLongLong(&ok);
+
+    if (!ok || size < 0)
+    {
+        size = m_fileSize;
+    }
+
+    socket->write(QString("HTTP/1.1 200 OK\r\n"
+                          "Content-Type: application/octet-stream\r\n"
+                          "Content-Length: %1\r\n"
+                          "Connection: close\r\n\r\n").arg(size).toLatin1());
+
+    m_remaining.insert(socket, size);
+    sendBody(socket);
+}
+
+void HttpFileServer::socketWritten()
+{
+    sendBody(qobject_cast<QTcpSocket *>(sender()));
+}
+
+void HttpFileServer::sendBody(QTcpSocket *socket)
+{
+    if (!m_remaining.contains(socket))
+    {
+        return;
+    }
+
+    qint64 &remaining = m_remaining[socket];
+
+    while (remaining > 0 && socket->bytesToWrite() < maxBuffered)
+    {
+        qint64 size = qMin<qint64>(remaining, m_chunk.size());
+        socket->write(m_chunk.constData(), size);
+        remaining -= size;
+        m_bytesSent += size;
+    }
+
+    if (remaining == 0)
+    {
+        m_remaining.remove(socket);
+        socket->disconnectFromHost();
+    }
+}
+
+void HttpFileServer::clientDisconnected()
+{
+    QTcpSocket *socket = qobject_cast<QTcpSocket *>(sender());
+
+    m_remaining.remove(socket);
+    socket->deleteLater();
+}
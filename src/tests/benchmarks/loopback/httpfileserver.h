@@ -0,0 +1,45 @@
+#ifndef HTTPFILESERVER_H
+#define HTTPFILESERVER_H
+
+#include <QTcpServer>
+#include <QHash>
+
+class QTcpSocket;
+
+// Just enough http for HTTPDownload: GET /<size> answers with size bytes of
+// zeros, any other path with fileSize() bytes. Every connection serves one
+// request and is closed afterwards.
+class HttpFileServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit HttpFileServer(QObject *parent = 0);
+
+    bool listen(const QHostAddress &address, quint16 port = 0);
+    quint16 port() const;
+    QString errorString() const;
+
+    void setFileSize(qint64 fileSize);
+    qint64 fileSize() const;
+
+    quint64 bytesSent() const;
+    void resetCounters();
+
+private slots:
+    void newConnection();
+    void readRequest();
+    void socketWritten();
+    void clientDisconnected();
+
+private:
+    void sendBody(QTcpSocket *socket);
+
+    QTcpServer m_server;
+    QHash<QTcpSocket *, qint64> m_remaining; // body bytes not yet handed to the socket
+    QByteArray m_chunk;
+    qint64 m_fileSize;
+    quint64 m_bytesSent;
+};
+
+#endif // HTTPFILESERVER_H
@@ -0,0 +1,22 @@
+CONFIG += testcase benchmark
+CONFIG -= app_bundle
+QT += testlib network
+
+TARGET = bench_loopback
+
+HEADERS = \
+    httpfileserver.h \
+    loopbackharness.h \
+    netemshaper.h \
+    peerstandin.h \
+    udptargets.h
+
+SOURCES = \
+    bench_loopback.cpp \
+    httpfileserver.cpp \
+    loopbackharness.cpp \
+    netemshaper.cpp \
+    peerstandin.cpp \
+    udptargets.cpp
+
+include($$SOURCE_DIRECTORY/src/libclient/libclient.pri)
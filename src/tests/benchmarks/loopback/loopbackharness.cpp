@@ -0,0 +1,396 @@
+#include "loopbackharness.h"
+#include "netemshaper.h"
+#include "peerstandin.h"
+#include "httpfileserver.h"
+#include "udptargets.h"
+
+#include <client.h>
+#include <settings.h>
+#include <trafficbudgetmanager.h>
+#include <network/networkmanager.h>
+#include <network/responses/getconfigresponse.h>
+
+#include <QThread>
+#include <QTcpServer>
+
+#include <time.h>
+
+namespace
+{
+    double clockSeconds(clockid_t clock)
+    {
+        struct timespec ts;
+
+        if (clock_gettime(clock, &ts) != 0)
+        {
+            return 0;
+        }
+
+        return ts.tv_sec + ts.tv_nsec / 1e9;
+    }
+
+    // The measurement points bind their port once the offer arrives, the
+    // shaper needs to know it before
+    quint16 freeTcpPort(const QHostAddress &address)
+    {
+        QTcpServer server;
+        return server.listen(address, 0) ? server.serverPort() : 0;
+    }
+
+    quint16 freeUdpPort(const QHostAddress &address)
+    {
+        QUdpSocket socket;
+        return socket.bind(address, 0) ? socket.localPort() : 0;
+    }
+}
+
+// Lives on the peer thread, created by setUp() so all sockets belong to it.
+// The harness only calls in with blocking connections and reads the members
+// afterwards.
+class Peers : public QObject
+{
+    Q_OBJECT
+
+public:
+    Peers()
+    : shaper(NULL)
+    , standIn(NULL)
+    , http(NULL)
+    , echo(NULL)
+    , silent(NULL)
+    , offerPort(0)
+    , btcPort(0)
+    , packetTrainsPort(0)
+    , httpPort(0)
+    , echoPort(0)
+    , silentPort(0)
+    , delay(0)
+    , jitter(0)
+    , loss(0)
+    , rate(0)
+    , bytesForwarded(0)
+    , datagramsDropped(0)
+    , cpuTime(0)
+    {
+    }
+
+    NetemShaper *shaper;
+    PeerStandIn *standIn;
+    HttpFileServer *http;
+    UdpEcho *echo;
+    SilentUdpTarget *silent;
+
+    quint16 offerPort;
+    quint16 btcPort;
+    quint16 packetTrainsPort;
+    quint16 httpPort;
+    quint16 echoPort;
+    quint16 silentPort;
+    QString errorString;
+
+    // In for applyShaping()
+    int delay;
+    int jitter;
+    qreal loss;
+    quint64 rate;
+
+    // Out of sample()
+    quint64 bytesForwarded;
+    quint64 datagramsDropped;
+    double cpuTime;
+
+signals:
+    void measurementFinished(const QString &measurement, const Result &result);
+
+public slots:
+    bool setUp()
+    {
+        QHostAddress address = LoopbackHarness::peerAddress();
+
+        shaper = new NetemShaper(LoopbackHarness::shapedAddress(), this);
+        standIn = new PeerStandIn(address, this);
+        http = new HttpFileServer(this);
+        echo = new UdpEcho(this);
+        silent = new SilentUdpTarget(this);
+
+        connect(standIn, SIGNAL(measurementFinished(QString, Result)), this,
+                SIGNAL(measurementFinished(QString, Result)));
+
+        if (!standIn->listen())
+        {
+            errorString = standIn->errorString();
+            return false;
+        }
+
+        if (!http->listen(address))
+        {
+            errorString = QString("Http server: %1").arg(http->errorString());
+            return false;
+        }
+
+        if (!echo->listen(address) || !silent->listen(address))
+        {
+            errorString = QString("Udp targets: %1 %2").arg(echo->errorString()).arg(silent->errorString());
+            return false;
+        }
+
+        quint16 btcPeerPort = freeTcpPort(address);
+        quint16 packetTrainsPeerPort = freeUdpPort(address);
+
+        offerPort = shaper->forwardUdp(0, address, standIn->offerPort());
+        btcPort = shaper->forwardTcp(0, address, btcPeerPort);
+        packetTrainsPort = shaper->forwardUdp(0, address, packetTrainsPeerPort);
+        httpPort = shaper->forwardTcp(0, address, http->port());
+        echoPort = shaper->forwardUdp(0, address, echo->port());
+        silentPort = silent->port();
+
+        if (!offerPort || !btcPort || !packetTrainsPort || !httpPort || !echoPort)
+        {
+            errorString = shaper->errorString();
+            return false;
+        }
+
+        standIn->mapPort(btcPort, btcPeerPort);
+        standIn->mapPort(packetTrainsPort, packetTrainsPeerPort);
+
+        return true;
+    }
+
+    void tearDown()
+    {
+        delete standIn;
+        delete shaper;
+        delete http;
+        delete echo;
+        delete silent;
+
+        standIn = NULL;
+        shaper = NULL;
+        http = NULL;
+        echo = NULL;
+        silent = NULL;
+    }
+
+    void applyShaping()
+    {
+        shaper->setDelay(delay);
+        shaper->setJitter(jitter);
+        shaper->setLoss(loss);
+        shaper->setRate(rate);
+    }
+
+    void resetCounters()
+    {
+        shaper->resetCounters();
+        http->resetCounters();
+    }
+
+    void sample()
+    {
+        bytesForwarded = shaper->bytesForwarded();
+        datagramsDropped = shaper->datagramsDropped();
+        cpuTime = clockSeconds(CLOCK_THREAD_CPUTIME_ID);
+    }
+};
+
+class LoopbackHarness::Private
+{
+public:
+    Private()
+    : peers(NULL)
+    {
+    }
+
+    QThread thread;
+    Peers *peers;
+
+    Settings settings;
+    NetworkManager networkManager;
+
+    QString errorString;
+
+    void call(const char *method)
+    {
+        QMetaObject::invokeMethod(peers, method, Qt::BlockingQueuedConnection);
+    }
+};
+
+LoopbackHarness::LoopbackHarness(QObject *parent)
+: QObject(parent)
+, d(new Private)
+{
+    qRegisterMetaType<Result>();
+}
+
+LoopbackHarness::~LoopbackHarness()
+{
+    stop();
+    delete d;
+}
+
+QHostAddress LoopbackHarness::peerAddress()
+{
+    return QHostAddress("127.0.0.2");
+}
+
+QHostAddress LoopbackHarness::shapedAddress()
+{
+    return QHostAddress("127.0.0.3");
+}
+
+bool LoopbackHarness::start()
+{
+    if (d->peers)
+    {
+        return true;
+    }
+
+    d->peers = new Peers;
+    d->peers->moveToThread(&d->thread);
+    d->thread.start();
+
+    connect(d->peers, SIGNAL(measurementFinished(QString, Result)), this,
+            SIGNAL(measurementFinished(QString, Result)));
+
+    bool ok = false;
+    QMetaObject::invokeMethod(d->peers, "setUp", Qt::BlockingQueuedConnection, Q_RETURN_ARG(bool, ok));
+
+    if (!ok)
+    {
+        d->errorString = d->peers->errorString;
+        stop();
+        return false;
+    }
+
+    // Offers go to the keepalive address, that is where the stand-in listens
+    QVariantMap keepaliveChannel;
+    keepaliveChannel.insert("target", QString("%1:%2").arg(shapedAddress().toString()).arg(d->peers->offerPort));
+
+    QVariantMap config;
+    config.insert("keepalive_channel", keepaliveChannel);
+
+    d->settings.config()->fillFromVariant(config);
+    d->networkManager.init(NULL, &d->settings);
+
+    // The agents account their traffic before they start
+    Client::instance()->trafficBudgetManager()->init();
+
+    return true;
+}
+
+void LoopbackHarness::stop()
+{
+    if (!d->peers)
+    {
+        return;
+    }
+
+    d->call("tearDown");
+    d->thread.quit();
+    d->thread.wait();
+
+    delete d->peers;
+    d->peers = NULL;
+}
+
+QString LoopbackHarness::errorString() const
+{
+    return d->errorString;
+}
+
+quint16 LoopbackHarness::offerPort() const
+{
+    return d->peers ? d->peers->offerPort : 0;
+}
+
+quint16 LoopbackHarness::btcPort() const
+{
+    return d->peers ? d->peers->btcPort : 0;
+}
+
+quint16 LoopbackHarness::packetTrainsPort() const
+{
+    return d->peers ? d->peers->packetTrainsPort : 0;
+}
+
+quint16 LoopbackHarness::httpPort() const
+{
+    return d->peers ? d->peers->httpPort : 0;
+}
+
+quint16 LoopbackHarness::echoPort() const
+{
+    return d->peers ? d->peers->echoPort : 0;
+}
+
+quint16 LoopbackHarness::silentPort() const
+{
+    return d->peers ? d->peers->silentPort : 0;
+}
+
+void LoopbackHarness::setShaping(int delay, int jitter, qreal loss, quint64 rate)
+{
+    if (!d->peers)
+    {
+        return;
+    }
+
+    d->peers->delay = delay;
+    d->peers->jitter = jitter;
+    d->peers->loss = loss;
+    d->peers->rate = rate;
+    d->call("applyShaping");
+}
+
+void LoopbackHarness::resetCounters()
+{
+    if (d->peers)
+    {
+        d->call("resetCounters");
+    }
+}
+
+quint64 LoopbackHarness::bytesForwarded() const
+{
+    if (!d->peers)
+    {
+        return 0;
+    }
+
+    d->call("sample");
+    return d->peers->bytesForwarded;
+}
+
+quint64 LoopbackHarness::datagramsDropped() const
+{
+    if (!d->peers)
+    {
+        return 0;
+    }
+
+    d->call("sample");
+    return d->peers->datagramsDropped;
+}
+
+double LoopbackHarness::peerCpuTime() const
+{
+    if (!d->peers)
+    {
+        return 0;
+    }
+
+    d->call("sample");
+    return d->peers->cpuTime;
+}
+
+double LoopbackHarness::processCpuTime()
+{
+    return clockSeconds(CLOCK_PROCESS_CPUTIME_ID);
+}
+
+NetworkManager *LoopbackHarness::networkManager() const
+{
+    return &d->networkManager;
+}
+
+#include "loopbackharness.moc"
@@ -0,0 +1,70 @@
+#ifndef LOOPBACKHARNESS_H
+#define LOOPBACKHARNESS_H
+
+#include <task/result.h>
+
+#include <QHostAddress>
+
+class NetworkManager;
+
+// Local stand-ins for everything the network measurements talk to: the
+// btc_mp and packettrains_mp peers, an http file server, an udp echo and a
+// silent udp target. They run on their own thread behind a NetemShaper, so
+// the cpu time of the calling thread is what the measurement agent costs.
+//
+// Linux only, the peers and the shaper use their own 127.0.0.0/8 addresses.
+class LoopbackHarness : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit LoopbackHarness(QObject *parent = 0);
+    ~LoopbackHarness();
+
+    // Where the stand-ins listen
+    static QHostAddress peerAddress();
+
+    // Where the shaper in front of them listens, use as measurement host
+    static QHostAddress shapedAddress();
+
+    bool start();
+    void stop();
+    QString errorString() const;
+
+    // Ports on shapedAddress()
+    quint16 offerPort() const;
+    quint16 btcPort() const;
+    quint16 packetTrainsPort() const;
+    quint16 httpPort() const;
+    quint16 echoPort() const;
+
+    // Port on peerAddress(), the shaper would answer in place of the target
+    quint16 silentPort() const;
+
+    // Like netem: one-way delay and jitter in ms, loss probability for
+    // datagrams and bytes per second (0 = unlimited)
+    void setShaping(int delay, int jitter = 0, qreal loss = 0, quint64 rate = 0);
+
+    // Traffic through the shaper, both directions
+    void resetCounters();
+    quint64 bytesForwarded() const;
+    quint64 datagramsDropped() const;
+
+    // Cpu seconds spent by the stand-ins and the shaper
+    double peerCpuTime() const;
+
+    // Cpu seconds spent by the whole process
+    static double processCpuTime();
+
+    // Set up to offer tests to the stand-in, pass it to prepareAsync()
+    NetworkManager *networkManager() const;
+
+signals:
+    void measurementFinished(const QString &measurement, const Result &result);
+
+protected:
+    class Private;
+    Private *d;
+};
+
+#endif // LOOPBACKHARNESS_H
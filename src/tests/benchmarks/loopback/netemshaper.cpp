@@ -0,0 +1,583 @@
+#include "netemshaper.h"
+
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QUdpSocket>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QHash>
+
+namespace
+{
+    // Stop reading from a tcp socket while this much is on its way, the
+    // kernel buffers then push back on the sender like a full queue would
+    const qint64 maxInFlight = 4 * 1024 * 1024;
+}
+
+class NetemShaper::Private
+{
+public:
+    Private()
+    : delay(0)
+    , jitter(0)
+    , loss(0)
+    , rate(0)
+    , bytesForwarded(0)
+    , datagramsDropped(0)
+    {
+        clock.start();
+    }
+
+    // Properties
+    QHostAddress address;
+    int delay;
+    int jitter;
+    qreal loss;
+    quint64 rate;
+
+    quint64 bytesForwarded;
+    quint64 datagramsDropped;
+
+    QElapsedTimer clock;
+    QString errorString;
+
+    // Functions
+    qint64 now() const
+    {
+        return clock.nsecsElapsed();
+    }
+
+    qint64 variation() const
+    {
+        return jitter ? (qrand() % (2 * jitter + 1) - jitter) * Q_INT64_C(1000000) : 0;
+    }
+
+    bool drop()
+    {
+        if (loss > 0 && qrand() < loss * RAND_MAX)
+        {
+            ++datagramsDropped;
+            return true;
+        }
+
+        return false;
+    }
+};
+
+// One direction of a flow, releases chunks once they are due
+class Link : public QObject
+{
+    Q_OBJECT
+
+public:
+    Link(NetemShaper::Private *shaper, bool ordered, QObject *parent = 0)
+    : QObject(parent)
+    , shaper(shaper)
+    , ordered(ordered)
+    , queued(0)
+    , busyUntil(0)
+    {
+        timer.setSingleShot(true);
+        timer.setTimerType(Qt::PreciseTimer);
+        connect(&timer, SIGNAL(timeout()), this, SLOT(release()));
+    }
+
+    void push(const QByteArray &data)
+    {
+        qint64 now = shaper->now();
+        qint64 sent = now;
+
+        // The last byte leaves the "wire" after the ones before it
+        if (shaper->rate)
+        {
+            sent = qMax(now, busyUntil) + data.size() * Q_INT64_C(1000000000) / shaper->rate;
+            busyUntil = sent;
+        }
+
+        qint64 due = sent + shaper->delay * Q_INT64_C(1000000) + shaper->variation();
+
+        // A stream keeps its order no matter the jitter
+        if (ordered && !queue.isEmpty())
+        {
+            due = qMax(due, queue.last().due);
+        }
+
+        if (queue.isEmpty() && due <= now)
+        {
+            shaper->bytesForwarded += data.size();
+            emit released(data);
+            return;
+        }
+
+        // Most chunks are due last, search from the back
+        int i = queue.size();
+
+        while (i > 0 && queue.at(i - 1).due > due)
+        {
+            --i;
+        }
+
+        Chunk chunk = { due, data };
+        queue.insert(i, chunk);
+        queued += data.size();
+
+        schedule();
+    }
+
+    qint64 bytesQueued() const
+    {
+        return queued;
+    }
+
+signals:
+    void released(const QByteArray &data);
+
+private slots:
+    void release()
+    {
+        qint64 now = shaper->now();
+
+        while (!queue.isEmpty() && queue.first().due <= now)
+        {
+            Chunk chunk = queue.takeFirst();
+            queued -= chunk.data.size();
+            shaper->bytesForwarded += chunk.data.size();
+            emit released(chunk.data);
+        }
+
+        schedule();
+    }
+
+private:
+    struct Chunk
+    {
+        qint64 due;
+        QByteArray data;
+    };
+
+    void schedule()
+    {
+        if (queue.isEmpty())
+        {
+            timer.stop();
+            return;
+        }
+
+        qint64 wait = queue.first().due - shaper->now();
+        timer.start(wait > 0 ? int((wait + 999999) / 1000000) : 0);
+    }
+
+    NetemShaper::Private *shaper;
+    bool ordered;
+    QList<Chunk> queue;
+    qint64 queued;
+    qint64 busyUntil;
+    QTimer timer;
+};
+
+// The datagrams of one client, the upstream socket tells the answers for
+// different clients apart
+class UdpFlow : public QObject
+{
+    Q_OBJECT
+
+public:
+    UdpFlow(NetemShaper::Private *shaper, QUdpSocket *front, const QHostAddress &client, quint16 clientPort,
+            const QHostAddress &target, quint16 targetPort, QObject *parent = 0)
+    : QObject(parent)
+    , shaper(shaper)
+    , front(front)
+    , client(client)
+    , clientPort(clientPort)
+    , target(target)
+    , targetPort(targetPort)
+    , up(shaper, false)
+    , down(shaper, false)
+    {
+        upstream.bind(shaper->address, 0);
+
+        connect(&upstream, SIGNAL(readyRead()), this, SLOT(readUpstream()));
+        connect(&up, SIGNAL(released(QByteArray)), this, SLOT(sendUpstream(QByteArray)));
+        connect(&down, SIGNAL(released(QByteArray)), this, SLOT(sendDownstream(QByteArray)));
+    }
+
+    void send(const QByteArray &datagram)
+    {
+        if (!shaper->drop())
+        {
+            up.push(datagram);
+        }
+    }
+
+private slots:
+    void readUpstream()
+    {
+        while (upstream.hasPendingDatagrams())
+        {
+            QByteArray datagram(qMax<qint64>(0, upstream.pendingDatagramSize()), 0);
+            upstream.readDatagram(datagram.data(), datagram.size());
+
+            if (!shaper->drop())
+            {
+                down.push(datagram);
+            }
+        }
+    }
+
+    void sendUpstream(const QByteArray &datagram)
+    {
+        upstream.writeDatagram(datagram, target, targetPort);
+    }
+
+    void sendDownstream(const QByteArray &datagram)
+    {
+        front->writeDatagram(datagram, client, clientPort);
+    }
+
+private:
+    NetemShaper::Private *shaper;
+    QUdpSocket *front;
+    QHostAddress client;
+    quint16 clientPort;
+    QHostAddress target;
+    quint16 targetPort;
+
+    QUdpSocket upstream;
+    Link up;
+    Link down;
+};
+
+class UdpForward : public QObject
+{
+    Q_OBJECT
+
+public:
+    UdpForward(NetemShaper::Private *shaper, const QHostAddress &target, quint16 targetPort, QObject *parent = 0)
+    : QObject(parent)
+    , shaper(shaper)
+    , target(target)
+    , targetPort(targetPort)
+    {
+        connect(&front, SIGNAL(readyRead()), this, SLOT(readFront()));
+    }
+
+    bool listen(quint16 port)
+    {
+        // The client may have bound the same port on the any address
+        return front.bind(shaper->address, port, QUdpSocket::ShareAddress | QUdpSocket::ReuseAddressHint);
+    }
+
+    quint16 port() const
+    {
+        return front.localPort();
+    }
+
+    QString errorString() const
+    {
+        return front.errorString();
+    }
+
+private slots:
+    void readFront()
+    {
+        while (front.hasPendingDatagrams())
+        {
+            QByteArray datagram(qMax<qint64>(0, front.pendingDatagramSize()), 0);
+            QHostAddress host;
+            quint16 port;
+            front.readDatagram(datagram.data(), datagram.size(), &host, &port);
+
+            QString hostAndPort = QString("%1:%2").arg(host.toString()).arg(port);
+            UdpFlow *flow = flows.value(hostAndPort);
+
+            if (!flow)
+            {
+                flow = new UdpFlow(shaper, &front, host, port, target, targetPort, this);
+                flows.insert(hostAndPort, flow);
+            }
+
+            flow->send(datagram);
+        }
+    }
+
+private:
+    NetemShaper::Private *shaper;
+    QHostAddress target;
+    quint16 targetPort;
+
+    QUdpSocket front;
+    QHash<QString, UdpFlow *> flows;
+};
+
+// One tcp connection, each direction goes through its own link
+class TcpPipe : public QObject
+{
+    Q_OBJECT
+
+public:
+    TcpPipe(NetemShaper::Private *shaper, QTcpSocket *client, const QHostAddress &target, quint16 targetPort,
+            QObject *parent = 0)
+    : QObject(parent)
+    , client(client)
+    , up(shaper, true)
+    , down(shaper, true)
+    , upstreamConnected(false)
+    {
+        client->setParent(this);
+        client->setReadBufferSize(maxInFlight);
+        upstream.setReadBufferSize(maxInFlight);
+
+        connect(client, SIGNAL(readyRead()), this, SLOT(pump()));
+        connect(client, SIGNAL(bytesWritten(qint64)), this, SLOT(pump()));
+        connect(client, SIGNAL(disconnected()), this, SLOT(pump()));
+        connect(&upstream, SIGNAL(readyRead()), this, SLOT(pump()));
+        connect(&upstream, SIGNAL(bytesWritten(qint64)), this, SLOT(pump()));
+        connect(&upstream, SIGNAL(disconnected()), this, SLOT(pump()));
+        connect(&upstream, SIGNAL(connected()), this, SLOT(connected()));
+        connect(&upstream, SIGNAL(error(QAbstractSocket::SocketError)), this,
+                SLOT(upstreamError(QAbstractSocket::SocketError)));
+
+        connect(&up, SIGNAL(released(QByteArray)), this, SLOT(writeUpstream(QByteArray)));
+        connect(&down, SIGNAL(released(QByteArray)), this, SLOT(writeClient(QByteArray)));
+
+        upstream.connectToHost(target, targetPort);
+    }
+
+private slots:
+    void connected()
+    {
+        upstreamConnected = true;
+        pump();
+    }
+
+    void upstreamError(QAbstractSocket::SocketError socketError)
+    {
+        Q_UNUSED(socketError);
+
+        // Nobody listens behind us, let the client see the refused connection
+        if (!upstreamConnected)
+        {
+            client->abort();
+            deleteLater();
+            return;
+        }
+
+        pump();
+    }
+
+    void writeUpstream(const QByteArray &data)
+    {
+        upstream.write(data);
+        pump();
+    }
+
+    void writeClient(const QByteArray &data)
+    {
+        client->write(data);
+        pump();
+    }
+
+    void pump()
+    {
+        if (!upstreamConnected)
+        {
+            return;
+        }
+
+        forward(client, &up, &upstream);
+        forward(&upstream, &down, client);
+
+        close(client, &up, &upstream);
+        close(&upstream, &down, client);
+
+        if (client->state() == QAbstractSocket::UnconnectedState &&
+            upstream.state() == QAbstractSocket::UnconnectedState)
+        {
+            deleteLater();
+        }
+    }
+
+private:
+    void forward(QTcpSocket *from, Link *link, QTcpSocket *to)
+    {
+        qint64 room = maxInFlight - link->bytesQueued() - to->bytesToWrite();
+
+        if (room > 0 && from->bytesAvailable() > 0)
+        {
+            link->push(from->read(room));
+        }
+    }
+
+    // Pass the close on once everything before it was delivered
+    void close(QTcpSocket *from, Link *link, QTcpSocket *to)
+    {
+        if (from->state() == QAbstractSocket::UnconnectedState && from->bytesAvailable() == 0 &&
+            link->bytesQueued() == 0 && to->state() == QAbstractSocket::ConnectedState)
+        {
+            to->disconnectFromHost();
+        }
+    }
+
+    QTcpSocket *client;
+    QTcpSocket upstream;
+    Link up;
+    Link down;
+    bool upstreamConnected;
+};
+
+class TcpForward : public QObject
+{
+    Q_OBJECT
+
+public:
+    TcpForward(NetemShaper::Private *shaper, const QHostAddress &target, quint16 targetPort, QObject *parent = 0)
+    : QObject(parent)
+    , shaper(shaper)
+    , target(target)
+    , targetPort(targetPort)
+    {
+        connect(&server, SIGNAL(newConnection()), this, SLOT(accept()));
+    }
+
+    bool listen(quint16 port)
+    {
+        return server.listen(shaper->address, port);
+    }
+
+    quint16 port() const
+    {
+        return server.serverPort();
+    }
+
+    QString errorString() const
+    {
+        return server.errorString();
+    }
+
+private slots:
+    void accept()
+    {
+        while (server.hasPendingConnections())
+        {
+            new TcpPipe(shaper, server.nextPendingConnection(), target, targetPort, this);
+        }
+    }
+
+private:
+    NetemShaper::Private *shaper;
+    QHostAddress target;
+    quint16 targetPort;
+
+    QTcpServer server;
+};
+
+NetemShaper::NetemShaper(const QHostAddress &address, QObject *parent)
+: QObject(parent)
+, d(new Private)
+{
+    d->address = address;
+}
+
+NetemShaper::~NetemShaper()
+{
+    // the forwards point to d
+    QObjectList forwards = children();
+    qDeleteAll(forwards);
+    delete d;
+}
+
+QHostAddress NetemShaper::address() const
+{
+    return d->address;
+}
+
+void NetemShaper::setDelay(int delay)
+{
+    d->delay = delay;
+}
+
+int NetemShaper::delay() const
+{
+    return d->delay;
+}
+
+void NetemShaper::setJitter(int jitter)
+{
+    d->jitter = jitter;
+}
+
+int NetemShaper::jitter() const
+{
+    return d->jitter;
+}
+
+void NetemShaper::setLoss(qreal loss)
+{
+    d->loss = loss;
+}
+
+qreal NetemShaper::loss() const
+{
+    return d->loss;
+}
+
+void NetemShaper::setRate(quint64 rate)
+{
+    d->rate = rate;
+}
+
+quint64 NetemShaper::rate() const
+{
+    return d->rate;
+}
+
+quint16 NetemShaper::forwardUdp(quint16 port, const QHostAddress &target, quint16 targetPort)
+{
+    UdpForward *forward = new UdpForward(d, target, targetPort, this);
+
+    if (!forward->listen(port))
+    {
+        d->errorString = QString("Unable to bind udp port %1: %2").arg(port).arg(forward->errorString());
+        delete forward;
+        return 0;
+    }
+
+    return forward->port();
+}
+
+quint16 NetemShaper::forwardTcp(quint16 port, const QHostAddress &target, quint16 targetPort)
+{
+    TcpForward *forward = new TcpForward(d, target, targetPort, this);
+
+    if (!forward->listen(port))
+    {
+        d->errorString = QString("Unable to listen on tcp port %1: %2").arg(port).arg(forward->errorString());
+        delete forward;
+        return 0;
+    }
+
+    return forward->port();
+}
+
+quint64 NetemShaper::bytesForwarded() const
+{
+    return d->bytesForwarded;
+}
+
+quint64 NetemShaper::datagramsDropped() const
+{
+    return d->datagramsDropped;
+}
+
+void NetemShaper::resetCounters()
+{
+    d->bytesForwarded = 0;
+    d->datagramsDropped = 0;
+}
+
+QString NetemShaper::errorString() const
+{
+    return d->errorString;
+}
+
+#include "netemshaper.moc"
@@ -0,0 +1,53 @@
+#ifndef NETEMSHAPER_H
+#define NETEMSHAPER_H
+
+#include <QObject>
+#include <QHostAddress>
+
+// User-space replacement for "tc qdisc add dev lo root netem delay ... loss ...",
+// which needs root. Forwards tcp connections and udp flows from a port on
+// address() to a target and holds every chunk back until it is due. Loss only
+// applies to udp, a tcp stream can not lose bytes above the socket layer.
+class NetemShaper : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit NetemShaper(const QHostAddress &address, QObject *parent = 0);
+    ~NetemShaper();
+
+    QHostAddress address() const;
+
+    // One-way delay in ms, every direction of every flow gets it
+    void setDelay(int delay);
+    int delay() const;
+
+    // The delay varies uniformly by +/- jitter ms, udp may get reordered
+    void setJitter(int jitter);
+    int jitter() const;
+
+    // Probability for every datagram to be dropped
+    void setLoss(qreal loss);
+    qreal loss() const;
+
+    // Bytes per second for each direction of a flow (0 = unlimited)
+    void setRate(quint64 rate);
+    quint64 rate() const;
+
+    // Listens on port (0 = any free port) and returns the port or 0 on error
+    quint16 forwardUdp(quint16 port, const QHostAddress &target, quint16 targetPort);
+    quint16 forwardTcp(quint16 port, const QHostAddress &target, quint16 targetPort);
+
+    quint64 bytesForwarded() const;
+    quint64 datagramsDropped() const;
+    void resetCounters();
+
+    QString errorString() const;
+
+    class Private;
+
+protected:
+    Private *d;
+};
+
+#endif // NETEMSHAPER_H
@@ -0,0 +1,202 @@
+#include "peerstandin.h"
+
+#include <network/peerrequest.h>
+
+#include <QJsonDocument>
+
+PeerStandIn::PeerStandIn(const QHostAddress &address, QObject *parent)
+: QObject(parent)
+, m_address(address)
+, m_offers(0)
+{
+    connect(&m_socket, SIGNAL(readyRead()), this, SLOT(readOffers()));
+}
+
+PeerStandIn::~PeerStandIn()
+{
+    stop();
+}
+
+bool PeerStandIn::listen(quint16 offerPort)
+{
+    if (!m_socket.bind(m_address, offerPort, QUdpSocket::ShareAddress | QUdpSocket::ReuseAddressHint))
+    {
+        m_errorString = QString("Unable to bind offer port %1: %2").arg(offerPort).arg(m_socket.errorString());
+        return false;
+    }
+
+    return true;
+}
+
+quint16 PeerStandIn::offerPort() const
+{
+    return m_socket.localPort();
+}
+
+void PeerStandIn::mapPort(quint16 port, quint16 peerPort)
+{
+    m_ports.insert(port, peerPort);
+}
+
+int PeerStandIn::offers() const
+{
+    return m_offers;
+}
+
+QString PeerStandIn::errorString() const
+{
+    return m_errorString;
+}
+
+void PeerStandIn::stop()
+{
+    foreach (const MeasurementPtr &measurement, m_measurements)
+    {
+        measurement->disconnect(this);
+        measurement->stop();
+    }
+
+    m_measurements.clear();
+    m_retired.clear();
+    m_names.clear();
+}
+
+void PeerStandIn::readOffers()
+{
+    while (m_socket.hasPendingDatagrams())
+    {
+        QByteArray datagram(qMax<qint64>(0, m_socket.pendingDatagramSize()), 0);
+        QHostAddress host;
+        quint16 port;
+
+        m_socket.readDatagram(datagram.data(), datagram.size(), &host, &port);
+        processOffer(datagram, host, port);
+    }
+}
+
+void PeerStandIn::processOffer(const QByteArray &datagram, const QHostAddress &host, quint16 port)
+{
+    PeerRequest request;
+
+    // Same formats as NetworkManager::processDatagram()
+    if (PeerRequest::isBinary(datagram))
+    {
+        if (!PeerRequest::fromBinary(datagram, &request, &m_errorString))
+        {
+            return;
+        }
+    }
+    else
+    {
+        QJsonParseError error;
+        QJsonDocument document = QJsonDocument::fromJson(datagram, &error);
+
+        if (error.error != QJsonParseError::NoError)
+        {
+            // hole punching and keepalives
+            return;
+        }
+
+        request = PeerRequest::fromVariant(document.toVariant());
+    }
+
+    // The offer is repeated until the peer answers
+    if (m_handled.contains(request.measurementUuid))
+    {
+        return;
+    }
+
+    m_handled.insert(request.measurementUuid);
+    ++m_offers;
+
+    // Frees the ports of the measurement points which are done
+    m_retired.clear();
+
+    QVariantMap definitionMap = request.measurementDefinition.toMap();
+    quint16 definitionPort = definitionMap.value("port").toUInt();
+    quint16 peerPort = m_ports.value(definitionPort, definitionPort);
+    definitionMap.insert("port", peerPort);
+
+    MeasurementPtr measurement = m_factory.createMeasurement(request.measurement, request.taskId);
+    MeasurementDefinitionPtr definition = m_factory.createMeasurementDefinition(request.measurement, definitionMap);
+
+    if (!measurement || !definition)
+    {
+        m_errorString = QString("Unknown measurement %1").arg(request.measurement);
+        return;
+    }
+
+    measurement->setMeasurementUuid(request.measurementUuid);
+
+    QUdpSocket *socket = NULL;
+
+    if (request.protocol == NetworkManager::UdpSocket)
+    {
+        // What NetworkManagerMeasurementObserver does, but on the mapped port
+        socket = qobject_cast<QUdpSocket *>(m_networkManager.createConnection(NetworkManager::UdpSocket));
+
+        if (!socket->bind(m_address, peerPort))
+        {
+            m_errorString = QString("Unable to bind port %1: %2").arg(peerPort).arg(socket->errorString());
+            delete socket;
+            return;
+        }
+
+        measurement->setPeerSocket(socket);
+    }
+
+    connect(measurement.data(), SIGNAL(finished()), this, SLOT(finished()));
+    connect(measurement.data(), SIGNAL(error(QString)), this, SLOT(failed(QString)));
+
+    if (!measurement->prepare(&m_networkManager, definition) || !measurement->start())
+    {
+        m_errorString = QString("Unable to run %1: %2").arg(request.measurement).arg(measurement->errorString());
+        return;
+    }
+
+    // ACK the connection once we are ready to receive
+    if (socket)
+    {
+        socket->writeDatagram(QByteArray(), host, port);
+    }
+
+    m_measurements.append(measurement);
+    m_names.insert(measurement.data(), request.measurement);
+}
+
+void PeerStandIn::finished()
+{
+    Measurement *measurement = qobject_cast<Measurement *>(sender());
+    QString name = m_names.value(measurement);
+
+    // Some measurement points finish on a timeout as well, only report once
+    retire(measurement);
+    emit measurementFinished(name, measurement->result());
+}
+
+void PeerStandIn::failed(const QString &message)
+{
+    Measurement *measurement = qobject_cast<Measurement *>(sender());
+    QString name = m_names.value(measurement);
+
+    m_errorString = QString("%1: %2").arg(name).arg(message);
+    retire(measurement);
+    emit measurementFinished(name, Result(message));
+}
+
+void PeerStandIn::retire(Measurement *measurement)
+{
+    measurement->disconnect(this);
+    measurement->stop();
+
+    for (int i = 0; i < m_measurements.size(); ++i)
+    {
+        if (m_measurements.at(i).data() == measurement)
+        {
+            m_retired.append(m_measurements.takeAt(i));
+            break;
+        }
+    }
+
+    m_names.remove(measurement);
+}
@@ -0,0 +1,61 @@
+#ifndef PEERSTANDIN_H
+#define PEERSTANDIN_H
+
+#include <measurement/measurementfactory.h>
+#include <network/networkmanager.h>
+
+#include <QUdpSocket>
+#include <QHash>
+#include <QSet>
+
+// The remote end of NetworkManager::establishConnection(): takes the test
+// offers on the keepalive port and runs the requested measurement point
+// (btc_mp, packettrains_mp) the way a peer would.
+class PeerStandIn : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit PeerStandIn(const QHostAddress &address, QObject *parent = 0);
+    ~PeerStandIn();
+
+    bool listen(quint16 offerPort = 0);
+    quint16 offerPort() const;
+
+    // Run a measurement point on peerPort when the offer asks for port, so
+    // a shaper can sit in between
+    void mapPort(quint16 port, quint16 peerPort);
+
+    int offers() const;
+    QString errorString() const;
+
+    void stop();
+
+signals:
+    void measurementFinished(const QString &measurement, const Result &result);
+
+private slots:
+    void readOffers();
+    void finished();
+    void failed(const QString &message);
+
+private:
+    void processOffer(const QByteArray &datagram, const QHostAddress &host, quint16 port);
+    void retire(Measurement *measurement);
+
+    QHostAddress m_address;
+    QUdpSocket m_socket;
+    NetworkManager m_networkManager;
+    MeasurementFactory m_factory;
+
+    QHash<Measurement *, QString> m_names;
+    QList<MeasurementPtr> m_measurements;
+    QList<MeasurementPtr> m_retired; // deleted with the next offer, not while they emit
+    QHash<quint16, quint16> m_ports;
+    QSet<QUuid> m_handled;
+
+    int m_offers;
+    QString m_errorString;
+};
+
+#endif // PEERSTANDIN_H
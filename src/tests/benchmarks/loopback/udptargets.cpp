@@ -0,0 +1,78 @@
+#include "udptargets.h"
+
+UdpEcho::UdpEcho(QObject *parent)
+: QObject(parent)
+, m_datagrams(0)
+{
+    connect(&m_socket, SIGNAL(readyRead()), this, SLOT(readDatagrams()));
+}
+
+bool UdpEcho::listen(const QHostAddress &address, quint16 port)
+{
+    return m_socket.bind(address, port);
+}
+
+quint16 UdpEcho::port() const
+{
+    return m_socket.localPort();
+}
+
+QString UdpEcho::errorString() const
+{
+    return m_socket.errorString();
+}
+
+quint64 UdpEcho::datagrams() const
+{
+    return m_datagrams;
+}
+
+void UdpEcho::readDatagrams()
+{
+    while (m_socket.hasPendingDatagrams())
+    {
+        QByteArray datagram(qMax<qint64>(0, m_socket.pendingDatagramSize()), 0);
+        QHostAddress host;
+        quint16 port;
+
+        m_socket.readDatagram(datagram.data(), datagram.size(), &host, &port);
+        m_socket.writeDatagram(datagram, host, port);
+        ++m_datagrams;
+    }
+}
+
+SilentUdpTarget::SilentUdpTarget(QObject *parent)
+: QObject(parent)
+, m_datagrams(0)
+{
+    connect(&m_socket, SIGNAL(readyRead()), this, SLOT(readDatagrams()));
+}
+
+bool SilentUdpTarget::listen(const QHostAddress &address, quint16 port)
+{
+    return m_socket.bind(address, port);
+}
+
+quint16 SilentUdpTarget::port() const
+{
+    return m_socket.localPort();
+}
+
+QString SilentUdpTarget::errorString() const
+{
+    return m_socket.errorString();
+}
+
+quint64 SilentUdpTarget::datagrams() const
+{
+    return m_datagrams;
+}
+
+void SilentUdpTarget::readDatagrams()
+{
+    while (m_socket.hasPendingDatagrams())
+    {
+        m_socket.readDatagram(0, 0);
+        ++m_datagrams;
+    }
+}
@@ -0,0 +1,51 @@
+#ifndef UDPTARGETS_H
+#define UDPTARGETS_H
+
+#include <QUdpSocket>
+
+// Sends every datagram back to where it came from
+class UdpEcho : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit UdpEcho(QObject *parent = 0);
+
+    bool listen(const QHostAddress &address, quint16 port = 0);
+    quint16 port() const;
+    QString errorString() const;
+
+    quint64 datagrams() const;
+
+private slots:
+    void readDatagrams();
+
+private:
+    QUdpSocket m_socket;
+    quint64 m_datagrams;
+};
+
+// Takes datagrams without answering, a closed port would send back an icmp
+// port unreachable which counts as a reply for ping and traceroute
+class SilentUdpTarget : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SilentUdpTarget(QObject *parent = 0);
+
+    bool listen(const QHostAddress &address, quint16 port = 0);
+    quint16 port() const;
+    QString errorString() const;
+
+    quint64 datagrams() const;
+
+private slots:
+    void readDatagrams();
+
+private:
+    QUdpSocket m_socket;
+    quint64 m_datagrams;
+};
+
+#endif // UDPTARGETS_H
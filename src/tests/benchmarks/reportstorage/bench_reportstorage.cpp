@@ -0,0 +1,98 @@
+#include <QtTest>
+
+#include "../benchmarkdata.h"
+
+#include <report/reportscheduler.h>
+#include <report/reportstorage.h>
+#include <storage/storagepaths.h>
+
+class BenchReportStorage : public QObject
+{
+    Q_OBJECT
+
+private:
+    void sizes()
+    {
+        QTest::addColumn<int>("reports");
+
+        QTest::newRow("10") << 10;
+        QTest::newRow("100") << 100;
+    }
+
+    void clear()
+    {
+        StoragePaths storagePaths;
+        storagePaths.reportDirectory().removeRecursively();
+        storagePaths.localCopyDirectory().removeRecursively();
+    }
+
+    void fill(ReportScheduler *scheduler, int reports)
+    {
+        for (int i = 1; i <= reports; ++i)
+        {
+            scheduler->addReport(BenchmarkData::report(i, 10));
+        }
+    }
+
+private slots:
+    void initTestCase()
+    {
+        QStandardPaths::setTestModeEnabled(true);
+    }
+
+    void cleanup()
+    {
+        clear();
+    }
+
+    void store_data()
+    {
+        sizes();
+    }
+
+    void store()
+    {
+        QFETCH(int, reports);
+
+        clear();
+
+        ReportScheduler scheduler;
+        fill(&scheduler, reports);
+        ReportStorage storage(&scheduler);
+
+        QBENCHMARK
+        {
+            storage.storeData(false);
+        }
+    }
+
+    void load_data()
+    {
+        sizes();
+    }
+
+    void load()
+    {
+        QFETCH(int, reports);
+
+        clear();
+
+        {
+            ReportScheduler scheduler;
+            fill(&scheduler, reports);
+            ReportStorage storage(&scheduler);
+            storage.storeData(false);
+        }
+
+        QBENCHMARK
+        {
+            ReportScheduler scheduler;
+            ReportStorage storage(&scheduler);
+            storage.loadData();
+        }
+    }
+};
+
+QTEST_MAIN(BenchReportStorage)
+
+#include "bench_reportstorage.moc"
@@ -0,0 +1,8 @@
+CONFIG += testcase benchmark
+CONFIG -= app_bundle
+QT += testlib network
+
+TARGET = bench_reportstorage
+SOURCES = bench_reportstorage.cpp
+
+include($$SOURCE_DIRECTORY/src/libclient/libclient.pri)
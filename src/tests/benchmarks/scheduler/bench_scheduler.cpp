@@ -0,0 +1,124 @@
+#include <QtTest>
+
+#include <scheduler/scheduler.h>
+
+class BenchScheduler : public QObject
+{
+    Q_OBJECT
+
+private:
+    ScheduleDefinition schedule(int id)
+    {
+        // Different intervals so every insert has to search its position
+        QVariantMap periodic;
+        periodic.insert("interval", 60000 + (id * 7919) % 3600000);
+
+        QVariantMap timing;
+        timing.insert("periodic", periodic);
+
+        QVariantMap options;
+        options.insert("host", QString("host%1.example.com").arg(id));
+
+        QVariantMap task;
+        task.insert("id", id);
+        task.insert("method", "ping");
+        task.insert("options", options);
+
+        QVariantMap map;
+        map.insert("id", id);
+        map.insert("timing", timing);
+        map.insert("precondition", QVariantMap());
+        map.insert("task", task);
+
+        return ScheduleDefinition::fromVariant(map);
+    }
+
+    ScheduleDefinitionList schedules(int count)
+    {
+        ScheduleDefinitionList list;
+
+        for (int i = 1; i <= count; ++i)
+        {
+            list.append(schedule(i));
+        }
+
+        return list;
+    }
+
+    void sizes()
+    {
+        QTest::addColumn<int>("count");
+
+        QTest::newRow("100") << 100;
+        QTest::newRow("1000") << 1000;
+        QTest::newRow("10000") << 10000;
+    }
+
+private slots:
+    void enqueueMany_data()
+    {
+        sizes();
+    }
+
+    void enqueueMany()
+    {
+        QFETCH(int, count);
+
+        ScheduleDefinitionList tests = schedules(count);
+
+        QBENCHMARK
+        {
+            Scheduler scheduler;
+            scheduler.enqueueMany(tests);
+        }
+    }
+
+    void enqueue_data()
+    {
+        sizes();
+    }
+
+    void enqueue()
+    {
+        QFETCH(int, count);
+
+        ScheduleDefinitionList tests = schedules(count);
+
+        QBENCHMARK
+        {
+            Scheduler scheduler;
+
+            foreach (const ScheduleDefinition &test, tests)
+            {
+                scheduler.enqueue(test);
+            }
+        }
+    }
+
+    // What the timeout does for every execution: take the schedule out and
+    // put it back at its next run
+    void reschedule_data()
+    {
+        sizes();
+    }
+
+    void reschedule()
+    {
+        QFETCH(int, count);
+
+        Scheduler scheduler;
+        scheduler.enqueueMany(schedules(count));
+
+        ScheduleDefinition test = schedule(count + 1);
+
+        QBENCHMARK
+        {
+            scheduler.enqueue(test);
+            scheduler.dequeue(test.id());
+        }
+    }
+};
+
+QTEST_MAIN(BenchScheduler)
+
+#include "bench_scheduler.moc"
@@ -0,0 +1,8 @@
+CONFIG += testcase benchmark
+CONFIG -= app_bundle
+QT += testlib network
+
+TARGET = bench_scheduler
+SOURCES = bench_scheduler.cpp
+
+include($$SOURCE_DIRECTORY/src/libclient/libclient.pri)
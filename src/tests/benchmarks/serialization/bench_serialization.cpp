@@ -0,0 +1,137 @@
+#include <QtTest>
+
+#include "../benchmarkdata.h"
+
+#include <storage/jsonwriter.h>
+
+#include <QJsonDocument>
+
+class BenchSerialization : public QObject
+{
+    Q_OBJECT
+
+private:
+    void sizes()
+    {
+        QTest::addColumn<int>("results");
+
+        QTest::newRow("1") << 1;
+        QTest::newRow("100") << 100;
+    }
+
+private slots:
+    void resultToVariant()
+    {
+        Result result = BenchmarkData::result(1);
+
+        QBENCHMARK
+        {
+            result.toVariant();
+        }
+    }
+
+    void resultWriteJson()
+    {
+        Result result = BenchmarkData::result(1);
+
+        QBENCHMARK
+        {
+            QByteArray json;
+            JsonWriter writer(&json);
+            result.writeJson(&writer);
+        }
+    }
+
+    void reportToVariant_data()
+    {
+        sizes();
+    }
+
+    void reportToVariant()
+    {
+        QFETCH(int, results);
+
+        Report report = BenchmarkData::report(1, results);
+
+        QBENCHMARK
+        {
+            report.toVariant();
+        }
+    }
+
+    // The path of every store and upload
+    void reportToJson_data()
+    {
+        sizes();
+    }
+
+    void reportToJson()
+    {
+        QFETCH(int, results);
+
+        Report report = BenchmarkData::report(1, results);
+
+        QBENCHMARK
+        {
+            QJsonDocument::fromVariant(report.toVariant()).toJson();
+        }
+    }
+
+    void reportFromJson_data()
+    {
+        sizes();
+    }
+
+    void reportFromJson()
+    {
+        QFETCH(int, results);
+
+        QByteArray json = QJsonDocument::fromVariant(BenchmarkData::report(1, results).toVariant()).toJson();
+
+        QBENCHMARK
+        {
+            Report::fromVariant(QJsonDocument::fromJson(json).toVariant());
+        }
+    }
+
+    // Same json without the QVariantMap and QJsonValue trees
+    void reportWriteJson_data()
+    {
+        sizes();
+    }
+
+    void reportWriteJson()
+    {
+        QFETCH(int, results);
+
+        Report report = BenchmarkData::report(1, results);
+
+        QBENCHMARK
+        {
+            report.toJson();
+        }
+    }
+
+    void reportReadJson_data()
+    {
+        sizes();
+    }
+
+    void reportReadJson()
+    {
+        QFETCH(int, results);
+
+        QByteArray json = BenchmarkData::report(1, results).toJson();
+
+        QBENCHMARK
+        {
+            Report report;
+            QString errorString;
+            Report::fromJson(json, &report, &errorString);
+        }
+    }
+};
+
+QTEST_MAIN(BenchSerialization)
+
+#include "bench_serialization.moc"
@@ -0,0 +1,8 @@
+CONFIG += testcase benchmark
+CONFIG -= app_bundle
+QT += testlib network
+
+TARGET = bench_serialization
+SOURCES = bench_serialization.cpp
+
+include($$SOURCE_DIRECTORY/src/libclient/libclient.pri)
@@ -0,0 +1,6 @@
+CONFIG += testcase
+CONFIG -= app_bundle
+QT += testlib network
+TARGET = tst_btc
+SOURCES = tst_btc.cpp
+include($$SOURCE_DIRECTORY/src/libclient/libclient.pri)
@@ -0,0 +1,80 @@
+#include <QtTest>
+#include <QTcpServer>
+#include <QTcpSocket>
+
+#include <limits>
+
+#include <measurement/btc/btc_mp.h>
+#include <measurement/measurementfactory.h>
+#include <network/networkmanager.h>
+
+class TestBulkTransportCapacity : public QObject
+{
+    Q_OBJECT
+
+private:
+    quint16 freePort()
+    {
+        QTcpServer server;
+        server.listen(QHostAddress::LocalHost, 0);
+        return server.serverPort();
+    }
+
+    void request(QTcpSocket &socket, quint64 bytes)
+    {
+        QDataStream out(&socket);
+        out << bytes;
+    }
+
+private slots:
+    // A second request must not wrap the per client size cap around
+    void sizeCap()
+    {
+        const quint64 cap = 256 * 1024;
+
+        NetworkManager networkManager;
+        BulkTransportCapacityMP server;
+        server.setMaxBytesPerClient(cap);
+        server.setMaxRatePerClient(0);
+
+        quint16 port = freePort();
+        QVERIFY(port);
+
+        QVariantMap options;
+        options.insert("port", port);
+
+        MeasurementFactory factory;
+        MeasurementDefinitionPtr definition = factory.createMeasurementDefinition("btc_mp", options);
+        QVERIFY(server.prepare(&networkManager, definition));
+        QVERIFY(server.start());
+
+        QTcpSocket socket;
+        socket.connectToHost(QHostAddress::LocalHost, port);
+        QVERIFY(socket.waitForConnected(5000));
+
+        request(socket, 1000);
+        request(socket, std::numeric_limits<quint64>::max() - 500);
+
+        // The server lives in this thread, keep the event loop running
+        quint64 received = 0;
+        QElapsedTimer timer;
+        timer.start();
+
+        while (socket.state() == QAbstractSocket::ConnectedState && received <= cap && timer.elapsed() < 10000)
+        {
+            QTest::qWait(10);
+            received += socket.readAll().size();
+        }
+
+        received += socket.readAll().size();
+
+        QCOMPARE(received, cap);
+        QVERIFY(socket.state() != QAbstractSocket::ConnectedState);
+
+        server.stop();
+    }
+};
+
+QTEST_MAIN(TestBulkTransportCapacity)
+
+#include "tst_btc.moc"
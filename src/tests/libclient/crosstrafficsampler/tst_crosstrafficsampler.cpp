@@ -0,0 +1,49 @@
+#include <QtTest>
+#include <QThread>
+
+#include <task/crosstrafficsampler.h>
+
+class TestCrossTrafficSampler : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    // The task executor runs the sampler on its own thread
+    void workerThread()
+    {
+        QThread thread;
+        thread.start();
+
+        CrossTrafficSampler *sampler = new CrossTrafficSampler;
+        sampler->setInterval(20);
+        sampler->setGatewayEnabled(false);
+        sampler->moveToThread(&thread);
+
+        QSignalSpy stopped(sampler, SIGNAL(stopped()));
+
+        QVERIFY(QMetaObject::invokeMethod(sampler, "start", Qt::BlockingQueuedConnection));
+        QTest::qWait(300);
+        QVERIFY(QMetaObject::invokeMethod(sampler, "stop", Qt::BlockingQueuedConnection));
+
+        QTRY_COMPARE(stopped.count(), 1);
+        QVERIFY(!sampler->isRunning());
+
+        // first, final and the periodic ones in between
+        QList<CrossTrafficSampler::Sample> samples = sampler->samples();
+        QVERIFY2(samples.size() > 2, qPrintable(QString::number(samples.size())));
+
+        for (int i = 1; i < samples.size(); ++i)
+        {
+            QVERIFY(samples.at(i).time >= samples.at(i - 1).time);
+            QVERIFY(!samples.at(i).hasGateway);
+        }
+
+        sampler->deleteLater();
+        thread.quit();
+        QVERIFY(thread.wait(5000));
+    }
+};
+
+QTEST_MAIN(TestCrossTrafficSampler)
+
+#include "tst_crosstrafficsampler.moc"
@@ -0,0 +1,8 @@
+CONFIG += testcase
+CONFIG -= app_bundle
+QT += testlib
+
+TARGET = tst_devicestatecolumns
+SOURCES = tst_devicestatecolumns.cpp
+
+include($$SOURCE_DIRECTORY/src/libclient/libclient.pri)
@@ -0,0 +1,249 @@
+#include <QtTest>
+
+#include <report/devicestatecolumns.h>
+#include <report/report.h>
+#include <storage/jsonwriter.h>
+#include <storage/jsonreader.h>
+
+class TestDeviceStateColumns : public QObject
+{
+    Q_OBJECT
+
+private:
+    QVariantMap deviceState(int i)
+    {
+        QVariantMap map;
+        map.insert("cpu_usage", 12 + i % 3);
+        map.insert("free_memory", Q_INT64_C(512000000) - i * 4096);
+        map.insert("connection_mode", 3);
+        map.insert("tbm_active", true);
+        map.insert("used_traffic", Q_INT64_C(1000) * (i / 4));
+        return map;
+    }
+
+    QList<QVariantMap> snapshots()
+    {
+        QList<QVariantMap> list;
+
+        for (int i = 0; i < 20; ++i)
+        {
+            QVariantMap map = deviceState(i);
+
+            // Failed runs have no device state, others miss a value
+            if (i == 7)
+            {
+                map.clear();
+            }
+            else if (i % 5 == 0)
+            {
+                map.remove("cpu_usage");
+                map.insert("signal_strength", -67.5);
+            }
+
+            list.append(map);
+        }
+
+        return list;
+    }
+
+    Report report(int results)
+    {
+        ResultList list;
+        QDateTime start(QDate(2021, 3, 1), QTime(12, 0, 0));
+
+        for (int i = 0; i < results; ++i)
+        {
+            QVariantMap probe;
+            probe.insert("round_trip_avg", 25.0);
+
+            list.append(Result(start.addSecs(60 * i), start.addSecs(60 * i + 10), probe, QUuid::createUuid(),
+                               deviceState(2 * i), deviceState(2 * i + 1), QString()));
+        }
+
+        return Report(TaskId(3), start, "1.2.3", list);
+    }
+
+    // The layout of older versions with the device state in each result
+    QVariant legacyVariant(const Report &report)
+    {
+        QVariantList results;
+
+        foreach (const Result &result, report.results())
+        {
+            results.append(result.toVariant());
+        }
+
+        QVariantMap map;
+        map.insert("task_id", report.taskId().toInt());
+        map.insert("report_time", report.dateTime());
+        map.insert("app_version", report.appVersion());
+        map.insert("results", results);
+        return map;
+    }
+
+    void compareDeviceStates(const Report &actual, const Report &expected)
+    {
+        QCOMPARE(actual.results().size(), expected.results().size());
+
+        for (int i = 0; i < expected.results().size(); ++i)
+        {
+            QCOMPARE(actual.results().at(i).preInfo(), expected.results().at(i).preInfo());
+            QCOMPARE(actual.results().at(i).postInfo(), expected.results().at(i).postInfo());
+        }
+    }
+
+private slots:
+    void empty()
+    {
+        DeviceStateColumns states((QList<QVariantMap>()));
+
+        QCOMPARE(states.count(), 0);
+        QVERIFY(states.snapshots().isEmpty());
+        QVERIFY(DeviceStateColumns::fromVariant(states.toVariant()).snapshots().isEmpty());
+    }
+
+    void resolve()
+    {
+        QList<QVariantMap> list = snapshots();
+        DeviceStateColumns states(list);
+
+        QCOMPARE(states.count(), list.size());
+        QCOMPARE(states.snapshots(), list);
+        QCOMPARE(DeviceStateColumns::fromVariant(states.toVariant()).snapshots(), list);
+
+        QByteArray json;
+        JsonWriter writer(&json);
+        states.writeJson(&writer);
+
+        QCOMPARE(DeviceStateColumns::fromVariant(JsonReader::toVariant(json)).snapshots(), list);
+    }
+
+    void changesOnly()
+    {
+        QList<QVariantMap> list;
+
+        for (int i = 0; i < 8; ++i)
+        {
+            list.append(deviceState(i));
+        }
+
+        QVariantMap columns = DeviceStateColumns(list).toVariant().toMap().value("columns").toMap();
+
+        // Never changes
+        QVariantMap mode = columns.value("connection_mode").toMap();
+        QCOMPARE(mode.value("at").toList(), QVariantList() << 0);
+        QCOMPARE(mode.value("delta").toList(), QVariantList() << 3);
+
+        // Changes every fourth snapshot, by the same amount
+        QVariantMap traffic = columns.value("used_traffic").toMap();
+        QCOMPARE(traffic.value("at").toList(), QVariantList() << 0 << 4);
+        QCOMPARE(traffic.value("delta").toList(), QVariantList() << 0 << 1000);
+
+        // Unsigned counters get differences as well
+        list.clear();
+
+        for (int i = 0; i < 3; ++i)
+        {
+            QVariantMap map;
+            map.insert("bytes", Q_UINT64_C(4000000000) + quint64(i) * 10);
+            list.append(map);
+        }
+
+        DeviceStateColumns unsignedStates(list);
+        QVariantMap bytes = unsignedStates.toVariant().toMap().value("columns").toMap().value("bytes").toMap();
+        QCOMPARE(bytes.value("delta").toList(), QVariantList() << Q_UINT64_C(4000000000) << 10 << 10);
+        QCOMPARE(unsignedStates.snapshots(), list);
+
+        // Not a number, so no differences
+        QVariantMap active = columns.value("tbm_active").toMap();
+        QVERIFY(!active.contains("delta"));
+        QCOMPARE(active.value("value").toList(), QVariantList() << true);
+    }
+
+    void malformed()
+    {
+        QVariantMap column;
+        column.insert("at", QVariantList() << 0 << -1 << 2);
+        column.insert("value", QVariantList() << 1 << 2 << 3);
+
+        QVariantMap columns;
+        columns.insert("a", column);
+
+        QVariantMap map;
+        map.insert("count", 4);
+        map.insert("columns", columns);
+
+        QList<QVariantMap> list = DeviceStateColumns::fromVariant(map).snapshots();
+
+        QCOMPARE(list.size(), 4);
+        QCOMPARE(list.at(0).value("a").toInt(), 1);
+        QCOMPARE(list.at(3).value("a").toInt(), 1);
+    }
+
+    void reportRoundTrip()
+    {
+        Report expected = report(50);
+
+        Report actual;
+        QString errorString;
+
+        QVERIFY2(Report::fromJson(expected.toJson(Report::StorageFormat), &actual, &errorString),
+                 qPrintable(errorString));
+        compareDeviceStates(actual, expected);
+
+        compareDeviceStates(Report::fromVariant(expected.toVariant(Report::StorageFormat)), expected);
+    }
+
+    // Uploads keep the device state in each result until the collector reads columns
+    void uploadFormat()
+    {
+        Report expected = report(3);
+        QVariantMap map = JsonReader::toVariant(expected.toJson()).toMap();
+
+        QVERIFY(!map.contains("device_state"));
+        QVERIFY(!map.contains("format_version"));
+
+        QVariantList results = map.value("results").toList();
+        QCOMPARE(results.size(), 3);
+        QVERIFY(results.at(0).toMap().contains("pre_info"));
+        QVERIFY(results.at(0).toMap().contains("post_info"));
+
+        QVariantMap stored = expected.toVariant(Report::StorageFormat).toMap();
+        QCOMPARE(stored.value("format_version").toInt(), 2);
+        QVERIFY(!stored.value("results").toList().at(0).toMap().contains("pre_info"));
+
+        Report actual;
+        QString errorString;
+
+        QVERIFY2(Report::fromJson(expected.toJson(), &actual, &errorString), qPrintable(errorString));
+        compareDeviceStates(actual, expected);
+    }
+
+    void legacyReport()
+    {
+        Report expected = report(5);
+        QVariant legacy = legacyVariant(expected);
+
+        compareDeviceStates(Report::fromVariant(legacy), expected);
+
+        Report actual;
+        QString errorString;
+
+        QVERIFY2(Report::fromJson(JsonWriter::toJson(legacy), &actual, &errorString), qPrintable(errorString));
+        compareDeviceStates(actual, expected);
+    }
+
+    void smaller()
+    {
+        Report columns = report(50);
+        QByteArray stored = columns.toJson(Report::StorageFormat);
+        QByteArray legacy = JsonWriter::toJson(legacyVariant(columns));
+
+        qDebug("%d bytes with columns, %d bytes before", stored.size(), legacy.size());
+        QVERIFY(stored.size() < legacy.size() * 3 / 4);
+    }
+};
+
+QTEST_MAIN(TestDeviceStateColumns)
+
+#include "tst_devicestatecolumns.moc"
@@ -0,0 +1,392 @@
+#include <QtTest>
+#include <QUdpSocket>
+#include <QTcpServer>
+#include <QTcpSocket>
+
+#include <network/dnsclient.h>
+#include <network/reverseresolver.h>
+
+// Answers A, AAAA and PTR queries, "missing." names do not exist
+class StubDnsServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    StubDnsServer()
+    : truncate(false)
+    , silent(false)
+    , wrongQuestion(false)
+    , lateDelay(0)
+    , received(0)
+    , latePort(0)
+    {
+        connect(&udp, SIGNAL(readyRead()), this, SLOT(readDatagrams()));
+        connect(&tcp, SIGNAL(newConnection()), this, SLOT(handleConnection()));
+    }
+
+    bool listen()
+    {
+        return udp.bind(QHostAddress::LocalHost, 0) && tcp.listen(QHostAddress::LocalHost, udp.localPort());
+    }
+
+    quint16 port() const
+    {
+        return udp.localPort();
+    }
+
+    bool truncate;
+    bool silent;
+    bool wrongQuestion;
+    int lateDelay; // answer only the first query after this many ms
+    int received;
+    QList<quint16> ids;
+
+private:
+    QByteArray answer(const QByteArray &query, bool truncated)
+    {
+        int end = query.indexOf('\0', 12);
+        QByteArray question = query.mid(12, end - 12 + 5);
+        QString name = QString::fromLatin1(question.mid(1, 7));
+        quint16 type = ((quint8)query.at(end + 1) << 8) | (quint8)query.at(end + 2);
+
+        QByteArray record;
+        QDataStream rdata(&record, QIODevice::WriteOnly);
+
+        if (type == DnsClient::A)
+        {
+            rdata << (quint32)QHostAddress("192.0.2.1").toIPv4Address();
+        }
+        else if (type == DnsClient::PTR)
+        {
+            rdata.writeRawData("\x04" "host" "\x07" "example", 13);
+            rdata << (quint8)0;
+        }
+        else
+        {
+            Q_IPV6ADDR address = QHostAddress("2001:db8::1").toIPv6Address();
+            rdata.writeRawData((const char *)address.c, 16);
+        }
+
+        bool missing = name == "missing";
+        int answers = truncated || missing ? 0 : 2;
+
+        QByteArray response;
+        QDataStream out(&response, QIODevice::WriteOnly);
+        out << (quint16)(((quint8)query.at(0) << 8) | (quint8)query.at(1))
+            << (quint16)(0x8180 | (truncated ? 0x0200 : 0) | (missing ? 3 : 0)) << (quint16)1 << (quint16)answers
+            << (quint16)0 << (quint16)0;
+        out.writeRawData(question.constData(), question.size());
+
+        // The owner names point back to the question
+        for (int i = 0; i < answers; ++i)
+        {
+            out << (quint16)0xc00c << type << (quint16)1 << (quint32)(300 - i) << (quint16)record.size();
+            out.writeRawData(record.constData(), record.size());
+        }
+
+        return response;
+    }
+
+private slots:
+    void readDatagrams()
+    {
+        while (udp.hasPendingDatagrams())
+        {
+            QByteArray query;
+            query.resize(udp.pendingDatagramSize());
+
+            QHostAddress sender;
+            quint16 senderPort;
+            udp.readDatagram(query.data(), query.size(), &sender, &senderPort);
+
+            ++received;
+            ids << (((quint8)query.at(0) << 8) | (quint8)query.at(1));
+
+            QByteArray response = answer(query, truncate);
+
+            if (wrongQuestion)
+            {
+                // "present" turns into "qresent"
+                response[13] = response.at(13) ^ 1;
+            }
+
+            if (lateDelay)
+            {
+                if (received == 1)
+                {
+                    late = response;
+                    lateSender = sender;
+                    latePort = senderPort;
+                    QTimer::singleShot(lateDelay, Qt::PreciseTimer, this, SLOT(sendLate()));
+                }
+            }
+            else if (!silent)
+            {
+                udp.writeDatagram(response, sender, senderPort);
+            }
+        }
+    }
+
+    void sendLate()
+    {
+        udp.writeDatagram(late, lateSender, latePort);
+    }
+
+    void handleConnection()
+    {
+        while (tcp.hasPendingConnections())
+        {
+            QTcpSocket *socket = tcp.nextPendingConnection();
+            connect(socket, SIGNAL(readyRead()), this, SLOT(readRequest()));
+            connect(socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()));
+        }
+    }
+
+    void readRequest()
+    {
+        QTcpSocket *socket = qobject_cast<QTcpSocket *>(sender());
+        QByteArray request = socket->property("request").toByteArray() + socket->readAll();
+        socket->setProperty("request", request);
+
+        if (request.size() < 2 || request.size() < 2 + (((quint8)request.at(0) << 8) | (quint8)request.at(1)))
+        {
+            return;
+        }
+
+        QByteArray response = answer(request.mid(2), false);
+        QByteArray frame;
+        frame.append((char)(response.size() >> 8));
+        frame.append((char)(response.size() & 0xff));
+        socket->write(frame + response);
+        socket->disconnectFromHost();
+    }
+
+private:
+    QUdpSocket udp;
+    QTcpServer tcp;
+
+    QByteArray late;
+    QHostAddress lateSender;
+    quint16 latePort;
+};
+
+class TestDnsClient : public QObject
+{
+    Q_OBJECT
+
+private:
+    bool run(DnsClient *client)
+    {
+        QSignalSpy finished(client, SIGNAL(finished()));
+
+        if (!client->start())
+        {
+            return false;
+        }
+
+        return finished.wait(5000);
+    }
+
+private slots:
+    void wireFormat()
+    {
+        QByteArray query = DnsClient::encodeQuery(0x1234, "www.example.com", DnsClient::AAAA);
+        QCOMPARE(query.toHex(), QByteArray("12340100000100000000000003777777076578616d706c6503636f6d00001c0001"));
+
+        // Labels are limited to 63 bytes
+        QVERIFY(DnsClient::encodeQuery(1, QString(64, 'a') + ".example", DnsClient::A).isEmpty());
+
+        // A compression pointer to itself must not hang
+        QByteArray loop = QByteArray::fromHex("000181800001000000000000c00c00010001");
+        quint16 id;
+        int rcode;
+        bool truncated;
+        QList<DnsClient::Answer> answers;
+        QVERIFY(!DnsClient::decodeResponse(loop, &id, &rcode, &truncated, &answers));
+
+        QCOMPARE(DnsClient::typeFromString("aaaa"), (quint16)DnsClient::AAAA);
+        QCOMPARE(DnsClient::typeToString(DnsClient::MX), QString("MX"));
+        QCOMPARE(DnsClient::typeFromString("BOGUS"), (quint16)0);
+    }
+
+    void matrix()
+    {
+        StubDnsServer first, second;
+        QVERIFY(first.listen());
+        QVERIFY(second.listen());
+
+        DnsClient client;
+        QSignalSpy queryFinished(&client, SIGNAL(queryFinished(int)));
+
+        foreach (const QString &name, QStringList() << "present.example" << "missing.example")
+        {
+            foreach (quint16 type, QList<quint16>() << DnsClient::A << DnsClient::AAAA)
+            {
+                client.addQuery(name, type, QHostAddress::LocalHost, first.port());
+                client.addQuery(name, type, QHostAddress::LocalHost, second.port());
+            }
+        }
+
+        QVERIFY(run(&client));
+        QCOMPARE(queryFinished.count(), 8);
+        QCOMPARE(first.received, 4);
+        QCOMPARE(second.received, 4);
+
+        foreach (const DnsClient::Query &query, client.queries())
+        {
+            QVERIFY(query.finished);
+            QVERIFY(query.latency() >= 0);
+            QVERIFY(query.receiveTime >= query.sendTime);
+            QCOMPARE(query.latency(), query.receiveMonotonic - query.sendMonotonic);
+            QCOMPARE(query.attempts, 1);
+            QVERIFY(!query.truncated);
+
+            if (query.name.startsWith("missing"))
+            {
+                QCOMPARE(DnsClient::rcodeToString(query.rcode), QString("NXDomain"));
+                QVERIFY(query.answers.isEmpty());
+                QCOMPARE(query.minimumTtl(), Q_INT64_C(-1));
+            }
+            else
+            {
+                QCOMPARE(query.rcode, 0);
+                QCOMPARE(query.answers.size(), 2);
+                QCOMPARE(query.answers.first().name, query.name);
+                QCOMPARE(query.answers.first().value,
+                         QString(query.type == DnsClient::A ? "192.0.2.1" : "2001:db8::1"));
+                QCOMPARE(query.minimumTtl(), Q_INT64_C(299));
+            }
+        }
+    }
+
+    void tcpFallback()
+    {
+        StubDnsServer server;
+        QVERIFY(server.listen());
+        server.truncate = true;
+
+        DnsClient client;
+        client.addQuery("present.example", DnsClient::A, QHostAddress::LocalHost, server.port());
+        QVERIFY(run(&client));
+
+        DnsClient::Query query = client.query(0);
+        QVERIFY(query.tcp);
+        QVERIFY(!query.truncated);
+        QCOMPARE(query.rcode, 0);
+        QCOMPARE(query.answers.size(), 2);
+        QVERIFY(query.errorString.isEmpty());
+    }
+
+    void retries()
+    {
+        StubDnsServer server;
+        QVERIFY(server.listen());
+        server.silent = true;
+
+        DnsClient client;
+        client.setTimeout(100);
+        client.setRetries(2);
+        client.addQuery("present.example", DnsClient::A, QHostAddress::LocalHost, server.port());
+        QVERIFY(run(&client));
+
+        DnsClient::Query query = client.query(0);
+        QCOMPARE(query.errorString, QString("Timeout"));
+        QCOMPARE(query.attempts, 3);
+        QCOMPARE(query.rcode, -1);
+        QCOMPARE(query.latency(), Q_INT64_C(-1));
+
+        // Every attempt has its own id
+        QCOMPARE(server.received, 3);
+        QCOMPARE(server.ids.toSet().size(), 3);
+    }
+
+    void lateAnswer()
+    {
+        StubDnsServer server;
+        QVERIFY(server.listen());
+        server.lateDelay = 150;
+
+        DnsClient client;
+        client.setTimeout(100);
+        client.setRetries(2);
+        client.addQuery("present.example", DnsClient::A, QHostAddress::LocalHost, server.port());
+        QVERIFY(run(&client));
+
+        // The answer to the first attempt arrives after the retry was sent,
+        // it is timed against the first attempt
+        DnsClient::Query query = client.query(0);
+        QCOMPARE(query.rcode, 0);
+        QCOMPARE(query.attempts, 2);
+        QVERIFY(query.latency() >= Q_INT64_C(120000000));
+    }
+
+    void wrongQuestion()
+    {
+        StubDnsServer server;
+        QVERIFY(server.listen());
+        server.wrongQuestion = true;
+
+        DnsClient client;
+        client.setTimeout(100);
+        client.setRetries(0);
+        client.addQuery("present.example", DnsClient::A, QHostAddress::LocalHost, server.port());
+        QVERIFY(run(&client));
+
+        DnsClient::Query query = client.query(0);
+        QCOMPARE(query.errorString, QString("Timeout"));
+        QCOMPARE(query.rcode, -1);
+        QCOMPARE(server.received, 1);
+    }
+
+    void reverseResolver()
+    {
+        QCOMPARE(ReverseResolver::reverseName(QHostAddress("192.0.2.1")), QString("1.2.0.192.in-addr.arpa"));
+        QCOMPARE(ReverseResolver::reverseName(QHostAddress("2001:db8::1")),
+                 QString("1.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.8.b.d.0.1.0.0.2.ip6.arpa"));
+
+        StubDnsServer server;
+        QVERIFY(server.listen());
+
+        QList<QHostAddress> addresses;
+        addresses << QHostAddress("192.0.2.1") << QHostAddress("192.0.2.2") << QHostAddress("2001:db8::1");
+
+        ReverseResolver::clearCache();
+
+        {
+            ReverseResolver resolver;
+            resolver.setServer(QHostAddress::LocalHost, server.port());
+            QSignalSpy finished(&resolver, SIGNAL(finished()));
+            QSignalSpy resolved(&resolver, SIGNAL(resolved(QHostAddress, QString)));
+
+            resolver.lookup(addresses);
+            QVERIFY(resolver.isRunning());
+            QVERIFY(finished.wait(5000));
+
+            QCOMPARE(resolved.count(), 3);
+            QCOMPARE(server.received, 3);
+            QCOMPARE(resolver.cacheHits(), 0);
+
+            foreach (const QHostAddress &address, addresses)
+            {
+                QCOMPARE(resolver.hostName(address), QString("host.example"));
+            }
+        }
+
+        // A second resolver is answered from the shared cache
+        ReverseResolver resolver;
+        resolver.setServer(QHostAddress::LocalHost, server.port());
+        QSignalSpy finished(&resolver, SIGNAL(finished()));
+
+        resolver.lookup(addresses);
+        QVERIFY(!resolver.isRunning());
+        QVERIFY(finished.wait(1000));
+
+        QCOMPARE(server.received, 3);
+        QCOMPARE(resolver.cacheHits(), 3);
+        QCOMPARE(resolver.hostName(addresses.last()), QString("host.example"));
+    }
+};
+
+QTEST_MAIN(TestDnsClient)
+
+#include "tst_dnsclient.moc"
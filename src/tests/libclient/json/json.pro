@@ -0,0 +1,8 @@
+CONFIG += testcase
+CONFIG -= app_bundle
+QT += testlib
+
+TARGET = tst_json
+SOURCES = tst_json.cpp
+
+include($$SOURCE_DIRECTORY/src/libclient/libclient.pri)
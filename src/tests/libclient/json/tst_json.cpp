@@ -0,0 +1,193 @@
+#include <QtTest>
+
+#include <storage/jsonwriter.h>
+#include <storage/jsonreader.h>
+#include <report/report.h>
+
+#include <QJsonDocument>
+
+class TestJson : public QObject
+{
+    Q_OBJECT
+
+private:
+    Result result(int i)
+    {
+        QVariantMap probe;
+        probe.insert("round_trip_avg", 25.25);
+        probe.insert("round_trip_ms", QVariantList() << 20.5 << 30 << -1);
+        probe.insert("host", QString::fromUtf8("h\xc3\xb6st \"%1\"\n").arg(i));
+
+        QVariantMap info;
+        info.insert("free_memory", Q_INT64_C(512000000) - i);
+        info.insert("tbm_active", true);
+
+        QDateTime start(QDate(2021, 3, 1), QTime(12, 0, 0, 250));
+        start = start.addSecs(i * 60);
+
+        Result result(start, start.addSecs(10), probe, QUuid::createUuid(), info, info, QString());
+        result.setClockError(i);
+        return result;
+    }
+
+private slots:
+    void writeVariant_data()
+    {
+        QTest::addColumn<QVariant>("value");
+
+        QVariantMap map;
+        map.insert("int", 42);
+        map.insert("negative", -7);
+        map.insert("large", Q_INT64_C(8000000000));
+        map.insert("double", 0.1);
+        map.insert("bool", false);
+        map.insert("null", QVariant());
+        map.insert("string", QString::fromUtf8("a\"b\\c/d\te\x01 \xc3\xa4 \xe2\x82\xac \xf0\x9f\x98\x80"));
+        map.insert("list", QVariantList() << 1 << "two" << QVariantList());
+        map.insert("strings", QStringList() << "x" << "y");
+        map.insert("date", QDateTime(QDate(2021, 3, 1), QTime(12, 0, 0, 5), Qt::UTC));
+        map.insert("nested", QVariantMap());
+
+        QTest::newRow("object") << QVariant(map);
+        QTest::newRow("array") << QVariant(QVariantList() << map << 1.5 << QVariant());
+    }
+
+    void writeVariant()
+    {
+        QFETCH(QVariant, value);
+
+        QByteArray json = JsonWriter::toJson(value);
+
+        QJsonParseError error;
+        QJsonDocument document = QJsonDocument::fromJson(json, &error);
+
+        QCOMPARE(error.error, QJsonParseError::NoError);
+        QCOMPARE(document, QJsonDocument::fromVariant(value));
+    }
+
+    void readVariant_data()
+    {
+        QTest::addColumn<QByteArray>("json");
+
+        QTest::newRow("empty object") << QByteArray("{}");
+        QTest::newRow("empty array") << QByteArray(" [ ] ");
+        QTest::newRow("numbers") << QByteArray("[0, -1, 1.5, 2e3, -0.25E-2, 123456789012345678, 12345678901234567890]");
+        QTest::newRow("literals") << QByteArray("[true, false, null]");
+        QTest::newRow("escapes") << QByteArray("[\"a\\\"b\\\\c\\/d\\b\\f\\n\\r\\t\\u00e4\\ud83d\\ude00\"]");
+        QTest::newRow("utf-8") << QByteArray("{\"k\\u00e4y\": \"\xe2\x82\xac\"}");
+        QTest::newRow("nested") << QByteArray("{\"a\": {\"b\": [[], {}, [1, {\"c\": null}]]}, \"d\": \"e\"}");
+    }
+
+    void readVariant()
+    {
+        QFETCH(QByteArray, json);
+
+        QString errorString;
+        QVariant value = JsonReader::toVariant(json, &errorString);
+
+        QVERIFY2(errorString.isEmpty(), qPrintable(errorString));
+        QCOMPARE(value, QJsonDocument::fromJson(json).toVariant());
+    }
+
+    void readInvalid_data()
+    {
+        QTest::addColumn<QByteArray>("json");
+
+        QTest::newRow("empty") << QByteArray();
+        QTest::newRow("unterminated object") << QByteArray("{\"a\": 1");
+        QTest::newRow("trailing comma") << QByteArray("[1, ]");
+        QTest::newRow("missing colon") << QByteArray("{\"a\" 1}");
+        QTest::newRow("unquoted name") << QByteArray("{a: 1}");
+        QTest::newRow("mismatched bracket") << QByteArray("[1}");
+        QTest::newRow("bad literal") << QByteArray("[nul]");
+        QTest::newRow("bad number") << QByteArray("[-]");
+        QTest::newRow("bad escape") << QByteArray("[\"\\x\"]");
+        QTest::newRow("control character") << QByteArray("[\"a\nb\"]");
+        QTest::newRow("garbage") << QByteArray("{} x");
+    }
+
+    void readInvalid()
+    {
+        QFETCH(QByteArray, json);
+
+        QString errorString;
+
+        QVERIFY(!JsonReader::toVariant(json, &errorString).isValid());
+        QVERIFY(!errorString.isEmpty());
+    }
+
+    void skipValue()
+    {
+        QByteArray json("{\"skip\": {\"a\": [1, {\"b\": []}]}, \"keep\": 2}");
+        JsonReader reader(json);
+
+        QCOMPARE(reader.next(), JsonReader::BeginObject);
+        QCOMPARE(reader.next(), JsonReader::Name);
+        QCOMPARE(reader.next(), JsonReader::BeginObject);
+        reader.skipValue();
+        QCOMPARE(reader.token(), JsonReader::EndObject);
+        QCOMPARE(reader.next(), JsonReader::Name);
+        QCOMPARE(reader.string(), QString("keep"));
+        QCOMPARE(reader.next(), JsonReader::Number);
+        QCOMPARE(reader.toInteger(), Q_INT64_C(2));
+        QCOMPARE(reader.next(), JsonReader::EndObject);
+        QCOMPARE(reader.next(), JsonReader::EndDocument);
+    }
+
+    // The direct path has to produce what the QVariant path did
+    void reportToJson()
+    {
+        ResultList results;
+        results << result(0) << result(1) << Result("failed");
+
+        Report report(TaskId(7), QDateTime(QDate(2021, 3, 1), QTime(12, 0, 0)), "1.2.3", results);
+
+        QCOMPARE(QJsonDocument::fromJson(report.toJson()), QJsonDocument::fromVariant(report.toVariant()));
+
+        QByteArray stripped;
+        JsonWriter writer(&stripped);
+        results.at(0).writeJsonStripped(&writer);
+
+        QCOMPARE(QJsonDocument::fromJson(stripped), QJsonDocument::fromVariant(results.at(0).toVariantStripped()));
+    }
+
+    void reportFromJson()
+    {
+        ResultList results;
+        results << result(0) << result(1);
+
+        Report report(TaskId(7), QDateTime(QDate(2021, 3, 1), QTime(12, 0, 0)), "1.2.3", results);
+
+        // Files written before were indented QJsonDocument output
+        QByteArray json = QJsonDocument::fromVariant(report.toVariant()).toJson();
+
+        Report loaded;
+        QString errorString;
+
+        QVERIFY2(Report::fromJson(json, &loaded, &errorString), qPrintable(errorString));
+        QCOMPARE(loaded.taskId().toInt(), report.taskId().toInt());
+        QCOMPARE(loaded.dateTime(), report.dateTime());
+        QCOMPARE(loaded.appVersion(), report.appVersion());
+        QCOMPARE(loaded.results().size(), 2);
+
+        for (int i = 0; i < results.size(); ++i)
+        {
+            Result expected = results.at(i);
+            Result actual = loaded.results().at(i);
+
+            QCOMPARE(actual.startDateTime(), expected.startDateTime());
+            QCOMPARE(actual.endDateTime(), expected.endDateTime());
+            QCOMPARE(actual.measureUuid(), expected.measureUuid());
+            QCOMPARE(actual.probeResult(), expected.probeResult());
+            QCOMPARE(actual.preInfo(), expected.preInfo());
+            QCOMPARE(actual.postInfo(), expected.postInfo());
+            QCOMPARE(actual.clockError(), expected.clockError());
+        }
+
+        QVERIFY(!Report::fromJson(json.left(json.size() / 2), &loaded, &errorString));
+    }
+};
+
+QTEST_MAIN(TestJson)
+
+#include "tst_json.moc"
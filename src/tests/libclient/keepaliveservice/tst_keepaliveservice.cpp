@@ -0,0 +1,76 @@
+#include <QtTest>
+#include <QUdpSocket>
+
+#include <network/keepaliveservice.h>
+
+class TestKeepaliveService : public QObject
+{
+    Q_OBJECT
+
+private:
+    QByteArray reply(quint16 port)
+    {
+        return QString("{\"type\": \"keepalive\", \"src_port\": %1}").arg(port).toUtf8();
+    }
+
+private slots:
+    void prebuiltPacket()
+    {
+        QUdpSocket server;
+        QVERIFY(server.bind(QHostAddress::LocalHost));
+
+        QUdpSocket socket;
+        QVERIFY(socket.bind(QHostAddress::LocalHost));
+
+        KeepaliveService keepalive;
+        keepalive.setSocket(&socket);
+        keepalive.setServer(QHostAddress::LocalHost, server.localPort());
+        keepalive.setSessionId("session");
+        keepalive.sendKeepalive();
+
+        QByteArray packet = keepalive.packet();
+        QVERIFY(packet.contains("\"session_id\":\"session\""));
+        QVERIFY(server.waitForReadyRead(1000));
+
+        QByteArray datagram(server.pendingDatagramSize(), 0);
+        server.readDatagram(datagram.data(), datagram.size());
+        QCOMPARE(datagram, packet);
+
+        qDebug("packet is reused until something changes");
+        keepalive.sendKeepalive();
+        QVERIFY(keepalive.packet().constData() == packet.constData());
+
+        keepalive.setSessionId("other");
+        keepalive.sendKeepalive();
+        QVERIFY(keepalive.packet().contains("\"session_id\":\"other\""));
+    }
+
+    void adaptInterval()
+    {
+        KeepaliveService keepalive;
+        keepalive.setServer(QHostAddress::LocalHost, 9999);
+        keepalive.setIntervalRange(10000, 60000);
+        keepalive.setInterval(20000);
+
+        QVERIFY(!keepalive.processReply(reply(5000), QHostAddress::LocalHost, 9998));
+        QVERIFY(keepalive.processReply(reply(5000), QHostAddress::LocalHost, 9999));
+        QCOMPARE(keepalive.interval(), 20000);
+
+        qDebug("grows while the binding holds");
+        keepalive.processReply(reply(5000), QHostAddress::LocalHost, 9999);
+        QCOMPARE(keepalive.interval(), 25000);
+
+        qDebug("backs off once the binding changed");
+        keepalive.processReply(reply(5001), QHostAddress::LocalHost, 9999);
+        QCOMPARE(keepalive.bindingTimeout(), 25000);
+        QCOMPARE(keepalive.interval(), 18750);
+
+        qDebug("stays below the binding timeout");
+        keepalive.processReply(reply(5001), QHostAddress::LocalHost, 9999);
+        QCOMPARE(keepalive.interval(), 18750);
+    }
+};
+
+QTEST_MAIN(TestKeepaliveService)
+
+#include "tst_keepaliveservice.moc"
@@ -1,4 +1,18 @@
 TEMPLATE = subdirs
 
 SUBDIRS += \
-	timing
+	btc \
+	crosstrafficsampler \
+	devicestatecolumns \
+	dnsclient \
+	json \
+	keepaliveservice \
+	measurementfactory \
+	networkstate \
+	packettrains \
+	peerrequest \
+	pingmesh \
+	schedulerstorage \
+	streamingstats \
+	timing \
+	webrequester
@@ -0,0 +1,8 @@
+CONFIG += testcase
+CONFIG -= app_bundle
+QT += testlib
+
+TARGET = tst_measurementfactory
+SOURCES = tst_measurementfactory.cpp
+
+include($$SOURCE_DIRECTORY/src/libclient/libclient.pri)
@@ -0,0 +1,64 @@
+#include <QtTest>
+
+#include <measurement/measurementfactory.h>
+#include <measurement/measurement.h>
+
+class TestMeasurementFactory : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void poolingDisabled()
+    {
+        MeasurementFactory factory;
+        QVERIFY(!factory.isPoolingEnabled());
+
+        MeasurementPtr first = factory.createMeasurement("ping", TaskId(1));
+        QVERIFY(!first.isNull());
+        factory.recycle("ping", first);
+
+        MeasurementPtr second = factory.createMeasurement("ping", TaskId(2));
+        QVERIFY(first != second);
+        QCOMPARE(factory.allocations(), quint64(2));
+        QCOMPARE(factory.reuses(), quint64(0));
+    }
+
+    void recycle()
+    {
+        MeasurementFactory factory;
+        factory.setPoolingEnabled(true);
+
+        MeasurementPtr first = factory.createMeasurement("ping", TaskId(1));
+        factory.recycle("ping", first);
+
+        MeasurementPtr second = factory.createMeasurement("ping", TaskId(2));
+        QVERIFY(first == second);
+        QCOMPARE(second->taskId(), TaskId(2));
+        QVERIFY(second->errorString().isEmpty());
+        QCOMPARE(factory.allocations(), quint64(1));
+        QCOMPARE(factory.reuses(), quint64(1));
+
+        // pooled per name
+        MeasurementPtr lookup = factory.createMeasurement("dnslookup", TaskId(3));
+        QVERIFY(lookup != second);
+        QCOMPARE(factory.allocations(), quint64(2));
+    }
+
+    void notReusable()
+    {
+        MeasurementFactory factory;
+        factory.setPoolingEnabled(true);
+
+        // upnp keeps the default reset() contract
+        MeasurementPtr first = factory.createMeasurement("upnp", TaskId(1));
+        factory.recycle("upnp", first);
+
+        MeasurementPtr second = factory.createMeasurement("upnp", TaskId(2));
+        QVERIFY(first != second);
+        QCOMPARE(factory.reuses(), quint64(0));
+    }
+};
+
+QTEST_MAIN(TestMeasurementFactory)
+
+#include "tst_measurementfactory.moc"
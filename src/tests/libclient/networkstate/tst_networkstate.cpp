@@ -0,0 +1,83 @@
+#include <QtTest>
+#include <QNetworkInterface>
+
+#include <network/networkstate.h>
+
+#if defined(Q_OS_LINUX) && !defined(Q_OS_ANDROID)
+#define HAVE_RTNETLINK
+#include <unistd.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#endif
+
+class TestNetworkState : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void snapshot()
+    {
+        QVERIFY(!NetworkState::snapshot());
+
+        {
+            NetworkState state;
+            NetworkState::SnapshotPtr snapshot = NetworkState::snapshot();
+            QVERIFY(snapshot);
+
+            bool up = false;
+
+            foreach (const QNetworkInterface &iface, QNetworkInterface::allInterfaces())
+            {
+                if (!(iface.flags() & QNetworkInterface::IsLoopBack) &&
+                    (iface.flags() & (QNetworkInterface::IsUp | QNetworkInterface::IsRunning)))
+                {
+                    up = true;
+                }
+            }
+
+            QCOMPARE(snapshot->interfacesUp, up);
+        }
+
+        QVERIFY(!NetworkState::snapshot());
+    }
+
+    void watching()
+    {
+#ifdef HAVE_RTNETLINK
+        NetworkState state;
+
+        if (!state.isWatching())
+        {
+            // Containers may not allow netlink sockets
+            int fd = ::socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+
+            if (fd == -1)
+            {
+                QSKIP("netlink sockets are not available");
+            }
+
+            ::close(fd);
+        }
+
+        QVERIFY(state.isWatching());
+#else
+        QSKIP("changes are only watched with rtnetlink");
+#endif
+    }
+
+    void refresh()
+    {
+        NetworkState state;
+
+        NetworkState::SnapshotPtr before = NetworkState::snapshot();
+        state.refresh();
+
+        // a new snapshot is published, readers keep the old one
+        QVERIFY(NetworkState::snapshot() != before);
+        QCOMPARE(before->defaultGateway, NetworkState::snapshot()->defaultGateway);
+    }
+};
+
+QTEST_MAIN(TestNetworkState)
+
+#include "tst_networkstate.moc"
@@ -0,0 +1,122 @@
+#include <QtTest>
+#include <QUdpSocket>
+
+#include <measurement/packettrains/packettrainsender.h>
+#include <measurement/packettrains/packettrainspacer.h>
+#include <measurement/packettrains/packettrainsdefinition.h>
+
+class TestPacketTrains : public QObject
+{
+    Q_OBJECT
+
+private:
+    QUdpSocket receiver;
+    QUdpSocket socket;
+
+    QList<msg> receive(int count)
+    {
+        QList<msg> messages;
+        QElapsedTimer timer;
+        timer.start();
+
+        while (messages.size() < count && timer.elapsed() < 5000)
+        {
+            if (!receiver.hasPendingDatagrams() && !receiver.waitForReadyRead(100))
+            {
+                continue;
+            }
+
+            QByteArray datagram(int(receiver.pendingDatagramSize()), 0);
+            receiver.readDatagram(datagram.data(), datagram.size());
+
+            if (datagram.size() >= int(sizeof(msg)))
+            {
+                messages.append(*reinterpret_cast<const msg *>(datagram.constData()));
+            }
+        }
+
+        return messages;
+    }
+
+private slots:
+    void initTestCase()
+    {
+        QVERIFY(receiver.bind(QHostAddress::LocalHost, 0));
+        QVERIFY(socket.bind(QHostAddress::LocalHost, 0));
+    }
+
+    void batchSize()
+    {
+        // 1 µs apart, too short to pace with a system call per packet
+        QCOMPARE(PacketTrainSender::batchSize(0, 10, 1000), 10);
+        QCOMPARE(PacketTrainSender::batchSize(4, 10, 1000), 6);
+        QCOMPARE(PacketTrainSender::batchSize(0, 100, 0), int(PacketTrainSender::maxBatch));
+
+        // longer gaps are paced, every packet on its own
+        QCOMPARE(PacketTrainSender::batchSize(0, 10, PacketTrainSender::syscallCost), 1);
+        QCOMPARE(PacketTrainSender::batchSize(0, 10, 8000), 1);
+        QCOMPARE(PacketTrainSender::batchSize(0, 10, 1000000), 1);
+    }
+
+    void send_data()
+    {
+        QTest::addColumn<qint64>("gap");
+
+        QTest::newRow("batched") << Q_INT64_C(1000);
+        QTest::newRow("short") << Q_INT64_C(8000);
+        QTest::newRow("long") << Q_INT64_C(200000);
+    }
+
+    void send()
+    {
+        QFETCH(qint64, gap);
+
+        const int trainLength = 10;
+        PacketTrainSender sender(&socket, QHostAddress::LocalHost, receiver.localPort(), 100);
+
+        qint64 start = PacketTrainsPacer::now() + 1000000;
+        QCOMPARE(sender.send(3, trainLength, start, gap), trainLength);
+
+        QVERIFY(sender.firstSent() >= start);
+        QVERIFY(sender.lastSent() > sender.firstSent());
+
+        // Even a train sent with one system call takes time to leave
+        QVERIFY(sender.achievedDispersion() > 0);
+
+        if (PacketTrainSender::batchSize(0, trainLength, gap) == 1)
+        {
+            QVERIFY(sender.achievedDispersion() >= gap * 9 / 10);
+        }
+
+        QList<msg> messages = receive(trainLength);
+        QCOMPARE(messages.size(), trainLength);
+
+        for (int i = 0; i < trainLength; ++i)
+        {
+            QCOMPARE(int(messages.at(i).id), i);
+        }
+
+        // Packets sharing a system call still carry their own send time
+        bool batched = PacketTrainSender::batchSize(0, trainLength, gap) == trainLength;
+
+        for (int i = 1; i < trainLength; ++i)
+        {
+            qint64 delta = messages.at(i).otime - messages.at(i - 1).otime;
+
+            if (batched)
+            {
+                QCOMPARE(delta, gap);
+            }
+            else
+            {
+                QVERIFY(delta > 0);
+            }
+        }
+
+        QVERIFY(messages.first().otime >= start);
+    }
+};
+
+QTEST_MAIN(TestPacketTrains)
+
+#include "tst_packettrains.moc"
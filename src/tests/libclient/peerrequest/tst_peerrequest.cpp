@@ -0,0 +1,79 @@
+#include <QtTest>
+#include <QJsonDocument>
+
+#include <network/peerrequest.h>
+
+class TestPeerRequest : public QObject
+{
+    Q_OBJECT
+
+private:
+    PeerRequest request()
+    {
+        QVariantMap definition;
+        definition.insert("host", "measure-it.net");
+        definition.insert("count", 3);
+        definition.insert("interval", 1000);
+
+        PeerRequest request;
+        request.measurementDefinition = definition;
+        request.taskId = TaskId(42);
+        request.measurementUuid = QUuid::createUuid();
+        request.measurement = "btc_ma";
+        request.peer = QString::fromUtf8("gr\xc3\xbc\xc3\x9f-peer.example");
+        request.port = 5106;
+        request.protocol = NetworkManager::TcpSocket;
+        return request;
+    }
+
+private slots:
+    void binary()
+    {
+        PeerRequest sent = request();
+        QByteArray datagram = sent.toBinary();
+        QVERIFY(PeerRequest::isBinary(datagram));
+
+        PeerRequest received;
+        QString errorString;
+        QVERIFY2(PeerRequest::fromBinary(datagram, &received, &errorString), qPrintable(errorString));
+
+        QCOMPARE(received.taskId.toInt(), 42);
+        QCOMPARE(received.measurementUuid, sent.measurementUuid);
+        QCOMPARE(received.measurement, sent.measurement);
+        QCOMPARE(received.peer, sent.peer);
+        QCOMPARE(received.port, sent.port);
+        QCOMPARE(received.protocol, sent.protocol);
+        QCOMPARE(received.measurementDefinition.toMap().value("host").toString(), QString("measure-it.net"));
+        QCOMPARE(received.measurementDefinition.toMap().value("count").toInt(), 3);
+    }
+
+    // The binary form exists to keep offers small
+    void size()
+    {
+        PeerRequest sent = request();
+        QByteArray json = QJsonDocument::fromVariant(sent.toVariant()).toJson(QJsonDocument::Compact);
+        QByteArray binary = sent.toBinary();
+
+        QVERIFY2(binary.size() < json.size() * 2 / 3,
+                 qPrintable(QString("%1 vs. %2 bytes").arg(binary.size()).arg(json.size())));
+    }
+
+    void malformed()
+    {
+        QByteArray datagram = request().toBinary();
+        PeerRequest received;
+        QString errorString;
+
+        // keep the length field consistent, the payload is cut short
+        QByteArray truncated = datagram.left(12);
+        truncated[4] = 0;
+        truncated[5] = truncated.size() - 6;
+        QVERIFY(!PeerRequest::fromBinary(truncated, &received, &errorString));
+
+        QVERIFY(!PeerRequest::fromBinary(datagram.left(datagram.size() - 1), &received, &errorString));
+    }
+};
+
+QTEST_MAIN(TestPeerRequest)
+
+#include "tst_peerrequest.moc"
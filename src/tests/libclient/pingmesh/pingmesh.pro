@@ -0,0 +1,6 @@
+CONFIG += testcase
+CONFIG -= app_bundle
+QT += testlib network
+TARGET = tst_pingmesh
+SOURCES = tst_pingmesh.cpp
+include($$SOURCE_DIRECTORY/src/libclient/libclient.pri)
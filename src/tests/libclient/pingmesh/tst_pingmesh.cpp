@@ -0,0 +1,177 @@
+#include <QtTest>
+#include <QUdpSocket>
+
+#include <client.h>
+#include <trafficbudgetmanager.h>
+#include <measurement/measurementfactory.h>
+#include <measurement/measurement.h>
+
+#include <string.h>
+
+// Udp echo which records the target index of every probe and can drop or
+// duplicate the answers for some sequence numbers
+class Echo : public QObject
+{
+    Q_OBJECT
+
+public:
+    Echo(QList<quint32> *order)
+    : order(order)
+    {
+        connect(&socket, SIGNAL(readyRead()), this, SLOT(readPending()));
+    }
+
+    QUdpSocket socket;
+    QList<quint32> *order;
+    QList<quint32> drop;
+    QList<quint32> duplicate;
+
+private slots:
+    void readPending()
+    {
+        while (socket.hasPendingDatagrams())
+        {
+            QByteArray datagram(int(socket.pendingDatagramSize()), 0);
+            QHostAddress sender;
+            quint16 senderPort;
+            socket.readDatagram(datagram.data(), datagram.size(), &sender, &senderPort);
+
+            quint32 header[2];
+
+            if (datagram.size() < int(sizeof(header)))
+            {
+                continue;
+            }
+
+            memcpy(header, datagram.constData(), sizeof(header));
+            order->append(header[0]);
+
+            if (drop.contains(header[1]))
+            {
+                continue;
+            }
+
+            socket.writeDatagram(datagram, sender, senderPort);
+
+            if (duplicate.contains(header[1]))
+            {
+                socket.writeDatagram(datagram, sender, senderPort);
+            }
+        }
+    }
+};
+
+class TestPingMesh : public QObject
+{
+    Q_OBJECT
+
+private:
+    MeasurementFactory factory;
+
+    bool waitFor(const QSignalSpy &done, const QSignalSpy &failed, int timeout)
+    {
+        QElapsedTimer timer;
+        timer.start();
+
+        while (done.isEmpty() && failed.isEmpty() && timer.elapsed() < timeout)
+        {
+            QTest::qWait(10);
+        }
+
+        return !done.isEmpty() && failed.isEmpty();
+    }
+
+    MeasurementDefinitionPtr definition(const QStringList &targets, quint16 port, int count)
+    {
+        QVariantMap options;
+        options.insert("targets", targets);
+        options.insert("destination_port", port);
+        options.insert("count", count);
+        options.insert("interval", 50);
+        options.insert("timeout", 300);
+        return factory.createMeasurementDefinition("pingmesh", options);
+    }
+
+private slots:
+    void initTestCase()
+    {
+#ifndef Q_OS_LINUX
+        QSKIP("pingmesh is only available on Linux");
+#endif
+        // The measurement accounts its traffic while preparing
+        Client::instance()->trafficBudgetManager()->init();
+    }
+
+    // Only prepareAsync() resolves hostnames, prepare() must not pretend
+    void prepareHostname()
+    {
+        MeasurementPtr measurement = factory.createMeasurement("pingmesh", TaskId(1));
+
+        QVERIFY(!measurement->prepare(NULL, definition(QStringList() << "localhost", 33434, 3)));
+        QVERIFY(!measurement->start());
+    }
+
+    void echo()
+    {
+        const int count = 5;
+        QList<quint32> order;
+
+        Echo first(&order);
+        QVERIFY(first.socket.bind(QHostAddress("127.0.0.1"), 0));
+        first.duplicate << 0;
+
+        Echo second(&order);
+
+        if (!second.socket.bind(QHostAddress("127.0.0.2"), first.socket.localPort()))
+        {
+            QSKIP("127.0.0.2 is not available");
+        }
+
+        second.drop << 2;
+
+        MeasurementPtr measurement = factory.createMeasurement("pingmesh", TaskId(2));
+        QSignalSpy prepared(measurement.data(), SIGNAL(prepared()));
+        QSignalSpy finished(measurement.data(), SIGNAL(finished()));
+        QSignalSpy error(measurement.data(), SIGNAL(error(QString)));
+
+        QStringList targets;
+        targets << "127.0.0.1" << "127.0.0.2";
+
+        QVERIFY2(measurement->prepareAsync(NULL, definition(targets, first.socket.localPort(), count)),
+                 qPrintable(measurement->errorString()));
+        QVERIFY(waitFor(prepared, error, 5000));
+        QVERIFY2(measurement->start(), qPrintable(measurement->errorString()));
+        QVERIFY(waitFor(finished, error, 5000));
+
+        // Probes alternate between the targets
+        QCOMPARE(order.size(), 2 * count);
+
+        for (int i = 0; i < order.size(); ++i)
+        {
+            QCOMPARE(order.at(i), quint32(i % 2));
+        }
+
+        QVariantMap result = measurement->result().probeResult();
+        QCOMPARE(result.value("probes_sent").toInt(), 2 * count);
+        QCOMPARE(result.value("probes_received").toInt(), 2 * count - 1);
+
+        // The duplicate answer counts once, the dropped one is lost
+        QVariantList list = result.value("targets").toList();
+        QCOMPARE(list.size(), 2);
+
+        QVariantMap answered = list.at(0).toMap();
+        QCOMPARE(answered.value("round_trip_received").toInt(), count);
+        QVERIFY(answered.value("round_trip_loss").toFloat() == 0);
+
+        QVariantMap lossy = list.at(1).toMap();
+        QCOMPARE(lossy.value("round_trip_sent").toInt(), count);
+        QCOMPARE(lossy.value("round_trip_received").toInt(), count - 1);
+        QCOMPARE(lossy.value("round_trip_loss").toFloat(), 1.0f / count);
+
+        measurement->stop();
+    }
+};
+
+QTEST_MAIN(TestPingMesh)
+
+#include "tst_pingmesh.moc"
@@ -0,0 +1,124 @@
+#include <QtTest>
+
+#include <scheduler/scheduler.h>
+#include <scheduler/schedulerstorage.h>
+#include <storage/storagepaths.h>
+
+class TestSchedulerStorage : public QObject
+{
+    Q_OBJECT
+
+private:
+    ScheduleDefinition schedule(int id)
+    {
+        QVariantMap periodic;
+        periodic.insert("interval", 3600000);
+
+        QVariantMap timing;
+        timing.insert("periodic", periodic);
+
+        QVariantMap options;
+        options.insert("host", QString("host%1.example.com").arg(id));
+        options.insert("count", 3);
+
+        QVariantMap task;
+        task.insert("id", 1);
+        task.insert("method", "ping");
+        task.insert("options", options);
+
+        QVariantMap map;
+        map.insert("id", id);
+        map.insert("timing", timing);
+        map.insert("precondition", QVariantMap());
+        map.insert("task", task);
+
+        return ScheduleDefinition::fromVariant(map);
+    }
+
+    void fillStore(int count)
+    {
+        ScheduleDefinitionList tests;
+
+        for (int i = 1; i <= count; ++i)
+        {
+            tests.append(schedule(i));
+        }
+
+        Scheduler scheduler;
+        SchedulerStorage storage(&scheduler);
+        scheduler.enqueueMany(tests);
+        storage.storeData();
+    }
+
+private slots:
+    void initTestCase()
+    {
+        QStandardPaths::setTestModeEnabled(true);
+    }
+
+    void init()
+    {
+        QDir dir = StoragePaths().schedulerDirectory();
+        dir.removeRecursively();
+    }
+
+    void roundTrip()
+    {
+        fillStore(3);
+
+        Scheduler scheduler;
+        SchedulerStorage storage(&scheduler);
+        storage.loadData();
+
+        QCOMPARE(scheduler.tests().size(), 3);
+        QVERIFY(scheduler.knownTestId(ScheduleId(2)));
+
+        ScheduleDefinition test = scheduler.tests().first();
+        QCOMPARE(test.name(), QString("ping"));
+        QCOMPARE(test.timing()->type(), QString("periodic"));
+        QCOMPARE(test.measurementDefinition().toMap().value("count").toInt(), 3);
+    }
+
+    void appendLog()
+    {
+        fillStore(3);
+
+        {
+            Scheduler scheduler;
+            SchedulerStorage storage(&scheduler);
+            storage.loadData();
+
+            // changes are appended to the store without a snapshot
+            scheduler.update(ScheduleDefinitionList() << schedule(4), QList<ScheduleId>() << ScheduleId(1));
+            scheduler.dequeue(ScheduleId(2));
+        }
+
+        Scheduler scheduler;
+        SchedulerStorage storage(&scheduler);
+        storage.loadData();
+
+        QCOMPARE(scheduler.tests().size(), 2);
+        QVERIFY(!scheduler.knownTestId(ScheduleId(1)));
+        QVERIFY(!scheduler.knownTestId(ScheduleId(2)));
+        QVERIFY(scheduler.knownTestId(ScheduleId(3)));
+        QVERIFY(scheduler.knownTestId(ScheduleId(4)));
+    }
+
+    void coldStart()
+    {
+        fillStore(10000);
+
+        QBENCHMARK
+        {
+            Scheduler scheduler;
+            SchedulerStorage storage(&scheduler);
+            storage.loadData();
+
+            QCOMPARE(scheduler.tests().size(), 10000);
+        }
+    }
+};
+
+QTEST_MAIN(TestSchedulerStorage)
+
+#include "tst_schedulerstorage.moc"
@@ -0,0 +1,136 @@
+#include <QtTest>
+
+#include <measurement/streamingstats.h>
+
+#include <algorithm>
+
+class TestStreamingStats : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void empty()
+    {
+        StreamingStats stats;
+
+        QCOMPARE(stats.count(), quint64(0));
+        QCOMPARE(stats.mean(), 0.0);
+        QCOMPARE(stats.stdev(), 0.0);
+        QCOMPARE(stats.min(), 0.0);
+        QCOMPARE(stats.max(), 0.0);
+        QCOMPARE(stats.quantile(0.5), 0.0);
+    }
+
+    void moments()
+    {
+        StreamingStats stats;
+
+        foreach (double value, QList<double>() << 2 << 4 << 4 << 4 << 5 << 5 << 7 << 9)
+        {
+            stats.add(value);
+        }
+
+        QCOMPARE(stats.count(), quint64(8));
+        QCOMPARE(stats.mean(), 5.0);
+        QCOMPARE(stats.stdev(), 2.0);
+        QCOMPARE(stats.min(), 2.0);
+        QCOMPARE(stats.max(), 9.0);
+        QCOMPARE(stats.sum(), 40.0);
+    }
+
+    void largeOffset()
+    {
+        // sq_sum / n - avg * avg loses all digits here
+        StreamingStats stats;
+
+        for (int i = 0; i < 1000; ++i)
+        {
+            stats.add(1e9 + i % 2);
+        }
+
+        QVERIFY(qAbs(stats.stdev() - 0.5) < 1e-6);
+    }
+
+    void quantiles()
+    {
+        StreamingStats stats;
+        QList<double> values;
+
+        qsrand(42);
+
+        for (int i = 0; i < 10000; ++i)
+        {
+            double value = 0.1 + qrand() % 100000 / 100.0;
+            values.append(value);
+            stats.add(value);
+        }
+
+        std::sort(values.begin(), values.end());
+
+        foreach (double q, QList<double>() << 0.5 << 0.9 << 0.99)
+        {
+            double exact = values.at(q * (values.size() - 1));
+            QVERIFY2(qAbs(stats.quantile(q) - exact) <= exact * 0.011,
+                     qPrintable(QString("p%1: %2 vs %3").arg(q).arg(stats.quantile(q)).arg(exact)));
+        }
+
+        QCOMPARE(stats.quantile(0), values.first());
+        QCOMPARE(stats.quantile(1), values.last());
+    }
+
+    void merge()
+    {
+        StreamingStats all;
+        StreamingStats even;
+        StreamingStats odd;
+
+        for (int i = 1; i <= 1000; ++i)
+        {
+            all.add(i);
+            (i % 2 ? odd : even).add(i);
+        }
+
+        even.merge(odd);
+
+        QCOMPARE(even.count(), all.count());
+        QCOMPARE(even.min(), all.min());
+        QCOMPARE(even.max(), all.max());
+        QVERIFY(qAbs(even.mean() - all.mean()) < 1e-9);
+        QVERIFY(qAbs(even.stdev() - all.stdev()) < 1e-9);
+
+        // Same buckets, so the sketches are identical
+        QCOMPARE(even.quantile(0.5), all.quantile(0.5));
+        QCOMPARE(even.quantile(0.9), all.quantile(0.9));
+        QCOMPARE(even.quantile(0.99), all.quantile(0.99));
+    }
+
+    void mergeIntoEmpty()
+    {
+        StreamingStats stats;
+        StreamingStats other;
+
+        other.add(3);
+        other.add(5);
+        stats.merge(other);
+        stats.merge(StreamingStats());
+
+        QCOMPARE(stats.count(), quint64(2));
+        QCOMPARE(stats.mean(), 4.0);
+        QCOMPARE(stats.min(), 3.0);
+    }
+
+    void zeros()
+    {
+        StreamingStats stats;
+        stats.add(0);
+        stats.add(0);
+        stats.add(10);
+
+        QCOMPARE(stats.quantile(0.5), 0.0);
+        QCOMPARE(stats.quantile(1), 10.0);
+    }
+};
+
+QTEST_MAIN(TestStreamingStats)
+
+#include "tst_streamingstats.moc"
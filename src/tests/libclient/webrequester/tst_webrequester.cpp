@@ -0,0 +1,157 @@
+#include <QtTest>
+#include <QTcpServer>
+#include <QTcpSocket>
+
+#include <webrequester.h>
+#include <network/requests/resourcerequest.h>
+#include <network/responses/getinstructionresponse.h>
+
+// Stand-in for the supervisor which serves versioned instructions
+class InstructionServer : public QTcpServer
+{
+    Q_OBJECT
+
+public:
+    InstructionServer()
+    : version("2")
+    {
+        connect(this, SIGNAL(newConnection()), this, SLOT(handleConnection()));
+    }
+
+    QByteArray version;
+    QByteArray ifNoneMatch;
+
+private slots:
+    void handleConnection()
+    {
+        while (hasPendingConnections())
+        {
+            QTcpSocket *socket = nextPendingConnection();
+            connect(socket, SIGNAL(readyRead()), this, SLOT(readRequest()));
+            connect(socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()));
+        }
+    }
+
+    void readRequest()
+    {
+        QTcpSocket *socket = qobject_cast<QTcpSocket *>(sender());
+        QByteArray request = socket->property("request").toByteArray() + socket->readAll();
+        socket->setProperty("request", request);
+
+        if (!request.contains("\r\n\r\n"))
+        {
+            return;
+        }
+
+        QList<QByteArray> lines = request.left(request.indexOf("\r\n\r\n")).split('\n');
+        QUrl url(QString::fromLatin1(lines.first().split(' ').value(1)));
+        QString since = QUrlQuery(url).queryItemValue("since");
+
+        ifNoneMatch.clear();
+
+        foreach (const QByteArray &line, lines)
+        {
+            if (line.toLower().startsWith("if-none-match:"))
+            {
+                ifNoneMatch = line.mid(line.indexOf(':') + 1).trimmed();
+            }
+        }
+
+        QByteArray eTag = "\"" + version + "\"";
+        QByteArray reply;
+
+        if (ifNoneMatch == eTag)
+        {
+            reply = "HTTP/1.1 304 Not Modified\r\nETag: " + eTag + "\r\nConnection: close\r\n\r\n";
+        }
+        else
+        {
+            QByteArray body;
+
+            if (since.isEmpty())
+            {
+                body = "{\"version\": \"" + version + "\", \"schedules\": [1, 2, 3], \"remove_schedules\": []}";
+            }
+            else
+            {
+                body = "{\"version\": \"" + version + "\", \"delta\": true, \"schedules\": [4], \"remove_schedules\": [1]}";
+            }
+
+            reply = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nETag: " + eTag +
+                    "\r\nContent-Length: " + QByteArray::number(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+        }
+
+        socket->write(reply);
+        socket->disconnectFromHost();
+    }
+};
+
+class TestWebRequester : public QObject
+{
+    Q_OBJECT
+
+private:
+    bool fetch(WebRequester *requester)
+    {
+        QSignalSpy finished(requester, SIGNAL(finished()));
+        QSignalSpy error(requester, SIGNAL(error()));
+
+        requester->start();
+
+        for (int i = 0; i < 50 && finished.isEmpty() && error.isEmpty(); ++i)
+        {
+            finished.wait(100);
+        }
+
+        return !finished.isEmpty();
+    }
+
+private slots:
+    void versionedInstructions()
+    {
+        InstructionServer server;
+        QVERIFY(server.listen(QHostAddress::LocalHost));
+
+        GetResourceRequest request;
+        request.setPath("/supervisor/api/v1/instruction/1/");
+        GetInstructionResponse response;
+
+        WebRequester requester;
+        requester.setUrl(QUrl(QString("http://127.0.0.1:%1").arg(server.serverPort())));
+        requester.setRequest(&request);
+        requester.setResponse(&response);
+
+        qDebug("full list without a known version");
+        QVERIFY(fetch(&requester));
+        QVERIFY(!requester.notModified());
+        QVERIFY(server.ifNoneMatch.isEmpty());
+        QCOMPARE(response.isDelta(), false);
+        QCOMPARE(response.version(), QString("2"));
+        QCOMPARE(response.scheduleIds().size(), 3);
+        QCOMPARE(requester.eTag(), QByteArray("\"2\""));
+
+        qDebug("not modified if the version is current");
+        QVariantMap data;
+        data.insert("since", "2");
+        request.addData(data);
+        QVERIFY(fetch(&requester));
+        QCOMPARE(server.ifNoneMatch, QByteArray("\"2\""));
+        QVERIFY(requester.notModified());
+        QCOMPARE(response.version(), QString("2"));
+
+        qDebug("only changes after a new version");
+        server.version = "3";
+        requester.setETag("\"2\"");
+        QVERIFY(fetch(&requester));
+        QVERIFY(!requester.notModified());
+        QCOMPARE(response.isDelta(), true);
+        QCOMPARE(response.version(), QString("3"));
+        QCOMPARE(response.scheduleIds(), QList<ScheduleId>() << ScheduleId(4));
+        QCOMPARE(response.removeScheduleIds(), QList<ScheduleId>() << ScheduleId(1));
+        QCOMPARE(requester.eTag(), QByteArray("\"3\""));
+    }
+};
+
+QTEST_MAIN(TestWebRequester)
+
+#include "tst_webrequester.moc"
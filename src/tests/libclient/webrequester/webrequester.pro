@@ -0,0 +1,8 @@
+CONFIG += testcase
+CONFIG -= app_bundle
+QT += testlib network
+
+TARGET = tst_webrequester
+SOURCES = tst_webrequester.cpp
+
+include($$SOURCE_DIRECTORY/src/libclient/libclient.pri)